@@ -24,14 +24,14 @@
 
 #include "credentials.h"
 
-#include "strings.h" /* for gvm_append_text */
+#include "strings.h" /* for gvm_append_text, gvm_strbuf_append_text */
 
 #include <string.h>
 
 /**
  * @brief Free credentials.
  *
- * Free the members of a credentials pair.
+ * Free the members of a credentials pair, zeroing the password first.
  *
  * @param[in]  credentials  Pointer to the credentials.
  */
@@ -39,6 +39,8 @@ void
 free_credentials (credentials_t *credentials)
 {
   g_free (credentials->username);
+  if (credentials->password)
+    gvm_secure_zero (credentials->password, strlen (credentials->password));
   g_free (credentials->password);
   g_free (credentials->uuid);
   g_free (credentials->timezone);
@@ -64,6 +66,8 @@ append_to_credentials_username (credentials_t *credentials, const char *text,
 /**
  * @brief Append text to the password of a credential pair.
  *
+ * The previous buffer of the password is zeroed before it is freed.
+ *
  * @param[in]  credentials  Credentials.
  * @param[in]  text         The text to append.
  * @param[in]  length       Length of the text.
@@ -72,5 +76,11 @@ void
 append_to_credentials_password (credentials_t *credentials, const char *text,
                                 gsize length)
 {
-  gvm_append_text (&credentials->password, text, length);
+  gvm_strbuf_t buf;
+
+  /* The builder only lives for the call, the caller owns the password. */
+  gvm_strbuf_init (&buf, 1);
+  gvm_strbuf_adopt (&buf, credentials->password);
+  gvm_strbuf_append_text (&buf, text, length);
+  credentials->password = gvm_strbuf_steal (&buf);
 }
@@ -23,7 +23,7 @@
  *
  * This file contains utility functions for handling CVSS.
  * Namels a calculator for the CVSS base score from a CVSS base
- * vector.
+ * vector, for CVSSv2 and CVSSv3.
  *
  * The base equation is the foundation of CVSS scoring. The base equation is:
  * BaseScore6
@@ -62,8 +62,11 @@
  *                       complete:          0.660
  */
 
+#define _GNU_SOURCE
+
 #include <glib.h>
-#include <string.h>
+#include <math.h>   /* for pow */
+#include <string.h> /* for strchrnul, memchr, memcmp, strlen */
 
 // clang-format off
 /**
@@ -184,36 +187,244 @@ static const struct impact_item impact_map[][3] = {
 };
 
 /**
- * @brief Determine base metric enumeration from a string.
+ * @brief Names of the base metrics, indexed by enum base_metrics.
+ */
+static const char *const metric_names[] = {
+  [A] = "A", [I] = "I", [C] = "C", [Au] = "Au", [AC] = "AC", [AV] = "AV",
+};
+
+/**
+ * @brief Number of CVSSv2 base metrics.
+ */
+#define CVSS2_METRICS 6
+
+/**
+ * @brief Number of packed CVSSv2 metric tuples.
+ *
+ * Each metric is unset or one of its three values, see
+ * \ref cvss2_pack.
+ */
+#define CVSS2_TUPLES (4 * 4 * 4 * 4 * 4 * 4)
+
+/**
+ * @brief Description of a CVSSv3 base metric.
+ */
+struct cvss3_metric
+{
+  const char *name;     /**< Metric name, e.g. "AV". */
+  const char *values;   /**< Value letters, one per value. */
+  double weights[4];    /**< Weight of each value. */
+  double weights_sc[4]; /**< Weight if the scope changed, for PR only. */
+};
+
+/**
+ * @brief CVSSv3 base metrics.
+ */
+enum cvss3_base_metrics
+{
+  V3_AV, /**< Attack Vector. */
+  V3_AC, /**< Attack Complexity. */
+  V3_PR, /**< Privileges Required. */
+  V3_UI, /**< User Interaction. */
+  V3_S,  /**< Scope. */
+  V3_C,  /**< Confidentiality Impact. */
+  V3_I,  /**< Integrity Impact. */
+  V3_A,  /**< Availability Impact. */
+  V3_METRICS
+};
+
+// clang-format off
+/**
+ * @brief CVSSv3 base metric weights, from the CVSS v3.1 specification.
+ */
+static const struct cvss3_metric cvss3_metrics[V3_METRICS] = {
+  [V3_AV] = {"AV", "NALP", {0.85, 0.62, 0.55, 0.2}, {0}},
+  [V3_AC] = {"AC", "LH",   {0.77, 0.44},            {0}},
+  [V3_PR] = {"PR", "NLH",  {0.85, 0.62, 0.27},      {0.85, 0.68, 0.5}},
+  [V3_UI] = {"UI", "NR",   {0.85, 0.62},            {0}},
+  [V3_S]  = {"S",  "UC",   {0},                     {0}},
+  [V3_C]  = {"C",  "HLN",  {0.56, 0.22, 0},         {0}},
+  [V3_I]  = {"I",  "HLN",  {0.56, 0.22, 0},         {0}},
+  [V3_A]  = {"A",  "HLN",  {0.56, 0.22, 0},         {0}},
+};
+// clang-format on
+
+/**
+ * @brief Number of packed CVSSv3 metric tuples.
+ */
+#define CVSS3_TUPLES (4 * 2 * 3 * 2 * 2 * 3 * 3 * 3)
+
+/**
+ * @brief Precomputed scores, indexed by packed metric tuple.
+ */
+static double cvss2_scores[CVSS2_TUPLES];
+
+/**
+ * @brief Precomputed scores, indexed by packed metric tuple.
+ */
+static double cvss3_scores[CVSS3_TUPLES];
+
+/**
+ * @brief Find the metric of a vector element.
+ *
+ * @param[in]  name  Metric name, not NULL terminated.
+ * @param[in]  len   Length of name.
+ *
+ * @return The metric, -1 if unknown.
+ */
+static int
+cvss2_metric (const char *name, size_t len)
+{
+  int metric;
+
+  if (len == 2 && name[0] == 'A' && name[1] == 'U')
+    return Au;
+  for (metric = 0; metric < CVSS2_METRICS; metric++)
+    if (strlen (metric_names[metric]) == len
+        && memcmp (metric_names[metric], name, len) == 0)
+      return metric;
+  return -1;
+}
+
+/**
+ * @brief Find the index of a metric value.
  *
- * @param[in]  str Base metric in string form, for example "A".
- * @param[out] res Where to write the desired value.
+ * @param[in]  metric  The metric.
+ * @param[in]  value   The value letter.
+ *
+ * @return Index of the value in \ref impact_map, -1 if invalid.
+ */
+static int
+cvss2_value (int metric, char value)
+{
+  int i;
+
+  for (i = 0; i < 3; i++)
+    if (impact_map[metric][i].name[0] == value)
+      return i;
+  return -1;
+}
+
+/**
+ * @brief Find the metric of a vector element.
+ *
+ * @param[in]  name  Metric name, not NULL terminated.
+ * @param[in]  len   Length of name.
+ *
+ * @return The metric, -1 if unknown.
+ */
+static int
+cvss3_metric (const char *name, size_t len)
+{
+  int metric;
+
+  for (metric = 0; metric < V3_METRICS; metric++)
+    if (strlen (cvss3_metrics[metric].name) == len
+        && memcmp (cvss3_metrics[metric].name, name, len) == 0)
+      return metric;
+  return -1;
+}
+
+/**
+ * @brief Find the index of a metric value.
+ *
+ * @param[in]  metric  The metric.
+ * @param[in]  value   The value letter.
+ *
+ * @return Index of the value in \ref cvss3_metrics, -1 if invalid.
+ */
+static int
+cvss3_value (int metric, char value)
+{
+  const char *found;
+
+  found = strchr (cvss3_metrics[metric].values, value);
+  if (found == NULL || value == '\0')
+    return -1;
+  return found - cvss3_metrics[metric].values;
+}
+
+/**
+ * @brief Parse a vector in place.
+ *
+ * The vector is a list of "NAME:VALUE" elements separated by slashes.
+ * Every element must be valid, a later element overrides an earlier one
+ * of the same metric.
+ *
+ * @param[in]  str        The vector.
+ * @param[in]  find       Function that finds the metric of a name.
+ * @param[in]  find_value Function that finds the index of a value.
+ * @param[out] values     Value index of each metric, -1 for the metrics
+ *                        that were not given.
+ * @param[in]  count      Number of metrics.
  *
  * @return 0 on success, -1 on error.
  */
 static int
-toenum (const char *str, enum base_metrics *res)
+cvss_parse (const char *str, int (*find) (const char *, size_t),
+            int (*find_value) (int, char), int *values, int count)
 {
-  int rc = 0; /* let's be optimistic */
-
-  if (g_strcmp0 (str, "A") == 0)
-    *res = A;
-  else if (g_strcmp0 (str, "I") == 0)
-    *res = I;
-  else if (g_strcmp0 (str, "C") == 0)
-    *res = C;
-  else if (g_strcmp0 (str, "Au") == 0)
-    *res = Au;
-  else if (g_strcmp0 (str, "AU") == 0)
-    *res = Au;
-  else if (g_strcmp0 (str, "AV") == 0)
-    *res = AV;
-  else if (g_strcmp0 (str, "AC") == 0)
-    *res = AC;
-  else
-    rc = -1;
+  int i;
 
-  return rc;
+  for (i = 0; i < count; i++)
+    values[i] = -1;
+
+  for (;;)
+    {
+      const char *colon, *end;
+      int metric, value;
+
+      end = strchrnul (str, '/');
+      colon = memchr (str, ':', end - str);
+      if (colon == NULL || colon == str || end - colon != 2)
+        return -1;
+
+      metric = find (str, colon - str);
+      if (metric < 0)
+        return -1;
+      value = find_value (metric, colon[1]);
+      if (value < 0)
+        return -1;
+      values[metric] = value;
+
+      if (*end == '\0')
+        return 0;
+      str = end + 1;
+    }
+}
+
+/**
+ * @brief Pack CVSSv2 metric values into a table index.
+ *
+ * @param[in]  values  Value index of each metric, -1 if not given.
+ *
+ * @return Index into \ref cvss2_scores.
+ */
+static int
+cvss2_pack (const int *values)
+{
+  int metric, index = 0;
+
+  for (metric = 0; metric < CVSS2_METRICS; metric++)
+    index = index * 4 + values[metric] + 1;
+  return index;
+}
+
+/**
+ * @brief Pack CVSSv3 metric values into a table index.
+ *
+ * @param[in]  values  Value index of each metric.
+ *
+ * @return Index into \ref cvss3_scores.
+ */
+static int
+cvss3_pack (const int *values)
+{
+  int metric, index = 0;
+
+  for (metric = 0; metric < V3_METRICS; metric++)
+    index = index * strlen (cvss3_metrics[metric].values) + values[metric];
+  return index;
 }
 
 /**
@@ -248,64 +459,6 @@ get_exploitability_subscore (const struct cvss *cvss)
           * cvss->authentication);
 }
 
-/**
- * @brief  Set impact score from string representation.
- *
- * @param[in] value  The literal value associated to the metric.
- * @param[in] metric The enumeration constant identifying the metric.
- * @param[out] cvss  The structure to update with the score.
- *
- * @return 0 on success, -1 on error.
- */
-static inline int
-set_impact_from_str (const char *value, enum base_metrics metric,
-                     struct cvss *cvss)
-{
-  int i;
-
-  for (i = 0; i < 3; i++)
-    {
-      const struct impact_item *impact;
-
-      impact = &impact_map[metric][i];
-
-      if (g_strcmp0 (impact->name, value) == 0)
-        {
-          switch (metric)
-            {
-            case A:
-              cvss->avail_impact = impact->nvalue;
-              break;
-
-            case I:
-              cvss->integ_impact = impact->nvalue;
-              break;
-
-            case C:
-              cvss->conf_impact = impact->nvalue;
-              break;
-
-            case Au:
-              cvss->authentication = impact->nvalue;
-              break;
-
-            case AV:
-              cvss->access_vector = impact->nvalue;
-              break;
-
-            case AC:
-              cvss->access_complexity = impact->nvalue;
-              break;
-
-            default:
-              return -1;
-            }
-          return 0;
-        }
-    }
-  return -1;
-}
-
 /**
  * @brief Final CVSS score computation helper.
  *
@@ -332,57 +485,168 @@ __get_cvss_score (struct cvss *cvss)
 }
 
 /**
- * @brief Calculate CVSS Score.
+ * @brief Round up to one decimal, as defined by CVSS v3.1.
  *
- * @param cvss_str Base vector string from which to compute score.
+ * @param[in] value  The value to round.
  *
- * @return The resulting score. -1 upon error during parsing.
+ * @return The smallest number with one decimal not below value.
  */
-double
-get_cvss_score_from_base_metrics (const char *cvss_str)
+static double
+cvss3_roundup (double value)
 {
-  struct cvss cvss;
-  char *token, *base_str, *base_metrics;
+  long int_input;
 
-  memset (&cvss, 0x00, sizeof (struct cvss));
+  int_input = (long) (value * 100000 + 0.5);
+  if (int_input % 10000 == 0)
+    return int_input / 100000.0;
+  return (int_input / 10000 + 1) / 10.0;
+}
 
-  if (cvss_str == NULL)
-    return -1.0;
+/**
+ * @brief Compute a CVSSv3 base score.
+ *
+ * @param[in] values  Value index of each metric.
+ *
+ * @return The base score.
+ */
+static double
+cvss3_score (const int *values)
+{
+  double iss, impact, exploitability;
+  int changed;
+
+  changed = values[V3_S] == 1;
+  iss = 1
+        - (1 - cvss3_metrics[V3_C].weights[values[V3_C]])
+            * (1 - cvss3_metrics[V3_I].weights[values[V3_I]])
+            * (1 - cvss3_metrics[V3_A].weights[values[V3_A]]);
+  if (changed)
+    impact = 7.52 * (iss - 0.029) - 3.25 * pow (iss - 0.02, 15);
+  else
+    impact = 6.42 * iss;
+
+  exploitability =
+    8.22 * cvss3_metrics[V3_AV].weights[values[V3_AV]]
+    * cvss3_metrics[V3_AC].weights[values[V3_AC]]
+    * (changed ? cvss3_metrics[V3_PR].weights_sc[values[V3_PR]]
+               : cvss3_metrics[V3_PR].weights[values[V3_PR]])
+    * cvss3_metrics[V3_UI].weights[values[V3_UI]];
+
+  if (impact <= 0)
+    return 0.0;
+  if (changed)
+    return cvss3_roundup (MIN (1.08 * (impact + exploitability), 10));
+  return cvss3_roundup (MIN (impact + exploitability, 10));
+}
 
-  base_str = base_metrics = g_strdup_printf ("%s/", cvss_str);
+/**
+ * @brief Fill the score tables, once.
+ */
+static void
+cvss_init_tables (void)
+{
+  static gsize initialized = 0;
 
-  while ((token = strchr (base_metrics, '/')) != NULL)
+  if (g_once_init_enter (&initialized))
     {
-      char *token2 = strtok (base_metrics, ":");
-      char *metric_name = token2;
-      char *metric_value;
-      enum base_metrics mval;
-      int rc;
+      int index, metric, values[V3_METRICS];
 
-      *token++ = '\0';
+      for (index = 0; index < CVSS2_TUPLES; index++)
+        {
+          struct cvss cvss;
+          double *fields[CVSS2_METRICS];
+          int rest = index;
+
+          fields[A] = &cvss.avail_impact;
+          fields[I] = &cvss.integ_impact;
+          fields[C] = &cvss.conf_impact;
+          fields[Au] = &cvss.authentication;
+          fields[AC] = &cvss.access_complexity;
+          fields[AV] = &cvss.access_vector;
+          for (metric = CVSS2_METRICS - 1; metric >= 0; metric--)
+            {
+              int value = rest % 4 - 1;
 
-      if (metric_name == NULL)
-        goto ret_err;
+              rest /= 4;
+              *fields[metric] =
+                value < 0 ? 0.0 : impact_map[metric][value].nvalue;
+            }
+          cvss2_scores[index] = __get_cvss_score (&cvss);
+        }
 
-      metric_value = strtok (NULL, ":");
+      for (index = 0; index < CVSS3_TUPLES; index++)
+        {
+          int rest = index;
 
-      if (metric_value == NULL)
-        goto ret_err;
+          for (metric = V3_METRICS - 1; metric >= 0; metric--)
+            {
+              int radix = strlen (cvss3_metrics[metric].values);
 
-      rc = toenum (metric_name, &mval);
-      if (rc)
-        goto ret_err;
+              values[metric] = rest % radix;
+              rest /= radix;
+            }
+          cvss3_scores[index] = cvss3_score (values);
+        }
 
-      if (set_impact_from_str (metric_value, mval, &cvss))
-        goto ret_err;
+      g_once_init_leave (&initialized, 1);
+    }
+}
 
-      base_metrics = token;
+/**
+ * @brief Calculate CVSS Score.
+ *
+ * Accepts CVSSv2 base vectors like "AV:N/AC:L/Au:N/C:N/I:N/A:C", where
+ * missing metrics count as 0, and CVSSv3 base vectors like
+ * "CVSS:3.1/AV:N/AC:L/PR:N/UI:N/S:U/C:H/I:H/A:H", which must give all
+ * metrics.  The vector is parsed in place and the score taken from a
+ * table of all metric combinations, so nothing is allocated.
+ *
+ * @param cvss_str Base vector string from which to compute score.
+ *
+ * @return The resulting score. -1 upon error during parsing.
+ */
+double
+get_cvss_score_from_base_metrics (const char *cvss_str)
+{
+  int values[V3_METRICS], metric;
+
+  if (cvss_str == NULL)
+    return -1.0;
+
+  cvss_init_tables ();
+
+  if (g_str_has_prefix (cvss_str, "CVSS:3.0/")
+      || g_str_has_prefix (cvss_str, "CVSS:3.1/"))
+    {
+      if (cvss_parse (cvss_str + strlen ("CVSS:3.x/"), cvss3_metric,
+                      cvss3_value, values, V3_METRICS))
+        return -1.0;
+      for (metric = 0; metric < V3_METRICS; metric++)
+        if (values[metric] < 0)
+          return -1.0;
+      return cvss3_scores[cvss3_pack (values)];
     }
 
-  g_free (base_str);
-  return __get_cvss_score (&cvss);
+  if (cvss_parse (cvss_str, cvss2_metric, cvss2_value, values, CVSS2_METRICS))
+    return -1.0;
+  return cvss2_scores[cvss2_pack (values)];
+}
+
+/**
+ * @brief Calculate the CVSS Scores of many vectors.
+ *
+ * @param[in]  cvss_strs  Base vector strings, see
+ *                        \ref get_cvss_score_from_base_metrics.
+ * @param[in]  count      Number of vectors.
+ * @param[out] scores     Where to write the count scores, -1 for vectors
+ *                        that could not be parsed.
+ */
+void
+get_cvss_scores_from_base_metrics (const char *const *cvss_strs, size_t count,
+                                   double *scores)
+{
+  size_t i;
 
-ret_err:
-  g_free (base_str);
-  return (double) -1;
+  for (i = 0; i < count; i++)
+    scores[i] = get_cvss_score_from_base_metrics (cvss_strs[i]);
 }
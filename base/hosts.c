@@ -33,8 +33,6 @@
 
 #include <arpa/inet.h> /* for inet_pton, inet_ntop */
 #include <assert.h>    /* for assert */
-#include <ctype.h>     /* for isdigit */
-#include <malloc.h>
 #include <netdb.h>      /* for getnameinfo, NI_NAMEREQD */
 #include <stdint.h>     /* for uint8_t, uint32_t */
 #include <stdio.h>      /* for sscanf, perror */
@@ -58,134 +56,130 @@ gchar *host_type_str[HOST_TYPE_MAX] = {
   [HOST_TYPE_RANGE_SHORT] = "IPv4 short range",
   [HOST_TYPE_RANGE_LONG] = "IPv4 long range"};
 
-/* Function definitions */
-
 /**
- * @brief Checks if a buffer points to a valid IPv4 address.
- * "192.168.11.1" is valid, "192.168.1.300" and "192.168.1.1e" are not.
- *
- * @param[in]   str Buffer to check in.
- *
- * @return 1 if valid IPv4 address, 0 otherwise.
+ * @brief Default max number of concurrent DNS lookups of hosts collections.
  */
-static int
-is_ipv4_address (const char *str)
-{
-  struct sockaddr_in sa;
+#define HOSTS_DNS_PARALLEL 16
 
-  return inet_pton (AF_INET, str, &(sa.sin_addr)) == 1;
-}
+/**
+ * @brief Max number of concurrent DNS lookups of hosts collections.
+ */
+static unsigned int dns_max_parallel = HOSTS_DNS_PARALLEL;
 
 /**
- * @brief Checks if a buffer points to a valid IPv6 address.
- * "0:0:0:0:0:0:0:1", "::1" and "::FFFF:192.168.13.55" are valid "::1g" is not.
- *
- * @param[in]   str Buffer to check in.
- *
- * @return 1 if valid IPv6 address, 0 otherwise.
+ * @brief Number of addresses reverse-looked up in one batch.
  */
-static int
-is_ipv6_address (const char *str)
-{
-  struct sockaddr_in6 sa6;
+#define HOSTS_LOOKUP_BATCH 4096
 
-  return inet_pton (AF_INET6, str, &(sa6.sin6_addr)) == 1;
-}
+/* Function definitions */
 
 /**
- * @brief Checks if a buffer points to an IPv4 CIDR-expressed block.
- * "192.168.12.3/24" is valid, "192.168.1.3/31" is not.
+ * @brief Parses a dotted-quad IPv4 address from part of a buffer.
+ *
+ * Accepts the same addresses as inet_pton: four decimal parts up to 255,
+ * without leading zeros.
  *
- * @param[in]   str Buffer to check in.
+ * @param[in]   str     Start of the address.
+ * @param[in]   len     Length of the address.
+ * @param[out]  addr    Address, in network byte order.
  *
- * @return 1 if valid CIDR-expressed block, 0 otherwise.
+ * @return 1 if valid address, 0 otherwise.
  */
 static int
-is_cidr_block (const char *str)
+host_spec_ipv4 (const char *str, size_t len, struct in_addr *addr)
 {
-  long block;
-  char *addr_str, *block_str, *p;
+  const char *end = str + len;
+  guint32 value = 0;
+  int parts = 0;
 
-  addr_str = g_strdup (str);
-  block_str = strchr (addr_str, '/');
-  if (block_str == NULL)
+  while (parts < 4)
     {
-      g_free (addr_str);
-      return 0;
-    }
+      unsigned int part = 0;
+      const char *start = str;
 
-  /* Separate the address from the block value. */
-  *block_str = '\0';
-  block_str++;
-
-  if (!is_ipv4_address (addr_str) || !isdigit (*block_str))
-    {
-      g_free (addr_str);
-      return 0;
+      while (str < end && g_ascii_isdigit (*str) && str - start < 3)
+        part = part * 10 + (*str++ - '0');
+      if (str == start || part > 255 || (*start == '0' && str - start > 1))
+        return 0;
+      value = (value << 8) | part;
+      if (++parts < 4 && (str == end || *str++ != '.'))
+        return 0;
     }
-
-  p = NULL;
-  block = strtol (block_str, &p, 10);
-  g_free (addr_str);
-
-  if (*p || block <= 0 || block > 30)
+  if (str != end)
     return 0;
 
+  addr->s_addr = htonl (value);
   return 1;
 }
 
 /**
- * @brief Gets the network block value from a CIDR-expressed block string.
- * For "192.168.1.1/24" it is 24.
+ * @brief Parses an IPv4 or IPv6 address from part of a buffer.
  *
- * @param[in]   str     Buffer containing CIDR-expressed block.
- * @param[out]  block   Variable to store block value.
+ * Addresses with a colon are parsed as IPv6, others as IPv4.
  *
- * @return -1 if error, 0 otherwise.
+ * @param[in]   str     Start of the address.
+ * @param[in]   len     Length of the address.
+ * @param[out]  type    HOST_TYPE_IPV4 or HOST_TYPE_IPV6.
+ * @param[out]  addr    Address. IPv4 addresses are IPv4-mapped.
+ *
+ * @return 1 if valid address, 0 otherwise.
  */
 static int
-cidr_get_block (const char *str, unsigned int *block)
+host_spec_addr (const char *str, size_t len, int *type, struct in6_addr *addr)
 {
-  if (str == NULL || block == NULL)
-    return -1;
+  char buf[INET6_ADDRSTRLEN];
+  struct in_addr addr4;
 
-  if (sscanf (str, "%*[0-9.]/%2u", block) != 1)
-    return -1;
+  if (!memchr (str, ':', len))
+    {
+      *type = HOST_TYPE_IPV4;
+      if (!host_spec_ipv4 (str, len, &addr4))
+        return 0;
+      ipv4_as_ipv6 (&addr4, addr);
+      return 1;
+    }
 
-  return 0;
+  /* inet_pton needs a NUL-terminated string. */
+  *type = HOST_TYPE_IPV6;
+  if (len >= sizeof (buf))
+    return 0;
+  memcpy (buf, str, len);
+  buf[len] = '\0';
+  return inet_pton (AF_INET6, buf, addr) == 1;
 }
 
 /**
- * @brief Gets the IPv4 value from a CIDR-expressed block.
- * eg. For "192.168.1.10/24" it is "192.168.1.10".
+ * @brief Parses a number that makes up the whole rest of a buffer.
  *
- * @param[in]   str     String containing CIDR-expressed block.
- * @param[out]  addr    Variable to store the IPv4 address value.
+ * @param[in]   str     Buffer.
+ * @param[in]   base    10 or 16.
+ * @param[out]  value   Value, saturated at G_MAXUINT.
  *
- * @return -1 if error, 0 otherwise.
+ * @return Number of digits, 0 if str is empty or holds other characters.
  */
 static int
-cidr_get_ip (const char *str, struct in_addr *addr)
+host_spec_number (const char *str, unsigned int base, unsigned int *value)
 {
-  gchar *addr_str, *tmp;
-
-  if (str == NULL || addr == NULL)
-    return -1;
+  const char *p;
 
-  addr_str = g_strdup (str);
-  tmp = strchr (addr_str, '/');
-  if (tmp == NULL)
+  *value = 0;
+  for (p = str; *p; p++)
     {
-      g_free (addr_str);
-      return -1;
-    }
-  *tmp = '\0';
+      unsigned int digit;
 
-  if (inet_pton (AF_INET, addr_str, addr) != 1)
-    return -1;
+      if (g_ascii_isdigit (*p))
+        digit = *p - '0';
+      else if (base == 16 && g_ascii_isxdigit (*p))
+        digit = g_ascii_tolower (*p) - 'a' + 10;
+      else
+        return 0;
 
-  g_free (addr_str);
-  return 0;
+      if (*value < G_MAXUINT / base - 1)
+        *value = *value * base + digit;
+      else
+        *value = G_MAXUINT;
+    }
+  return p - str;
 }
 
 /**
@@ -198,713 +192,898 @@ cidr_get_ip (const char *str, struct in_addr *addr)
  *   behaviour from users.
  * - When needed, short/long ranges (eg. 192.168.1.0-255) are available.
  *
- * @param[in]   str     Buffer containing CIDR-expressed block.
- * @param[out]  first   First IPv4 address in block.
- * @param[out]  last    Last IPv4 address in block.
- *
- * @return -1 if error, 0 else.
+ * @param[in,out]  first   IPv4-mapped address of the block, set to the first
+ *                         address in block.
+ * @param[out]     last    Last IPv4-mapped address in block.
+ * @param[in]      block   Block value, 1 to 30.
  */
-static int
-cidr_block_ips (const char *str, struct in_addr *first, struct in_addr *last)
+static void
+cidr_block_ips (struct in6_addr *first, struct in6_addr *last,
+                unsigned int block)
 {
-  unsigned int block;
-
-  if (str == NULL || first == NULL || last == NULL)
-    return -1;
-
-  /* Get IP and block values. */
-  if (cidr_get_block (str, &block) == -1)
-    return -1;
-  if (cidr_get_ip (str, first) == -1)
-    return -1;
+  guint32 addr = ntohl (first->s6_addr32[3]);
 
   /* First IP: And with mask and increment. */
-  first->s_addr &= htonl (0xffffffff ^ ((1 << (32 - block)) - 1));
-  first->s_addr = htonl (ntohl (first->s_addr) + 1);
+  addr = (addr & (0xffffffffU << (32 - block))) + 1;
+  first->s6_addr32[3] = htonl (addr);
 
   /* Last IP: First IP + Number of usable hosts - 1. */
-  last->s_addr = htonl (ntohl (first->s_addr) + (1 << (32 - block)) - 3);
-  return 0;
+  *last = *first;
+  last->s6_addr32[3] = htonl (addr + (1U << (32 - block)) - 3);
 }
 
 /**
- * @brief Checks if a buffer points to a valid long range-expressed network.
- * "192.168.12.1-192.168.13.50" is valid.
- *
- * @param[in]   str Buffer to check in.
- *
- * @return 1 if valid long range-expressed network, 0 otherwise.
+ * @brief Gets the first and last usable IPv6 addresses from a CIDR-expressed
+ * block. eg. "2620:0:2d0:200::/120" would give 2620:0:2d0:200::1 as first and
+ * 2620:0:2d0:200::fe as last. Thus, it skips the network and broadcast
+ * addresses, unless the block is /127 or /128.
+ *
+ * @param[in,out]  first   Address of the block, set to the first address in
+ *                         block.
+ * @param[out]     last    Last address in block.
+ * @param[in]      block   Block value, 1 to 128.
  */
-static int
-is_long_range_network (const char *str)
+static void
+cidr6_block_ips (struct in6_addr *first, struct in6_addr *last,
+                 unsigned int block)
 {
-  char *first_str, *second_str;
-  int ret;
+  int i, j;
+
+  memcpy (&last->s6_addr, &first->s6_addr, 16);
+
+  /* /128 => Specified address is the first and last one. */
+  if (block == 128)
+    return;
 
-  first_str = g_strdup (str);
-  second_str = strchr (first_str, '-');
-  if (second_str == NULL)
+  /* First IP: And with mask and increment to skip network address. */
+  j = 15;
+  for (i = (128 - block) / 8; i > 0; i--)
     {
-      g_free (first_str);
-      return 0;
+      first->s6_addr[j] = 0;
+      j--;
     }
+  if (j >= 0)
+    first->s6_addr[j] &= 0xff ^ ((1 << ((128 - block) % 8)) - 1);
 
-  /* Separate the addresses. */
-  *second_str = '\0';
-  second_str++;
+  /* Last IP: Broadcast address - 1. */
+  j = 15;
+  for (i = (128 - block) / 8; i > 0; i--)
+    {
+      last->s6_addr[j] = 0xff;
+      j--;
+    }
+  if (j >= 0)
+    last->s6_addr[j] |= (1 << ((128 - block) % 8)) - 1;
 
-  ret = is_ipv4_address (first_str) && is_ipv4_address (second_str);
-  g_free (first_str);
+  /* /127 => Only two addresses. Don't skip network / broadcast addresses.*/
+  if (block == 127)
+    return;
 
-  return ret;
+  /* Increment first IP. */
+  for (i = 15; i >= 0; --i)
+    if (first->s6_addr[i] < 255)
+      {
+        first->s6_addr[i]++;
+        break;
+      }
+    else
+      first->s6_addr[i] = 0;
+  /* Decrement last IP. */
+  for (i = 15; i >= 0; --i)
+    if (last->s6_addr[i] > 0)
+      {
+        last->s6_addr[i]--;
+        break;
+      }
+    else
+      last->s6_addr[i] = 0xff;
 }
 
 /**
- * @brief Gets the first and last IPv4 addresses from a long range-expressed
- * network. eg. "192.168.1.1-192.168.2.40" would give 192.168.1.1 as first and
- * 192.168.2.40 as last.
- *
- * @param[in]   str     String containing long range-expressed network.
- * @param[out]  first   First IP address in block.
- * @param[out]  last    Last IP address in block.
- *
- * @return -1 if error, 0 else.
+ * @brief Classifies a host definition and gets its addresses, in a single
+ * scan and without allocating.
+ *
+ * The forms are, in order of precedence:
+ * - Single IPv4 or IPv6 address: "192.168.11.1", "::1".
+ * - CIDR-expressed block: "192.168.12.3/24" (/1 to /30),
+ *   "2620:0:2d0:200::7/120" (/1 to /128).
+ * - Short range-expressed network: "192.168.11.1-50" (end up to 255),
+ *   "::200:ff:1-fee5" (end of at most 4 hexadecimal characters).
+ * - Long range-expressed network: "192.168.12.1-192.168.13.50",
+ *   "::fee5-::1:530".
+ * - Hostname: Alphanumerics, dot (.), dash (-) and underscore (_) up to 255
+ *   characters.
+ *
+ * @param[in]   str     Buffer that contains the host definition, without
+ *                      leading or trailing white spaces.
+ * @param[out]  first   First address. IPv4 addresses are IPv4-mapped.
+ * @param[out]  last    Last address. first and last are not set for
+ *                      hostnames.
+ *
+ * @return HOST_TYPE_*, -1 if error.
  */
 static int
-long_range_network_ips (const char *str, struct in_addr *first,
-                        struct in_addr *last)
+host_spec_parse (const char *str, struct in6_addr *first, struct in6_addr *last)
 {
-  char *first_str, *last_str;
+  const char *p, *slash, *hyphen;
+  size_t len;
+  int type;
+  unsigned int value;
 
-  if (str == NULL || first == NULL || last == NULL)
+  if (str == NULL || *str == '\0')
     return -1;
 
-  first_str = g_strdup (str);
-  last_str = strchr (first_str, '-');
-  if (last_str == NULL)
+  /* Find the separators. */
+  len = strlen (str);
+  slash = memchr (str, '/', len);
+  hyphen = memchr (str, '-', len);
+
+  if (!slash && !hyphen)
     {
-      g_free (first_str);
-      return -1;
+      /* Single IPv4 or IPv6 address. */
+      if (host_spec_addr (str, len, &type, first))
+        {
+          *last = *first;
+          return type;
+        }
+    }
+  else if (slash && !hyphen)
+    {
+      /* CIDR-expressed block. */
+      if (host_spec_addr (str, slash - str, &type, first)
+          && host_spec_number (slash + 1, 10, &value) && value > 0)
+        {
+          if (type == HOST_TYPE_IPV4 && value <= 30)
+            {
+              cidr_block_ips (first, last, value);
+              return HOST_TYPE_CIDR_BLOCK;
+            }
+          if (type == HOST_TYPE_IPV6 && value <= 128)
+            {
+              cidr6_block_ips (first, last, value);
+              return HOST_TYPE_CIDR6_BLOCK;
+            }
+        }
     }
+  else if (hyphen && !slash && host_spec_addr (str, hyphen - str, &type, first))
+    {
+      int digits, last_type;
 
-  /* Separate the two IPs. */
-  *last_str = '\0';
-  last_str++;
+      /* Short range-expressed network. */
+      digits = host_spec_number (hyphen + 1, type == HOST_TYPE_IPV4 ? 10 : 16,
+                                 &value);
+      *last = *first;
+      if (type == HOST_TYPE_IPV4 && digits && value <= 255)
+        {
+          last->s6_addr[15] = value;
+          return HOST_TYPE_RANGE_SHORT;
+        }
+      if (type == HOST_TYPE_IPV6 && digits && digits <= 4)
+        {
+          last->s6_addr[14] = value >> 8;
+          last->s6_addr[15] = value & 0xff;
+          return HOST_TYPE_RANGE6_SHORT;
+        }
 
-  if (inet_pton (AF_INET, first_str, first) != 1
-      || inet_pton (AF_INET, last_str, last) != 1)
-    {
-      g_free (first_str);
-      return -1;
+      /* Long range-expressed network. */
+      if (host_spec_addr (hyphen + 1, str + len - hyphen - 1, &last_type, last)
+          && last_type == type)
+        return type == HOST_TYPE_IPV4 ? HOST_TYPE_RANGE_LONG
+                                      : HOST_TYPE_RANGE6_LONG;
     }
 
-  g_free (first_str);
-  return 0;
+  /* Hostname. */
+  if (len > 255)
+    return -1;
+  for (p = str; *p; p++)
+    if (!g_ascii_isalnum (*p) && *p != '-' && *p != '_' && *p != '.')
+      return -1;
+  return HOST_TYPE_NAME;
 }
 
 /**
- * @brief Checks if a buffer points to a valid short range-expressed network.
- * "192.168.11.1-50" is valid, "192.168.1.1-50e" and "192.168.1.1-300" are not.
+ * @brief Determines the host type in a buffer.
  *
- * @param   str String to check in.
+ * @param[in] str_stripped   Buffer that contains host definition, could a be
+ * hostname, single IPv4 or IPv6, CIDR-expressed block etc,.
  *
- * @return 1 if str points to a valid short range-network, 0 otherwise.
+ * @return Host_TYPE_*, -1 if error.
  */
-static int
-is_short_range_network (const char *str)
+int
+gvm_get_host_type (const gchar *str_stripped)
 {
-  long end;
-  char *ip_str, *end_str, *p;
-
-  ip_str = g_strdup (str);
-  end_str = strchr (ip_str, '-');
-  if (end_str == NULL)
-    {
-      g_free (ip_str);
-      return 0;
-    }
-
-  /* Separate the addresses. */
-  *end_str = '\0';
-  end_str++;
+  struct in6_addr first, last;
 
-  if (!is_ipv4_address (ip_str) || !isdigit (*end_str))
-    {
-      g_free (ip_str);
-      return 0;
-    }
-
-  p = NULL;
-  end = strtol (end_str, &p, 10);
-  g_free (ip_str);
-
-  if (*p || end < 0 || end > 255)
-    return 0;
-
-  return 1;
+  return host_spec_parse (str_stripped, &first, &last);
 }
 
 /**
- * @brief Gets the first and last IPv4 addresses from a short range-expressed
- * network. "192.168.1.1-40" would give 192.168.1.1 as first and 192.168.1.40 as
- * last.
+ * @brief Creates a new gvm_vhost_t object.
  *
- * @param[in]   str     String containing short range-expressed network.
- * @param[out]  first   First IP address in block.
- * @param[out]  last    Last IP address in block.
+ * @param[in] value     Vhost value.
+ * @param[in] source    Source of hostname.
  *
- * @return -1 if error, 0 else.
+ * @return Pointer to new vhost object.
  */
-static int
-short_range_network_ips (const char *str, struct in_addr *first,
-                         struct in_addr *last)
+gvm_vhost_t *
+gvm_vhost_new (char *value, char *source)
 {
-  char *first_str, *last_str;
-  int end;
-
-  if (str == NULL || first == NULL || last == NULL)
-    return -1;
+  gvm_vhost_t *vhost;
 
-  first_str = g_strdup (str);
-  last_str = strchr (first_str, '-');
-  if (last_str == NULL)
-    {
-      g_free (first_str);
-      return -1;
-    }
+  vhost = g_malloc0 (sizeof (gvm_vhost_t));
+  vhost->value = value;
+  vhost->source = source;
 
-  /* Separate the two IPs. */
-  *last_str = '\0';
-  last_str++;
-  end = atoi (last_str);
+  return vhost;
+}
 
-  /* Get the first IP */
-  if (inet_pton (AF_INET, first_str, first) != 1)
+/**
+ * @brief Frees the memory occupied by an gvm_vhost_t object.
+ *
+ * @param[in] vhost Vhost to free.
+ */
+static void
+gvm_vhost_free (gpointer vhost)
+{
+  if (vhost)
     {
-      g_free (first_str);
-      return -1;
+      g_free (((gvm_vhost_t *) vhost)->value);
+      g_free (((gvm_vhost_t *) vhost)->source);
     }
+  g_free (vhost);
+}
 
-  /* Get the last IP */
-  last->s_addr = htonl ((ntohl (first->s_addr) & 0xffffff00) + end);
+/**
+ * @brief Creates a new gvm_host_t object.
+ *
+ * @return Pointer to new host object, NULL if creation fails.
+ */
+static gvm_host_t *
+gvm_host_new ()
+{
+  gvm_host_t *host;
 
-  g_free (first_str);
-  return 0;
+  host = g_malloc0 (sizeof (gvm_host_t));
+
+  return host;
 }
 
 /**
- * @brief Checks if a buffer points to a valid hostname.
- * Valid characters include: Alphanumerics, dot (.), dash (-) and underscore (_)
- * up to 255 characters.
- *
- * @param[in]   str Buffer to check in.
+ * @brief Frees the memory occupied by an gvm_host_t object.
  *
- * @return 1 if valid hostname, 0 otherwise.
+ * @param[in] host  Host to free.
  */
-static int
-is_hostname (const char *str)
+static void
+gvm_host_free (gpointer host)
 {
-  const char *h = str;
-
-  while (*h && (isalnum (*h) || strchr ("-_.", *h)))
-    h++;
+  gvm_host_t *h = host;
+  if (h == NULL)
+    return;
 
-  /* Valid string if no other chars, and length is 255 at most. */
-  if (*h == '\0' && h - str < 256)
-    return 1;
+  /* If host of type hostname, free the name buffer, first. */
+  if (h->type == HOST_TYPE_NAME)
+    g_free (h->name);
 
-  return 0;
+  g_slist_free_full (h->vhosts, gvm_vhost_free);
+  g_free (h);
 }
 
 /**
- * @brief Checks if a buffer points to an IPv6 CIDR-expressed block.
- * "2620:0:2d0:200::7/120" is valid, "2620:0:2d0:200::7/129" is not.
+ * @brief Splits an IPv6 address into two 64 bits integers.
  *
- * @param[in]   str Buffer to check in.
- *
- * @return 1 if valid IPv6 CIDR-expressed block, 0 otherwise.
+ * @param[in]   addr    Address to split.
+ * @param[out]  hi      High 64 bits.
+ * @param[out]  lo      Low 64 bits.
  */
-static int
-is_cidr6_block (const char *str)
+static void
+addr6_split (const struct in6_addr *addr, guint64 *hi, guint64 *lo)
 {
-  long block;
-  char *addr6_str, *block_str, *p;
+  int i;
 
-  addr6_str = g_strdup (str);
-  block_str = strchr (addr6_str, '/');
-  if (block_str == NULL)
+  *hi = *lo = 0;
+  for (i = 0; i < 8; i++)
     {
-      g_free (addr6_str);
-      return 0;
+      *hi = (*hi << 8) | addr->s6_addr[i];
+      *lo = (*lo << 8) | addr->s6_addr[i + 8];
     }
+}
 
-  /* Separate the address from the block value. */
-  *block_str = '\0';
-  block_str++;
-
-  if (!is_ipv6_address (addr6_str) || !isdigit (*block_str))
+/**
+ * @brief Adds an offset to an IPv6 address.
+ *
+ * @param[in,out]   addr    Address to increase.
+ * @param[in]       offset  Offset to add.
+ */
+static void
+addr6_add (struct in6_addr *addr, guint64 offset)
+{
+  guint64 hi, lo;
+  int i;
+
+  addr6_split (addr, &hi, &lo);
+  if (lo + offset < lo)
+    hi++;
+  lo += offset;
+  for (i = 7; i >= 0; i--)
     {
-      g_free (addr6_str);
-      return 0;
+      addr->s6_addr[i] = hi & 0xff;
+      addr->s6_addr[i + 8] = lo & 0xff;
+      hi >>= 8;
+      lo >>= 8;
     }
-
-  p = NULL;
-  block = strtol (block_str, &p, 10);
-  g_free (addr6_str);
-
-  if (*p || block <= 0 || block > 128)
-    return 0;
-
-  return 1;
 }
 
 /**
- * @brief Gets the network block value from a CIDR-expressed block string.
- * For "192.168.1.1/24" it is 24.
+ * @brief Increments an IPv6 address.
  *
- * @param[in]   str     Buffer containing CIDR-expressed block.
- * @param[out]  block   Variable to store block value.
+ * @param[in,out]   addr    Address to increment.
  *
- * @return -1 if error, 0 otherwise.
+ * @return 1 if the address wrapped around, 0 otherwise.
  */
 static int
-cidr6_get_block (const char *str, unsigned int *block)
+addr6_inc (struct in6_addr *addr)
 {
-  if (str == NULL || block == NULL)
-    return -1;
-
-  if (sscanf (str, "%*[0-9a-fA-F.:]/%3u", block) != 1)
-    return -1;
+  int i;
 
-  return 0;
+  for (i = 15; i >= 0; i--)
+    if (++addr->s6_addr[i] != 0)
+      return 0;
+  return 1;
 }
 
 /**
- * @brief Gets the IPv4 value from a CIDR-expressed block.
- * eg. For "192.168.1.10/24" it is "192.168.1.10".
+ * @brief Decrements an IPv6 address, which must not be \::.
  *
- * @param[in]   str     String containing CIDR-expressed block.
- * @param[out]  addr6   Variable to store the IPv4 address value.
- *
- * @return -1 if error, 0 otherwise.
+ * @param[in,out]   addr    Address to decrement.
  */
-static int
-cidr6_get_ip (const char *str, struct in6_addr *addr6)
+static void
+addr6_dec (struct in6_addr *addr)
 {
-  gchar *addr6_str, *tmp;
-
-  if (str == NULL || addr6 == NULL)
-    return -1;
-
-  addr6_str = g_strdup (str);
-  tmp = strchr (addr6_str, '/');
-  if (tmp == NULL)
-    {
-      g_free (addr6_str);
-      return -1;
-    }
-  *tmp = '\0';
+  int i;
 
-  if (inet_pton (AF_INET6, addr6_str, addr6) != 1)
-    return -1;
-
-  g_free (addr6_str);
-  return 0;
+  for (i = 15; i >= 0; i--)
+    if (addr->s6_addr[i]-- != 0)
+      break;
 }
 
 /**
- * @brief Gets the first and last usable IPv4 addresses from a CIDR-expressed
- * block. eg. "192.168.1.0/24 would give 192.168.1.1 as first and 192.168.1.254
- * as last. Thus, it skips the network and broadcast addresses.
+ * @brief Gets the number of addresses in an IPv6 range.
  *
- * @param[in]   str     Buffer containing CIDR-expressed block.
- * @param[out]  first   First IPv4 address in block.
- * @param[out]  last    Last IPv4 address in block.
+ * @param[in]   first   First address of the range.
+ * @param[in]   last    Last address of the range, not lower than first.
  *
- * @return -1 if error, 0 else.
+ * @return Number of addresses, G_MAXUINT64 if it doesn't fit in 64 bits.
  */
-static int
-cidr6_block_ips (const char *str, struct in6_addr *first, struct in6_addr *last)
+static guint64
+addr6_range_size (const struct in6_addr *first, const struct in6_addr *last)
 {
-  unsigned int block;
-  int i, j;
+  guint64 fhi, flo, lhi, llo;
 
-  if (str == NULL || first == NULL || last == NULL)
-    return -1;
+  addr6_split (first, &fhi, &flo);
+  addr6_split (last, &lhi, &llo);
+  if (lhi - fhi - (llo < flo) != 0 || llo - flo == G_MAXUINT64)
+    return G_MAXUINT64;
+  return llo - flo + 1;
+}
 
-  /* Get IP and block values. */
-  if (cidr6_get_block (str, &block) == -1)
-    return -1;
-  if (cidr6_get_ip (str, first) == -1)
-    return -1;
-  memcpy (&last->s6_addr, &first->s6_addr, 16);
+/**
+ * @brief A hostname, or a range of consecutive addresses, in a hosts
+ * collection.
+ *
+ * Ranges are only expanded into host objects when these are handed out.
+ */
+struct gvm_hosts_entry
+{
+  enum host_type type;   /**< HOST_TYPE_NAME, HOST_TYPE_IPV4 or IPV6. */
+  gvm_host_t *host;      /**< Host object of a hostname entry. */
+  struct in6_addr first; /**< First address, IPv4-mapped for IPv4. */
+  struct in6_addr last;  /**< Last address, IPv4-mapped for IPv4. */
+};
 
-  /* /128 => Specified address is the first and last one. */
-  if (block == 128)
-    return 0;
-
-  /* First IP: And with mask and increment to skip network address. */
-  j = 15;
-  for (i = (128 - block) / 8; i > 0; i--)
-    {
-      first->s6_addr[j] = 0;
-      j--;
-    }
-  first->s6_addr[j] &= 0xff ^ ((1 << ((128 - block) % 8)) - 1);
-
-  /* Last IP: Broadcast address - 1. */
-  j = 15;
-  for (i = (128 - block) / 8; i > 0; i--)
-    {
-      last->s6_addr[j] = 0xff;
-      j--;
-    }
-  last->s6_addr[j] |= (1 << ((128 - block) % 8)) - 1;
-
-  /* /127 => Only two addresses. Don't skip network / broadcast addresses.*/
-  if (block == 127)
-    return 0;
-
-  /* Increment first IP. */
-  for (i = 15; i >= 0; --i)
-    if (first->s6_addr[i] < 255)
-      {
-        first->s6_addr[i]++;
-        break;
-      }
-    else
-      first->s6_addr[i] = 0;
-  /* Decrement last IP. */
-  for (i = 15; i >= 0; --i)
-    if (last->s6_addr[i] > 0)
-      {
-        last->s6_addr[i]--;
-        break;
-      }
-    else
-      last->s6_addr[i] = 0xff;
-
-  return 0;
+/**
+ * @brief Gets the number of single hosts of a hosts collection entry.
+ *
+ * @param[in] entry Entry.
+ *
+ * @return Number of hosts, G_MAXUINT64 if it doesn't fit in 64 bits.
+ */
+static guint64
+gvm_hosts_entry_size (const struct gvm_hosts_entry *entry)
+{
+  if (entry->type == HOST_TYPE_NAME)
+    return 1;
+  return addr6_range_size (&entry->first, &entry->last);
 }
 
 /**
- * @brief Checks if a buffer points to a valid long IPv6 range-expressed
- * network. "::fee5-::1:530" is valid.
+ * @brief Checks whether an address is in the range of a hosts collection
+ * entry.
  *
- * @param[in]   str Buffer to check in.
+ * @param[in] addr  Address, IPv4-mapped for IPv4.
+ * @param[in] entry Entry.
  *
- * @return 1 if valid long range-expressed network, 0 otherwise.
+ * @return 1 if the entry is a range containing addr, 0 otherwise.
  */
 static int
-is_long_range6_network (const char *str)
+gvm_hosts_entry_has (const struct in6_addr *addr,
+                     const struct gvm_hosts_entry *entry)
 {
-  char *first_str, *second_str;
-  int ret;
-
-  first_str = g_strdup (str);
-  second_str = strchr (first_str, '-');
-  if (second_str == NULL)
-    {
-      g_free (first_str);
-      return 0;
-    }
-
-  /* Separate the addresses. */
-  *second_str = '\0';
-  second_str++;
+  return entry->type != HOST_TYPE_NAME
+         && memcmp (addr, &entry->first, sizeof (*addr)) >= 0
+         && memcmp (addr, &entry->last, sizeof (*addr)) <= 0;
+}
 
-  ret = is_ipv6_address (first_str) && is_ipv6_address (second_str);
-  g_free (first_str);
+/**
+ * @brief Hash function for the host objects of addresses.
+ *
+ * @param[in] key   Host of type HOST_TYPE_IPV4 or HOST_TYPE_IPV6.
+ *
+ * @return Hash value.
+ */
+static guint
+host_addr_hash (gconstpointer key)
+{
+  const gvm_host_t *host = key;
 
-  return ret;
+  if (host->type == HOST_TYPE_IPV4)
+    return host->addr.s_addr;
+  return host->addr6.s6_addr32[0] ^ host->addr6.s6_addr32[1]
+         ^ host->addr6.s6_addr32[2] ^ host->addr6.s6_addr32[3] ^ 1;
 }
 
 /**
- * @brief Gets the first and last IPv6 addresses from a long range-expressed
- * network. eg. "::1:200:7-::1:205:500" would give ::1:200:7 as first and
- * ::1:205:500 as last.
+ * @brief Equality function for the host objects of addresses.
  *
- * @param[in]   str     String containing long IPv6 range-expressed network.
- * @param[out]  first   First IPv6 address in range.
- * @param[out]  last    Last IPv6 address in range.
+ * @param[in] a First host.
+ * @param[in] b Second host.
  *
- * @return -1 if error, 0 else.
+ * @return TRUE if both hosts have the same type and address.
  */
-static int
-long_range6_network_ips (const char *str, struct in6_addr *first,
-                         struct in6_addr *last)
+static gboolean
+host_addr_equal (gconstpointer a, gconstpointer b)
 {
-  char *first_str, *last_str;
+  const gvm_host_t *ha = a, *hb = b;
 
-  if (str == NULL || first == NULL || last == NULL)
-    return -1;
+  if (ha->type != hb->type)
+    return FALSE;
+  if (ha->type == HOST_TYPE_IPV4)
+    return ha->addr.s_addr == hb->addr.s_addr;
+  return !memcmp (&ha->addr6, &hb->addr6, sizeof (ha->addr6));
+}
 
-  first_str = g_strdup (str);
-  last_str = strchr (first_str, '-');
-  if (last_str == NULL)
-    {
-      g_free (first_str);
-      return -1;
-    }
+/**
+ * @brief Sets up a host object for an address, without allocating it.
+ *
+ * @param[out] host Host to set up.
+ * @param[in]  type HOST_TYPE_IPV4 or HOST_TYPE_IPV6.
+ * @param[in]  addr Address, IPv4-mapped for IPv4.
+ */
+static void
+host_addr_init (gvm_host_t *host, enum host_type type,
+                const struct in6_addr *addr)
+{
+  memset (host, 0, sizeof (*host));
+  host->type = type;
+  if (type == HOST_TYPE_IPV4)
+    host->addr.s_addr = addr->s6_addr32[3];
+  else
+    memcpy (&host->addr6, addr, sizeof (host->addr6));
+}
 
-  /* Separate the two IPs. */
-  *last_str = '\0';
-  last_str++;
+/**
+ * @brief Gets the host object of an address of a hosts collection, creating
+ * it if needed. It stays valid until the address is removed from the
+ * collection or the collection is freed.
+ *
+ * @param[in] hosts Hosts collection.
+ * @param[in] type  HOST_TYPE_IPV4 or HOST_TYPE_IPV6.
+ * @param[in] addr  Address, IPv4-mapped for IPv4.
+ *
+ * @return Host object.
+ */
+static gvm_host_t *
+gvm_hosts_addr_host (gvm_hosts_t *hosts, enum host_type type,
+                     const struct in6_addr *addr)
+{
+  gvm_host_t key, *host;
 
-  if (inet_pton (AF_INET6, first_str, first) != 1
-      || inet_pton (AF_INET6, last_str, last) != 1)
+  host_addr_init (&key, type, addr);
+  host = g_hash_table_lookup (hosts->addr_hosts, &key);
+  if (host == NULL)
     {
-      g_free (first_str);
-      return -1;
+      host = gvm_host_new ();
+      *host = key;
+      g_hash_table_add (hosts->addr_hosts, host);
     }
-
-  g_free (first_str);
-  return 0;
+  return host;
 }
 
 /**
- * @brief Checks if a buffer points to a valid short IPv6 range-expressed
- * network. "::200:ff:1-fee5" is valid.
+ * @brief Inserts an entry at the end of a hosts collection.
  *
- * @param   str String to check in.
- *
- * @return 1 if str points to a valid short-range IPv6 network, 0 otherwise.
+ * @param[in] hosts Hosts in which to insert the entry.
+ * @param[in] entry Entry to insert.
  */
-static int
-is_short_range6_network (const char *str)
+static void
+gvm_hosts_add_entry (gvm_hosts_t *hosts, const struct gvm_hosts_entry *entry)
 {
-  char *ip_str, *end_str, *p;
-
-  ip_str = g_strdup (str);
-  end_str = strchr (ip_str, '-');
-  if (end_str == NULL)
+  if (hosts->nentries == hosts->max_size)
     {
-      g_free (ip_str);
-      return 0;
+      hosts->max_size *= 4;
+      hosts->entries =
+        g_realloc_n (hosts->entries, hosts->max_size, sizeof (*hosts->entries));
     }
+  hosts->entries[hosts->nentries] = *entry;
+  hosts->nentries++;
+}
 
-  /* Separate the addresses. */
-  *end_str = '\0';
-  end_str++;
+/**
+ * @brief Inserts a host object of type name at the end of a hosts
+ * collection.
+ *
+ * @param[in] hosts Hosts in which to insert the host.
+ * @param[in] host  Host to insert.
+ */
+static void
+gvm_hosts_add (gvm_hosts_t *hosts, gvm_host_t *host)
+{
+  struct gvm_hosts_entry entry;
 
-  if (!is_ipv6_address (ip_str) || *end_str == '\0')
-    {
-      g_free (ip_str);
-      return 0;
-    }
+  memset (&entry, 0, sizeof (entry));
+  entry.type = HOST_TYPE_NAME;
+  entry.host = host;
+  gvm_hosts_add_entry (hosts, &entry);
+}
 
-  p = end_str;
-  /* Check that the 2nd part is at most 4 hexadecimal characters. */
-  while (isxdigit (*p) && p++)
-    ;
-  if (*p || p - end_str > 4)
-    {
-      g_free (ip_str);
-      return 0;
-    }
+/**
+ * @brief Inserts a range of addresses at the end of a hosts collection.
+ *
+ * @param[in] hosts Hosts in which to insert the range.
+ * @param[in] type  HOST_TYPE_IPV4 or HOST_TYPE_IPV6.
+ * @param[in] first First address, IPv4-mapped for IPv4.
+ * @param[in] last  Last address, IPv4-mapped for IPv4.
+ */
+static void
+gvm_hosts_add_range (gvm_hosts_t *hosts, enum host_type type,
+                     const struct in6_addr *first, const struct in6_addr *last)
+{
+  struct gvm_hosts_entry entry;
 
-  g_free (ip_str);
-  return 1;
+  entry.type = type;
+  entry.host = NULL;
+  entry.first = *first;
+  entry.last = *last;
+  gvm_hosts_add_entry (hosts, &entry);
 }
 
 /**
- * @brief Gets the first and last IPv6 addresses from a short range-expressed
- * network. eg. "\::ffee:1:1001-1005" would give \::ffee:1:1001 as first and
- * \::ffee:1:1005 as last.
+ * @brief Sorts an array by byte string keys, most significant byte first,
+ * with a stable LSD radix sort.
  *
- * @param[in]   str     String containing short IPv6 range-expressed network.
- * @param[out]  first   First IPv6 address in range.
- * @param[out]  last    Last IPv6 address in range.
+ * Runs in O(N * key length) time. Key bytes equal in all elements, like the
+ * prefix of IPv4-mapped addresses, cost a single counting pass.
  *
- * @return -1 if error, 0 else.
+ * @param[in] array     Array to sort.
+ * @param[in] keylen    Length of the keys.
+ * @param[in] key       Function writing the key of an element.
  */
-static int
-short_range6_network_ips (const char *str, struct in6_addr *first,
-                          struct in6_addr *last)
+static void
+hosts_radix_sort (GArray *array, size_t keylen,
+                  void (*key) (gconstpointer, guint8 *))
 {
-  char *first_str, *last_str;
-  long int end;
+  size_t n = array->len, size, i, pass, *order, *tmp;
+  guint8 *keys;
+  gchar *sorted;
 
-  if (str == NULL || first == NULL || last == NULL)
-    return -1;
+  if (n < 2)
+    return;
 
-  first_str = g_strdup (str);
-  last_str = strchr (first_str, '-');
-  if (last_str == NULL)
+  size = g_array_get_element_size (array);
+  keys = g_malloc_n (n, keylen);
+  order = g_malloc_n (n, sizeof (size_t));
+  tmp = g_malloc_n (n, sizeof (size_t));
+  for (i = 0; i < n; i++)
     {
-      g_free (first_str);
-      return -1;
+      key (array->data + i * size, keys + i * keylen);
+      order[i] = i;
     }
 
-  /* Separate the first IP. */
-  *last_str = '\0';
-  last_str++;
-
-  if (inet_pton (AF_INET6, first_str, first) != 1)
+  for (pass = keylen; pass-- > 0;)
     {
-      g_free (first_str);
-      return -1;
+      size_t counts[256] = {0}, pos = 0, *swap;
+      int byte;
+
+      for (i = 0; i < n; i++)
+        counts[keys[i * keylen + pass]]++;
+      if (counts[keys[pass]] == n)
+        continue;
+      for (byte = 0; byte < 256; byte++)
+        {
+          size_t count = counts[byte];
+
+          counts[byte] = pos;
+          pos += count;
+        }
+      for (i = 0; i < n; i++)
+        tmp[counts[keys[order[i] * keylen + pass]]++] = order[i];
+      swap = order;
+      order = tmp;
+      tmp = swap;
     }
 
-  /* Calculate the last IP. */
-  memcpy (last, first, sizeof (*last));
-  end = strtol (last_str, NULL, 16);
-  memcpy (&last->s6_addr[15], &end, 1);
-  memcpy (&last->s6_addr[14], ((char *) &end) + 1, 1);
+  sorted = g_malloc_n (n, size);
+  for (i = 0; i < n; i++)
+    memcpy (sorted + i * size, array->data + order[i] * size, size);
+  memcpy (array->data, sorted, n * size);
+  g_free (sorted);
+  g_free (tmp);
+  g_free (order);
+  g_free (keys);
+}
 
-  g_free (first_str);
-  return 0;
+/**
+ * @brief Writes the sort key of an address range: type then first address.
+ *
+ * @param[in]  element  Range.
+ * @param[out] key      Key, of 17 bytes.
+ */
+static void
+hosts_range_key (gconstpointer element, guint8 *key)
+{
+  const struct gvm_hosts_entry *range = element;
+
+  key[0] = range->type;
+  memcpy (key + 1, &range->first, sizeof (range->first));
 }
 
 /**
- * @brief Determines the host type in a buffer.
+ * @brief Builds the sorted, disjoint address ranges covering the ranges of
+ * entries.
  *
- * @param[in] str_stripped   Buffer that contains host definition, could a be
- * hostname, single IPv4 or IPv6, CIDR-expressed block etc,.
+ * @param[in] entries   Entries of a hosts collection.
+ * @param[in] nentries  Number of entries.
  *
- * @return Host_TYPE_*, -1 if error.
+ * @return Array of gvm_hosts_entry structures, sorted by type and address.
  */
-int
-gvm_get_host_type (const gchar *str_stripped)
+static GArray *
+hosts_ranges_index (const struct gvm_hosts_entry *entries, size_t nentries)
 {
-  /*
-   * We have a single element with no leading or trailing
-   * white spaces. This element could represent different host
-   * definitions: single IPs, host names, CIDR-expressed blocks,
-   * range-expressed networks, IPv6 addresses.
-   */
+  GArray *ranges;
+  size_t i, j;
 
-  /* Null or empty string. */
-  if (str_stripped == NULL || *str_stripped == '\0')
-    return -1;
+  ranges = g_array_sized_new (FALSE, FALSE, sizeof (struct gvm_hosts_entry),
+                              nentries);
+  for (i = 0; i < nentries; i++)
+    if (entries[i].type != HOST_TYPE_NAME)
+      g_array_append_val (ranges, entries[i]);
+  hosts_radix_sort (ranges, 1 + sizeof (struct in6_addr), hosts_range_key);
+
+  /* Merge the overlapping and adjacent ranges. */
+  for (i = 0, j = 0; i < ranges->len; i++)
+    {
+      struct gvm_hosts_entry *range, *prev;
+      struct in6_addr next;
 
-  /* Check for regular single IPv4 address. */
-  if (is_ipv4_address (str_stripped))
-    return HOST_TYPE_IPV4;
+      range = &g_array_index (ranges, struct gvm_hosts_entry, i);
+      if (j)
+        {
+          prev = &g_array_index (ranges, struct gvm_hosts_entry, j - 1);
+          next = prev->last;
+          if (prev->type == range->type
+              && (addr6_inc (&next)
+                  || memcmp (&range->first, &next, sizeof (next)) <= 0))
+            {
+              if (memcmp (&range->last, &prev->last, sizeof (prev->last)) > 0)
+                prev->last = range->last;
+              continue;
+            }
+        }
+      g_array_index (ranges, struct gvm_hosts_entry, j++) = *range;
+    }
+  g_array_set_size (ranges, j);
+  return ranges;
+}
 
-  /* Check for regular single IPv6 address. */
-  if (is_ipv6_address (str_stripped))
-    return HOST_TYPE_IPV6;
+/**
+ * @brief Finds the first range of an index not ending before an address.
+ *
+ * @param[in] ranges    Ranges from hosts_ranges_index.
+ * @param[in] type      HOST_TYPE_IPV4 or HOST_TYPE_IPV6.
+ * @param[in] addr      Address, IPv4-mapped for IPv4.
+ *
+ * @return Index of the range, ranges->len if none.
+ */
+static size_t
+hosts_ranges_find (const GArray *ranges, enum host_type type,
+                   const struct in6_addr *addr)
+{
+  size_t low = 0, high = ranges->len;
 
-  /* Check for regular IPv4 CIDR-expressed block like "192.168.12.0/24" */
-  if (is_cidr_block (str_stripped))
-    return HOST_TYPE_CIDR_BLOCK;
+  while (low < high)
+    {
+      size_t middle = low + (high - low) / 2;
+      const struct gvm_hosts_entry *range;
+
+      range = &g_array_index (ranges, struct gvm_hosts_entry, middle);
+      if (range->type < type
+          || (range->type == type
+              && memcmp (&range->last, addr, sizeof (*addr)) < 0))
+        low = middle + 1;
+      else
+        high = middle;
+    }
+  return low;
+}
 
-  /* Check for short range-expressed networks "192.168.12.5-40" */
-  if (is_short_range_network (str_stripped))
-    return HOST_TYPE_RANGE_SHORT;
+/**
+ * @brief Checks whether an index of ranges has an address.
+ *
+ * @param[in] ranges    Ranges from hosts_ranges_index.
+ * @param[in] type      HOST_TYPE_IPV4 or HOST_TYPE_IPV6.
+ * @param[in] addr      Address, IPv4-mapped for IPv4.
+ *
+ * @return 1 if the address is in a range, 0 otherwise.
+ */
+static int
+hosts_ranges_has (const GArray *ranges, enum host_type type,
+                  const struct in6_addr *addr)
+{
+  size_t i = hosts_ranges_find (ranges, type, addr);
+  const struct gvm_hosts_entry *range;
 
-  /* Check for long range-expressed networks "192.168.1.0-192.168.3.44" */
-  if (is_long_range_network (str_stripped))
-    return HOST_TYPE_RANGE_LONG;
+  if (i == ranges->len)
+    return 0;
+  range = &g_array_index (ranges, struct gvm_hosts_entry, i);
+  return range->type == type && gvm_hosts_entry_has (addr, range);
+}
 
-  /* Check for regular IPv6 CIDR-expressed block like "2620:0:2d0:200::7/120" */
-  if (is_cidr6_block (str_stripped))
-    return HOST_TYPE_CIDR6_BLOCK;
+/**
+ * @brief Builds the lookup index of a hosts collection, if not done yet.
+ *
+ * The index is dropped whenever the entries change.
+ *
+ * @param[in] hosts Hosts collection.
+ */
+static void
+gvm_hosts_index (gvm_hosts_t *hosts)
+{
+  size_t i;
 
-  /* Check for short range-expressed networks "::1-ef12" */
-  if (is_short_range6_network (str_stripped))
-    return HOST_TYPE_RANGE6_SHORT;
+  if (hosts->ranges)
+    return;
 
-  /* Check for long IPv6 range-expressed networks like "::1:20:7-::1:25:3" */
-  if (is_long_range6_network (str_stripped))
-    return HOST_TYPE_RANGE6_LONG;
+  hosts->ranges = hosts_ranges_index (hosts->entries, hosts->nentries);
+  hosts->names = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i < hosts->nentries; i++)
+    if (hosts->entries[i].type == HOST_TYPE_NAME)
+      g_hash_table_add (hosts->names, hosts->entries[i].host->name);
+}
 
-  /* Check for hostname. */
-  if (is_hostname (str_stripped))
-    return HOST_TYPE_NAME;
+/**
+ * @brief Drops the lookup index of a hosts collection.
+ *
+ * @param[in] hosts Hosts collection.
+ */
+static void
+gvm_hosts_index_free (gvm_hosts_t *hosts)
+{
+  if (hosts->ranges == NULL)
+    return;
 
-  return -1;
+  g_array_free (hosts->ranges, TRUE);
+  g_hash_table_destroy (hosts->names);
+  hosts->ranges = NULL;
+  hosts->names = NULL;
 }
 
 /**
- * @brief Creates a new gvm_vhost_t object.
+ * @brief Checks whether the address of a host object is no longer in a hosts
+ * collection.
  *
- * @param[in] value     Vhost value.
- * @param[in] source    Source of hostname.
+ * @param[in] key   Host object.
+ * @param[in] value Unused.
+ * @param[in] hosts Hosts collection, with its lookup index.
  *
- * @return Pointer to new vhost object.
+ * @return TRUE if the host object is to be removed.
  */
-gvm_vhost_t *
-gvm_vhost_new (char *value, char *source)
+static gboolean
+gvm_hosts_addr_host_gone (gpointer key, gpointer value, gpointer hosts)
 {
-  gvm_vhost_t *vhost;
-
-  vhost = g_malloc0 (sizeof (gvm_vhost_t));
-  vhost->value = value;
-  vhost->source = source;
+  struct in6_addr addr;
 
-  return vhost;
+  (void) value;
+  gvm_host_get_addr6 (key, &addr);
+  return !hosts_ranges_has (((gvm_hosts_t *) hosts)->ranges,
+                            ((gvm_host_t *) key)->type, &addr);
 }
 
 /**
- * @brief Frees the memory occupied by an gvm_vhost_t object.
+ * @brief Updates the count and the index of a hosts collection, after its
+ * entries changed. Also resets the iterator current position and drops the
+ * lookup index.
  *
- * @param[in] vhost Vhost to free.
+ * @param[in] hosts Hosts collection to update.
  */
 static void
-gvm_vhost_free (gpointer vhost)
+gvm_hosts_update (gvm_hosts_t *hosts)
 {
-  if (vhost)
+  size_t i, count = 0;
+
+  hosts->starts =
+    g_realloc_n (hosts->starts, MAX (hosts->nentries, 1), sizeof (size_t));
+  for (i = 0; i < hosts->nentries; i++)
     {
-      g_free (((gvm_vhost_t *) vhost)->value);
-      g_free (((gvm_vhost_t *) vhost)->source);
+      hosts->starts[i] = count;
+      count += gvm_hosts_entry_size (&hosts->entries[i]);
     }
-  g_free (vhost);
+  hosts->count = count;
+  hosts->current = 0;
+  gvm_hosts_index_free (hosts);
 }
 
 /**
- * @brief Creates a new gvm_host_t object.
+ * @brief Replaces the entries of a hosts collection.
  *
- * @return Pointer to new host object, NULL if creation fails.
+ * @param[in] hosts     Hosts collection.
+ * @param[in] entries   New entries, owned by the collection afterwards.
  */
-static gvm_host_t *
-gvm_host_new ()
+static void
+gvm_hosts_set_entries (gvm_hosts_t *hosts, GArray *entries)
 {
-  gvm_host_t *host;
-
-  host = g_malloc0 (sizeof (gvm_host_t));
-
-  return host;
+  g_free (hosts->entries);
+  hosts->nentries = entries->len;
+  hosts->max_size = MAX (entries->len, 1);
+  g_array_set_size (entries, hosts->max_size);
+  hosts->entries = (struct gvm_hosts_entry *) g_array_free (entries, FALSE);
+  gvm_hosts_update (hosts);
 }
 
 /**
- * @brief Frees the memory occupied by an gvm_host_t object.
+ * @brief Finds the entry holding a position of a hosts collection.
  *
- * @param[in] host  Host to free.
+ * @param[in] hosts Hosts collection.
+ * @param[in] pos   Position, lower than the count of hosts.
+ *
+ * @return Index of the entry.
  */
-static void
-gvm_host_free (gpointer host)
+static size_t
+gvm_hosts_find_entry (const gvm_hosts_t *hosts, size_t pos)
 {
-  gvm_host_t *h = host;
-  if (h == NULL)
-    return;
+  size_t low = 0, high = hosts->nentries;
 
-  /* If host of type hostname, free the name buffer, first. */
-  if (h->type == HOST_TYPE_NAME)
-    g_free (h->name);
+  while (high - low > 1)
+    {
+      size_t middle = low + (high - low) / 2;
 
-  g_slist_free_full (h->vhosts, gvm_vhost_free);
-  g_free (h);
+      if (hosts->starts[middle] <= pos)
+        low = middle;
+      else
+        high = middle;
+    }
+  return low;
 }
 
 /**
- * @brief Inserts a host object at the end of a hosts collection.
+ * @brief Gets the host at a position of a hosts collection, in its stored
+ * order.
  *
- * @param[in] hosts Hosts in which to insert the host.
- * @param[in] host  Host to insert.
+ * @param[in] hosts Hosts collection.
+ * @param[in] pos   Position, lower than the count of hosts.
+ *
+ * @return Host object.
  */
-static void
-gvm_hosts_add (gvm_hosts_t *hosts, gvm_host_t *host)
+static gvm_host_t *
+gvm_hosts_get (gvm_hosts_t *hosts, size_t pos)
 {
-  if (hosts->count == hosts->max_size)
-    {
-      hosts->max_size *= 4;
-      hosts->hosts =
-        g_realloc_n (hosts->hosts, hosts->max_size, sizeof (*hosts->hosts));
-    }
-  hosts->hosts[hosts->count] = host;
-  hosts->count++;
+  size_t i = gvm_hosts_find_entry (hosts, pos);
+  struct gvm_hosts_entry *entry = &hosts->entries[i];
+  struct in6_addr addr;
+
+  if (entry->type == HOST_TYPE_NAME)
+    return entry->host;
+  addr = entry->first;
+  addr6_add (&addr, pos - hosts->starts[i]);
+  return gvm_hosts_addr_host (hosts, entry->type, &addr);
 }
 
 /**
@@ -921,328 +1100,744 @@ gvm_hosts_init (const char *hosts_str)
 
   hosts = g_malloc0 (sizeof (gvm_hosts_t));
   hosts->max_size = 1024;
-  hosts->hosts = g_malloc0_n (hosts->max_size, sizeof (gvm_host_t *));
+  hosts->entries = g_malloc0_n (hosts->max_size, sizeof (*hosts->entries));
+  hosts->addr_hosts =
+    g_hash_table_new_full (host_addr_hash, host_addr_equal, gvm_host_free, NULL);
   hosts->orig_str = g_strdup (hosts_str);
   return hosts;
 }
 
 /**
- * @brief Fill the gaps in the array of a hosts collection, which are caused by
- * the removal of host entries.
+ * @brief Boundary of an address range, for the deduplication sweep.
+ */
+struct hosts_event
+{
+  enum host_type type;  /**< Type of the range. */
+  struct in6_addr addr; /**< First or last address of the range. */
+  int end;              /**< 0 for the first address, 1 for the last one. */
+  size_t entry;         /**< Index of the range in the entries. */
+};
+
+/**
+ * @brief Compares two range boundaries by address.
+ *
+ * @param[in] a First boundary.
+ * @param[in] b Second boundary.
  *
- * @param[in] hosts Hosts collection to fill gaps in.
+ * @return Negative, 0 or positive, like strcmp.
  */
-static void
-gvm_hosts_fill_gaps (gvm_hosts_t *hosts)
+static gint
+hosts_event_cmp (gconstpointer a, gconstpointer b)
 {
-  size_t i;
-  if (!hosts)
-    return;
+  const struct hosts_event *ea = a, *eb = b;
+  int rc;
+
+  if (ea->type != eb->type)
+    return ea->type - eb->type;
+  if ((rc = memcmp (&ea->addr, &eb->addr, sizeof (ea->addr))))
+    return rc;
+  /* Ranges starting at an address are active before the others end. */
+  return ea->end - eb->end;
+}
 
-  for (i = 0; i < hosts->max_size; i++)
+/**
+ * @brief Writes the sort key of a range boundary: type, address then kind.
+ *
+ * @param[in]  element  Range boundary.
+ * @param[out] key      Key, of 18 bytes.
+ */
+static void
+hosts_event_key (gconstpointer element, guint8 *key)
+{
+  const struct hosts_event *event = element;
+
+  key[0] = event->type;
+  memcpy (key + 1, &event->addr, sizeof (event->addr));
+  key[17] = event->end;
+}
+
+/**
+ * @brief Part of a range kept by the deduplication.
+ */
+struct hosts_piece
+{
+  size_t entry;          /**< Index of the range in the entries. */
+  struct in6_addr first; /**< First address. */
+  struct in6_addr last;  /**< Last address. */
+};
+
+/**
+ * @brief Writes the sort key of a range part: entry index then address.
+ *
+ * @param[in]  element  Range part.
+ * @param[out] key      Key, of 24 bytes.
+ */
+static void
+hosts_piece_key (gconstpointer element, guint8 *key)
+{
+  const struct hosts_piece *piece = element;
+  guint64 entry = piece->entry;
+  int i;
+
+  for (i = 7; i >= 0; i--, entry >>= 8)
+    key[i] = entry & 0xff;
+  memcpy (key + 8, &piece->first, sizeof (piece->first));
+}
+
+/**
+ * @brief Adds a part to the kept parts of the ranges, merging it with the
+ * previous one when they are adjacent.
+ *
+ * @param[in] pieces    Kept parts.
+ * @param[in] entry     Index of the range.
+ * @param[in] first     First address.
+ * @param[in] last      Last address.
+ */
+static void
+hosts_piece_add (GArray *pieces, size_t entry, const struct in6_addr *first,
+                 const struct in6_addr *last)
+{
+  struct hosts_piece piece;
+
+  if (pieces->len)
     {
-      if (!hosts->hosts[i])
+      struct hosts_piece *prev;
+      struct in6_addr next;
+
+      prev = &g_array_index (pieces, struct hosts_piece, pieces->len - 1);
+      next = prev->last;
+      if (prev->entry == entry && !addr6_inc (&next)
+          && !memcmp (&next, first, sizeof (next)))
         {
-          size_t j;
+          prev->last = *last;
+          return;
+        }
+    }
+  piece.entry = entry;
+  piece.first = *first;
+  piece.last = *last;
+  g_array_append_val (pieces, piece);
+}
 
-          /* Fill the gap with the closest host entry, in order to keep the
-           * sequential ordering. */
-          for (j = i + 1; j < hosts->max_size; j++)
-            {
-              if (hosts->hosts[j])
-                {
-                  hosts->hosts[i] = hosts->hosts[j];
-                  hosts->hosts[j] = NULL;
-                  break;
-                }
-            }
-          /* No more entries left, ie. the empty space between count and
-           * max_size. */
-          if (!hosts->hosts[i])
-            return;
+/**
+ * @brief Pushes an entry index on a min-heap.
+ *
+ * @param[in] heap  Heap of entry indexes.
+ * @param[in] value Entry index.
+ */
+static void
+hosts_heap_push (GArray *heap, size_t value)
+{
+  size_t i;
+
+  g_array_set_size (heap, heap->len + 1);
+  i = heap->len - 1;
+  while (i > 0)
+    {
+      size_t parent = (i - 1) / 2;
+
+      if (g_array_index (heap, size_t, parent) <= value)
+        break;
+      g_array_index (heap, size_t, i) = g_array_index (heap, size_t, parent);
+      i = parent;
+    }
+  g_array_index (heap, size_t, i) = value;
+}
+
+/**
+ * @brief Removes the lowest entry index from a min-heap.
+ *
+ * @param[in] heap  Heap of entry indexes, not empty.
+ */
+static void
+hosts_heap_pop (GArray *heap)
+{
+  size_t i = 0, last, len;
+
+  len = heap->len - 1;
+  last = g_array_index (heap, size_t, len);
+  g_array_set_size (heap, len);
+  if (len == 0)
+    return;
+  for (;;)
+    {
+      size_t child = 2 * i + 1;
+
+      if (child >= len)
+        break;
+      if (child + 1 < len
+          && g_array_index (heap, size_t, child + 1)
+               < g_array_index (heap, size_t, child))
+        child++;
+      if (g_array_index (heap, size_t, child) >= last)
+        break;
+      g_array_index (heap, size_t, i) = g_array_index (heap, size_t, child);
+      i = child;
+    }
+  g_array_index (heap, size_t, i) = last;
+}
+
+/**
+ * @brief Gets the lowest index of the active ranges of the deduplication
+ * sweep.
+ *
+ * @param[in]   heap    Heap of entry indexes.
+ * @param[in]   done    Whether each range ended already.
+ * @param[out]  top     Lowest index.
+ *
+ * @return 1 if a range is active, 0 otherwise.
+ */
+static int
+hosts_heap_top (GArray *heap, const gboolean *done, size_t *top)
+{
+  while (heap->len && done[g_array_index (heap, size_t, 0)])
+    hosts_heap_pop (heap);
+  if (heap->len == 0)
+    return 0;
+  *top = g_array_index (heap, size_t, 0);
+  return 1;
+}
+
+/**
+ * @brief Removes duplicate hostnames from the entries of a hosts collection,
+ * merging their vhosts into the first occurrence. The host of the removed
+ * entries is set to NULL.
+ *
+ * @param[in] hosts hosts collection from which to remove duplicates.
+ */
+static void
+gvm_hosts_deduplicate_names (gvm_hosts_t *hosts)
+{
+  GHashTable *name_table;
+  size_t i;
+
+  name_table = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i < hosts->nentries; i++)
+    {
+      struct gvm_hosts_entry *entry = &hosts->entries[i];
+      gvm_host_t *host, *removed = entry->host;
+
+      if (entry->type != HOST_TYPE_NAME)
+        continue;
+
+      host = g_hash_table_lookup (name_table, removed->name);
+      if (host)
+        {
+          /* Remove duplicate host. Add its vhosts to the original host. */
+          host->vhosts = g_slist_concat (host->vhosts, removed->vhosts);
+          removed->vhosts = NULL;
+          gvm_host_free (removed);
+          entry->host = NULL;
         }
+      else
+        g_hash_table_insert (name_table, removed->name, removed);
     }
+  g_hash_table_destroy (name_table);
 }
 
 /**
- * @brief Removes duplicate hosts values from an gvm_hosts_t structure.
- * Also resets the iterator current position.
+ * @brief Removes duplicate addresses from the ranges of a hosts collection,
+ * keeping the first occurrence of each: overlapping parts of address ranges
+ * are removed from the ranges that come later. Also drops the hostname
+ * entries whose host is NULL.
  *
  * @param[in] hosts hosts collection from which to remove duplicates.
  */
 static void
-gvm_hosts_deduplicate (gvm_hosts_t *hosts)
+gvm_hosts_deduplicate_ordered (gvm_hosts_t *hosts)
 {
   /**
-   * Uses a hash table in order to deduplicate the hosts list in O(N) time.
+   * Range boundaries are radix sorted by address and swept, each address
+   * going to the first range it appears in, in O(N log N) time for the heap
+   * of active ranges.
    */
-  GHashTable *name_table;
-  size_t i, duplicates = 0;
+  GArray *events, *heap, *pieces, *entries;
+  gboolean *done;
+  struct in6_addr current;
+  size_t i, j, piece, count;
+
+  events = g_array_sized_new (FALSE, FALSE, sizeof (struct hosts_event),
+                              2 * hosts->nentries);
+  for (i = 0; i < hosts->nentries; i++)
+    {
+      struct gvm_hosts_entry *entry = &hosts->entries[i];
+      struct hosts_event event;
 
-  if (hosts == NULL)
-    return;
-  name_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      if (entry->type == HOST_TYPE_NAME)
+        continue;
 
-  for (i = 0; i < hosts->count; i++)
+      event.type = entry->type;
+      event.entry = i;
+      event.addr = entry->first;
+      event.end = 0;
+      g_array_append_val (events, event);
+      event.addr = entry->last;
+      event.end = 1;
+      g_array_append_val (events, event);
+    }
+  hosts_radix_sort (events, 2 + sizeof (struct in6_addr), hosts_event_key);
+
+  done = g_malloc0_n (MAX (hosts->nentries, 1), sizeof (gboolean));
+  heap = g_array_new (FALSE, FALSE, sizeof (size_t));
+  pieces = g_array_new (FALSE, FALSE, sizeof (struct hosts_piece));
+  memset (&current, 0, sizeof (current));
+  for (i = 0; i < events->len; i = j)
     {
-      gchar *name;
+      struct hosts_event *event = &g_array_index (events, struct hosts_event, i);
+      size_t owner, k;
 
-      if ((name = gvm_host_value_str (hosts->hosts[i])))
-        {
-          gvm_host_t *host, *removed = hosts->hosts[i];
+      /* Boundaries of the same kind at the same address: handle at once. */
+      for (j = i + 1; j < events->len
+                      && !hosts_event_cmp (
+                        event, &g_array_index (events, struct hosts_event, j));
+           j++)
+        ;
 
-          host = g_hash_table_lookup (name_table, name);
-          if (host)
+      if (!event->end)
+        {
+          /* The addresses before go to the range owning them so far. */
+          if (hosts_heap_top (heap, done, &owner)
+              && memcmp (&current, &event->addr, sizeof (current)) < 0)
             {
-              /* Remove duplicate host. Add its vhosts to the original host. */
-              host->vhosts = g_slist_concat (host->vhosts, removed->vhosts);
-              removed->vhosts = NULL;
-              gvm_host_free (removed);
-              hosts->hosts[i] = NULL;
-              duplicates++;
-              g_free (name);
+              struct in6_addr last = event->addr;
+
+              addr6_dec (&last);
+              hosts_piece_add (pieces, owner, &current, &last);
             }
-          else
-            g_hash_table_insert (name_table, name, hosts->hosts[i]);
+          for (k = i; k < j; k++)
+            hosts_heap_push (heap,
+                             g_array_index (events, struct hosts_event, k).entry);
+          current = event->addr;
+        }
+      else
+        {
+          if (hosts_heap_top (heap, done, &owner))
+            hosts_piece_add (pieces, owner, &current, &event->addr);
+          for (k = i; k < j; k++)
+            done[g_array_index (events, struct hosts_event, k).entry] = TRUE;
+          current = event->addr;
+          addr6_inc (&current);
         }
     }
+  hosts_radix_sort (pieces, 8 + sizeof (struct in6_addr), hosts_piece_key);
 
-  if (duplicates)
-    gvm_hosts_fill_gaps (hosts);
-  g_hash_table_destroy (name_table);
-  hosts->count -= duplicates;
-  hosts->removed += duplicates;
-  hosts->current = 0;
-  malloc_trim (0);
+  /* Rebuild the entries, in their original order. */
+  entries = g_array_sized_new (FALSE, FALSE, sizeof (struct gvm_hosts_entry),
+                               hosts->nentries);
+  for (i = 0, piece = 0; i < hosts->nentries; i++)
+    {
+      struct gvm_hosts_entry *entry = &hosts->entries[i];
+
+      if (entry->type == HOST_TYPE_NAME)
+        {
+          if (entry->host)
+            g_array_append_val (entries, *entry);
+          continue;
+        }
+      for (; piece < pieces->len
+             && g_array_index (pieces, struct hosts_piece, piece).entry == i;
+           piece++)
+        {
+          struct hosts_piece *kept;
+          struct gvm_hosts_entry part = *entry;
+
+          kept = &g_array_index (pieces, struct hosts_piece, piece);
+          part.first = kept->first;
+          part.last = kept->last;
+          g_array_append_val (entries, part);
+        }
+    }
+
+  count = hosts->count;
+  gvm_hosts_set_entries (hosts, entries);
+  hosts->removed += count - hosts->count;
+
+  g_array_free (pieces, TRUE);
+  g_array_free (heap, TRUE);
+  g_array_free (events, TRUE);
+  g_free (done);
+}
+
+/**
+ * @brief Removes duplicate hosts values from an gvm_hosts_t structure.
+ * Also resets the iterator current position.
+ *
+ * Addresses are compared as numbers, only hostnames as strings.
+ *
+ * @param[in] hosts         hosts collection from which to remove duplicates.
+ * @param[in] keep_order    Whether to keep the first occurrence of each host
+ *                          in place. Otherwise, addresses are merged into
+ *                          ranges in ascending order, followed by hostnames.
+ */
+static void
+gvm_hosts_deduplicate (gvm_hosts_t *hosts, int keep_order)
+{
+  GArray *entries;
+  size_t i, count;
+
+  if (hosts == NULL)
+    return;
+
+  gvm_hosts_deduplicate_names (hosts);
+  if (keep_order)
+    {
+      gvm_hosts_deduplicate_ordered (hosts);
+      return;
+    }
+
+  entries = hosts_ranges_index (hosts->entries, hosts->nentries);
+  for (i = 0; i < hosts->nentries; i++)
+    if (hosts->entries[i].type == HOST_TYPE_NAME && hosts->entries[i].host)
+      g_array_append_val (entries, hosts->entries[i]);
+  count = hosts->count;
+  gvm_hosts_set_entries (hosts, entries);
+  hosts->removed += count - hosts->count;
+}
+
+/**
+ * @brief Parses one element of a hosts string.
+ *
+ * @param[in]  element  Stripped element, such as "192.168.0.0/24".
+ * @param[out] entry    Entry for the hosts of the element. For a hostname,
+ *                      entry->host is a new host owned by the caller.
+ *
+ * @return 1 if entry was set, 0 if the element holds no hosts (e.g. a range
+ *         whose first address comes after the last), -1 if it is invalid.
+ */
+static int
+gvm_hosts_parse_element (const gchar *element, struct gvm_hosts_entry *entry)
+{
+  int host_type;
+
+  memset (entry, 0, sizeof (*entry));
+
+  /* IPv4, hostname, IPv6, collection (short/long range, cidr block) etc,. ? */
+  /* -1 if error. */
+  host_type = host_spec_parse (element, &entry->first, &entry->last);
+
+  switch (host_type)
+    {
+    case HOST_TYPE_NAME:
+      entry->type = HOST_TYPE_NAME;
+      entry->host = gvm_host_new ();
+      entry->host->type = HOST_TYPE_NAME;
+      entry->host->name = g_ascii_strdown (element, -1);
+      return 1;
+    case HOST_TYPE_IPV4:
+    case HOST_TYPE_CIDR_BLOCK:
+    case HOST_TYPE_RANGE_SHORT:
+    case HOST_TYPE_RANGE_LONG:
+    case HOST_TYPE_IPV6:
+    case HOST_TYPE_CIDR6_BLOCK:
+    case HOST_TYPE_RANGE6_LONG:
+    case HOST_TYPE_RANGE6_SHORT:
+      /* Make sure the first comes before the last. */
+      if (memcmp (&entry->first, &entry->last, sizeof (entry->first)) > 0)
+        return 0;
+
+      entry->type = (host_type == HOST_TYPE_IPV4
+                     || host_type == HOST_TYPE_CIDR_BLOCK
+                     || host_type == HOST_TYPE_RANGE_SHORT
+                     || host_type == HOST_TYPE_RANGE_LONG)
+                      ? HOST_TYPE_IPV4
+                      : HOST_TYPE_IPV6;
+      return 1;
+    case -1:
+    default:
+      /* Invalid host string. */
+      return -1;
+    }
+}
+
+/**
+ * @brief Cuts the next element out of a hosts string.
+ *
+ * Elements are separated by commas or newlines. The separator is overwritten,
+ * so that the element can be parsed in place.
+ *
+ * @param[in,out] str  Rest of the hosts string, moved past the element. Set to
+ *                     NULL after the last element.
+ *
+ * @return Stripped element, within the hosts string. NULL if str is NULL.
+ */
+static gchar *
+hosts_str_next_element (gchar **str)
+{
+  gchar *start = *str;
+  size_t len;
+
+  if (start == NULL)
+    return NULL;
+
+  len = strcspn (start, ",\n");
+  *str = start[len] ? start + len + 1 : NULL;
+  start[len] = '\0';
+  return g_strstrip (start);
 }
 
+/**
+ * @brief How @ref gvm_hosts_new_full handles duplicate hosts.
+ */
+enum hosts_dedup
+{
+  HOSTS_DEDUP_NONE,       /**< Keep duplicates. */
+  HOSTS_DEDUP_KEEP_ORDER, /**< Keep the first of each host, in order. */
+  HOSTS_DEDUP_SORT        /**< Sort the hosts while merging duplicates. */
+};
+
 /**
  * @brief Creates a new gvm_hosts_t structure and the associated hosts
  * objects from the provided hosts_str.
  *
- * @param[in] hosts_str The hosts string. A copy will be created of this within
- *                      the returned struct.
- * @param[in] max_hosts Max number of hosts in hosts_str. 0 means unlimited.
+ * Address ranges are stored as such, their host objects are only created
+ * when handed out.
+ *
+ * @param[in] hosts_str     The hosts string. A copy will be created of this
+ *                          within the returned struct.
+ * @param[in] max_hosts     Max number of hosts in hosts_str. 0 means
+ *                          unlimited.
+ * @param[in] dedup         How to handle duplicate hosts.
  *
  * @return NULL if error or hosts_str contains more than max hosts. Otherwise, a
  * hosts structure that should be released using @ref gvm_hosts_free.
  */
-gvm_hosts_t *
-gvm_hosts_new_with_max (const gchar *hosts_str, unsigned int max_hosts)
+static gvm_hosts_t *
+gvm_hosts_new_full (const gchar *hosts_str, unsigned int max_hosts,
+                    enum hosts_dedup dedup)
 {
   gvm_hosts_t *hosts;
-  gchar **host_element, **split;
-  gchar *str;
+  gchar *str, *rest, *element;
+  guint64 count = 0;
+  size_t elements = 0;
 
   if (hosts_str == NULL)
     return NULL;
 
-  /* Normalize separator: Transform newlines into commas. */
   hosts = gvm_hosts_init (hosts_str);
-  str = hosts->orig_str;
-  while (*str)
+  str = rest = g_strdup (hosts_str);
+  while ((element = hosts_str_next_element (&rest)))
     {
-      if (*str == '\n')
-        *str = ',';
-      str++;
-    }
-
-  /* Split comma-separated list into single host-specifications */
-  split = g_strsplit (hosts->orig_str, ",", 0);
+      struct gvm_hosts_entry entry;
+      guint64 size;
+      int ret;
 
-  /* first element of the split list */
-  host_element = split;
-  while (*host_element)
-    {
-      int host_type;
-      gchar *stripped = g_strstrip (*host_element);
+      if (*element == '\0')
+        continue;
 
-      if (stripped == NULL || *stripped == '\0')
+      elements++;
+      ret = gvm_hosts_parse_element (element, &entry);
+      if (ret == -1)
         {
-          host_element++;
-          continue;
+          g_free (str);
+          gvm_hosts_free (hosts);
+          return NULL;
         }
+      if (ret == 0)
+        continue;
 
-      /* IPv4, hostname, IPv6, collection (short/long range, cidr block) etc,. ?
-       */
-      /* -1 if error. */
-      host_type = gvm_get_host_type (stripped);
+      if (entry.type == HOST_TYPE_NAME)
+        gvm_hosts_add (hosts, entry.host);
+      else
+        gvm_hosts_add_range (hosts, entry.type, &entry.first, &entry.last);
+      size = gvm_hosts_entry_size (&entry);
+      count = size > G_MAXUINT ? size : count + size;
 
-      switch (host_type)
+      /* Counts are unsigned int. */
+      if ((max_hosts > 0 && count > max_hosts) || count > G_MAXUINT)
         {
-        case HOST_TYPE_NAME:
-        case HOST_TYPE_IPV4:
-        case HOST_TYPE_IPV6:
-          {
-            /* New host. */
-            gvm_host_t *host = gvm_host_new ();
-            host->type = host_type;
-            if (host_type == HOST_TYPE_NAME)
-              host->name = g_ascii_strdown (stripped, -1);
-            else if (host_type == HOST_TYPE_IPV4)
-              {
-                if (inet_pton (AF_INET, stripped, &host->addr) != 1)
-                  break;
-              }
-            else if (host_type == HOST_TYPE_IPV6)
-              {
-                if (inet_pton (AF_INET6, stripped, &host->addr6) != 1)
-                  break;
-              }
-            gvm_hosts_add (hosts, host);
-            break;
-          }
-        case HOST_TYPE_CIDR_BLOCK:
-        case HOST_TYPE_RANGE_SHORT:
-        case HOST_TYPE_RANGE_LONG:
-          {
-            struct in_addr first, last;
-            uint32_t current;
-            int (*ips_func) (const char *, struct in_addr *, struct in_addr *);
-
-            if (host_type == HOST_TYPE_CIDR_BLOCK)
-              ips_func = cidr_block_ips;
-            else if (host_type == HOST_TYPE_RANGE_SHORT)
-              ips_func = short_range_network_ips;
-            else
-              ips_func = long_range_network_ips;
-
-            if (ips_func (stripped, &first, &last) == -1)
-              break;
+          g_free (str);
+          gvm_hosts_free (hosts);
+          return NULL;
+        }
+    }
+  g_free (str);
+  gvm_hosts_update (hosts);
 
-            /* Make sure that first actually comes before last */
-            if (ntohl (first.s_addr) > ntohl (last.s_addr))
-              break;
+  /* No need to check for duplicates when a hosts string contains a
+   * single (IP/Hostname/Range/Subnetwork) entry. */
+  if (elements > 1 && dedup != HOSTS_DEDUP_NONE)
+    gvm_hosts_deduplicate (hosts, dedup == HOSTS_DEDUP_KEEP_ORDER);
 
-            /* Add addresses from first to last as single hosts. */
-            current = first.s_addr;
-            while (ntohl (current) <= ntohl (last.s_addr))
-              {
-                gvm_host_t *host;
-                if (max_hosts > 0 && hosts->count > max_hosts)
-                  {
-                    g_strfreev (split);
-                    gvm_hosts_free (hosts);
-                    return NULL;
-                  }
-                host = gvm_host_new ();
-                host->type = HOST_TYPE_IPV4;
-                host->addr.s_addr = current;
-                gvm_hosts_add (hosts, host);
-                /* Next IP address. */
-                current = htonl (ntohl (current) + 1);
-              }
-            break;
-          }
-        case HOST_TYPE_CIDR6_BLOCK:
-        case HOST_TYPE_RANGE6_LONG:
-        case HOST_TYPE_RANGE6_SHORT:
-          {
-            struct in6_addr first, last;
-            unsigned char current[16];
-            int (*ips_func) (const char *, struct in6_addr *,
-                             struct in6_addr *);
-
-            if (host_type == HOST_TYPE_CIDR6_BLOCK)
-              ips_func = cidr6_block_ips;
-            else if (host_type == HOST_TYPE_RANGE6_SHORT)
-              ips_func = short_range6_network_ips;
-            else
-              ips_func = long_range6_network_ips;
-
-            if (ips_func (stripped, &first, &last) == -1)
-              break;
+  return hosts;
+}
 
-            /* Make sure the first comes before the last. */
-            if (memcmp (&first.s6_addr, &last.s6_addr, 16) > 0)
-              break;
+/**
+ * @brief Creates a new gvm_hosts_t structure and the associated hosts
+ * objects from the provided hosts_str.
+ *
+ * @param[in] hosts_str The hosts string. A copy will be created of this within
+ *                      the returned struct.
+ * @param[in] max_hosts Max number of hosts in hosts_str. 0 means unlimited.
+ *
+ * @return NULL if error or hosts_str contains more than max hosts. Otherwise, a
+ * hosts structure that should be released using @ref gvm_hosts_free.
+ */
+gvm_hosts_t *
+gvm_hosts_new_with_max (const gchar *hosts_str, unsigned int max_hosts)
+{
+  return gvm_hosts_new_full (hosts_str, max_hosts, HOSTS_DEDUP_KEEP_ORDER);
+}
 
-            /* Add addresses from first to last as single hosts. */
-            memcpy (current, &first.s6_addr, 16);
-            while (memcmp (current, &last.s6_addr, 16) <= 0)
-              {
-                int i;
-                gvm_host_t *host;
-
-                if (max_hosts > 0 && hosts->count > max_hosts)
-                  {
-                    g_strfreev (split);
-                    gvm_hosts_free (hosts);
-                    return NULL;
-                  }
-                host = gvm_host_new ();
-                host->type = HOST_TYPE_IPV6;
-                memcpy (host->addr6.s6_addr, current, 16);
-                gvm_hosts_add (hosts, host);
-                /* Next IPv6 address. */
-                for (i = 15; i >= 0; --i)
-                  if (current[i] < 255)
-                    {
-                      current[i]++;
-                      break;
-                    }
-                  else
-                    current[i] = 0;
-              }
-            break;
-          }
-        case -1:
-        default:
-          /* Invalid host string. */
-          g_strfreev (split);
-          gvm_hosts_free (hosts);
-          return NULL;
-        }
-      host_element++; /* move on to next element of split list */
-      if (max_hosts > 0 && hosts->count > max_hosts)
+/**
+ * @brief Creates a new gvm_hosts_t structure and the associated hosts
+ * objects from the provided hosts_str, with addresses in ascending order
+ * followed by hostnames, instead of the order of hosts_str.
+ *
+ * Cheaper than @ref gvm_hosts_new_with_max for large lists with overlapping
+ * ranges, as duplicates are merged without tracking where they came from.
+ *
+ * @param[in] hosts_str The hosts string. A copy will be created of this within
+ *                      the returned struct.
+ * @param[in] max_hosts Max number of hosts in hosts_str. 0 means unlimited.
+ *
+ * @return NULL if error or hosts_str contains more than max hosts. Otherwise, a
+ * hosts structure that should be released using @ref gvm_hosts_free.
+ */
+gvm_hosts_t *
+gvm_hosts_new_sorted (const gchar *hosts_str, unsigned int max_hosts)
+{
+  return gvm_hosts_new_full (hosts_str, max_hosts, HOSTS_DEDUP_SORT);
+}
+
+/**
+ * @brief Creates a new gvm_hosts_t structure and the associated hosts
+ * objects from the provided hosts_str.
+ *
+ * @param[in] hosts_str The hosts string. A copy will be created of this within
+ *                      the returned struct.
+ *
+ * @return NULL if error, otherwise, a hosts structure that should be released
+ * using @ref gvm_hosts_free.
+ */
+gvm_hosts_t *
+gvm_hosts_new (const gchar *hosts_str)
+{
+  return gvm_hosts_new_with_max (hosts_str, 0);
+}
+
+/**
+ * @brief Round function of the permutation of shuffled hosts collections.
+ *
+ * @param[in] value Half block.
+ * @param[in] key   Round key.
+ *
+ * @return Mixed value.
+ */
+static guint32
+shuffle_round (guint32 value, guint32 key)
+{
+  value ^= key;
+  value *= 0x9e3779b1;
+  value ^= value >> 15;
+  value *= 0x85ebca77;
+  value ^= value >> 13;
+  return value;
+}
+
+/**
+ * @brief Maps an iteration index of a shuffled hosts collection to a
+ * position in its stored order.
+ *
+ * This is a keyed Feistel network over the smallest even power of two not
+ * lower than the count of hosts, cycle-walked to stay below that count: a
+ * permutation computed in constant memory.
+ *
+ * @param[in] hosts Hosts collection.
+ * @param[in] index Iteration index, lower than the count of hosts.
+ *
+ * @return Position.
+ */
+static size_t
+gvm_hosts_shuffled_pos (const gvm_hosts_t *hosts, size_t index)
+{
+  unsigned int half = 1, round;
+  guint64 mask, value = index;
+
+  while (((guint64) 1 << (2 * half)) < hosts->count)
+    half++;
+  mask = ((guint64) 1 << half) - 1;
+  do
+    {
+      guint64 left = value >> half, right = value & mask;
+
+      for (round = 0; round < G_N_ELEMENTS (hosts->shuffle); round++)
         {
-          g_strfreev (split);
-          gvm_hosts_free (hosts);
-          return NULL;
+          guint64 tmp = right;
+
+          right = left ^ (shuffle_round (right, hosts->shuffle[round]) & mask);
+          left = tmp;
         }
+      value = (left << half) | right;
     }
+  while (value >= hosts->count);
+  return value;
+}
 
-  /* No need to check for duplicates when a hosts string contains a
-   * single (IP/Hostname/Range/Subnetwork) entry. */
-  if (g_strv_length (split) > 1)
-    gvm_hosts_deduplicate (hosts);
+/**
+ * @brief Gets the number of hosts in the slice of a hosts collection.
+ *
+ * @param[in] hosts Hosts collection.
+ *
+ * @return Number of hosts iterated over.
+ */
+static size_t
+gvm_hosts_slice_count (const gvm_hosts_t *hosts)
+{
+  size_t slices = MAX (hosts->slices, 1);
 
-  g_strfreev (split);
-  malloc_trim (0);
-  return hosts;
+  return hosts->count / slices + (hosts->slice < hosts->count % slices);
 }
 
 /**
- * @brief Creates a new gvm_hosts_t structure and the associated hosts
- * objects from the provided hosts_str.
+ * @brief Maps an index in the slice of a hosts collection to an iteration
+ * index of the whole collection.
  *
- * @param[in] hosts_str The hosts string. A copy will be created of this within
- *                      the returned struct.
+ * Blocks are balanced: the first count % slices blocks have one host more.
  *
- * @return NULL if error, otherwise, a hosts structure that should be released
- * using @ref gvm_hosts_free.
+ * @param[in] hosts Hosts collection.
+ * @param[in] index Index in the slice, lower than its count of hosts.
+ *
+ * @return Iteration index.
  */
-gvm_hosts_t *
-gvm_hosts_new (const gchar *hosts_str)
+static size_t
+gvm_hosts_slice_pos (const gvm_hosts_t *hosts, size_t index)
 {
-  return gvm_hosts_new_with_max (hosts_str, 0);
+  size_t slices = MAX (hosts->slices, 1);
+
+  if (hosts->strided)
+    return hosts->slice + index * slices;
+  return hosts->slice * (hosts->count / slices)
+         + MIN (hosts->slice, hosts->count % slices) + index;
 }
 
 /**
  * @brief Gets the next gvm_host_t from a gvm_hosts_t structure. The
  * state of iteration is kept internally within the gvm_hosts structure.
  *
+ * Only the hosts of the slice picked by gvm_hosts_slice are returned.
+ *
+ * Host objects of addresses are kept until the collection is freed. To
+ * iterate over targets too large for that, use gvm_hosts_stream_new.
+ *
  * @param[in]   hosts     gvm_hosts_t structure to get next host from.
  *
- * @return Pointer to host. NULL if error or end of hosts.
+ * @return Pointer to host, valid until the collection is freed. NULL if
+ *         error or end of hosts.
  */
 gvm_host_t *
 gvm_hosts_next (gvm_hosts_t *hosts)
 {
-  if (!hosts || hosts->current == hosts->count)
+  size_t pos;
+
+  if (!hosts || hosts->current >= gvm_hosts_slice_count (hosts))
     return NULL;
 
-  return hosts->hosts[hosts->current++];
+  pos = gvm_hosts_slice_pos (hosts, hosts->current++);
+  if (hosts->reversed)
+    pos = hosts->count - 1 - pos;
+  if (hosts->shuffled)
+    pos = gvm_hosts_shuffled_pos (hosts, pos);
+  return gvm_hosts_get (hosts, pos);
 }
 
 /**
@@ -1261,12 +1856,35 @@ gvm_hosts_free (gvm_hosts_t *hosts)
 
   if (hosts->orig_str)
     g_free (hosts->orig_str);
-  for (i = 0; i < hosts->count; i++)
-    gvm_host_free (hosts->hosts[i]);
-  g_free (hosts->hosts);
+  for (i = 0; i < hosts->nentries; i++)
+    if (hosts->entries[i].type == HOST_TYPE_NAME)
+      gvm_host_free (hosts->entries[i].host);
+  gvm_hosts_index_free (hosts);
+  g_hash_table_destroy (hosts->addr_hosts);
+  g_free (hosts->entries);
+  g_free (hosts->starts);
   g_free (hosts);
 }
 
+/**
+ * @brief Picks a permutation of the hosts of a collection.
+ *
+ * @param[in] hosts The hosts collection to shuffle.
+ * @param[in] rand  Random generator to pick the permutation with.
+ */
+static void
+gvm_hosts_shuffle_rand (gvm_hosts_t *hosts, GRand *rand)
+{
+  size_t i;
+
+  for (i = 0; i < G_N_ELEMENTS (hosts->shuffle); i++)
+    hosts->shuffle[i] = g_rand_int (rand);
+  hosts->shuffled = 1;
+  hosts->reversed = 0;
+
+  hosts->current = 0;
+}
+
 /**
  * @brief Randomizes the order of the hosts objects in the collection.
  * Not to be used while iterating over the single hosts as it resets the
@@ -1277,25 +1895,36 @@ gvm_hosts_free (gvm_hosts_t *hosts)
 void
 gvm_hosts_shuffle (gvm_hosts_t *hosts)
 {
-  size_t i = 0;
   GRand *rand;
 
   if (hosts == NULL)
     return;
 
-  /* Shuffle the array. */
+  /* Pick a new permutation of the hosts. */
   rand = g_rand_new ();
-  for (i = 0; i < hosts->count; i++)
-    {
-      void *tmp;
-      int j = g_rand_int_range (rand, 0, hosts->count);
+  gvm_hosts_shuffle_rand (hosts, rand);
+  g_rand_free (rand);
+}
 
-      tmp = hosts->hosts[i];
-      hosts->hosts[i] = hosts->hosts[j];
-      hosts->hosts[j] = tmp;
-    }
+/**
+ * @brief Puts the hosts objects of the collection in a pseudo-random order
+ * given by a seed. The same seed and hosts give the same order.
+ * Not to be used while iterating over the single hosts as it resets the
+ * iterator.
+ *
+ * @param[in] hosts The hosts collection to shuffle.
+ * @param[in] seed  Seed of the order.
+ */
+void
+gvm_hosts_shuffle_with_seed (gvm_hosts_t *hosts, guint32 seed)
+{
+  GRand *rand;
 
-  hosts->current = 0;
+  if (hosts == NULL)
+    return;
+
+  rand = g_rand_new_with_seed (seed);
+  gvm_hosts_shuffle_rand (hosts, rand);
   g_rand_free (rand);
 }
 
@@ -1309,17 +1938,67 @@ gvm_hosts_shuffle (gvm_hosts_t *hosts)
 void
 gvm_hosts_reverse (gvm_hosts_t *hosts)
 {
-  size_t i, j;
   if (hosts == NULL)
     return;
 
-  for (i = 0, j = hosts->count - 1; i < j; i++, j--)
-    {
-      gvm_host_t *tmp = hosts->hosts[i];
-      hosts->hosts[i] = hosts->hosts[j];
-      hosts->hosts[j] = tmp;
-    }
+  hosts->reversed = !hosts->reversed;
+  hosts->current = 0;
+}
+
+/**
+ * @brief Restricts the iteration of a hosts collection to one of several
+ * disjoint slices.
+ *
+ * Meant for workers that each scan a part of the same target: after the
+ * collection is parsed, and shuffled with the same seed if at all, each
+ * worker picks its own slice of the same number of slices.  The slices
+ * together hold every host exactly once, and their sizes differ by at most
+ * one.  No hosts are copied.
+ *
+ * Slices apply to the iteration order, so reversing and shuffling keep
+ * them disjoint.  gvm_hosts_count still gives the whole collection.
+ * Not to be used while iterating over the single hosts as it resets the
+ * iterator.
+ *
+ * @param[in] hosts   The hosts collection.
+ * @param[in] slice   Index of the slice to iterate over, lower than slices.
+ * @param[in] slices  Number of slices.  1 to iterate over all hosts again.
+ * @param[in] strided Whether a slice takes every slices-th host, starting
+ *                    at its index, rather than a block of consecutive hosts.
+ * @param[out] count  Number of hosts in the slice.  Can be NULL.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_hosts_slice (gvm_hosts_t *hosts, unsigned int slice, unsigned int slices,
+                 int strided, size_t *count)
+{
+  if (hosts == NULL || slices == 0 || slice >= slices)
+    return -1;
+
+  hosts->slice = slice;
+  hosts->slices = slices;
+  hosts->strided = strided;
   hosts->current = 0;
+  if (count)
+    *count = gvm_hosts_slice_count (hosts);
+  return 0;
+}
+
+/**
+ * @brief Removes the hostname entries whose host was freed.
+ *
+ * @param[in] hosts The hosts collection.
+ */
+static void
+gvm_hosts_compact (gvm_hosts_t *hosts)
+{
+  size_t i, j;
+
+  for (i = 0, j = 0; i < hosts->nentries; i++)
+    if (hosts->entries[i].type != HOST_TYPE_NAME || hosts->entries[i].host)
+      hosts->entries[j++] = hosts->entries[i];
+  hosts->nentries = j;
 }
 
 /**
@@ -1335,204 +2014,516 @@ gvm_hosts_reverse (gvm_hosts_t *hosts)
 GSList *
 gvm_hosts_resolve (gvm_hosts_t *hosts)
 {
-  size_t i, new_entries = 0, resolved = 0;
-  GSList *unresolved = NULL;
+  size_t i, n, nentries, new_entries = 0, resolved = 0;
+  GSList *unresolved = NULL, **lists;
+  const char **names;
+  size_t *indexes;
+
+  /* Resolve all hostnames at once, then apply the results in order. */
+  nentries = hosts->nentries;
+  names = g_malloc_n (MAX (nentries, 1), sizeof (*names));
+  indexes = g_malloc_n (MAX (nentries, 1), sizeof (*indexes));
+  for (i = 0, n = 0; i < nentries; i++)
+    if (hosts->entries[i].type == HOST_TYPE_NAME)
+      {
+        names[n] = hosts->entries[i].host->name;
+        indexes[n++] = i;
+      }
+  /* Without timeout, so that no lookup outlives the call. */
+  lists = gvm_resolve_list_batch (names, n, dns_max_parallel, 0);
 
-  for (i = 0; i < hosts->count; i++)
+  for (i = 0; i < n; i++)
     {
       GSList *list, *tmp;
-      gvm_host_t *host = hosts->hosts[i];
+      gvm_host_t *host = hosts->entries[indexes[i]].host;
 
-      if (host->type != HOST_TYPE_NAME)
-        continue;
-
-      list = tmp = gvm_resolve_list (host->name);
+      list = tmp = lists[i];
       while (tmp)
         {
-          /* Create a new host for each IP address. */
+          /* Add each IP address, with the hostname as vhost. */
           gvm_host_t *new;
           struct in6_addr *ip6 = tmp->data;
+          enum host_type type;
           gvm_vhost_t *vhost;
 
-          new = gvm_host_new ();
           if (ip6->s6_addr32[0] != 0 || ip6->s6_addr32[1] != 0
               || ip6->s6_addr32[2] != htonl (0xffff))
-            {
-              new->type = HOST_TYPE_IPV6;
-              memcpy (&new->addr6, ip6, sizeof (new->addr6));
-            }
+            type = HOST_TYPE_IPV6;
           else
-            {
-              new->type = HOST_TYPE_IPV4;
-              memcpy (&new->addr6, &ip6->s6_addr32[3], sizeof (new->addr));
-            }
+            type = HOST_TYPE_IPV4;
+          gvm_hosts_add_range (hosts, type, ip6, ip6);
+          new = gvm_hosts_addr_host (hosts, type, ip6);
           vhost =
             gvm_vhost_new (g_strdup (host->name), g_strdup ("Forward-DNS"));
-          new->vhosts = g_slist_prepend (new->vhosts, vhost);
-          gvm_hosts_add (hosts, new);
+          new->vhosts = g_slist_append (new->vhosts, vhost);
           tmp = tmp->next;
           new_entries = 1;
         }
       /* Remove hostname from list, as it was either replaced by IPs, or
        * is unresolvable. */
-      hosts->hosts[i] = NULL;
+      hosts->entries[indexes[i]].host = NULL;
       resolved++;
       if (!list)
         unresolved = g_slist_prepend (unresolved, g_strdup (host->name));
       gvm_host_free (host);
       g_slist_free_full (list, g_free);
     }
+  g_free (lists);
+  g_free (names);
+  g_free (indexes);
   if (resolved)
-    gvm_hosts_fill_gaps (hosts);
-  hosts->count -= resolved;
+    gvm_hosts_compact (hosts);
+  gvm_hosts_update (hosts);
   hosts->removed += resolved;
   if (new_entries)
-    gvm_hosts_deduplicate (hosts);
+    gvm_hosts_deduplicate (hosts, 1);
   hosts->current = 0;
   return unresolved;
 }
 
 /**
- * @brief Exclude a list of vhosts from a host's vhosts list.
+ * @brief Exclude a list of vhosts from a host's vhosts list.
+ *
+ * @param[in] host  The host whose vhosts are to be excluded from.
+ * @param[in] excluded_str  String of hosts to exclude.
+ *
+ * @return Number of excluded vhosts.
+ */
+int
+gvm_vhosts_exclude (gvm_host_t *host, const char *excluded_str)
+{
+  GSList *vhost;
+  char **excluded;
+  int ret = 0;
+
+  if (!host || !excluded_str)
+    return ret;
+
+  vhost = host->vhosts;
+  excluded = g_strsplit (excluded_str, ",", 0);
+  if (!excluded || !*excluded)
+    {
+      g_strfreev (excluded);
+      return ret;
+    }
+  while (vhost)
+    {
+      char **tmp = excluded;
+      char *value = ((gvm_vhost_t *) vhost->data)->value;
+
+      while (*tmp)
+        {
+          if (!strcasecmp (value, g_strstrip (*tmp)))
+            {
+              gvm_vhost_free (vhost->data);
+              host->vhosts = vhost = g_slist_delete_link (host->vhosts, vhost);
+              ret++;
+              break;
+            }
+          tmp++;
+          if (!*tmp)
+            {
+              vhost = vhost->next;
+              break;
+            }
+        }
+    }
+  g_strfreev (excluded);
+
+  return ret;
+}
+
+/**
+ * @brief Excludes a set of hosts provided as a string from a hosts collection.
+ * Not to be used while iterating over the single hosts as it resets the
+ * iterator.
+ *
+ * @param[in] hosts         The hosts collection from which to exclude.
+ * @param[in] excluded_str  String of hosts to exclude.
+ * @param[in] max_hosts     Max number of hosts in hosts_str. 0 means unlimited.
+ *
+ * @return Number of excluded hosts, -1 if error.
+ */
+int
+gvm_hosts_exclude_with_max (gvm_hosts_t *hosts, const char *excluded_str,
+                            unsigned int max_hosts)
+{
+  /**
+   * Uses a hash table for hostnames. The excluded ranges are sorted and
+   * merged, then cut out of each range of the collection, found by binary
+   * search. That is O((N+M) log M) time, whatever the ranges sizes.
+   */
+  gvm_hosts_t *excluded_hosts;
+  GArray *entries, *ranges;
+  size_t excluded, i;
+
+  if (hosts == NULL || excluded_str == NULL)
+    return -1;
+
+  excluded_hosts = gvm_hosts_new_with_max (excluded_str, max_hosts);
+  if (excluded_hosts == NULL)
+    return -1;
+
+  if (gvm_hosts_count (excluded_hosts) == 0)
+    {
+      gvm_hosts_free (excluded_hosts);
+      return 0;
+    }
+
+  gvm_hosts_index (excluded_hosts);
+  ranges = excluded_hosts->ranges;
+  entries = g_array_sized_new (FALSE, FALSE, sizeof (struct gvm_hosts_entry),
+                               hosts->nentries);
+  for (i = 0; i < hosts->nentries; i++)
+    {
+      struct gvm_hosts_entry *entry = &hosts->entries[i], part = *entry;
+      size_t j;
+      int covered;
+
+      if (entry->type == HOST_TYPE_NAME)
+        {
+          if (g_hash_table_contains (excluded_hosts->names, entry->host->name))
+            gvm_host_free (entry->host);
+          else
+            g_array_append_val (entries, *entry);
+          continue;
+        }
+
+      /* Keep the gaps between the excluded ranges overlapping the entry. */
+      covered = 0;
+      for (j = hosts_ranges_find (ranges, entry->type, &entry->first);
+           j < ranges->len && !covered; j++)
+        {
+          struct gvm_hosts_entry *range;
+
+          range = &g_array_index (ranges, struct gvm_hosts_entry, j);
+          if (range->type != entry->type
+              || memcmp (&range->first, &entry->last, sizeof (range->first))
+                   > 0)
+            break;
+          if (memcmp (&range->first, &part.first, sizeof (part.first)) > 0)
+            {
+              part.last = range->first;
+              addr6_dec (&part.last);
+              g_array_append_val (entries, part);
+            }
+          if (memcmp (&range->last, &entry->last, sizeof (range->last)) >= 0)
+            covered = 1;
+          else
+            {
+              part.first = range->last;
+              addr6_inc (&part.first);
+            }
+        }
+      if (!covered)
+        {
+          part.last = entry->last;
+          g_array_append_val (entries, part);
+        }
+    }
+
+  /* Cleanup. */
+  excluded = hosts->count;
+  gvm_hosts_set_entries (hosts, entries);
+  excluded -= hosts->count;
+  if (excluded)
+    {
+      gvm_hosts_index (hosts);
+      g_hash_table_foreach_remove (hosts->addr_hosts, gvm_hosts_addr_host_gone,
+                                   hosts);
+    }
+  hosts->removed += excluded;
+  gvm_hosts_free (excluded_hosts);
+  return excluded;
+}
+
+/**
+ * @brief Excludes a set of hosts provided as a string from a hosts collection.
+ * Not to be used while iterating over the single hosts as it resets the
+ * iterator.
+ *
+ * @param[in] hosts         The hosts collection from which to exclude.
+ * @param[in] excluded_str  String of hosts to exclude.
+ *
+ * @return Number of excluded hosts, -1 if error.
+ */
+int
+gvm_hosts_exclude (gvm_hosts_t *hosts, const char *excluded_str)
+{
+  return gvm_hosts_exclude_with_max (hosts, excluded_str, 0);
+}
+
+/**
+ * @brief Hosts of a hosts string, generated one at a time.
+ */
+struct gvm_hosts_stream
+{
+  gchar *hosts_str;             /**< Copy of the hosts string. */
+  gchar *rest;                  /**< Part of hosts_str left to parse. */
+  gvm_hosts_t *excluded;        /**< Hosts to skip, NULL if none. */
+  gvm_hosts_t *hosts;           /**< Whole collection if shuffled, or NULL. */
+  size_t current;               /**< Iteration index if shuffled. */
+  struct gvm_hosts_entry entry; /**< Element being streamed. */
+  struct in6_addr next;         /**< Next address of entry. */
+  int in_entry;                 /**< Whether entry has hosts left. */
+  gvm_host_t *host;             /**< Last host handed out. */
+};
+
+/**
+ * @brief Checks that all the elements of a hosts string are valid.
+ *
+ * @param[in] hosts_str Hosts string.
+ *
+ * @return 0 if valid, -1 otherwise.
+ */
+static int
+hosts_str_check (const gchar *hosts_str)
+{
+  gchar *str, *rest, *element;
+  int ret = 0;
+
+  str = rest = g_strdup (hosts_str);
+  while (ret != -1 && (element = hosts_str_next_element (&rest)))
+    {
+      struct gvm_hosts_entry entry;
+
+      ret = *element ? gvm_hosts_parse_element (element, &entry) : 0;
+      if (ret == 1 && entry.type == HOST_TYPE_NAME)
+        gvm_host_free (entry.host);
+    }
+  g_free (str);
+  return ret == -1 ? -1 : 0;
+}
+
+/**
+ * @brief Creates a stream of the hosts of a hosts string, in the order of the
+ * string.
+ *
+ * Unlike a hosts collection, the stream parses the string element by element
+ * as hosts are requested, and only keeps the current element and the
+ * excluded hosts. Duplicate hosts are not removed.
+ *
+ * @param[in] hosts_str   The hosts string. A copy is kept in the stream.
+ * @param[in] exclude_str String of hosts to skip. NULL for none.
+ *
+ * @return NULL if either string is invalid, otherwise a stream to release
+ *         with @ref gvm_hosts_stream_free.
+ */
+gvm_hosts_stream_t *
+gvm_hosts_stream_new (const gchar *hosts_str, const gchar *exclude_str)
+{
+  gvm_hosts_stream_t *stream;
+  gvm_hosts_t *excluded = NULL;
+
+  if (hosts_str == NULL || hosts_str_check (hosts_str))
+    return NULL;
+
+  if (exclude_str)
+    {
+      excluded = gvm_hosts_new (exclude_str);
+      if (excluded == NULL)
+        return NULL;
+      gvm_hosts_index (excluded);
+    }
+
+  stream = g_malloc0 (sizeof (*stream));
+  stream->hosts_str = g_strdup (hosts_str);
+  stream->rest = stream->hosts_str;
+  stream->excluded = excluded;
+  return stream;
+}
+
+/**
+ * @brief Creates a stream of the hosts of a hosts string, in a pseudo-random
+ * order given by a seed.
+ *
+ * The hosts come in the order @ref gvm_hosts_shuffle_with_seed gives to the
+ * same hosts, kept as ranges. The stream doesn't create the host objects of
+ * the whole collection. Duplicate hosts are not removed.
+ *
+ * @param[in] hosts_str   The hosts string.
+ * @param[in] exclude_str String of hosts to skip. NULL for none.
+ * @param[in] seed        Seed of the order.
+ *
+ * @return NULL if either string is invalid or holds more than G_MAXUINT
+ *         hosts, otherwise a stream to release with
+ *         @ref gvm_hosts_stream_free.
+ */
+gvm_hosts_stream_t *
+gvm_hosts_stream_new_shuffled (const gchar *hosts_str, const gchar *exclude_str,
+                               guint32 seed)
+{
+  gvm_hosts_stream_t *stream;
+  gvm_hosts_t *hosts;
+
+  hosts = gvm_hosts_new_full (hosts_str, 0, HOSTS_DEDUP_NONE);
+  if (hosts == NULL)
+    return NULL;
+  if (exclude_str && gvm_hosts_exclude (hosts, exclude_str) == -1)
+    {
+      gvm_hosts_free (hosts);
+      return NULL;
+    }
+  gvm_hosts_shuffle_with_seed (hosts, seed);
+
+  stream = g_malloc0 (sizeof (*stream));
+  stream->hosts = hosts;
+  return stream;
+}
+
+/**
+ * @brief Gets the next host of a shuffled stream.
  *
- * @param[in] host  The host whose vhosts are to be excluded from.
- * @param[in] excluded_str  String of hosts to exclude.
+ * @param[in] stream Shuffled stream.
  *
- * @return Number of excluded vhosts.
+ * @return New host, NULL at the end of the stream.
  */
-int
-gvm_vhosts_exclude (gvm_host_t *host, const char *excluded_str)
+static gvm_host_t *
+gvm_hosts_stream_next_shuffled (gvm_hosts_stream_t *stream)
 {
-  GSList *vhost;
-  char **excluded;
-  int ret = 0;
+  gvm_hosts_t *hosts = stream->hosts;
+  struct gvm_hosts_entry *entry;
+  struct in6_addr addr;
+  gvm_host_t *host;
+  size_t pos, i;
 
-  if (!host || !excluded_str)
-    return ret;
+  if (stream->current >= hosts->count)
+    return NULL;
 
-  vhost = host->vhosts;
-  excluded = g_strsplit (excluded_str, ",", 0);
-  if (!excluded || !*excluded)
+  pos = gvm_hosts_shuffled_pos (hosts, stream->current++);
+  i = gvm_hosts_find_entry (hosts, pos);
+  entry = &hosts->entries[i];
+  host = gvm_host_new ();
+  if (entry->type == HOST_TYPE_NAME)
     {
-      g_strfreev (excluded);
-      return ret;
+      host->type = HOST_TYPE_NAME;
+      host->name = g_strdup (entry->host->name);
+      return host;
     }
-  while (vhost)
+  addr = entry->first;
+  addr6_add (&addr, pos - hosts->starts[i]);
+  host_addr_init (host, entry->type, &addr);
+  return host;
+}
+
+/**
+ * @brief Gets the next address of the element being streamed, skipping the
+ * excluded ones.
+ *
+ * @param[in]  stream Stream.
+ * @param[out] addr   Address.
+ *
+ * @return 1 if addr was set, 0 if the element has no hosts left.
+ */
+static int
+gvm_hosts_stream_next_addr (gvm_hosts_stream_t *stream, struct in6_addr *addr)
+{
+  const struct gvm_hosts_entry *entry = &stream->entry;
+
+  while (stream->in_entry)
     {
-      char **tmp = excluded;
-      char *value = ((gvm_vhost_t *) vhost->data)->value;
+      GArray *ranges = stream->excluded ? stream->excluded->ranges : NULL;
+      size_t i;
 
-      while (*tmp)
+      *addr = stream->next;
+      if (ranges
+          && (i = hosts_ranges_find (ranges, entry->type, addr)) < ranges->len)
         {
-          if (!strcasecmp (value, g_strstrip (*tmp)))
-            {
-              gvm_vhost_free (vhost->data);
-              host->vhosts = vhost = g_slist_delete_link (host->vhosts, vhost);
-              ret++;
-              break;
-            }
-          tmp++;
-          if (!*tmp)
+          struct gvm_hosts_entry *range;
+
+          range = &g_array_index (ranges, struct gvm_hosts_entry, i);
+          if (range->type == entry->type
+              && memcmp (&range->first, addr, sizeof (*addr)) <= 0)
             {
-              vhost = vhost->next;
-              break;
+              /* Skip the whole excluded range at once. */
+              stream->next = range->last;
+              stream->in_entry =
+                memcmp (&range->last, &entry->last, sizeof (*addr)) < 0;
+              addr6_inc (&stream->next);
+              continue;
             }
         }
-    }
-  g_strfreev (excluded);
 
-  return ret;
+      if (memcmp (addr, &entry->last, sizeof (*addr)) == 0)
+        stream->in_entry = 0;
+      else
+        addr6_inc (&stream->next);
+      return 1;
+    }
+  return 0;
 }
 
 /**
- * @brief Excludes a set of hosts provided as a string from a hosts collection.
- * Not to be used while iterating over the single hosts as it resets the
- * iterator.
+ * @brief Gets the next host of a hosts stream.
  *
- * @param[in] hosts         The hosts collection from which to exclude.
- * @param[in] excluded_str  String of hosts to exclude.
- * @param[in] max_hosts     Max number of hosts in hosts_str. 0 means unlimited.
+ * @param[in] stream Hosts stream.
  *
- * @return Number of excluded hosts, -1 if error.
+ * @return Host, owned by the stream and valid until the next call. NULL at the
+ *         end of the stream or if error.
  */
-int
-gvm_hosts_exclude_with_max (gvm_hosts_t *hosts, const char *excluded_str,
-                            unsigned int max_hosts)
+gvm_host_t *
+gvm_hosts_stream_next (gvm_hosts_stream_t *stream)
 {
-  /**
-   * Uses a hash table in order to exclude hosts in O(N+M) time.
-   */
-  gvm_hosts_t *excluded_hosts;
-  GHashTable *name_table;
-  size_t excluded = 0, i;
+  gchar *element;
 
-  if (hosts == NULL || excluded_str == NULL)
-    return -1;
-
-  excluded_hosts = gvm_hosts_new_with_max (excluded_str, max_hosts);
-  if (excluded_hosts == NULL)
-    return -1;
+  if (stream == NULL)
+    return NULL;
 
-  if (gvm_hosts_count (excluded_hosts) == 0)
-    {
-      gvm_hosts_free (excluded_hosts);
-      return 0;
-    }
+  gvm_host_free (stream->host);
+  stream->host = NULL;
+  if (stream->hosts)
+    return stream->host = gvm_hosts_stream_next_shuffled (stream);
 
-  /* Hash host values from excluded hosts list. */
-  name_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-  for (i = 0; i < excluded_hosts->count; i++)
+  for (;;)
     {
-      gchar *name;
+      struct in6_addr addr;
+      int ret = 0;
 
-      if ((name = gvm_host_value_str (excluded_hosts->hosts[i])))
-        g_hash_table_insert (name_table, name, hosts);
-    }
+      if (gvm_hosts_stream_next_addr (stream, &addr))
+        {
+          stream->host = gvm_host_new ();
+          host_addr_init (stream->host, stream->entry.type, &addr);
+          return stream->host;
+        }
 
-  /* Check for hosts values in hash table. */
-  for (i = 0; i < hosts->count; i++)
-    {
-      gchar *name;
+      element = hosts_str_next_element (&stream->rest);
+      if (element == NULL)
+        return NULL;
+      if (*element)
+        ret = gvm_hosts_parse_element (element, &stream->entry);
+      if (ret != 1)
+        continue;
 
-      if ((name = gvm_host_value_str (hosts->hosts[i])))
+      if (stream->entry.type != HOST_TYPE_NAME)
         {
-          if (g_hash_table_lookup (name_table, name))
-            {
-              gvm_host_free (hosts->hosts[i]);
-              hosts->hosts[i] = NULL;
-              excluded++;
-              g_free (name);
-              continue;
-            }
-          g_free (name);
+          stream->next = stream->entry.first;
+          stream->in_entry = 1;
         }
+      else if (stream->excluded
+               && g_hash_table_contains (stream->excluded->names,
+                                         stream->entry.host->name))
+        gvm_host_free (stream->entry.host);
+      else
+        return stream->host = stream->entry.host;
     }
-
-  /* Cleanup. */
-  if (excluded)
-    gvm_hosts_fill_gaps (hosts);
-  hosts->count -= excluded;
-  hosts->removed += excluded;
-  hosts->current = 0;
-  g_hash_table_destroy (name_table);
-  gvm_hosts_free (excluded_hosts);
-  return excluded;
 }
 
 /**
- * @brief Excludes a set of hosts provided as a string from a hosts collection.
- * Not to be used while iterating over the single hosts as it resets the
- * iterator.
- *
- * @param[in] hosts         The hosts collection from which to exclude.
- * @param[in] excluded_str  String of hosts to exclude.
+ * @brief Frees a hosts stream.
  *
- * @return Number of excluded hosts, -1 if error.
+ * @param[in] stream Hosts stream.
  */
-int
-gvm_hosts_exclude (gvm_hosts_t *hosts, const char *excluded_str)
+void
+gvm_hosts_stream_free (gvm_hosts_stream_t *stream)
 {
-  return gvm_hosts_exclude_with_max (hosts, excluded_str, 0);
+  if (stream == NULL)
+    return;
+
+  gvm_host_free (stream->host);
+  gvm_hosts_free (stream->excluded);
+  gvm_hosts_free (stream->hosts);
+  g_free (stream->hosts_str);
+  g_free (stream);
 }
 
 /**
@@ -1545,45 +2536,13 @@ gvm_hosts_exclude (gvm_hosts_t *hosts, const char *excluded_str)
 char *
 gvm_host_reverse_lookup (gvm_host_t *host)
 {
-  int retry = 2;
-  gchar hostname[NI_MAXHOST];
-  void *addr;
-  size_t addrlen;
-  struct sockaddr_in sa;
-  struct sockaddr_in6 sa6;
-
-  if (!host)
-    return NULL;
+  struct in6_addr addr;
 
-  if (host->type == HOST_TYPE_IPV4)
-    {
-      addr = &sa;
-      addrlen = sizeof (sa);
-      memset (addr, '\0', addrlen);
-      sa.sin_addr = host->addr;
-      sa.sin_family = AF_INET;
-    }
-  else if (host->type == HOST_TYPE_IPV6)
-    {
-      addr = &sa6;
-      addrlen = sizeof (sa6);
-      memset (&sa6, '\0', addrlen);
-      memcpy (&sa6.sin6_addr, &host->addr6, 16);
-      sa6.sin6_family = AF_INET6;
-    }
-  else
+  if (!host || host->type == HOST_TYPE_NAME)
     return NULL;
 
-  while (retry--)
-    {
-      int ret = getnameinfo (addr, addrlen, hostname, sizeof (hostname), NULL,
-                             0, NI_NAMEREQD);
-      if (!ret)
-        return g_ascii_strdown (hostname, -1);
-      if (ret != EAI_AGAIN)
-        break;
-    }
-  return NULL;
+  gvm_host_get_addr6 (host, &addr);
+  return gvm_reverse_lookup (&addr);
 }
 
 /**
@@ -1659,6 +2618,198 @@ gvm_host_add_reverse_lookup (gvm_host_t *host)
   host->vhosts = g_slist_prepend (host->vhosts, vhost);
 }
 
+/**
+ * @brief State of a reverse-lookup filter of a hosts collection.
+ */
+struct hosts_filter
+{
+  gvm_hosts_t *hosts;            /**< Hosts collection. */
+  GArray *entries;               /**< Entries kept so far. */
+  struct gvm_hosts_entry *batch; /**< Addresses to look up, as ranges. */
+  size_t len;                    /**< Number of addresses to look up. */
+  struct gvm_hosts_entry run;    /**< Current run of kept addresses. */
+  int in_run;                    /**< Whether run is set. */
+  int (*keep) (gvm_host_t *, gchar *, gpointer); /**< Filter function. */
+  gpointer data;                                 /**< Data of keep. */
+};
+
+/**
+ * @brief Adds the current run of kept addresses to the kept entries.
+ *
+ * @param[in] filter    Filter state.
+ */
+static void
+hosts_filter_end_run (struct hosts_filter *filter)
+{
+  if (filter->in_run)
+    g_array_append_val (filter->entries, filter->run);
+  filter->in_run = 0;
+}
+
+/**
+ * @brief Reverse-lookups the pending addresses of a filter concurrently, then
+ * keeps or removes them, in order.
+ *
+ * @param[in] filter    Filter state.
+ */
+static void
+hosts_filter_flush (struct hosts_filter *filter)
+{
+  struct in6_addr *addrs;
+  gchar **names;
+  size_t i;
+
+  if (filter->len == 0)
+    return;
+
+  addrs = g_malloc_n (filter->len, sizeof (*addrs));
+  for (i = 0; i < filter->len; i++)
+    addrs[i] = filter->batch[i].first;
+  names = gvm_reverse_lookup_batch (addrs, filter->len, dns_max_parallel, 0);
+
+  for (i = 0; i < filter->len; i++)
+    {
+      struct gvm_hosts_entry *current = &filter->batch[i];
+      gvm_host_t tmp, *host;
+      struct in6_addr next;
+
+      host_addr_init (&tmp, current->type, &current->first);
+      host = g_hash_table_lookup (filter->hosts->addr_hosts, &tmp);
+      if (!filter->keep (host ? host : &tmp, names[i], filter->data))
+        {
+          hosts_filter_end_run (filter);
+          if (host)
+            g_hash_table_remove (filter->hosts->addr_hosts, host);
+          continue;
+        }
+
+      /* Extend the run if the address follows it. */
+      next = filter->run.last;
+      if (filter->in_run && filter->run.type == current->type
+          && !addr6_inc (&next)
+          && !memcmp (&next, &current->first, sizeof (next)))
+        filter->run.last = current->first;
+      else
+        {
+          hosts_filter_end_run (filter);
+          filter->run = *current;
+          filter->in_run = 1;
+        }
+    }
+  g_free (names);
+  g_free (addrs);
+  filter->len = 0;
+}
+
+/**
+ * @brief Removes the hosts of a hosts collection that a function rejects,
+ * given their reverse-lookup. Also resets the iterator current position.
+ *
+ * Addresses are looked up in concurrent batches, and decided on in order.
+ *
+ * @param[in] hosts The hosts collection to filter.
+ * @param[in] keep  Function returning whether to keep a host, given the
+ *                  hostname it reverse-lookups to, which it frees.
+ * @param[in] data  Data passed to keep.
+ *
+ * @return Number of hosts removed.
+ */
+static size_t
+gvm_hosts_filter (gvm_hosts_t *hosts,
+                  int (*keep) (gvm_host_t *, gchar *, gpointer), gpointer data)
+{
+  struct hosts_filter filter;
+  size_t i, count;
+
+  memset (&filter, 0, sizeof (filter));
+  filter.hosts = hosts;
+  filter.keep = keep;
+  filter.data = data;
+  filter.entries = g_array_sized_new (
+    FALSE, FALSE, sizeof (struct gvm_hosts_entry), hosts->nentries);
+  filter.batch = g_malloc_n (HOSTS_LOOKUP_BATCH, sizeof (*filter.batch));
+  for (i = 0; i < hosts->nentries; i++)
+    {
+      struct gvm_hosts_entry *entry = &hosts->entries[i];
+      struct in6_addr addr;
+
+      if (entry->type == HOST_TYPE_NAME)
+        {
+          /* Hostnames don't reverse-lookup. */
+          hosts_filter_flush (&filter);
+          hosts_filter_end_run (&filter);
+          if (keep (entry->host, NULL, data))
+            g_array_append_val (filter.entries, *entry);
+          else
+            gvm_host_free (entry->host);
+          continue;
+        }
+
+      addr = entry->first;
+      for (;;)
+        {
+          struct gvm_hosts_entry *pending = &filter.batch[filter.len++];
+
+          *pending = *entry;
+          pending->first = pending->last = addr;
+          if (filter.len == HOSTS_LOOKUP_BATCH)
+            hosts_filter_flush (&filter);
+          if (!memcmp (&addr, &entry->last, sizeof (addr)))
+            break;
+          addr6_inc (&addr);
+        }
+    }
+  hosts_filter_flush (&filter);
+  hosts_filter_end_run (&filter);
+  g_free (filter.batch);
+
+  count = hosts->count;
+  gvm_hosts_set_entries (hosts, filter.entries);
+  return count - hosts->count;
+}
+
+/**
+ * @brief Checks whether a host reverse-lookups.
+ *
+ * @param[in] host  The host object.
+ * @param[in] name  Hostname the host reverse-lookups to, or NULL.
+ * @param[in] data  Unused.
+ *
+ * @return 1 if the host reverse-lookups, 0 otherwise.
+ */
+static int
+host_reverse_lookup_exists (gvm_host_t *host, gchar *name, gpointer data)
+{
+  (void) host;
+  (void) data;
+  g_free (name);
+  return name != NULL;
+}
+
+/**
+ * @brief Checks whether a host reverse-lookups to a new value.
+ *
+ * @param[in] host          The host object.
+ * @param[in] name          Hostname the host reverse-lookups to, or NULL.
+ * @param[in] name_table    Set of the values seen so far.
+ *
+ * @return 0 if the host reverse-lookups to a value seen before, 1 otherwise.
+ */
+static int
+host_reverse_lookup_new (gvm_host_t *host, gchar *name, gpointer name_table)
+{
+  (void) host;
+  if (name == NULL)
+    return 1;
+  if (g_hash_table_contains (name_table, name))
+    {
+      g_free (name);
+      return 0;
+    }
+  g_hash_table_add (name_table, name);
+  return 1;
+}
+
 /**
  * @brief Removes hosts that don't reverse-lookup from the hosts collection.
  * Not to be used while iterating over the single hosts as it resets the
@@ -1671,30 +2822,13 @@ gvm_host_add_reverse_lookup (gvm_host_t *host)
 int
 gvm_hosts_reverse_lookup_only (gvm_hosts_t *hosts)
 {
-  size_t i, count = 0;
+  size_t count;
 
   if (hosts == NULL)
     return -1;
 
-  for (i = 0; i < hosts->count; i++)
-    {
-      gchar *name = gvm_host_reverse_lookup (hosts->hosts[i]);
-
-      if (name == NULL)
-        {
-          gvm_host_free (hosts->hosts[i]);
-          hosts->hosts[i] = NULL;
-          count++;
-        }
-      else
-        g_free (name);
-    }
-
-  if (count)
-    gvm_hosts_fill_gaps (hosts);
-  hosts->count -= count;
+  count = gvm_hosts_filter (hosts, host_reverse_lookup_exists, NULL);
   hosts->removed += count;
-  hosts->current = 0;
   return count;
 }
 
@@ -1713,40 +2847,16 @@ gvm_hosts_reverse_lookup_unify (gvm_hosts_t *hosts)
   /**
    * Uses a hash table in order to unify the hosts list in O(N) time.
    */
-  size_t i, count = 0;
+  size_t count;
   GHashTable *name_table;
 
   if (hosts == NULL)
     return -1;
 
   name_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-  for (i = 0; i < hosts->count; i++)
-    {
-      gchar *name;
-
-      if ((name = gvm_host_reverse_lookup (hosts->hosts[i])))
-        {
-          if (g_hash_table_lookup (name_table, name))
-            {
-              gvm_host_free (hosts->hosts[i]);
-              hosts->hosts[i] = NULL;
-              count++;
-              g_free (name);
-            }
-          else
-            {
-              /* Insert in the hash table. Value not important. */
-              g_hash_table_insert (name_table, name, hosts);
-            }
-        }
-    }
-
-  if (count)
-    gvm_hosts_fill_gaps (hosts);
+  count = gvm_hosts_filter (hosts, host_reverse_lookup_new, name_table);
   g_hash_table_destroy (name_table);
   hosts->removed += count;
-  hosts->count -= count;
-  hosts->current = 0;
   return count;
 }
 
@@ -1777,6 +2887,21 @@ gvm_hosts_removed (const gvm_hosts_t *hosts)
   return hosts ? hosts->removed : 0;
 }
 
+/**
+ * @brief Sets the max number of concurrent DNS lookups of hosts collections,
+ * for gvm_hosts_resolve and the reverse-lookup filters.
+ *
+ * The lookups have no timeout other than the system resolver settings, so
+ * that all of them are done when these functions return.
+ *
+ * @param[in] max_parallel  Max number of concurrent lookups. 0 for default.
+ */
+void
+gvm_hosts_set_dns_parallel (unsigned int max_parallel)
+{
+  dns_max_parallel = max_parallel ? max_parallel : HOSTS_DNS_PARALLEL;
+}
+
 /**
  * @brief Returns whether a host has an equal host in a hosts collection.
  * eg. 192.168.10.1 has an equal in list created from
@@ -1793,43 +2918,37 @@ int
 gvm_host_in_hosts (const gvm_host_t *host, const struct in6_addr *addr,
                    const gvm_hosts_t *hosts)
 {
-  char *host_str;
-  size_t i;
+  /**
+   * Looks the host up in an index of the collection, built on first use, in
+   * O(log N) time.
+   */
+  gvm_hosts_t *indexed = (gvm_hosts_t *) hosts;
+  struct in6_addr host_addr;
 
   if (host == NULL || hosts == NULL)
     return 0;
 
-  host_str = gvm_host_value_str (host);
-
-  for (i = 0; i < hosts->count; i++)
+  gvm_hosts_index (indexed);
+  if (host->type == HOST_TYPE_NAME)
     {
-      gvm_host_t *current_host = hosts->hosts[i];
-      char *tmp = gvm_host_value_str (current_host);
-
-      if (strcasecmp (host_str, tmp) == 0)
-        {
-          g_free (host_str);
-          g_free (tmp);
-          return 1;
-        }
-      g_free (tmp);
-
-      /* Hostnames in hosts list shouldn't be resolved. */
-      if (addr && gvm_host_type (current_host) != HOST_TYPE_NAME)
-        {
-          struct in6_addr tmpaddr;
-          gvm_host_get_addr6 (current_host, &tmpaddr);
+      gchar *name = g_ascii_strdown (host->name, -1);
+      int found = g_hash_table_contains (indexed->names, name);
 
-          if (memcmp (addr->s6_addr, &tmpaddr.s6_addr, 16) == 0)
-            {
-              g_free (host_str);
-              return 1;
-            }
-        }
+      g_free (name);
+      if (found)
+        return 1;
+    }
+  else
+    {
+      gvm_host_get_addr6 (host, &host_addr);
+      if (hosts_ranges_has (indexed->ranges, host->type, &host_addr))
+        return 1;
     }
 
-  g_free (host_str);
-  return 0;
+  /* Hostnames in hosts list shouldn't be resolved. */
+  return addr
+         && (hosts_ranges_has (indexed->ranges, HOST_TYPE_IPV4, addr)
+             || hosts_ranges_has (indexed->ranges, HOST_TYPE_IPV6, addr));
 }
 
 /**
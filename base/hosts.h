@@ -51,6 +51,7 @@ enum host_type
 typedef struct gvm_host gvm_host_t;
 typedef struct gvm_vhost gvm_vhost_t;
 typedef struct gvm_hosts gvm_hosts_t;
+typedef struct gvm_hosts_stream gvm_hosts_stream_t;
 
 /* Data structures. */
 
@@ -89,12 +90,23 @@ struct gvm_vhost
  */
 struct gvm_hosts
 {
-  gchar *orig_str;    /**< Original hosts definition string. */
-  gvm_host_t **hosts; /**< Hosts objects list. */
-  size_t max_size;    /**< Current max size of hosts array entries. */
-  size_t current;     /**< Current host index in iteration. */
+  gchar *orig_str;                 /**< Original hosts definition string. */
+  struct gvm_hosts_entry *entries; /**< Hostnames and address ranges. */
+  size_t *starts;         /**< Index of the first host of each entry. */
+  size_t nentries;        /**< Number of entries. */
+  size_t max_size;        /**< Current max size of entries array. */
+  GHashTable *addr_hosts; /**< Host objects of the addresses handed out. */
+  GArray *ranges;         /**< Sorted disjoint ranges, for lookups. */
+  GHashTable *names;      /**< Set of the hostnames, for lookups. */
+  size_t current;         /**< Current host index in iteration. */
   size_t count;       /**< Number of single host objects in hosts list. */
   size_t removed;     /**< Number of duplicate/excluded values. */
+  guint32 shuffle[4]; /**< Keys of the random order, if shuffled. */
+  int shuffled;       /**< Whether the order is random. */
+  int reversed;       /**< Whether the order is reversed. */
+  size_t slice;       /**< Index of the slice iterated over. */
+  size_t slices;      /**< Number of slices, 0 if not sliced. */
+  int strided;        /**< Whether slices are strided, not blocks. */
 };
 
 /* Function prototypes. */
@@ -106,6 +118,9 @@ gvm_hosts_new (const gchar *);
 gvm_hosts_t *
 gvm_hosts_new_with_max (const gchar *, unsigned int);
 
+gvm_hosts_t *
+gvm_hosts_new_sorted (const gchar *, unsigned int);
+
 gvm_host_t *
 gvm_hosts_next (gvm_hosts_t *);
 
@@ -115,9 +130,15 @@ gvm_hosts_free (gvm_hosts_t *);
 void
 gvm_hosts_shuffle (gvm_hosts_t *);
 
+void
+gvm_hosts_shuffle_with_seed (gvm_hosts_t *, guint32);
+
 void
 gvm_hosts_reverse (gvm_hosts_t *);
 
+int
+gvm_hosts_slice (gvm_hosts_t *, unsigned int, unsigned int, int, size_t *);
+
 GSList *
 gvm_hosts_resolve (gvm_hosts_t *);
 
@@ -145,6 +166,21 @@ gvm_hosts_count (const gvm_hosts_t *);
 unsigned int
 gvm_hosts_removed (const gvm_hosts_t *);
 
+void
+gvm_hosts_set_dns_parallel (unsigned int);
+
+gvm_hosts_stream_t *
+gvm_hosts_stream_new (const gchar *, const gchar *);
+
+gvm_hosts_stream_t *
+gvm_hosts_stream_new_shuffled (const gchar *, const gchar *, guint32);
+
+gvm_host_t *
+gvm_hosts_stream_next (gvm_hosts_stream_t *);
+
+void
+gvm_hosts_stream_free (gvm_hosts_stream_t *);
+
 /* gvm_host_t related */
 
 int
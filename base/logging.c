@@ -31,15 +31,33 @@
 
 #include <errno.h>  /* for errno */
 #include <libgen.h> /* for dirname */
+#include <pthread.h> /* for pthread_atfork */
 #include <stdio.h>  /* for fflush, fprintf, stderr */
 #include <stdlib.h> /* for atoi */
 #include <string.h> /* for strcasecmp, strlen, strerror */
 #define SYSLOG_NAMES
 #include <syslog.h> /* for LOG_INFO, facilitynames, closelog, openlog */
 #undef SYSLOG_NAMES
-#include <time.h>   /* for localtime, time, time_t */
+#include <time.h>   /* for localtime_r, strftime, time_t */
 #include <unistd.h> /* for getpid */
 
+/**
+ * @brief Default number of messages each thread can queue in the
+ *        asynchronous mode.
+ */
+#define LOG_ASYNC_DEFAULT_SLOTS 1024
+
+/**
+ * @brief Longest time the idle writer thread waits before checking the
+ *        queues, in milliseconds.
+ */
+#define LOG_ASYNC_INTERVAL 100
+
+/**
+ * @brief Time a thread waits for room in its full queue, in microseconds.
+ */
+#define LOG_ASYNC_BLOCK_SLEEP 100
+
 /**
  * @struct gvm_logging_t
  * @brief Logging stores the parameters loaded from a log configuration
@@ -57,14 +75,189 @@ typedef struct
   gchar *syslog_ident;           ///< Syslog ident to use for syslog logging.
   gchar *prepend_separator; ///< If prependstring has %s, used this symbol as
                             ///< separator.
+  struct log_routes *routes; ///< Compiled routes of the list, in the first
+                             ///< entry of the list only.
 } gvm_logging_t;
 
+/**
+ * @brief Settings used for the messages of a log domain.
+ *
+ * Settings missing in the group of the domain are taken from the group "*",
+ * then from the defaults.
+ */
+typedef struct
+{
+  gvm_logging_t *entry;        ///< Entry that holds the channel, or NULL.
+  gchar *prepend_tokens;       ///< Directives of the prepend format, as the
+                               ///< letters after the %.
+  const gchar *time_format;    ///< Format of the %t directive.
+  const gchar *log_file;       ///< Where to log to.
+  const gchar *separator;      ///< Separator.
+  const gchar *syslog_facility; ///< Syslog facility.
+  const gchar *syslog_ident;    ///< Syslog ident.
+  GLogLevelFlags level_mask;    ///< Levels that are logged.
+} log_route_t;
+
+/**
+ * @brief Routes compiled from a log configuration.
+ */
+typedef struct log_routes
+{
+  GHashTable *domains;   ///< Route per log domain, case insensitive.
+  log_route_t *wildcard; ///< Route of the other log domains.
+} log_routes_t;
+
+/**
+ * @brief Route used without configuration and for messages without domain.
+ */
+static log_route_t log_default_route = {
+  NULL,
+  "tsp",
+  "%Y-%m-%d %Hh%M.%S %Z",
+  "-",
+  ":",
+  "local0",
+  NULL,
+  G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING
+    | G_LOG_LEVEL_MESSAGE | G_LOG_LEVEL_INFO | G_LOG_LEVEL_DEBUG};
+
+/**
+ * @brief Log configuration given to setup_log_handlers.
+ */
+static GSList *log_handlers_config = NULL;
+
+/**
+ * @brief Longest formatted time, in bytes.
+ */
+#define LOG_TIME_MAX 80
+
+/**
+ * @brief Time formatted for the current second, cached per thread.
+ */
+typedef struct
+{
+  gint64 second;            ///< Wall clock second of the text.
+  gchar *format;            ///< Format of the text.
+  gchar text[LOG_TIME_MAX]; ///< Formatted time, without the microseconds.
+  gsize split;              ///< Where the microseconds go in text, if any.
+  gsize length;             ///< Length of text.
+  gboolean usec;            ///< Whether the format has %f.
+} log_time_cache_t;
+
+/**
+ * @brief Free the time cache of an exiting thread.
+ *
+ * @param[in]  data  Time cache.
+ */
+static void
+log_time_cache_free (gpointer data)
+{
+  log_time_cache_t *cache = data;
+
+  g_free (cache->format);
+  g_free (cache);
+}
+
+/**
+ * @brief Time cache of the calling thread.
+ */
+static GPrivate log_time_key = G_PRIVATE_INIT (log_time_cache_free);
+
+/**
+ * @brief Format a time into a time cache.
+ *
+ * @param[in]  cache   Time cache.
+ * @param[in]  format  Format.
+ * @param[in]  second  Wall clock second.
+ */
+static void
+log_time_format (log_time_cache_t *cache, const gchar *format, gint64 second)
+{
+  time_t now = second;
+  struct tm ts;
+  const gchar *usec;
+  gchar *prefix;
+
+  if (cache->format == NULL || strcmp (cache->format, format))
+    {
+      g_free (cache->format);
+      cache->format = g_strdup (format);
+    }
+  cache->second = second;
+  localtime_r (&now, &ts);
+
+  /* Split the format at the first %f, which strftime does not know. */
+  for (usec = format; *usec; usec++)
+    if (usec[0] == '%')
+      {
+        if (usec[1] == 'f')
+          break;
+        if (usec[1])
+          usec++;
+      }
+
+  cache->usec = *usec != '\0';
+  if (!cache->usec)
+    {
+      cache->length = strftime (cache->text, sizeof (cache->text), format, &ts);
+      cache->split = cache->length;
+      return;
+    }
+
+  prefix = g_strndup (format, usec - format);
+  cache->split = strftime (cache->text, sizeof (cache->text), prefix, &ts);
+  g_free (prefix);
+  cache->length =
+    cache->split
+    + strftime (cache->text + cache->split, sizeof (cache->text) - cache->split,
+                usec + 2, &ts);
+}
+
+/**
+ * @brief Append the current time to a string.
+ *
+ * The time is formatted once per second and thread, the microseconds
+ * of %f are inserted each time.
+ *
+ * @param[in]  string  String.
+ * @param[in]  format  strftime format, with %f for the microseconds.
+ */
+static void
+log_time_append (GString *string, const gchar *format)
+{
+  log_time_cache_t *cache;
+  gint64 now;
+
+  cache = g_private_get (&log_time_key);
+  if (cache == NULL)
+    {
+      cache = g_malloc0 (sizeof (*cache));
+      g_private_set (&log_time_key, cache);
+    }
+
+  now = g_get_real_time ();
+  if (cache->format == NULL || now / G_USEC_PER_SEC != cache->second
+      || strcmp (cache->format, format))
+    log_time_format (cache, format, now / G_USEC_PER_SEC);
+
+  if (!cache->usec)
+    {
+      g_string_append_len (string, cache->text, cache->length);
+      return;
+    }
+  g_string_append_len (string, cache->text, cache->split);
+  g_string_append_printf (string, "%06d", (int) (now % G_USEC_PER_SEC));
+  g_string_append_len (string, cache->text + cache->split,
+                       cache->length - cache->split);
+}
+
 /**
  * @brief Returns time as specified in time_fmt strftime format.
  *
  * @param time_fmt ptr to the string format to use. The strftime
  *        man page documents the conversion specification. An
- *        example time_fmt string is "%Y-%m-%d %H:%M:%S".
+ *        example time_fmt string is "%Y-%m-%d %H:%M:%S".  In addition
+ *        the first %f is replaced by the microseconds.
  *
  * @return NULL in case the format string is NULL. A ptr to a
  *         string that contains the formatted date time value.
@@ -73,18 +266,14 @@ typedef struct
 gchar *
 get_time (gchar *time_fmt)
 {
-  time_t now;
-  struct tm *ts;
-  gchar buf[80];
-
-  /* Get the current time. */
-  now = time (NULL);
+  GString *string;
 
-  /* Format and print the time, "ddd yyyy-mm-dd hh:mm:ss zzz." */
-  ts = localtime (&now);
-  strftime (buf, sizeof (buf), time_fmt, ts);
+  if (time_fmt == NULL)
+    return NULL;
 
-  return g_strdup_printf ("%s", buf);
+  string = g_string_sized_new (LOG_TIME_MAX);
+  log_time_append (string, time_fmt);
+  return g_string_free (string, FALSE);
 }
 
 /**
@@ -141,6 +330,205 @@ facility_int_from_string (const gchar *facility)
   return LOG_LOCAL0;
 }
 
+/**
+ * @brief Case insensitive hash of a log domain.
+ *
+ * @param[in]  key  Log domain.
+ *
+ * @return Hash.
+ */
+static guint
+log_domain_hash (gconstpointer key)
+{
+  const gchar *domain = key;
+  guint hash = 5381;
+
+  while (*domain)
+    hash = (hash << 5) + hash + g_ascii_tolower (*domain++);
+  return hash;
+}
+
+/**
+ * @brief Case insensitive comparison of log domains.
+ *
+ * @param[in]  a  Log domain.
+ * @param[in]  b  Log domain.
+ *
+ * @return TRUE if equal, FALSE otherwise.
+ */
+static gboolean
+log_domain_equal (gconstpointer a, gconstpointer b)
+{
+  return g_ascii_strcasecmp (a, b) == 0;
+}
+
+/**
+ * @brief Get the levels that a level setting logs.
+ *
+ * @param[in]  level  Most verbose level that is logged.
+ *
+ * @return Mask of the levels.
+ */
+static GLogLevelFlags
+log_level_mask (gint level)
+{
+  GLogLevelFlags mask = 0;
+  guint flag;
+
+  for (flag = G_LOG_LEVEL_ERROR; flag <= (guint) G_MAXINT; flag <<= 1)
+    if ((gint) flag <= level)
+      mask |= flag;
+  return mask;
+}
+
+/**
+ * @brief Compile the route of a group of a log configuration.
+ *
+ * @param[in]  entry     Group of the domain, or NULL for the other domains.
+ * @param[in]  wildcard  Group "*", or NULL.
+ *
+ * @return Route.
+ */
+static log_route_t *
+log_route_new (gvm_logging_t *entry, const gvm_logging_t *wildcard)
+{
+  log_route_t *route;
+  const gchar *format, *directive;
+  GString *tokens;
+
+  route = g_malloc (sizeof (*route));
+  *route = log_default_route;
+  route->entry = entry ? entry : (gvm_logging_t *) wildcard;
+
+  format = "%t %s %p - ";
+  if (entry && entry->prepend_string)
+    format = entry->prepend_string;
+  else if (wildcard && wildcard->prepend_string)
+    format = wildcard->prepend_string;
+
+#define ROUTE_SETTING(field, member)              \
+  if (entry && entry->member)                     \
+    route->field = entry->member;                 \
+  else if (wildcard && wildcard->member)          \
+    route->field = wildcard->member;
+
+  ROUTE_SETTING (time_format, prepend_time_format);
+  ROUTE_SETTING (log_file, log_file);
+  ROUTE_SETTING (separator, prepend_separator);
+  ROUTE_SETTING (syslog_facility, syslog_facility);
+  ROUTE_SETTING (syslog_ident, syslog_ident);
+  if (entry && entry->default_level)
+    route->level_mask = log_level_mask (*entry->default_level);
+  else if (wildcard && wildcard->default_level)
+    route->level_mask = log_level_mask (*wildcard->default_level);
+#undef ROUTE_SETTING
+
+  /* Only the %p, %t, %m (monotonic clock) and %s directives are output,
+   * other characters of the format are skipped. */
+  tokens = g_string_new ("");
+  for (directive = format; *directive; directive++)
+    if (directive[0] == '%'
+        && (directive[1] == 'p' || directive[1] == 't' || directive[1] == 'm'
+            || directive[1] == 's'))
+      {
+        g_string_append_c (tokens, directive[1]);
+        directive++;
+      }
+  route->prepend_tokens = g_string_free (tokens, FALSE);
+  return route;
+}
+
+/**
+ * @brief Free a route.
+ *
+ * @param[in]  route  Route.
+ */
+static void
+log_route_free (gpointer route)
+{
+  g_free (((log_route_t *) route)->prepend_tokens);
+  g_free (route);
+}
+
+/**
+ * @brief Compile the routes of a log configuration.
+ *
+ * @param[in]  log_domain_list  Log configuration.
+ *
+ * @return Routes.
+ */
+static log_routes_t *
+log_routes_new (GSList *log_domain_list)
+{
+  log_routes_t *routes;
+  gvm_logging_t *wildcard = NULL;
+  GSList *list;
+
+  for (list = log_domain_list; list; list = g_slist_next (list))
+    {
+      gvm_logging_t *entry = list->data;
+
+      if (g_ascii_strcasecmp (entry->log_domain, "*") == 0)
+        {
+          wildcard = entry;
+          break;
+        }
+    }
+
+  routes = g_malloc (sizeof (*routes));
+  routes->domains = g_hash_table_new_full (log_domain_hash, log_domain_equal,
+                                           NULL, log_route_free);
+  routes->wildcard = log_route_new (NULL, wildcard);
+  for (list = log_domain_list; list; list = g_slist_next (list))
+    {
+      gvm_logging_t *entry = list->data;
+
+      /* The first of groups that differ only in case is used. */
+      if (entry != wildcard
+          && !g_hash_table_contains (routes->domains, entry->log_domain))
+        g_hash_table_insert (routes->domains, entry->log_domain,
+                             log_route_new (entry, wildcard));
+    }
+  return routes;
+}
+
+/**
+ * @brief Free compiled routes.
+ *
+ * @param[in]  routes  Routes.
+ */
+static void
+log_routes_free (log_routes_t *routes)
+{
+  g_hash_table_destroy (routes->domains);
+  log_route_free (routes->wildcard);
+  g_free (routes);
+}
+
+/**
+ * @brief Get the route of the messages of a log domain.
+ *
+ * @param[in]  log_domain_list  Log configuration.
+ * @param[in]  log_domain       Log domain.
+ *
+ * @return Route.
+ */
+static const log_route_t *
+log_route_lookup (GSList *log_domain_list, const char *log_domain)
+{
+  log_routes_t *routes;
+  log_route_t *route;
+
+  if (log_domain_list == NULL || log_domain == NULL)
+    return &log_default_route;
+
+  routes = ((gvm_logging_t *) log_domain_list->data)->routes;
+  if (routes == NULL)
+    return &log_default_route;
+  route = g_hash_table_lookup (routes->domains, log_domain);
+  return route ? route : routes->wildcard;
+}
+
 /**
  * @brief Loads parameters from a config file into a linked list.
  *
@@ -202,6 +590,7 @@ load_log_configuration (gchar *config_file)
       log_domain_entry->syslog_facility = NULL;
       log_domain_entry->syslog_ident = NULL;
       log_domain_entry->prepend_separator = NULL;
+      log_domain_entry->routes = NULL;
 
       /* Look for the prepend string. */
       if (g_key_file_has_key (key_file, *group, "prepend", &error))
@@ -271,6 +660,11 @@ load_log_configuration (gchar *config_file)
   /* Free the key file. */
   g_key_file_free (key_file);
 
+  /* Compile the routes, so that messages need a single lookup. */
+  if (log_domain_list)
+    ((gvm_logging_t *) log_domain_list->data)->routes =
+      log_routes_new (log_domain_list);
+
   return log_domain_list;
 }
 
@@ -305,6 +699,8 @@ free_log_configuration (GSList *log_domain_list)
       g_free (log_domain_entry->default_level);
       g_free (log_domain_entry->syslog_ident);
       g_free (log_domain_entry->prepend_separator);
+      if (log_domain_entry->routes)
+        log_routes_free (log_domain_entry->routes);
 
       /* Drop the reference to the GIOChannel. */
       if (log_domain_entry->log_channel)
@@ -318,6 +714,8 @@ free_log_configuration (GSList *log_domain_list)
     }
   /* Free the link list. */
   g_slist_free (log_domain_list);
+  if (log_handlers_config == log_domain_list)
+    log_handlers_config = NULL;
 }
 
 /**
@@ -373,297 +771,652 @@ gvm_log_unlock (void)
 }
 
 /**
- * @brief Creates the formatted string and outputs it to the log destination.
+ * @brief Slot of an asynchronous logging ring buffer.
+ */
+typedef struct
+{
+  gchar *message;      ///< Formatted log line, owned by the slot.
+  GIOChannel *channel; ///< Channel to write to, NULL for stderr.
+} log_async_slot_t;
+
+/**
+ * @brief Per-thread ring buffer of the asynchronous logging mode.
  *
- * @param log_domain A string containing the message's log domain.
- * @param log_level  Flags defining the message's log level.
- * @param message    A string containing the log message.
- * @param gvm_log_config_list A pointer to the configuration linked list.
+ * The owning thread is the only producer and advances head, the writer
+ * thread is the only consumer and advances tail, so neither side needs a
+ * lock to access the slots.
  */
-void
-gvm_log_func (const char *log_domain, GLogLevelFlags log_level,
-              const char *message, gpointer gvm_log_config_list)
+typedef struct
 {
-  gchar *prepend;
-  gchar *prepend_buf;
-  gchar *prepend_tmp;
-  gchar *prepend_tmp1;
-  gchar *tmp;
-  gchar *tmpstr;
-  int messagelen;
+  log_async_slot_t *slots; ///< Slots, a power of two of them.
+  guint mask;              ///< Number of slots minus one.
+  volatile gint head;      ///< Next slot to fill, written by the producer.
+  volatile gint tail;      ///< Next slot to write, written by the consumer.
+  gboolean closed;         ///< Whether the owning thread exited.
+} log_async_ring_t;
 
-  /* For link list operations. */
-  GSList *log_domain_list_tmp;
-  gvm_logging_t *log_domain_entry = NULL;
+/**
+ * @brief Whether the asynchronous logging mode is running.
+ */
+static volatile gint log_async_running = 0;
 
-  /* Channel to log through. */
-  GIOChannel *channel;
-  GError *error = NULL;
+/**
+ * @brief Whether the writer thread is waiting for messages.
+ */
+static volatile gint log_async_idle = 0;
 
-  /* The default parameters to be used. The group '*' will override
-   * these defaults if it's found.
-   */
-  gchar *prepend_format = "%t %s %p - ";
-  gchar *time_format = "%Y-%m-%d %Hh%M.%S %Z";
-  gchar *log_separator = ":";
-  gchar *log_file = "-";
-  GLogLevelFlags default_level = G_LOG_LEVEL_DEBUG;
-  channel = NULL;
-  gchar *syslog_facility = "local0";
-  gchar *syslog_ident = NULL;
+/**
+ * @brief Number of messages dropped because a ring buffer was full.
+ */
+static volatile gint log_async_drops = 0;
 
-  /* Initialize logger lock if not done. */
-  gvm_log_lock_init ();
+static gvm_log_async_policy_t log_async_policy = GVM_LOG_ASYNC_DROP;
+static guint log_async_slots = 0;
+static GThread *log_async_thread = NULL;
 
-  /* Let's load the default configuration file directives from the
-   * linked list. Scanning the link list twice is inefficient but
-   * leaves the source cleaner.
-   */
-  if (gvm_log_config_list != NULL && log_domain != NULL)
+/**
+ * @brief List of log_async_ring_t of all threads, and the lock that also
+ *        serializes draining them.
+ */
+static GSList *log_async_rings = NULL;
+static GMutex log_async_rings_lock;
+
+/**
+ * @brief Lock and condition the writer thread sleeps on when idle.
+ */
+static GMutex log_async_wait_lock;
+static GCond log_async_wait_cond;
+
+static void
+log_async_ring_release (gpointer);
+
+/**
+ * @brief Ring buffer of the calling thread.
+ */
+static GPrivate log_async_ring_key = G_PRIVATE_INIT (log_async_ring_release);
+
+/**
+ * @brief Free a ring buffer.
+ *
+ * Drops the messages still in the buffer.
+ *
+ * @param[in]  ring  Ring buffer.
+ */
+static void
+log_async_ring_free (log_async_ring_t *ring)
+{
+  while (ring->tail != ring->head)
     {
-      /* Go to the head of the list. */
-      log_domain_list_tmp = (GSList *) gvm_log_config_list;
+      log_async_slot_t *slot = &ring->slots[ring->tail & ring->mask];
 
-      while (log_domain_list_tmp != NULL)
-        {
-          gvm_logging_t *entry;
+      g_free (slot->message);
+      if (slot->channel)
+        g_io_channel_unref (slot->channel);
+      ring->tail++;
+    }
+  g_free (ring->slots);
+  g_free (ring);
+}
 
-          entry = log_domain_list_tmp->data;
+/**
+ * @brief Release the ring buffer of an exiting thread.
+ *
+ * When the asynchronous mode is running the ring is only marked closed, so
+ * that the writer thread still writes its messages before freeing it.
+ *
+ * @param[in]  data  Ring buffer.
+ */
+static void
+log_async_ring_release (gpointer data)
+{
+  log_async_ring_t *ring = data;
 
-          /* Override defaults if the current linklist group name is '*'. */
-          if (g_ascii_strcasecmp (entry->log_domain, "*") == 0)
-            {
-              /* Get the list data for later use. */
-              log_domain_entry = entry;
-
-              /* Override defaults if the group items are not null. */
-              if (log_domain_entry->prepend_string)
-                prepend_format = log_domain_entry->prepend_string;
-              if (log_domain_entry->prepend_time_format)
-                time_format = log_domain_entry->prepend_time_format;
-              if (log_domain_entry->log_file)
-                log_file = log_domain_entry->log_file;
-              if (log_domain_entry->default_level)
-                default_level = *log_domain_entry->default_level;
-              if (log_domain_entry->log_channel)
-                channel = log_domain_entry->log_channel;
-              if (log_domain_entry->syslog_facility)
-                syslog_facility = log_domain_entry->syslog_facility;
-              if (log_domain_entry->prepend_separator)
-                log_separator = log_domain_entry->prepend_separator;
-              break;
-            }
+  g_mutex_lock (&log_async_rings_lock);
+  if (g_atomic_int_get (&log_async_running))
+    ring->closed = TRUE;
+  else
+    {
+      log_async_rings = g_slist_remove (log_async_rings, ring);
+      log_async_ring_free (ring);
+    }
+  g_mutex_unlock (&log_async_rings_lock);
+}
 
-          /* Go to the next item. */
-          log_domain_list_tmp = g_slist_next (log_domain_list_tmp);
-        }
+/**
+ * @brief Get the ring buffer of the calling thread, creating it if needed.
+ *
+ * @return Ring buffer.
+ */
+static log_async_ring_t *
+log_async_ring (void)
+{
+  log_async_ring_t *ring;
+
+  ring = g_private_get (&log_async_ring_key);
+  if (ring)
+    return ring;
+
+  ring = g_malloc0 (sizeof (*ring));
+  g_mutex_lock (&log_async_rings_lock);
+  ring->slots = g_malloc0 (log_async_slots * sizeof (*ring->slots));
+  ring->mask = log_async_slots - 1;
+  log_async_rings = g_slist_prepend (log_async_rings, ring);
+  g_mutex_unlock (&log_async_rings_lock);
+  g_private_set (&log_async_ring_key, ring);
+  return ring;
+}
+
+/**
+ * @brief Write a batch of log lines to a destination.
+ *
+ * @param[in]  channel  Channel to write to, NULL for stderr.
+ * @param[in]  batch    Log lines.
+ */
+static void
+log_async_write (GIOChannel *channel, GString *batch)
+{
+  if (batch->len == 0)
+    return;
+
+  gvm_log_lock ();
+  if (channel == NULL)
+    {
+      fwrite (batch->str, 1, batch->len, stderr);
+      fflush (stderr);
+    }
+  else
+    {
+      g_io_channel_write_chars (channel, batch->str, batch->len, NULL, NULL);
+      g_io_channel_flush (channel, NULL);
     }
+  gvm_log_unlock ();
+  g_string_truncate (batch, 0);
+}
 
-  /* Let's load the configuration file directives if a linked list item for
-   * the log domain group exists.
-   */
-  if (gvm_log_config_list != NULL && log_domain != NULL)
+/**
+ * @brief Write out the messages queued in all ring buffers.
+ *
+ * Consecutive messages to the same destination are written with a single
+ * write and flush.  Messages keep their order per thread, but not across
+ * threads.
+ *
+ * @return Number of messages written.
+ */
+static guint
+log_async_drain (void)
+{
+  GSList *list, *next;
+  GString *batch;
+  GIOChannel *channel = NULL;
+  guint count = 0;
+
+  batch = g_string_sized_new (4096);
+  g_mutex_lock (&log_async_rings_lock);
+  for (list = log_async_rings; list; list = next)
     {
-      /* Go to the head of the list. */
-      log_domain_list_tmp = (GSList *) gvm_log_config_list;
+      log_async_ring_t *ring = list->data;
+      guint tail, head;
 
-      while (log_domain_list_tmp != NULL)
+      next = g_slist_next (list);
+      tail = ring->tail;
+      head = g_atomic_int_get (&ring->head);
+      for (; tail != head; tail++)
         {
-          gvm_logging_t *entry;
-
-          entry = log_domain_list_tmp->data;
+          log_async_slot_t *slot = &ring->slots[tail & ring->mask];
 
-          /* Search for the log domain in the link list. */
-          if (g_ascii_strcasecmp (entry->log_domain, log_domain) == 0)
+          if (slot->channel != channel)
             {
-              /* Get the list data which is an gvm_logging_t struct. */
-              log_domain_entry = entry;
-
-              /* Get the struct contents. */
-              prepend_format = log_domain_entry->prepend_string;
-              time_format = log_domain_entry->prepend_time_format;
-              log_file = log_domain_entry->log_file;
-              if (log_domain_entry->default_level)
-                default_level = *log_domain_entry->default_level;
-              channel = log_domain_entry->log_channel;
-              syslog_facility = log_domain_entry->syslog_facility;
-              syslog_ident = log_domain_entry->syslog_ident;
-              if (log_domain_entry->prepend_separator)
-                log_separator = log_domain_entry->prepend_separator;
-              break;
+              log_async_write (channel, batch);
+              if (channel)
+                g_io_channel_unref (channel);
+              channel = slot->channel;
             }
+          else if (slot->channel)
+            g_io_channel_unref (slot->channel);
+          g_string_append (batch, slot->message);
+          g_free (slot->message);
+          count++;
+        }
+      g_atomic_int_set (&ring->tail, tail);
 
-          /* Go to the next item. */
-          log_domain_list_tmp = g_slist_next (log_domain_list_tmp);
+      if (ring->closed)
+        {
+          log_async_rings = g_slist_delete_link (log_async_rings, list);
+          log_async_ring_free (ring);
         }
     }
+  log_async_write (channel, batch);
+  if (channel)
+    g_io_channel_unref (channel);
+  g_mutex_unlock (&log_async_rings_lock);
+  g_string_free (batch, TRUE);
+  return count;
+}
 
-  /* If the current log entry is less severe than the specified log level,
-   * let's exit.
-   */
-  if (default_level < log_level)
-    return;
+/**
+ * @brief Wake up the writer thread if it is waiting for messages.
+ */
+static void
+log_async_wake (void)
+{
+  if (g_atomic_int_get (&log_async_idle))
+    {
+      g_mutex_lock (&log_async_wait_lock);
+      g_cond_signal (&log_async_wait_cond);
+      g_mutex_unlock (&log_async_wait_lock);
+    }
+}
+
+/**
+ * @brief Writer thread of the asynchronous logging mode.
+ *
+ * @param[in]  data  Unused.
+ *
+ * @return NULL.
+ */
+static gpointer
+log_async_writer (gpointer data)
+{
+  (void) data;
+
+  while (g_atomic_int_get (&log_async_running))
+    {
+      if (log_async_drain ())
+        continue;
+
+      g_mutex_lock (&log_async_wait_lock);
+      g_atomic_int_set (&log_async_idle, 1);
+      /* Producers only signal when they see the idle flag, so wake up
+       * regularly in case a message was queued just before it was set. */
+      g_cond_wait_until (&log_async_wait_cond, &log_async_wait_lock,
+                         g_get_monotonic_time ()
+                           + LOG_ASYNC_INTERVAL * G_TIME_SPAN_MILLISECOND);
+      g_atomic_int_set (&log_async_idle, 0);
+      g_mutex_unlock (&log_async_wait_lock);
+    }
+  return NULL;
+}
+
+/**
+ * @brief Turn off the asynchronous mode in a forked child.
+ *
+ * The writer thread does not exist in the child, so the child logs
+ * synchronously.  The lines queued by the parent are the parent's to write,
+ * so the inherited ring buffers are dropped.  They are not freed, because
+ * the writer thread may have been draining them, and the locks may have been
+ * held, at the time of the fork.
+ */
+static void
+log_async_atfork_child (void)
+{
+  log_async_running = 0;
+  log_async_idle = 0;
+  log_async_thread = NULL;
+  log_async_rings = NULL;
+  g_private_set (&log_async_ring_key, NULL);
+  g_mutex_init (&log_async_rings_lock);
+  g_mutex_init (&log_async_wait_lock);
+  g_cond_init (&log_async_wait_cond);
+}
 
-  /* Prepend buf is a newly allocated empty string. Makes life easier. */
-  prepend_buf = g_strdup ("");
+/**
+ * @brief Queue a log line for the writer thread.
+ *
+ * @param[in]  message  Formatted log line.  Ownership is taken when the
+ *                      line is queued or dropped.
+ * @param[in]  channel  Channel to write to, NULL for stderr.
+ *
+ * @return 0 if queued or dropped, -1 if the asynchronous mode is not
+ *         running, in which case the caller must write the line.
+ */
+static int
+log_async_push (gchar *message, GIOChannel *channel)
+{
+  log_async_ring_t *ring;
+  log_async_slot_t *slot;
+  guint head;
 
-  /* Make the tmp pointer (for iteration) point to the format string. */
-  tmp = prepend_format;
+  if (!g_atomic_int_get (&log_async_running))
+    return -1;
 
-  while (*tmp != '\0')
+  ring = log_async_ring ();
+  head = ring->head;
+  while (head - (guint) g_atomic_int_get (&ring->tail) > ring->mask)
     {
-      /* If the current char is a % and the next one is a p, get the pid. */
-      if ((*tmp == '%') && (*(tmp + 1) == 'p'))
-        {
-          /* Use g_strdup, a new string returned. Store it in a tmp var until
-           * we free the old one. */
-          prepend_tmp = g_strdup_printf ("%s%d", prepend_buf, (int) getpid ());
-          /* Free the old string. */
-          g_free (prepend_buf);
-          /* Point the buf ptr to the new string. */
-          prepend_buf = prepend_tmp;
-          /* Skip over the two chars we've processed '%p'. */
-          tmp += 2;
-        }
-      else if ((*tmp == '%') && (*(tmp + 1) == 't'))
-        {
-          /* Get time returns a newly allocated string.
-           * Store it in a tmp var.
-           */
-          prepend_tmp1 = get_time (time_format);
-          /* Use g_strdup. New string returned. Store it in a tmp var until
-           * we free the old one.
-           */
-          prepend_tmp = g_strdup_printf ("%s%s", prepend_buf, prepend_tmp1);
-          /* Free the time tmp var. */
-          g_free (prepend_tmp1);
-          /* Free the old string. */
-          g_free (prepend_buf);
-          /* Point the buf ptr to the new string. */
-          prepend_buf = prepend_tmp;
-          /* Skip over the two chars we've processed '%t.' */
-          tmp += 2;
-        }
-      else if ((*tmp == '%') && (*(tmp + 1) == 's'))
+      if (log_async_policy == GVM_LOG_ASYNC_DROP)
         {
-          /* Use g_strdup. New string returned. Store it in a tmp var until
-           * we free the old one.
-           */
-          prepend_tmp = g_strdup_printf ("%s%s", prepend_buf, log_separator);
-          /* Free the old string. */
-          g_free (prepend_buf);
-          /* Point the buf ptr to the new string. */
-          prepend_buf = prepend_tmp;
-          /* Skip over the two chars we've processed '%s.' */
-          tmp += 2;
-        }
-      else
-        {
-          /* Jump to the next character. */
-          tmp++;
+          g_atomic_int_inc (&log_async_drops);
+          g_free (message);
+          log_async_wake ();
+          return 0;
         }
+      log_async_wake ();
+      g_usleep (LOG_ASYNC_BLOCK_SLEEP);
+      if (!g_atomic_int_get (&log_async_running))
+        return -1;
     }
 
-  /* Step through all possible messages prefixing them with an appropriate
-   * tag.
-   */
+  slot = &ring->slots[head & ring->mask];
+  slot->message = message;
+  slot->channel = channel ? g_io_channel_ref (channel) : NULL;
+  g_atomic_int_set (&ring->head, head + 1);
+
+  /* The mode may have been stopped after the check above, in which case the
+   * final drain of gvm_log_async_stop could have missed this message. */
+  if (!g_atomic_int_get (&log_async_running))
+    log_async_drain ();
+  else
+    log_async_wake ();
+  return 0;
+}
+
+/**
+ * @brief Start logging asynchronously.
+ *
+ * Log lines for stderr and log files are then queued in a lock-free ring
+ * buffer of the calling thread, and written in batches by a writer thread.
+ * Syslog messages, and errors and fatal messages that abort the process,
+ * are still written synchronously, after the queued messages.
+ *
+ * Forked children log synchronously.  Call gvm_log_async_stop before the
+ * process exits, to write out the queued messages.
+ *
+ * @param[in]  slots   Number of messages each thread can queue, rounded up
+ *                     to a power of two.  0 for a default.  Only applies to
+ *                     threads that did not log asynchronously before.
+ * @param[in]  policy  What to do when the queue of a thread is full.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+gvm_log_async_start (size_t slots, gvm_log_async_policy_t policy)
+{
+  static gboolean atfork = FALSE;
+
+  if (g_atomic_int_get (&log_async_running))
+    return 0;
+
+  gvm_log_lock_init ();
+  if (!atfork)
+    {
+      if (pthread_atfork (NULL, NULL, log_async_atfork_child))
+        return -1;
+      atfork = TRUE;
+    }
+
+  if (slots == 0)
+    slots = LOG_ASYNC_DEFAULT_SLOTS;
+  g_mutex_lock (&log_async_rings_lock);
+  log_async_slots = 1;
+  while (log_async_slots < slots && log_async_slots < (1U << 30))
+    log_async_slots <<= 1;
+  g_mutex_unlock (&log_async_rings_lock);
+  log_async_policy = policy;
+
+  g_atomic_int_set (&log_async_running, 1);
+  log_async_thread = g_thread_try_new ("gvm-log", log_async_writer, NULL,
+                                       NULL);
+  if (log_async_thread == NULL)
+    {
+      g_atomic_int_set (&log_async_running, 0);
+      return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Write out the messages queued by the asynchronous mode.
+ */
+void
+gvm_log_async_flush (void)
+{
+  log_async_drain ();
+}
+
+/**
+ * @brief Stop logging asynchronously.
+ *
+ * Stops the writer thread and writes out the queued messages.
+ */
+void
+gvm_log_async_stop (void)
+{
+  if (!g_atomic_int_get (&log_async_running))
+    return;
+
+  g_atomic_int_set (&log_async_running, 0);
+  g_mutex_lock (&log_async_wait_lock);
+  g_cond_signal (&log_async_wait_cond);
+  g_mutex_unlock (&log_async_wait_lock);
+  g_thread_join (log_async_thread);
+  log_async_thread = NULL;
+  log_async_drain ();
+}
+
+/**
+ * @brief Get the number of messages dropped by the asynchronous mode.
+ *
+ * @return Number of messages dropped because a queue was full.
+ */
+unsigned int
+gvm_log_async_dropped (void)
+{
+  return g_atomic_int_get (&log_async_drops);
+}
+
+/**
+ * @brief Get the tag of a log level.
+ *
+ * @param[in]  log_level  Log level.
+ *
+ * @return Tag, padded to the same width for the usual levels.
+ */
+static const gchar *
+log_level_tag (GLogLevelFlags log_level)
+{
   switch (log_level)
     {
     case G_LOG_FLAG_RECURSION:
-      prepend = g_strdup_printf ("RECURSION%s%s", log_separator, prepend_buf);
-      break;
-
+      return "RECURSION";
     case G_LOG_FLAG_FATAL:
-      prepend = g_strdup_printf ("FATAL%s%s", log_separator, prepend_buf);
-      break;
-
+      return "FATAL";
     case G_LOG_LEVEL_ERROR:
-      prepend = g_strdup_printf ("ERROR%s%s", log_separator, prepend_buf);
-      break;
-
+      return "ERROR";
     case G_LOG_LEVEL_CRITICAL:
-      prepend = g_strdup_printf ("CRITICAL%s%s", log_separator, prepend_buf);
-      break;
-
+      return "CRITICAL";
     case G_LOG_LEVEL_WARNING:
-      prepend = g_strdup_printf ("WARNING%s%s", log_separator, prepend_buf);
-      break;
-
+      return "WARNING";
     case G_LOG_LEVEL_MESSAGE:
-      prepend = g_strdup_printf ("MESSAGE%s%s", log_separator, prepend_buf);
-      break;
-
+      return "MESSAGE";
     case G_LOG_LEVEL_INFO:
-      prepend = g_strdup_printf ("   INFO%s%s", log_separator, prepend_buf);
-      break;
-
+      return "   INFO";
     case G_LOG_LEVEL_DEBUG:
-      prepend = g_strdup_printf ("  DEBUG%s%s", log_separator, prepend_buf);
-      break;
+      return "  DEBUG";
+    default:
+      return "UNKNOWN";
+    }
+}
 
+/**
+ * @brief Get the syslog priority of a log level.
+ *
+ * @param[in]  log_level  Log level.
+ *
+ * @return Syslog priority.
+ */
+static int
+log_level_syslog (GLogLevelFlags log_level)
+{
+  switch (log_level)
+    {
+    case G_LOG_FLAG_FATAL:
+      return LOG_ALERT;
+    case G_LOG_LEVEL_ERROR:
+      return LOG_ERR;
+    case G_LOG_LEVEL_CRITICAL:
+      return LOG_CRIT;
+    case G_LOG_LEVEL_WARNING:
+      return LOG_WARNING;
+    case G_LOG_LEVEL_MESSAGE:
+      return LOG_NOTICE;
+    case G_LOG_LEVEL_INFO:
+      return LOG_INFO;
+    case G_LOG_LEVEL_DEBUG:
+      return LOG_DEBUG;
     default:
-      prepend = g_strdup_printf ("UNKNOWN%s%s", log_separator, prepend_buf);
-      break;
+      return LOG_INFO;
     }
+}
+
+/**
+ * @brief Open the log file of a route.
+ *
+ * Creates the directory of the file if it does not exist.
+ *
+ * @param[in]  log_file  Log file.
+ *
+ * @return Channel, or NULL if the directory could not be created.
+ */
+static GIOChannel *
+log_open_file (const gchar *log_file)
+{
+  GIOChannel *channel;
+  GError *error = NULL;
+  gchar *log, *dir;
+
+  channel = g_io_channel_new_file (log_file, "a", &error);
+  if (channel)
+    return channel;
+
+  /* Check error. In case of the directory does not exist, it will
+   * be handle below. In other case a message is printed to the
+   * stderr since the channel is still not created/accessible.
+   */
+  if (error->code != G_FILE_ERROR_NOENT)
+    fprintf (stderr, "Can not open '%s' logfile: %s\n", log_file,
+             error->message);
+  g_error_free (error);
+
+  /* Ensure directory exists. */
+  log = g_strdup (log_file);
+  dir = dirname (log);
+  if (g_mkdir_with_parents (dir, 0755)) /* "rwxr-xr-x" */
+    {
+      g_warning ("Failed to create log file directory %s: %s", dir,
+                 strerror (errno));
+      g_free (log);
+      return NULL;
+    }
+  g_free (log);
+
+  /* Try again. */
+  error = NULL;
+  channel = g_io_channel_new_file (log_file, "a", &error);
+  if (!channel)
+    g_error ("Can not open '%s' logfile: %s", log_file, error->message);
+  return channel;
+}
+
+/**
+ * @brief Creates the formatted string and outputs it to the log destination.
+ *
+ * @param log_domain A string containing the message's log domain.
+ * @param log_level  Flags defining the message's log level.
+ * @param message    A string containing the log message.
+ * @param gvm_log_config_list A pointer to the configuration linked list.
+ */
+void
+gvm_log_func (const char *log_domain, GLogLevelFlags log_level,
+              const char *message, gpointer gvm_log_config_list)
+{
+  const log_route_t *route;
+  const gchar *token;
+  GString *line;
+  gchar *tmpstr;
+  int messagelen;
+
+  /* Channel to log through. */
+  GIOChannel *channel;
+
+  /* If the current log entry is less severe than the specified log level,
+   * let's exit.
+   */
+  route = log_route_lookup (gvm_log_config_list, log_domain);
+  if (log_level & G_LOG_LEVEL_MASK & ~route->level_mask)
+    return;
+
+  /* Initialize logger lock if not done. */
+  gvm_log_lock_init ();
 
-  /* If the current log entry is more severe than the specified log
-   * level, print out the message.  In case MESSAGE already ends in a
-   * LF and there is not only the LF, remove the LF to avoid empty
-   * lines in the log.
+  /* Build the line from the tokens of the prepend format.  In case MESSAGE
+   * already ends in a LF and there is not only the LF, remove the LF to
+   * avoid empty lines in the log.
    */
   messagelen = message ? strlen (message) : 0;
   if (messagelen > 1 && message[messagelen - 1] == '\n')
     messagelen--;
-  tmpstr = g_strdup_printf ("%s%s%s%s %.*s\n", log_domain ? log_domain : "",
-                            log_separator, prepend, log_separator, messagelen,
-                            message);
-  g_free (prepend);
+  line = g_string_sized_new (128 + messagelen);
+  g_string_append (line, log_domain ? log_domain : "");
+  g_string_append (line, route->separator);
+  g_string_append (line, log_level_tag (log_level));
+  g_string_append (line, route->separator);
+  for (token = route->prepend_tokens; *token; token++)
+    switch (*token)
+      {
+      case 'p':
+        g_string_append_printf (line, "%d", (int) getpid ());
+        break;
+      case 't':
+        log_time_append (line, route->time_format);
+        break;
+      case 'm':
+        {
+          gint64 now = g_get_monotonic_time ();
+
+          g_string_append_printf (line, "%" G_GINT64_FORMAT ".%06d",
+                                  now / G_USEC_PER_SEC,
+                                  (int) (now % G_USEC_PER_SEC));
+          break;
+        }
+      case 's':
+        g_string_append (line, route->separator);
+        break;
+      }
+  g_string_append (line, route->separator);
+  g_string_append_c (line, ' ');
+  if (messagelen)
+    g_string_append_len (line, message, messagelen);
+  g_string_append_c (line, '\n');
+  tmpstr = g_string_free (line, FALSE);
+
+  channel = route->entry ? route->entry->log_channel : NULL;
+
+  /* In the asynchronous mode queue lines for stderr and for log files that
+   * are already open.  Errors and fatal messages abort the process, so they
+   * are written right away, after the lines queued before them.
+   */
+  if (log_level & (G_LOG_FLAG_FATAL | G_LOG_LEVEL_ERROR))
+    {
+      if (g_atomic_int_get (&log_async_running))
+        gvm_log_async_flush ();
+    }
+  else if ((channel || g_ascii_strcasecmp (route->log_file, "-") == 0)
+           && log_async_push (tmpstr, channel) == 0)
+    return;
 
   gvm_log_lock ();
   /* Output everything to stderr if logfile is "-". */
-  if (g_ascii_strcasecmp (log_file, "-") == 0)
+  if (g_ascii_strcasecmp (route->log_file, "-") == 0)
     {
       fprintf (stderr, "%s", tmpstr);
       fflush (stderr);
     }
   /* Output everything to syslog if logfile is "syslog" */
-  else if (g_ascii_strcasecmp (log_file, "syslog") == 0)
+  else if (g_ascii_strcasecmp (route->log_file, "syslog") == 0)
     {
-      int facility = facility_int_from_string (syslog_facility);
-      int syslog_level = LOG_INFO;
-
-      openlog (syslog_ident, LOG_CONS | LOG_PID | LOG_NDELAY, facility);
-
-      switch (log_level)
-        {
-        case G_LOG_FLAG_FATAL:
-          syslog_level = LOG_ALERT;
-          break;
-        case G_LOG_LEVEL_ERROR:
-          syslog_level = LOG_ERR;
-          break;
-        case G_LOG_LEVEL_CRITICAL:
-          syslog_level = LOG_CRIT;
-          break;
-        case G_LOG_LEVEL_WARNING:
-          syslog_level = LOG_WARNING;
-          break;
-        case G_LOG_LEVEL_MESSAGE:
-          syslog_level = LOG_NOTICE;
-          break;
-        case G_LOG_LEVEL_INFO:
-          syslog_level = LOG_INFO;
-          break;
-        case G_LOG_LEVEL_DEBUG:
-          syslog_level = LOG_DEBUG;
-          break;
-        default:
-          syslog_level = LOG_INFO;
-          break;
-        }
-
-      syslog (syslog_level, "%s", message);
-
+      openlog (route->syslog_ident, LOG_CONS | LOG_PID | LOG_NDELAY,
+               facility_int_from_string (route->syslog_facility));
+      syslog (log_level_syslog (log_level), "%s", message);
       closelog ();
     }
   else
@@ -673,54 +1426,26 @@ gvm_log_func (const char *log_domain, GLogLevelFlags log_level,
        */
       if (channel == NULL)
         {
-          channel = g_io_channel_new_file (log_file, "a", &error);
-          if (!channel)
+          channel = log_open_file (route->log_file);
+          if (channel == NULL)
             {
-              gchar *log = g_strdup (log_file);
-              gchar *dir = dirname (log);
-
-              /* Check error. In case of the directory does not exist, it will
-               * be handle below. In other case a message is printed to the
-               * stderr since the channel is still not created/accessible.
-               */
-              if (error->code != G_FILE_ERROR_NOENT)
-                fprintf (stderr, "Can not open '%s' logfile: %s\n", log_file,
-                         error->message);
-              g_error_free (error);
-
-              /* Ensure directory exists. */
-              if (g_mkdir_with_parents (dir, 0755)) /* "rwxr-xr-x" */
-                {
-                  g_warning ("Failed to create log file directory %s: %s", dir,
-                             strerror (errno));
-                  g_free (log);
-                  g_free (tmpstr);
-                  g_free (prepend_buf);
-                  return;
-                }
-              g_free (log);
-
-              /* Try again. */
-              error = NULL;
-              channel = g_io_channel_new_file (log_file, "a", &error);
-              if (!channel)
-                {
-                  g_error ("Can not open '%s' logfile: %s", log_file,
-                           error->message);
-                }
+              gvm_log_unlock ();
+              g_free (tmpstr);
+              return;
             }
 
           /* Store it in the struct for later use. */
-          if (log_domain_entry != NULL)
-            log_domain_entry->log_channel = channel;
+          if (route->entry != NULL)
+            route->entry->log_channel = channel;
         }
       g_io_channel_write_chars (channel, (const gchar *) tmpstr, -1, NULL,
-                                &error);
+                                NULL);
       g_io_channel_flush (channel, NULL);
+      if (route->entry == NULL)
+        g_io_channel_unref (channel);
     }
   gvm_log_unlock ();
   g_free (tmpstr);
-  g_free (prepend_buf);
 }
 
 /**
@@ -751,6 +1476,8 @@ void
 setup_log_handlers (GSList *gvm_log_config_list)
 {
   GSList *log_domain_list_tmp;
+
+  log_handlers_config = gvm_log_config_list;
   if (gvm_log_config_list != NULL)
     {
       /* Go to the head of the list. */
@@ -797,3 +1524,26 @@ setup_log_handlers (GSList *gvm_log_config_list)
                       | G_LOG_FLAG_RECURSION),
     (GLogFunc) gvm_log_func, gvm_log_config_list);
 }
+
+/**
+ * @brief Check whether messages of a level would be logged for a domain.
+ *
+ * Lets callers skip building expensive messages, like dumps of network
+ * data, that the log level would drop anyway.
+ *
+ * @param[in]  log_domain  Log domain.
+ * @param[in]  log_level   Log level.
+ *
+ * @return TRUE if the messages would be logged, or if handlers have not been
+ *         set up with setup_log_handlers, FALSE otherwise.
+ */
+gboolean
+gvm_log_enabled (const char *log_domain, GLogLevelFlags log_level)
+{
+  if (log_handlers_config == NULL)
+    return TRUE;
+
+  return (log_level & G_LOG_LEVEL_MASK
+          & ~log_route_lookup (log_handlers_config, log_domain)->level_mask)
+         == 0;
+}
@@ -27,6 +27,16 @@
 
 #include <glib.h> /* for GSList, gchar, GLogLevelFlags, gpointer */
 
+/**
+ * @brief What to do when the queue of a thread is full in the asynchronous
+ *        logging mode.
+ */
+typedef enum
+{
+  GVM_LOG_ASYNC_DROP = 0, ///< Drop the message.
+  GVM_LOG_ASYNC_BLOCK = 1 ///< Wait until the writer thread made room.
+} gvm_log_async_policy_t;
+
 GSList *
 load_log_configuration (gchar *);
 
@@ -47,4 +57,19 @@ log_func_for_gnutls (int, const char *);
 void
 setup_log_handlers (GSList *);
 
+gboolean
+gvm_log_enabled (const char *, GLogLevelFlags);
+
+int
+gvm_log_async_start (size_t, gvm_log_async_policy_t);
+
+void
+gvm_log_async_flush (void);
+
+void
+gvm_log_async_stop (void);
+
+unsigned int
+gvm_log_async_dropped (void);
+
 #endif /* not _GVM_LOGGING_H */
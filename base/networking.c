@@ -327,31 +327,291 @@ sockaddr_as_str (const struct sockaddr_storage *addr, char *str)
     }
 }
 
+/* DNS cache. */
+
 /**
- * @brief Returns a list of addresses that a hostname resolves to.
+ * @brief Answer in the DNS cache.
+ */
+typedef struct
+{
+  gpointer key;           /**< Lowercase hostname, or address if reverse. */
+  int reverse;            /**< Whether this answers a reverse lookup. */
+  int negative;           /**< Whether the name or address doesn't exist. */
+  struct in6_addr *addrs; /**< Addresses of a hostname, in resolver order. */
+  size_t naddrs;          /**< Number of addresses. */
+  gchar *hostname;        /**< Hostname of an address. */
+  gint64 expires;         /**< Monotonic time at which the answer expires. */
+} dns_cache_entry_t;
+
+/**
+ * @brief Process-wide cache of forward and reverse DNS answers, disabled
+ *        until gvm_dns_cache_set is called.
+ */
+static struct
+{
+  GHashTable *names;           /**< Lowercase hostname to link in lru. */
+  GHashTable *addrs;           /**< Address to link in lru. */
+  GQueue lru;                  /**< Entries, most recently used first. */
+  size_t max_entries;          /**< Max number of entries, 0 if disabled. */
+  gint64 ttl;                  /**< Lifetime of answers, in microseconds. */
+  gint64 negative_ttl;         /**< Lifetime of negative answers. */
+  gvm_dns_cache_stats_t stats; /**< Usage counters. */
+} dns_cache = {NULL, NULL, G_QUEUE_INIT, 0, 0, 0, {0}};
+
+/**
+ * @brief Lock of the DNS cache, which the concurrent lookups share.
+ */
+static GMutex dns_cache_lock;
+
+/**
+ * @brief Hash function for IPv6 addresses.
+ *
+ * @param[in]   key Address.
+ *
+ * @return Hash value.
+ */
+static guint
+dns_addr_hash (gconstpointer key)
+{
+  const struct in6_addr *addr = key;
+
+  return addr->s6_addr32[0] ^ addr->s6_addr32[1] ^ addr->s6_addr32[2]
+         ^ addr->s6_addr32[3];
+}
+
+/**
+ * @brief Equality function for IPv6 addresses.
+ *
+ * @param[in]   a   First address.
+ * @param[in]   b   Second address.
+ *
+ * @return TRUE if both addresses are equal.
+ */
+static gboolean
+dns_addr_equal (gconstpointer a, gconstpointer b)
+{
+  return !memcmp (a, b, sizeof (struct in6_addr));
+}
+
+/**
+ * @brief Drops an answer from the DNS cache. Must be called locked.
+ *
+ * @param[in]   link    Link of the answer in the LRU queue.
+ */
+static void
+dns_cache_drop (GList *link)
+{
+  dns_cache_entry_t *entry = link->data;
+
+  g_hash_table_remove (entry->reverse ? dns_cache.addrs : dns_cache.names,
+                       entry->key);
+  g_queue_delete_link (&dns_cache.lru, link);
+  g_free (entry->key);
+  g_free (entry->addrs);
+  g_free (entry->hostname);
+  g_free (entry);
+}
+
+/**
+ * @brief Finds an unexpired answer in the DNS cache. Must be called locked.
+ *
+ * @param[in]   reverse Whether to find the answer of a reverse lookup.
+ * @param[in]   key     Lowercase hostname, or address if reverse.
+ *
+ * @return Answer, NULL if none.
+ */
+static dns_cache_entry_t *
+dns_cache_find (int reverse, gconstpointer key)
+{
+  GList *link = NULL;
+
+  if (dns_cache.names)
+    link =
+      g_hash_table_lookup (reverse ? dns_cache.addrs : dns_cache.names, key);
+  if (link
+      && ((dns_cache_entry_t *) link->data)->expires <= g_get_monotonic_time ())
+    {
+      dns_cache_drop (link);
+      dns_cache.stats.expired++;
+      link = NULL;
+    }
+  if (link == NULL)
+    {
+      dns_cache.stats.misses++;
+      return NULL;
+    }
+
+  dns_cache.stats.hits++;
+  g_queue_unlink (&dns_cache.lru, link);
+  g_queue_push_head_link (&dns_cache.lru, link);
+  return link->data;
+}
+
+/**
+ * @brief Adds an answer to the DNS cache, evicting the least recently used
+ * ones if needed.
+ *
+ * @param[in]   reverse     Whether this answers a reverse lookup.
+ * @param[in]   key         Lowercase hostname, or address if reverse. Freed
+ *                          by the cache.
+ * @param[in]   addrs       Addresses of the hostname.
+ * @param[in]   naddrs      Number of addresses.
+ * @param[in]   hostname    Hostname of the address.
+ * @param[in]   negative    Whether the name or address doesn't exist.
+ */
+static void
+dns_cache_add (int reverse, gpointer key, const struct in6_addr *addrs,
+               size_t naddrs, const gchar *hostname, int negative)
+{
+  dns_cache_entry_t *entry;
+  GHashTable *table;
+  GList *link;
+
+  g_mutex_lock (&dns_cache_lock);
+  if (dns_cache.max_entries == 0)
+    {
+      g_mutex_unlock (&dns_cache_lock);
+      g_free (key);
+      return;
+    }
+  if (dns_cache.names == NULL)
+    {
+      dns_cache.names = g_hash_table_new (g_str_hash, g_str_equal);
+      dns_cache.addrs = g_hash_table_new (dns_addr_hash, dns_addr_equal);
+    }
+
+  table = reverse ? dns_cache.addrs : dns_cache.names;
+  if ((link = g_hash_table_lookup (table, key)))
+    dns_cache_drop (link);
+  while (dns_cache.lru.length >= dns_cache.max_entries)
+    {
+      dns_cache_drop (dns_cache.lru.tail);
+      dns_cache.stats.evictions++;
+    }
+
+  entry = g_malloc0 (sizeof (*entry));
+  entry->key = key;
+  entry->reverse = reverse;
+  entry->negative = negative;
+  entry->addrs = g_memdup (addrs, naddrs * sizeof (*addrs));
+  entry->naddrs = naddrs;
+  entry->hostname = g_strdup (hostname);
+  entry->expires = g_get_monotonic_time ()
+                   + (negative ? dns_cache.negative_ttl : dns_cache.ttl);
+  g_queue_push_head (&dns_cache.lru, entry);
+  g_hash_table_insert (table, key, dns_cache.lru.head);
+  g_mutex_unlock (&dns_cache_lock);
+}
+
+/**
+ * @brief Sets the limits of the process-wide DNS cache.
+ *
+ * gvm_resolve, gvm_resolve_list, gvm_resolve_as_addr6 and gvm_reverse_lookup
+ * keep their answers in this cache. getaddrinfo and getnameinfo don't give
+ * the TTLs of the records, so the answers live for a fixed time, which
+ * should stay short. The cache is disabled by default.
+ *
+ * @param[in]   max_entries     Max number of answers. 0 disables and empties
+ *                              the cache.
+ * @param[in]   ttl             Lifetime of answers, in seconds.
+ * @param[in]   negative_ttl    Lifetime of negative answers, in seconds.
+ */
+void
+gvm_dns_cache_set (size_t max_entries, unsigned int ttl,
+                   unsigned int negative_ttl)
+{
+  g_mutex_lock (&dns_cache_lock);
+  dns_cache.max_entries = max_entries;
+  dns_cache.ttl = (gint64) ttl * G_USEC_PER_SEC;
+  dns_cache.negative_ttl = (gint64) negative_ttl * G_USEC_PER_SEC;
+  while (dns_cache.lru.length > max_entries)
+    {
+      dns_cache_drop (dns_cache.lru.tail);
+      dns_cache.stats.evictions++;
+    }
+  g_mutex_unlock (&dns_cache_lock);
+}
+
+/**
+ * @brief Empties the process-wide DNS cache.
+ */
+void
+gvm_dns_cache_clear (void)
+{
+  g_mutex_lock (&dns_cache_lock);
+  while (dns_cache.lru.tail)
+    dns_cache_drop (dns_cache.lru.tail);
+  g_mutex_unlock (&dns_cache_lock);
+}
+
+/**
+ * @brief Gets the usage counters of the process-wide DNS cache.
+ *
+ * @param[out]  stats   Where to store the counters.
+ */
+void
+gvm_dns_cache_get_stats (gvm_dns_cache_stats_t *stats)
+{
+  assert (stats);
+
+  g_mutex_lock (&dns_cache_lock);
+  *stats = dns_cache.stats;
+  stats->entries = dns_cache.lru.length;
+  stats->max_entries = dns_cache.max_entries;
+  g_mutex_unlock (&dns_cache_lock);
+}
+
+/**
+ * @brief Gets the addresses a hostname resolves to, from the DNS cache or
+ * the system resolver.
  *
  * @param[in]   name    Hostname to resolve.
+ * @param[out]  addrs   Addresses in resolver order, IPv4-mapped for IPv4.
+ *                      Free with g_free().
+ * @param[out]  naddrs  Number of addresses.
  *
- * @return List of addresses, NULL otherwise.
+ * @return 0 if the name resolved, -1 otherwise.
  */
-GSList *
-gvm_resolve_list (const char *name)
+static int
+dns_resolve_addrs (const char *name, struct in6_addr **addrs, size_t *naddrs)
 {
   struct addrinfo hints, *info, *p;
-  GSList *list = NULL;
-
-  if (name == NULL)
-    return NULL;
+  dns_cache_entry_t *entry;
+  GArray *array;
+  gchar *key;
+  int ret;
+
+  key = g_ascii_strdown (name, -1);
+  g_mutex_lock (&dns_cache_lock);
+  if ((entry = dns_cache_find (FALSE, key)))
+    {
+      *addrs = g_memdup (entry->addrs, entry->naddrs * sizeof (**addrs));
+      *naddrs = entry->naddrs;
+      ret = entry->negative ? -1 : 0;
+      g_mutex_unlock (&dns_cache_lock);
+      g_free (key);
+      return ret;
+    }
+  g_mutex_unlock (&dns_cache_lock);
 
+  *addrs = NULL;
+  *naddrs = 0;
   bzero (&hints, sizeof (hints));
   hints.ai_family = AF_UNSPEC;
   hints.ai_socktype = SOCK_STREAM;
   hints.ai_protocol = 0;
-  if ((getaddrinfo (name, NULL, &hints, &info)) != 0)
-    return NULL;
+  if ((ret = getaddrinfo (name, NULL, &hints, &info)) != 0)
+    {
+      /* Only cache definite answers. */
+      if (ret == EAI_NONAME)
+        dns_cache_add (FALSE, key, NULL, 0, NULL, 1);
+      else
+        g_free (key);
+      return -1;
+    }
 
-  p = info;
-  while (p)
+  array = g_array_new (FALSE, FALSE, sizeof (struct in6_addr));
+  for (p = info; p; p = p->ai_next)
     {
       struct in6_addr dst;
 
@@ -359,18 +619,46 @@ gvm_resolve_list (const char *name)
         {
           struct sockaddr_in *addrin = (struct sockaddr_in *) p->ai_addr;
           ipv4_as_ipv6 (&(addrin->sin_addr), &dst);
-          list = g_slist_prepend (list, g_memdup (&dst, sizeof (dst)));
+          g_array_append_val (array, dst);
         }
       else if (p->ai_family == AF_INET6)
         {
           struct sockaddr_in6 *addrin = (struct sockaddr_in6 *) p->ai_addr;
           memcpy (&dst, &(addrin->sin6_addr), sizeof (struct in6_addr));
-          list = g_slist_prepend (list, g_memdup (&dst, sizeof (dst)));
+          g_array_append_val (array, dst);
         }
-      p = p->ai_next;
     }
-
   freeaddrinfo (info);
+
+  *naddrs = array->len;
+  *addrs = (struct in6_addr *) g_array_free (array, FALSE);
+  dns_cache_add (FALSE, key, *addrs, *naddrs, NULL, 0);
+  return 0;
+}
+
+/**
+ * @brief Returns a list of addresses that a hostname resolves to.
+ *
+ * @param[in]   name    Hostname to resolve.
+ *
+ * @return List of addresses, NULL otherwise.
+ */
+GSList *
+gvm_resolve_list (const char *name)
+{
+  struct in6_addr *addrs;
+  size_t naddrs, i;
+  GSList *list = NULL;
+
+  if (name == NULL)
+    return NULL;
+
+  if (dns_resolve_addrs (name, &addrs, &naddrs))
+    return NULL;
+
+  for (i = 0; i < naddrs; i++)
+    list = g_slist_prepend (list, g_memdup (&addrs[i], sizeof (addrs[i])));
+  g_free (addrs);
   return list;
 }
 
@@ -382,52 +670,40 @@ gvm_resolve_list (const char *name)
  *                      4 bytes for AF_INET and 16 bytes for AF_INET6.
  * @param[in] family    Either AF_INET or AF_INET6.
  *
- * @return -1 if error, 0 otherwise.
+ * @return -1 if error or if the name has no address of the family, 0
+ *         otherwise.
  */
 int
 gvm_resolve (const char *name, void *dst, int family)
 {
-  struct addrinfo hints, *info, *p;
+  struct in6_addr *addrs;
+  size_t naddrs, i;
+  int ret = -1;
 
   if (name == NULL || dst == NULL
       || (family != AF_INET && family != AF_INET6 && family != AF_UNSPEC))
     return -1;
 
-  bzero (&hints, sizeof (hints));
-  hints.ai_family = family;
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = 0;
-  if ((getaddrinfo (name, NULL, &hints, &info)) != 0)
+  if (dns_resolve_addrs (name, &addrs, &naddrs))
     return -1;
 
-  p = info;
-  while (p)
+  for (i = 0; i < naddrs; i++)
     {
-      if (p->ai_family == family || family == AF_UNSPEC)
-        {
-          if (p->ai_family == AF_INET && family == AF_UNSPEC)
-            {
-              struct sockaddr_in *addrin = (struct sockaddr_in *) p->ai_addr;
-              ipv4_as_ipv6 (&(addrin->sin_addr), dst);
-            }
-          else if (p->ai_family == AF_INET)
-            {
-              struct sockaddr_in *addrin = (struct sockaddr_in *) p->ai_addr;
-              memcpy (dst, &(addrin->sin_addr), sizeof (struct in_addr));
-            }
-          else if (p->ai_family == AF_INET6)
-            {
-              struct sockaddr_in6 *addrin = (struct sockaddr_in6 *) p->ai_addr;
-              memcpy (dst, &(addrin->sin6_addr), sizeof (struct in6_addr));
-            }
-          break;
-        }
-
-      p = p->ai_next;
+      int is_ipv4 = IN6_IS_ADDR_V4MAPPED (&addrs[i]);
+
+      if (family == AF_UNSPEC)
+        memcpy (dst, &addrs[i], sizeof (struct in6_addr));
+      else if (family == AF_INET && is_ipv4)
+        memcpy (dst, &addrs[i].s6_addr32[3], sizeof (struct in_addr));
+      else if (family == AF_INET6 && !is_ipv4)
+        memcpy (dst, &addrs[i], sizeof (struct in6_addr));
+      else
+        continue;
+      ret = 0;
+      break;
     }
-
-  freeaddrinfo (info);
-  return 0;
+  g_free (addrs);
+  return ret;
 }
 
 /**
@@ -444,6 +720,353 @@ gvm_resolve_as_addr6 (const char *name, struct in6_addr *ip6)
   return gvm_resolve (name, ip6, AF_UNSPEC);
 }
 
+/**
+ * @brief Gets the name an address reverse-lookups to.
+ *
+ * @param[in]   addr    Address, IPv4-mapped for IPv4.
+ *
+ * @return Lowercase hostname, NULL if none. Free with g_free().
+ */
+gchar *
+gvm_reverse_lookup (const struct in6_addr *addr)
+{
+  int retry = 2, ret = 0;
+  gchar hostname[NI_MAXHOST];
+  dns_cache_entry_t *entry;
+  void *sa;
+  size_t salen;
+  struct sockaddr_in sa4;
+  struct sockaddr_in6 sa6;
+
+  if (addr == NULL)
+    return NULL;
+
+  g_mutex_lock (&dns_cache_lock);
+  if ((entry = dns_cache_find (TRUE, addr)))
+    {
+      gchar *name = g_strdup (entry->hostname);
+
+      g_mutex_unlock (&dns_cache_lock);
+      return name;
+    }
+  g_mutex_unlock (&dns_cache_lock);
+
+  if (IN6_IS_ADDR_V4MAPPED (addr))
+    {
+      sa = &sa4;
+      salen = sizeof (sa4);
+      memset (&sa4, '\0', salen);
+      memcpy (&sa4.sin_addr, &addr->s6_addr32[3], sizeof (sa4.sin_addr));
+      sa4.sin_family = AF_INET;
+    }
+  else
+    {
+      sa = &sa6;
+      salen = sizeof (sa6);
+      memset (&sa6, '\0', salen);
+      memcpy (&sa6.sin6_addr, addr, sizeof (sa6.sin6_addr));
+      sa6.sin6_family = AF_INET6;
+    }
+
+  while (retry--)
+    {
+      ret = getnameinfo (sa, salen, hostname, sizeof (hostname), NULL, 0,
+                         NI_NAMEREQD);
+      if (!ret)
+        {
+          gchar *name = g_ascii_strdown (hostname, -1);
+
+          dns_cache_add (TRUE, g_memdup (addr, sizeof (*addr)), NULL, 0, name,
+                         0);
+          return name;
+        }
+      if (ret != EAI_AGAIN)
+        break;
+    }
+  /* Only cache definite answers. */
+  if (ret == EAI_NONAME)
+    dns_cache_add (TRUE, g_memdup (addr, sizeof (*addr)), NULL, 0, NULL, 1);
+  return NULL;
+}
+
+/**
+ * @brief States of a DNS lookup of a batch.
+ */
+enum dns_lookup_state
+{
+  DNS_LOOKUP_QUEUED,   /**< Not started yet. */
+  DNS_LOOKUP_RUNNING,  /**< Started, no answer yet. */
+  DNS_LOOKUP_DONE,     /**< Answered before timing out. */
+  DNS_LOOKUP_ABANDONED /**< Timed out, its answer is dropped. */
+};
+
+struct dns_batch;
+
+/**
+ * @brief A DNS lookup of a batch.
+ */
+struct dns_lookup
+{
+  gchar *name;                 /**< Name to resolve, NULL if reverse. */
+  struct in6_addr addr;        /**< Address to reverse-lookup. */
+  gpointer result;             /**< List of addresses or hostname. */
+  gint64 deadline;             /**< Monotonic time at which it times out. */
+  enum dns_lookup_state state; /**< State of the lookup. */
+  struct dns_batch *batch;     /**< Batch of the lookup. */
+};
+
+/**
+ * @brief A batch of concurrent DNS lookups.
+ *
+ * System resolver calls can't be interrupted: lookups that time out are
+ * abandoned, and the batch is freed by the last of the caller and the
+ * workers still running.  Without timeout, the workers are joined before
+ * returning.
+ */
+struct dns_batch
+{
+  GMutex lock;                 /**< Protects the fields below. */
+  GCond cond;                  /**< Signalled when a lookup changes state. */
+  struct dns_lookup *lookups;  /**< Lookups. */
+  size_t count;                /**< Number of lookups. */
+  size_t pending;              /**< Lookups neither done nor abandoned. */
+  GQueue started;              /**< Lookups in the order they started. */
+  gint64 timeout;              /**< Timeout of a lookup, in microseconds. */
+  int refs;                    /**< References from caller and workers. */
+};
+
+/**
+ * @brief Frees the result of a DNS lookup.
+ *
+ * @param[in]   lookup  Lookup.
+ */
+static void
+dns_lookup_free_result (struct dns_lookup *lookup)
+{
+  if (lookup->name)
+    g_slist_free_full (lookup->result, g_free);
+  else
+    g_free (lookup->result);
+  lookup->result = NULL;
+}
+
+/**
+ * @brief Drops a reference to a batch of DNS lookups, freeing it with the
+ * last one. Must be called with the batch locked.
+ *
+ * @param[in]   batch   Batch of lookups, unlocked on return.
+ */
+static void
+dns_batch_unref (struct dns_batch *batch)
+{
+  size_t i;
+
+  if (--batch->refs)
+    {
+      g_mutex_unlock (&batch->lock);
+      return;
+    }
+  g_mutex_unlock (&batch->lock);
+
+  for (i = 0; i < batch->count; i++)
+    {
+      dns_lookup_free_result (&batch->lookups[i]);
+      g_free (batch->lookups[i].name);
+    }
+  g_queue_clear (&batch->started);
+  g_cond_clear (&batch->cond);
+  g_mutex_clear (&batch->lock);
+  g_free (batch->lookups);
+  g_free (batch);
+}
+
+/**
+ * @brief Runs a DNS lookup of a batch, in a worker thread.
+ *
+ * @param[in]   data        Lookup.
+ * @param[in]   user_data   Unused.
+ */
+static void
+dns_lookup_run (gpointer data, gpointer user_data)
+{
+  struct dns_lookup *lookup = data;
+  struct dns_batch *batch = lookup->batch;
+  gpointer result;
+
+  (void) user_data;
+  g_mutex_lock (&batch->lock);
+  lookup->state = DNS_LOOKUP_RUNNING;
+  lookup->deadline = batch->timeout ? g_get_monotonic_time () + batch->timeout
+                                    : G_MAXINT64;
+  g_queue_push_tail (&batch->started, lookup);
+  g_cond_broadcast (&batch->cond);
+  g_mutex_unlock (&batch->lock);
+
+  if (lookup->name)
+    result = gvm_resolve_list (lookup->name);
+  else
+    result = gvm_reverse_lookup (&lookup->addr);
+
+  g_mutex_lock (&batch->lock);
+  lookup->result = result;
+  if (lookup->state == DNS_LOOKUP_ABANDONED)
+    dns_lookup_free_result (lookup);
+  else
+    {
+      lookup->state = DNS_LOOKUP_DONE;
+      batch->pending--;
+      g_cond_broadcast (&batch->cond);
+    }
+  dns_batch_unref (batch);
+}
+
+/**
+ * @brief Creates a batch of DNS lookups.
+ *
+ * @param[in]   count       Number of lookups.
+ * @param[in]   timeout     Timeout of each lookup in seconds, 0 for none.
+ *
+ * @return Batch of lookups.
+ */
+static struct dns_batch *
+dns_batch_new (size_t count, unsigned int timeout)
+{
+  struct dns_batch *batch;
+  size_t i;
+
+  batch = g_malloc0 (sizeof (*batch));
+  g_mutex_init (&batch->lock);
+  g_cond_init (&batch->cond);
+  g_queue_init (&batch->started);
+  batch->lookups = g_malloc0_n (MAX (count, 1), sizeof (*batch->lookups));
+  batch->count = batch->pending = count;
+  batch->timeout = (gint64) timeout * G_USEC_PER_SEC;
+  batch->refs = 1 + count;
+  for (i = 0; i < count; i++)
+    batch->lookups[i].batch = batch;
+  return batch;
+}
+
+/**
+ * @brief Runs the lookups of a batch, until all of them are answered or
+ * timed out.
+ *
+ * @param[in]   batch           Batch of lookups.
+ * @param[in]   max_parallel    Max number of concurrent lookups.
+ * @param[out]  results         Results of the answered lookups.
+ */
+static void
+dns_batch_run (struct dns_batch *batch, unsigned int max_parallel,
+               gpointer *results)
+{
+  GThreadPool *pool;
+  size_t i;
+  int abandoned = 0;
+
+  pool = g_thread_pool_new (dns_lookup_run, NULL, MAX (max_parallel, 1), FALSE,
+                            NULL);
+  for (i = 0; i < batch->count; i++)
+    g_thread_pool_push (pool, &batch->lookups[i], NULL);
+
+  /* All lookups have the same timeout: they time out in the order they
+   * started. */
+  g_mutex_lock (&batch->lock);
+  while (batch->pending)
+    {
+      struct dns_lookup *lookup = g_queue_peek_head (&batch->started);
+
+      if (lookup && lookup->state != DNS_LOOKUP_RUNNING)
+        g_queue_pop_head (&batch->started);
+      else if (lookup && lookup->deadline <= g_get_monotonic_time ())
+        {
+          g_queue_pop_head (&batch->started);
+          lookup->state = DNS_LOOKUP_ABANDONED;
+          batch->pending--;
+          abandoned = 1;
+        }
+      else if (lookup && lookup->deadline != G_MAXINT64)
+        g_cond_wait_until (&batch->cond, &batch->lock, lookup->deadline);
+      else
+        g_cond_wait (&batch->cond, &batch->lock);
+    }
+
+  for (i = 0; i < batch->count; i++)
+    if (batch->lookups[i].state == DNS_LOOKUP_DONE)
+      {
+        results[i] = batch->lookups[i].result;
+        batch->lookups[i].result = NULL;
+      }
+
+  /* No lookup is queued any more. Abandoned ones finish in the
+   * background, otherwise the workers are joined so that no thread is
+   * left in a resolver call, for callers which fork. */
+  g_mutex_unlock (&batch->lock);
+  g_thread_pool_free (pool, FALSE, !abandoned);
+  g_mutex_lock (&batch->lock);
+  dns_batch_unref (batch);
+}
+
+/**
+ * @brief Resolves hostnames concurrently.
+ *
+ * @param[in]   names           Hostnames to resolve.
+ * @param[in]   count           Number of hostnames.
+ * @param[in]   max_parallel    Max number of concurrent lookups.
+ * @param[in]   timeout         Timeout of each lookup in seconds, 0 for none.
+ *
+ * Lookups that time out keep running in the background after returning,
+ * so with a timeout this is not safe to call before fork().
+ *
+ * @return Array of count lists of addresses, as from gvm_resolve_list. A NULL
+ *         list if the name didn't resolve in time. Free the lists and the
+ *         array.
+ */
+GSList **
+gvm_resolve_list_batch (const char *const *names, size_t count,
+                        unsigned int max_parallel, unsigned int timeout)
+{
+  struct dns_batch *batch;
+  GSList **results;
+  size_t i;
+
+  results = g_malloc0_n (MAX (count, 1), sizeof (*results));
+  batch = dns_batch_new (count, timeout);
+  for (i = 0; i < count; i++)
+    batch->lookups[i].name = g_strdup (names[i] ? names[i] : "");
+  dns_batch_run (batch, max_parallel, (gpointer *) results);
+  return results;
+}
+
+/**
+ * @brief Reverse-lookups addresses concurrently.
+ *
+ * @param[in]   addrs           Addresses, IPv4-mapped for IPv4.
+ * @param[in]   count           Number of addresses.
+ * @param[in]   max_parallel    Max number of concurrent lookups.
+ * @param[in]   timeout         Timeout of each lookup in seconds, 0 for none.
+ *
+ * Lookups that time out keep running in the background after returning,
+ * so with a timeout this is not safe to call before fork().
+ *
+ * @return Array of count hostnames, as from gvm_reverse_lookup. NULL if the
+ *         address didn't reverse-lookup in time. Free the names and the array.
+ */
+gchar **
+gvm_reverse_lookup_batch (const struct in6_addr *addrs, size_t count,
+                          unsigned int max_parallel, unsigned int timeout)
+{
+  struct dns_batch *batch;
+  gchar **results;
+  size_t i;
+
+  results = g_malloc0_n (MAX (count, 1), sizeof (*results));
+  batch = dns_batch_new (count, timeout);
+  for (i = 0; i < count; i++)
+    batch->lookups[i].addr = addrs[i];
+  dns_batch_run (batch, max_parallel, (gpointer *) results);
+  return results;
+}
+
 /* Ports related. */
 
 /**
@@ -717,6 +1340,208 @@ port_in_port_ranges (int pnum, port_protocol_t ptype, array_t *pranges)
   return 0;
 }
 
+/**
+ * @brief Number of port numbers, 0 to 65535.
+ */
+#define PORT_SET_PORTS 65536
+
+/**
+ * @brief Number of bitmap words per protocol in a port set.
+ */
+#define PORT_SET_WORDS (PORT_SET_PORTS / 64)
+
+/**
+ * @brief A set of TCP and UDP ports, as one bit per port and protocol.
+ */
+struct port_set
+{
+  guint64 bits[2][PORT_SET_WORDS]; /**< Bitmaps, indexed by port_protocol_t. */
+};
+
+/**
+ * @brief Creates an empty port set.
+ *
+ * @return Port set, to free with @ref port_set_free.
+ */
+port_set_t *
+port_set_new (void)
+{
+  return g_malloc0 (sizeof (port_set_t));
+}
+
+/**
+ * @brief Frees a port set.
+ *
+ * @param[in] set Port set.
+ */
+void
+port_set_free (port_set_t *set)
+{
+  g_free (set);
+}
+
+/**
+ * @brief Adds a range of ports to a port set.
+ *
+ * @param[in] set    Port set.
+ * @param[in] ptype  Protocol of the ports, TCP or UDP.
+ * @param[in] start  First port.
+ * @param[in] end    Last port. Clamped to 65535.
+ */
+void
+port_set_add_range (port_set_t *set, port_protocol_t ptype, int start, int end)
+{
+  guint64 *bits;
+
+  if (set == NULL || ptype > PORT_PROTOCOL_UDP)
+    return;
+
+  if (start < 0)
+    start = 0;
+  if (end >= PORT_SET_PORTS)
+    end = PORT_SET_PORTS - 1;
+  bits = set->bits[ptype];
+  while (start <= end)
+    {
+      int bit = start % 64, last = MIN (63, bit + end - start);
+      guint64 mask;
+
+      /* Bits bit to last of the word. */
+      mask = (last == 63 ? ~(guint64) 0 : ((guint64) 1 << (last + 1)) - 1)
+             & ~(((guint64) 1 << bit) - 1);
+      bits[start / 64] |= mask;
+      start += last - bit + 1;
+    }
+}
+
+/**
+ * @brief Compiles a range array into a port set.
+ *
+ * @param[in] ranges  Range array, as from @ref port_range_ranges.
+ *
+ * @return Port set, to free with @ref port_set_free. NULL if ranges is NULL.
+ */
+port_set_t *
+port_set_from_ranges (array_t *ranges)
+{
+  port_set_t *set;
+  unsigned int i;
+
+  if (ranges == NULL)
+    return NULL;
+
+  set = port_set_new ();
+  for (i = 0; i < ranges->len; i++)
+    {
+      range_t *range = (range_t *) g_ptr_array_index (ranges, i);
+
+      port_set_add_range (set, range->type, range->start, range->end);
+    }
+  return set;
+}
+
+/**
+ * @brief Creates a port set from a port_range string.
+ *
+ * @param[in]  port_range  Valid port_range string.
+ *
+ * @return Port set, to free with @ref port_set_free. NULL if port_range is
+ *         NULL.
+ */
+port_set_t *
+port_range_set (const char *port_range)
+{
+  array_t *ranges;
+  port_set_t *set;
+
+  ranges = port_range_ranges (port_range);
+  set = port_set_from_ranges (ranges);
+  array_free (ranges);
+  return set;
+}
+
+/**
+ * @brief Checks if a port num is in a port set.
+ *
+ * @param[in]  pnum   Port number.
+ * @param[in]  ptype  Port type.
+ * @param[in]  set    Port set.
+ *
+ * @return 1 if port in port set, 0 otherwise.
+ */
+int
+port_in_port_set (int pnum, port_protocol_t ptype, const port_set_t *set)
+{
+  if (set == NULL || pnum < 0 || pnum >= PORT_SET_PORTS
+      || ptype > PORT_PROTOCOL_UDP)
+    return 0;
+
+  return (set->bits[ptype][pnum / 64] >> (pnum % 64)) & 1;
+}
+
+/**
+ * @brief Adds the ports of a port set to another one.
+ *
+ * @param[in,out] set    Port set to add to.
+ * @param[in]     other  Port set to add.
+ */
+void
+port_set_union (port_set_t *set, const port_set_t *other)
+{
+  int i;
+
+  if (set == NULL || other == NULL)
+    return;
+
+  for (i = 0; i < PORT_SET_WORDS; i++)
+    {
+      set->bits[PORT_PROTOCOL_TCP][i] |= other->bits[PORT_PROTOCOL_TCP][i];
+      set->bits[PORT_PROTOCOL_UDP][i] |= other->bits[PORT_PROTOCOL_UDP][i];
+    }
+}
+
+/**
+ * @brief Removes from a port set the ports missing from another one.
+ *
+ * @param[in,out] set    Port set to remove from.
+ * @param[in]     other  Port set to intersect with.
+ */
+void
+port_set_intersection (port_set_t *set, const port_set_t *other)
+{
+  int i;
+
+  if (set == NULL || other == NULL)
+    return;
+
+  for (i = 0; i < PORT_SET_WORDS; i++)
+    {
+      set->bits[PORT_PROTOCOL_TCP][i] &= other->bits[PORT_PROTOCOL_TCP][i];
+      set->bits[PORT_PROTOCOL_UDP][i] &= other->bits[PORT_PROTOCOL_UDP][i];
+    }
+}
+
+/**
+ * @brief Counts the ports of a protocol in a port set.
+ *
+ * @param[in]  set    Port set.
+ * @param[in]  ptype  Port type.
+ *
+ * @return Number of ports.
+ */
+int
+port_set_count (const port_set_t *set, port_protocol_t ptype)
+{
+  int i, count = 0;
+
+  if (set == NULL || ptype > PORT_PROTOCOL_UDP)
+    return 0;
+
+  for (i = 0; i < PORT_SET_WORDS; i++)
+    count += __builtin_popcountll (set->bits[ptype][i]);
+  return count;
+}
+
 /**
  * @brief Checks if IPv6 support is enabled.
  *
@@ -56,6 +56,24 @@ struct range
 };
 typedef struct range range_t;
 
+/**
+ * @brief A set of TCP and UDP ports, for constant time lookups.
+ */
+typedef struct port_set port_set_t;
+
+/**
+ * @brief Usage counters of the DNS cache.
+ */
+typedef struct
+{
+  unsigned long hits;      /**< Lookups answered from the cache. */
+  unsigned long misses;    /**< Lookups that went to the system resolver. */
+  unsigned long expired;   /**< Answers dropped as they were too old. */
+  unsigned long evictions; /**< Answers dropped to stay under max_entries. */
+  size_t entries;          /**< Number of cached answers. */
+  size_t max_entries;      /**< Max number of cached answers. */
+} gvm_dns_cache_stats_t;
+
 int
 gvm_source_iface_init (const char *);
 
@@ -92,6 +110,7 @@ addr6_as_str (const struct in6_addr *);
 void
 sockaddr_as_str (const struct sockaddr_storage *, char *);
 
+/* Returns -1 if the name has no address of the requested family. */
 int
 gvm_resolve (const char *, void *, int);
 
@@ -101,6 +120,26 @@ gvm_resolve_list (const char *);
 int
 gvm_resolve_as_addr6 (const char *, struct in6_addr *);
 
+gchar *
+gvm_reverse_lookup (const struct in6_addr *);
+
+void
+gvm_dns_cache_set (size_t, unsigned int, unsigned int);
+
+void
+gvm_dns_cache_clear (void);
+
+void
+gvm_dns_cache_get_stats (gvm_dns_cache_stats_t *);
+
+GSList **
+gvm_resolve_list_batch (const char *const *, size_t, unsigned int,
+                        unsigned int);
+
+gchar **
+gvm_reverse_lookup_batch (const struct in6_addr *, size_t, unsigned int,
+                          unsigned int);
+
 int
 validate_port_range (const char *);
 
@@ -110,6 +149,33 @@ port_range_ranges (const char *);
 int
 port_in_port_ranges (int, port_protocol_t, array_t *);
 
+port_set_t *
+port_set_new (void);
+
+void
+port_set_free (port_set_t *);
+
+void
+port_set_add_range (port_set_t *, port_protocol_t, int, int);
+
+port_set_t *
+port_set_from_ranges (array_t *);
+
+port_set_t *
+port_range_set (const char *);
+
+int
+port_in_port_set (int, port_protocol_t, const port_set_t *);
+
+void
+port_set_union (port_set_t *, const port_set_t *);
+
+void
+port_set_intersection (port_set_t *, const port_set_t *);
+
+int
+port_set_count (const port_set_t *, port_protocol_t);
+
 int
 ipv6_is_enabled ();
 
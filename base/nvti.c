@@ -62,11 +62,62 @@
  */
 typedef struct vtref
 {
-  gchar *type;     ///< Reference type ("cve", "bid", ...)
+  const gchar *type; ///< Reference type ("cve", "bid", ...), interned
   gchar *ref_id;   ///< The actual reference ID ("CVE-2018-1234", "https://example.org")
   gchar *ref_text; ///< Optional additional text
 } vtref_t;
 
+/**
+ * @brief Index of the references and preferences of a NVT Info.
+ *
+ * The refs and prefs lists of the nvti_t own the elements, the arrays only
+ * point to them, for indexed access and grouping.
+ */
+struct nvti_index
+{
+  GPtrArray *refs;       ///< References, in the order of the list
+  GPtrArray *ref_groups; ///< References grouped by type, arrays of vtref_t
+  GPtrArray *prefs;      ///< Preferences, in the order of the list
+  GSList *refs_last;     ///< Last link of the references list
+  GSList *prefs_last;    ///< Last link of the preferences list
+};
+
+/**
+ * @brief Get the index of a NVT Info, creating it if needed.
+ *
+ * @param n The NVT Info structure.
+ *
+ * @return The index.
+ */
+static struct nvti_index *
+nvti_index (nvti_t *n)
+{
+  if (n->index == NULL)
+    n->index = g_malloc0 (sizeof (struct nvti_index));
+  return n->index;
+}
+
+/**
+ * @brief Append an element to a list in constant time.
+ *
+ * @param list The list.
+ *
+ * @param last The last link of the list, updated.
+ *
+ * @param data The element to append.
+ */
+static void
+nvti_list_append (GSList **list, GSList **last, gpointer data)
+{
+  GSList *link = g_slist_prepend (NULL, data);
+
+  if (*last)
+    (*last)->next = link;
+  else
+    *list = link;
+  *last = link;
+}
+
 /**
  * @brief Create a new vtref structure filled with the given values.
  *
@@ -86,7 +137,7 @@ vtref_new (const gchar *type, const gchar *ref_id, const gchar *ref_text)
   vtref_t *ref = g_malloc0 (sizeof (vtref_t));
 
   if (type)
-    ref->type = g_strdup (type);
+    ref->type = g_intern_string (type);
   if (ref_id)
     ref->ref_id = g_strdup (ref_id);
   if (ref_text)
@@ -107,7 +158,6 @@ vtref_free (vtref_t *ref)
   if (!ref)
     return;
 
-  g_free (ref->type);
   g_free (ref->ref_id);
   g_free (ref->ref_text);
   g_free (ref);
@@ -141,6 +191,35 @@ vtref_id (const vtref_t *r)
   return (r ? r->ref_id : NULL);
 }
 
+/**
+ * @brief Get the references of a type.
+ *
+ * @param vt    The VT Info structure.
+ *
+ * @param type  The reference type, compared case insensitively.
+ *
+ * @return Array of references, NULL if there are none of the type.
+ */
+static GPtrArray *
+nvti_ref_group (const nvti_t *vt, const gchar *type)
+{
+  guint i;
+
+  if (vt->index == NULL || vt->index->ref_groups == NULL)
+    return NULL;
+
+  for (i = 0; i < vt->index->ref_groups->len; i++)
+    {
+      GPtrArray *group = g_ptr_array_index (vt->index->ref_groups, i);
+      vtref_t *ref = g_ptr_array_index (group, 0);
+
+      if ((ref->type == NULL || type == NULL) ? ref->type == type
+                                              : !strcasecmp (ref->type, type))
+        return group;
+    }
+  return NULL;
+}
+
 /**
  * @brief Add a reference to the VT Info.
  *
@@ -153,10 +232,28 @@ vtref_id (const vtref_t *r)
 int
 nvti_add_vtref (nvti_t *vt, vtref_t *ref)
 {
+  struct nvti_index *index;
+  GPtrArray *group;
+
   if (!vt)
     return (-1);
 
-  vt->refs = g_slist_append (vt->refs, ref);
+  index = nvti_index (vt);
+  nvti_list_append (&vt->refs, &index->refs_last, ref);
+  if (index->refs == NULL)
+    index->refs = g_ptr_array_new ();
+  g_ptr_array_add (index->refs, ref);
+
+  group = nvti_ref_group (vt, ref->type);
+  if (group == NULL)
+    {
+      if (index->ref_groups == NULL)
+        index->ref_groups =
+          g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+      group = g_ptr_array_new ();
+      g_ptr_array_add (index->ref_groups, group);
+    }
+  g_ptr_array_add (group, ref);
   return (0);
 }
 
@@ -167,7 +264,7 @@ nvti_add_vtref (nvti_t *vt, vtref_t *ref)
  *
  * @param name The name to be set. A copy will created of this.
  *
- * @param type The type to be set. A copy will created of this.
+ * @param type The type to be set. This is interned.
  *
  * @param dflt The default to be set. A copy will created of this.
  *
@@ -184,7 +281,7 @@ nvtpref_new (int id, gchar *name, gchar *type, gchar *dflt)
   if (name)
     np->name = g_strdup (name);
   if (type)
-    np->type = g_strdup (type);
+    np->type = (gchar *) g_intern_string (type);
   if (dflt)
     np->dflt = g_strdup (dflt);
 
@@ -203,7 +300,6 @@ nvtpref_free (nvtpref_t *np)
     return;
 
   g_free (np->name);
-  g_free (np->type);
   g_free (np->dflt);
   g_free (np);
 }
@@ -292,19 +388,76 @@ nvti_free (nvti_t *n)
   g_free (n->oid);
   g_free (n->name);
   g_free (n->tag);
-  g_free (n->cvss_base);
   g_free (n->dependencies);
   g_free (n->required_keys);
   g_free (n->mandatory_keys);
   g_free (n->excluded_keys);
   g_free (n->required_ports);
   g_free (n->required_udp_ports);
-  g_free (n->family);
-  g_slist_free_full (n->refs, (void (*) (void *)) vtref_free);
-  g_slist_free_full (n->prefs, (void (*) (void *)) nvtpref_free);
+  g_slist_free_full (n->refs, (GDestroyNotify) vtref_free);
+  g_slist_free_full (n->prefs, (GDestroyNotify) nvtpref_free);
+  if (n->index)
+    {
+      if (n->index->refs)
+        g_ptr_array_free (n->index->refs, TRUE);
+      if (n->index->ref_groups)
+        g_ptr_array_free (n->index->ref_groups, TRUE);
+      if (n->index->prefs)
+        g_ptr_array_free (n->index->prefs, TRUE);
+      g_free (n->index);
+    }
   g_free (n);
 }
 
+/**
+ * @brief Create a deep copy of a nvti structure.
+ *
+ * @param n The structure to copy.
+ *
+ * @return NULL if n is NULL. Else a copy of n which needs to be
+ *         released using @ref nvti_free .
+ */
+nvti_t *
+nvti_dup (const nvti_t *n)
+{
+  nvti_t *dup;
+  GSList *list;
+
+  if (!n)
+    return NULL;
+
+  dup = nvti_new ();
+  dup->oid = g_strdup (n->oid);
+  dup->name = g_strdup (n->name);
+  dup->tag = g_strdup (n->tag);
+  dup->cvss_base = n->cvss_base;
+  dup->dependencies = g_strdup (n->dependencies);
+  dup->required_keys = g_strdup (n->required_keys);
+  dup->mandatory_keys = g_strdup (n->mandatory_keys);
+  dup->excluded_keys = g_strdup (n->excluded_keys);
+  dup->required_ports = g_strdup (n->required_ports);
+  dup->required_udp_ports = g_strdup (n->required_udp_ports);
+  dup->family = n->family;
+  dup->timeout = n->timeout;
+  dup->category = n->category;
+
+  for (list = n->refs; list; list = list->next)
+    {
+      vtref_t *ref = list->data;
+
+      nvti_add_vtref (dup, vtref_new (ref->type, ref->ref_id, ref->ref_text));
+    }
+
+  for (list = n->prefs; list; list = list->next)
+    {
+      nvtpref_t *np = list->data;
+
+      nvti_add_pref (dup, nvtpref_new (np->id, np->name, np->type, np->dflt));
+    }
+
+  return dup;
+}
+
 /**
  * @brief Get the OID string.
  *
@@ -343,7 +496,7 @@ nvti_name (const nvti_t *n)
 guint
 nvti_vtref_len (const nvti_t *n)
 {
-  return (n ? g_slist_length (n->refs) : 0);
+  return (n && n->index && n->index->refs ? n->index->refs->len : 0);
 }
 
 /**
@@ -358,7 +511,8 @@ nvti_vtref_len (const nvti_t *n)
 vtref_t *
 nvti_vtref (const nvti_t *n, guint p)
 {
-  return (n ? g_slist_nth_data (n->refs, p) : NULL);
+  return (p < nvti_vtref_len (n) ? g_ptr_array_index (n->index->refs, p)
+                                 : NULL);
 }
 
 /**
@@ -382,70 +536,97 @@ nvti_vtref (const nvti_t *n, guint p)
  *         is returned.
  *         If use_types is not 0 a comma-separated list like
  *         "type:id, type:id, type:id" is returned.
+ *         References are listed in the order they were added.
  *         NULL is returned in case n is NULL.
  */
 gchar *
-nvti_refs (const nvti_t *n, const gchar *type, const gchar *exclude_types, guint use_types)
+nvti_refs (const nvti_t *n, const gchar *type, const gchar *exclude_types,
+           guint use_types)
 {
-  gchar *refs, *refs2, **exclude_item;
-  vtref_t * ref;
-  guint i, exclude;
+  GString *refs;
+  GPtrArray *selected;
+  GHashTable *excluded = NULL;
   gchar **exclude_split;
+  gsize size;
+  guint i, j;
 
-  if (!n) return (NULL);
-
-  refs = NULL;
-  refs2 = NULL;
-  exclude = 0;
+  if (!n || !n->index || !n->index->refs)
+    return (NULL);
 
   if (exclude_types && exclude_types[0])
+    {
       exclude_split = g_strsplit (exclude_types, ",", 0);
+      for (i = 0; exclude_split[i]; i++)
+        g_strstrip (exclude_split[i]);
+    }
+  else
+    exclude_split = NULL;
+
+  /* Flag the references of the excluded types, per group. */
+  for (i = 0; exclude_split && n->index->ref_groups
+              && i < n->index->ref_groups->len;
+       i++)
+    {
+      GPtrArray *group = g_ptr_array_index (n->index->ref_groups, i);
+      const gchar *group_type = ((vtref_t *) g_ptr_array_index (group, 0))->type;
+      gboolean exclude = FALSE;
+
+      for (j = 0; exclude_split[j] && !exclude; j++)
+        exclude = group_type && !strcasecmp (exclude_split[j], group_type);
+      if (!exclude)
+        continue;
+      if (excluded == NULL)
+        excluded = g_hash_table_new (NULL, NULL);
+      for (j = 0; j < group->len; j++)
+        g_hash_table_add (excluded, g_ptr_array_index (group, j));
+    }
+  g_strfreev (exclude_split);
+
+  /* A single type is a group, all types are the references in order. */
+  if (type)
+    selected = nvti_ref_group (n, type);
   else
-      exclude_split = NULL;
+    selected = n->index->refs;
 
-  for (i = 0; i < g_slist_length (n->refs); i++)
+  size = 0;
+  for (i = 0; selected && i < selected->len; i++)
     {
-      ref = g_slist_nth_data (n->refs, i);
-      if (type && strcasecmp (ref->type, type) != 0)
+      vtref_t *ref = g_ptr_array_index (selected, i);
+
+      if (excluded && g_hash_table_contains (excluded, ref))
         continue;
+      size += 2 + strlen (ref->ref_id ?: "(null)");
+      if (use_types)
+        size += 1 + strlen (ref->type ?: "(null)");
+    }
 
-      if (exclude_split)
-        {
-          exclude = 0;
-          for (exclude_item = exclude_split; *exclude_item; exclude_item++)
-            {
-              if (strcasecmp (g_strstrip (*exclude_item), ref->type) == 0)
-                {
-                  exclude = 1;
-                  break;
-                }
-            }
-        }
+  if (size == 0)
+    {
+      if (excluded)
+        g_hash_table_destroy (excluded);
+      return (NULL);
+    }
 
-      if (!exclude)
+  refs = g_string_sized_new (size);
+  for (i = 0; i < selected->len; i++)
+    {
+      vtref_t *ref = g_ptr_array_index (selected, i);
+
+      if (excluded && g_hash_table_contains (excluded, ref))
+        continue;
+      if (refs->len)
+        g_string_append (refs, ", ");
+      if (use_types)
         {
-          if (use_types)
-            {
-              if (refs)
-                refs2 = g_strdup_printf ("%s, %s:%s", refs, ref->type, ref->ref_id);
-              else
-                refs2 = g_strdup_printf ("%s:%s", ref->type, ref->ref_id);
-            }
-          else
-            {
-              if (refs)
-                refs2 = g_strdup_printf ("%s, %s", refs, ref->ref_id);
-              else
-                refs2 = g_strdup_printf ("%s", ref->ref_id);
-            }
-          g_free (refs);
-          refs = refs2;
+          g_string_append (refs, ref->type ?: "(null)");
+          g_string_append_c (refs, ':');
         }
+      g_string_append (refs, ref->ref_id ?: "(null)");
     }
+  if (excluded)
+    g_hash_table_destroy (excluded);
 
-  g_strfreev (exclude_split);
-
-  return (refs);
+  return (g_string_free (refs, FALSE));
 }
 
 /**
@@ -584,7 +765,7 @@ nvti_family (const nvti_t *n)
 guint
 nvti_pref_len (const nvti_t *n)
 {
-  return (n ? g_slist_length (n->prefs) : 0);
+  return (n && n->index && n->index->prefs ? n->index->prefs->len : 0);
 }
 
 /**
@@ -599,7 +780,8 @@ nvti_pref_len (const nvti_t *n)
 const nvtpref_t *
 nvti_pref (const nvti_t *n, guint p)
 {
-  return (n ? g_slist_nth_data (n->prefs, p) : NULL);
+  return (p < nvti_pref_len (n) ? g_ptr_array_index (n->index->prefs, p)
+                                : NULL);
 }
 
 /**
@@ -700,7 +882,7 @@ nvti_set_tag (nvti_t *n, const gchar *tag)
  *
  * @param n The NVT Info structure.
  *
- * @param cvss_base The CVSS base to set. A copy will be created from this.
+ * @param cvss_base The CVSS base to set. This is interned.
  *
  * @return 0 for success. Anything else indicates an error.
  */
@@ -710,10 +892,8 @@ nvti_set_cvss_base (nvti_t *n, const gchar *cvss_base)
   if (!n)
     return (-1);
 
-  if (n->cvss_base)
-    g_free (n->cvss_base);
   if (cvss_base && cvss_base[0])
-    n->cvss_base = g_strdup (cvss_base);
+    n->cvss_base = (gchar *) g_intern_string (cvss_base);
   else
     n->cvss_base = NULL;
   return (0);
@@ -874,7 +1054,7 @@ nvti_set_required_udp_ports (nvti_t *n, const gchar *required_udp_ports)
  *
  * @param n The NVT Info structure.
  *
- * @param family The family to set. A copy will be created from this.
+ * @param family The family to set. This is interned.
  *
  * @return 0 for success. Anything else indicates an error.
  */
@@ -884,9 +1064,7 @@ nvti_set_family (nvti_t *n, const gchar *family)
   if (!n)
     return (-1);
 
-  if (n->family)
-    g_free (n->family);
-  n->family = g_strdup (family);
+  n->family = family ? (gchar *) g_intern_string (family) : NULL;
   return (0);
 }
 
@@ -1155,10 +1333,16 @@ nvti_add_required_udp_ports (nvti_t *n, const gchar *port)
 int
 nvti_add_pref (nvti_t *n, nvtpref_t *np)
 {
+  struct nvti_index *index;
+
   if (!n)
     return (-1);
 
-  n->prefs = g_slist_append (n->prefs, np);
+  index = nvti_index (n);
+  nvti_list_append (&n->prefs, &index->prefs_last, np);
+  if (index->prefs == NULL)
+    index->prefs = g_ptr_array_new ();
+  g_ptr_array_add (index->prefs, np);
   return (0);
 }
 
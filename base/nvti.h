@@ -38,7 +38,7 @@
 typedef struct nvtpref
 {
   int id;      ///< Preference ID
-  gchar *type; ///< Preference type
+  gchar *type; ///< Preference type, interned, not to be freed
   gchar *name; ///< Name of the preference
   gchar *dflt; ///< Default value of the preference
 } nvtpref_t;
@@ -78,7 +78,7 @@ typedef struct nvti
   gchar *name; /**< @brief The name */
 
   gchar *tag;       /**< @brief List of tags attached to this NVT */
-  gchar *cvss_base; /**< @brief CVSS base score for this NVT. */
+  gchar *cvss_base; /**< @brief CVSS base score for this NVT, interned */
 
   gchar *dependencies;   /**< @brief List of dependencies of this NVT */
   gchar *required_keys;  /**< @brief List of required KB keys of this NVT */
@@ -94,7 +94,9 @@ typedef struct nvti
   // The following are not settled yet.
   gint timeout;  /**< @brief Default timeout time for this NVT */
   gint category; /**< @brief The category, this NVT belongs to */
-  gchar *family; /**< @brief Family the NVT belongs to */
+  gchar *family; /**< @brief Family the NVT belongs to, interned */
+
+  struct nvti_index *index; /**< @brief Private index of refs and prefs */
 } nvti_t;
 
 
@@ -118,6 +120,8 @@ nvti_t *
 nvti_new (void);
 void
 nvti_free (nvti_t *);
+nvti_t *
+nvti_dup (const nvti_t *);
 
 gchar *
 nvti_oid (const nvti_t *);
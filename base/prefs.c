@@ -30,10 +30,33 @@
 #include <glib.h>   /* for gchar */
 #include <stdio.h>  /* for printf() */
 #include <stdlib.h> /* for atoi() */
-#include <string.h> /* for strlen() */
+#include <string.h> /* for strlen(), strcmp() */
 
 static GHashTable *global_prefs = NULL;
 
+/**
+ * @brief Parsed forms of a preference value.
+ */
+typedef struct
+{
+  int boolean; ///< 1 if the value is "yes", else 0.
+  int integer; ///< The value as parsed by atoi.
+} prefs_typed_t;
+
+/**
+ * @brief Parsed preference values, by key.
+ *
+ * Kept in sync with global_prefs by prefs_set.
+ */
+static GHashTable *global_prefs_typed = NULL;
+
+/**
+ * @brief NVT timeouts, by OID.
+ *
+ * Built from the "timeout.<oid>" preferences by prefs_set.
+ */
+static GHashTable *nvt_timeouts = NULL;
+
 void
 prefs_set (const gchar *, const gchar *);
 
@@ -46,10 +69,17 @@ static void
 prefs_init (void)
 {
   if (global_prefs)
-    g_hash_table_destroy (global_prefs);
+    {
+      g_hash_table_destroy (global_prefs);
+      g_hash_table_destroy (global_prefs_typed);
+      g_hash_table_destroy (nvt_timeouts);
+    }
 
   global_prefs =
     g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  global_prefs_typed =
+    g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  nvt_timeouts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
   prefs_set ("cgi_path", "/cgi-bin:/scripts");
   prefs_set ("checks_read_timeout", "5");
   prefs_set ("unscanned_closed", "yes");
@@ -66,6 +96,9 @@ prefs_init (void)
  * @brief Get the pointer to the global preferences structure.
  *        Eventually this function should not be used anywhere.
  *
+ * Changes made directly to the structure are not seen by prefs_get_bool,
+ * prefs_get_int and prefs_nvt_timeout, use prefs_set instead.
+ *
  * @return Pointer to the global preferences structure.
  */
 GHashTable *
@@ -109,16 +142,32 @@ prefs_get (const gchar *key)
 int
 prefs_get_bool (const gchar *key)
 {
-  gchar *str;
+  prefs_typed_t *typed;
 
   if (!global_prefs)
     prefs_init ();
 
-  str = g_hash_table_lookup (global_prefs, key);
-  if (str && !strcmp (str, "yes"))
-    return 1;
+  typed = g_hash_table_lookup (global_prefs_typed, key);
+  return typed ? typed->boolean : 0;
+}
 
-  return 0;
+/**
+ * @brief Get an integer expression of a preference value via a key.
+ *
+ * @param key    The identifier for the preference.
+ *
+ * @return The value parsed as by atoi, 0 for a non-existing key.
+ */
+int
+prefs_get_int (const gchar *key)
+{
+  prefs_typed_t *typed;
+
+  if (!global_prefs)
+    prefs_init ();
+
+  typed = g_hash_table_lookup (global_prefs_typed, key);
+  return typed ? typed->integer : 0;
 }
 
 /**
@@ -132,10 +181,21 @@ prefs_get_bool (const gchar *key)
 void
 prefs_set (const gchar *key, const gchar *value)
 {
+  prefs_typed_t *typed;
+
   if (!global_prefs)
     prefs_init ();
 
   g_hash_table_insert (global_prefs, g_strdup (key), g_strdup (value));
+
+  typed = g_malloc (sizeof (*typed));
+  typed->boolean = value && !strcmp (value, "yes");
+  typed->integer = value ? atoi (value) : 0;
+  g_hash_table_insert (global_prefs_typed, g_strdup (key), typed);
+
+  if (g_str_has_prefix (key, "timeout."))
+    g_hash_table_insert (nvt_timeouts, g_strdup (key + strlen ("timeout.")),
+                         GINT_TO_POINTER (typed->integer));
 }
 
 /**
@@ -195,11 +255,11 @@ prefs_dump (void)
 int
 prefs_nvt_timeout (const char *oid)
 {
-  char *pref_name = g_strdup_printf ("timeout.%s", oid);
-  const char *val = prefs_get (pref_name);
-  int timeout = (val ? atoi (val) : 0);
+  if (!global_prefs)
+    prefs_init ();
 
-  g_free (pref_name);
+  if (oid == NULL)
+    return 0;
 
-  return timeout;
+  return GPOINTER_TO_INT (g_hash_table_lookup (nvt_timeouts, oid));
 }
@@ -35,6 +35,8 @@ const gchar *
 prefs_get (const gchar *key);
 int
 prefs_get_bool (const gchar *key);
+int
+prefs_get_int (const gchar *key);
 void
 prefs_set (const gchar *, const gchar *);
 void
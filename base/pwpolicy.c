@@ -27,11 +27,14 @@
 
 #include "pwpolicy.h"
 
-#include <errno.h> /* for errno */
-#include <glib.h>  /* for g_strdup_printf, g_ascii_strcasecmp, g_free, ... */
-#include <stdio.h> /* for fclose, fgets, fopen, FILE, ferror, EOF, getc */
+#include <errno.h>    /* for errno */
+#include <fcntl.h>    /* for open, O_RDONLY */
+#include <glib.h>     /* for g_strdup_printf, g_ascii_strcasecmp, g_free, ... */
+#include <stdio.h>    /* for fclose, fgets, fopen, FILE, ferror, EOF, getc */
 #include <stdlib.h>
-#include <string.h> /* for strstr, strlen, strncmp */
+#include <string.h>   /* for strstr, strlen, strncmp, memchr */
+#include <sys/stat.h> /* for fstat, struct stat */
+#include <unistd.h>   /* for read, close */
 
 #ifndef DIM
 #define DIM(v) (sizeof (v) / sizeof ((v)[0]))
@@ -92,11 +95,11 @@
  *   #+search[:] FILENAME
  *
  *     This searches the file with name FILENAME for a match.  The
- *     comparison is case insensitive for all ASCII characters.  This
- *     is a simple linear search and stops at the first match.
- *     Comments are not allowed in that file.  A line in that file may
- *     not be longer than 255 characters.  An example for such a file
- *     is "/usr/share/dict/words".
+ *     comparison is case insensitive for all ASCII characters.  The
+ *     file is loaded once into a hash set and only loaded again when
+ *     it changes.  Comments are not allowed in that file.  A line in
+ *     that file may not be longer than 255 characters.  An example for
+ *     such a file is "/usr/share/dict/words".
  *
  *   #+username
  *
@@ -154,11 +157,131 @@ is_keyword (char *string, const char *keyword)
   return NULL;
 }
 
+/**
+ * @brief Longest word of a search file, longer lines are ignored.
+ */
+#define SEARCH_FILE_MAX_WORD 253
+
+/**
+ * @brief A search file loaded into memory.
+ */
+struct search_file
+{
+  char *data;        /**< Contents of the file, lower cased, one word per
+                          NULL terminated line. */
+  GHashTable *words; /**< Set of the words, pointing into data. */
+  dev_t dev;         /**< Device of the loaded file. */
+  ino_t ino;         /**< Inode of the loaded file. */
+  off_t size;        /**< Size of the loaded file. */
+  time_t mtime;      /**< Modification time of the loaded file. */
+};
+
+/**
+ * @brief Loaded search files, keyed by file name.
+ */
+static GHashTable *search_files = NULL;
+
+/**
+ * @brief Lock for search_files.
+ */
+G_LOCK_DEFINE_STATIC (search_files);
+
+/**
+ * @brief Free a loaded search file.
+ *
+ * @param data  The search file.
+ */
+static void
+search_file_free (gpointer data)
+{
+  struct search_file *sf = data;
+
+  g_hash_table_destroy (sf->words);
+  g_free (sf->data);
+  g_free (sf);
+}
+
+/**
+ * @brief Load a search file into memory.
+ *
+ * Lines are handled like the line based reader did before: lines longer
+ * than \ref SEARCH_FILE_MAX_WORD, empty lines and an incomplete last line
+ * are skipped, and an optional CR before the LF is removed.
+ *
+ * @param fd  File descriptor of the opened file.
+ * @param st  Status of the opened file.
+ *
+ * @return The search file, NULL on read error with errno set.
+ */
+static struct search_file *
+search_file_load (int fd, const struct stat *st)
+{
+  struct search_file *sf;
+  char *line, *end;
+  size_t done = 0;
+
+  sf = g_malloc0 (sizeof (*sf));
+  sf->data = g_malloc (st->st_size + 1);
+  while (done < (size_t) st->st_size)
+    {
+      ssize_t ret;
+
+      ret = read (fd, sf->data + done, st->st_size - done);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret < 0)
+        {
+          int save_errno = errno;
+
+          g_free (sf->data);
+          g_free (sf);
+          errno = save_errno;
+          return NULL;
+        }
+      if (ret == 0)
+        break; /* Truncated under us, use what was read. */
+      done += ret;
+    }
+  sf->data[done] = '\0';
+
+  sf->words = g_hash_table_new (g_str_hash, g_str_equal);
+  line = sf->data;
+  end = sf->data + done;
+  while (line < end)
+    {
+      char *lf;
+      size_t len, i;
+
+      lf = memchr (line, '\n', end - line);
+      if (!lf)
+        break; /* Incomplete last line. */
+      *lf = '\0';
+      len = lf - line;
+      if (len && line[len - 1] == '\r')
+        line[--len] = '\0'; /* Chop an optional CR. */
+      if (len && lf - line <= SEARCH_FILE_MAX_WORD)
+        {
+          for (i = 0; i < len; i++)
+            line[i] = g_ascii_tolower (line[i]);
+          g_hash_table_add (sf->words, line);
+        }
+      line = lf + 1;
+    }
+
+  sf->dev = st->st_dev;
+  sf->ino = st->st_ino;
+  sf->size = st->st_size;
+  sf->mtime = st->st_mtime;
+  return sf;
+}
+
 /**
  * @brief Search a file for a matching line
  *
  * This is a case insensitive search for a password in a file.  The
- * file is assumed to be a simple LF delimited list of words.
+ * file is assumed to be a simple LF delimited list of words.  It is
+ * loaded into a hash set on first use and loaded again only when its
+ * inode, size or modification time change.
  *
  * @param fname    Name of the file to search.
  * @param password Password to search for.
@@ -169,52 +292,158 @@ is_keyword (char *string, const char *keyword)
 static int
 search_file (const char *fname, const char *password)
 {
-  FILE *fp;
-  int c;
-  char line[256];
+  struct search_file *sf;
+  struct stat st;
+  char *folded;
+  int fd, found;
 
-  fp = fopen (fname, "r");
-  if (!fp)
+  fd = open (fname, O_RDONLY);
+  if (fd < 0)
     return -1;
-
-  while (fgets (line, DIM (line) - 1, fp))
+  if (fstat (fd, &st))
     {
-      size_t len;
+      int save_errno = errno;
+      close (fd);
+      errno = save_errno;
+      return -1;
+    }
 
-      len = strlen (line);
-      if (!len || line[len - 1] != '\n')
-        {
-          /* Incomplete last line or line too long.  Eat until end of
-             line. */
-          while ((c = getc (fp)) != EOF && c != '\n')
-            ;
-          continue;
-        }
-      line[--len] = 0; /* Chop the LF. */
-      if (len && line[len - 1] == '\r')
-        line[--len] = 0; /* Chop an optional CR. */
-      if (!len)
-        continue; /* Empty */
-      if (!g_ascii_strcasecmp (line, password))
+  G_LOCK (search_files);
+  if (!search_files)
+    search_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          search_file_free);
+  sf = g_hash_table_lookup (search_files, fname);
+  if (!sf || sf->dev != st.st_dev || sf->ino != st.st_ino
+      || sf->size != st.st_size || sf->mtime != st.st_mtime)
+    {
+      sf = search_file_load (fd, &st);
+      if (!sf)
         {
-          fclose (fp);
-          return 1; /* Found.  */
+          int save_errno = errno;
+          G_UNLOCK (search_files);
+          close (fd);
+          errno = save_errno;
+          return -1; /* Read error.  */
         }
+      g_hash_table_replace (search_files, g_strdup (fname), sf);
     }
-  if (ferror (fp))
-    {
-      int save_errno = errno;
-      fclose (fp);
-      errno = save_errno;
-      return -1; /* Read error.  */
-    }
-  fclose (fp);
-  return 0; /* Not found.  */
+  close (fd);
+
+  folded = g_ascii_strdown (password, -1);
+  found = g_hash_table_contains (sf->words, folded);
+  G_UNLOCK (search_files);
+  g_free (folded);
+  return found;
+}
+
+/**
+ * @brief Kinds of compiled pattern file rules.
+ */
+enum pwpolicy_rule_type
+{
+  RULE_STRING,   /**< Simple string. */
+  RULE_REGEX,    /**< Regular expression. */
+  RULE_SEARCH,   /**< #+search processing instruction. */
+  RULE_USERNAME, /**< #+username processing instruction. */
+  RULE_ERROR     /**< Broken line, fails the check when reached. */
+};
+
+/**
+ * @brief One compiled line of the pattern file.
+ */
+struct pwpolicy_rule
+{
+  enum pwpolicy_rule_type type; /**< Kind of rule. */
+  int lineno;                   /**< Line of the rule in the pattern file. */
+  char *value;     /**< String, search file name or error message. */
+  char *desc;      /**< Description in effect for the rule, or NULL. */
+  GRegex *regex;   /**< Compiled regular expression, NULL if invalid. */
+  gboolean invert; /**< Whether a regular expression must match. */
+};
+
+/**
+ * @brief The compiled pattern file.
+ */
+struct pwpolicy
+{
+  GPtrArray *rules; /**< Rules in file order. */
+  dev_t dev;        /**< Device of the compiled file. */
+  ino_t ino;        /**< Inode of the compiled file. */
+  off_t size;       /**< Size of the compiled file. */
+  time_t mtime;     /**< Modification time of the compiled file. */
+};
+
+/**
+ * @brief Cached compiled pattern file, NULL if not compiled yet.
+ */
+static struct pwpolicy *pwpolicy = NULL;
+
+/**
+ * @brief Lock for pwpolicy.
+ */
+G_LOCK_DEFINE_STATIC (pwpolicy);
+
+/**
+ * @brief Free a compiled rule.
+ *
+ * @param data  The rule.
+ */
+static void
+pwpolicy_rule_free (gpointer data)
+{
+  struct pwpolicy_rule *rule = data;
+
+  if (rule->regex)
+    g_regex_unref (rule->regex);
+  g_free (rule->value);
+  g_free (rule->desc);
+  g_free (rule);
+}
+
+/**
+ * @brief Free a compiled pattern file.
+ *
+ * @param policy  The compiled pattern file.
+ */
+static void
+pwpolicy_free (struct pwpolicy *policy)
+{
+  if (!policy)
+    return;
+  g_ptr_array_free (policy->rules, TRUE);
+  g_free (policy);
+}
+
+/**
+ * @brief Add a rule to a compiled pattern file.
+ *
+ * @param policy  The compiled pattern file.
+ * @param type    Kind of rule.
+ * @param lineno  Line of the rule.
+ * @param value   String of the rule, copied.
+ * @param desc    Current description or NULL, copied.
+ *
+ * @return The new rule.
+ */
+static struct pwpolicy_rule *
+pwpolicy_add_rule (struct pwpolicy *policy, enum pwpolicy_rule_type type,
+                   int lineno, const char *value, const char *desc)
+{
+  struct pwpolicy_rule *rule;
+
+  rule = g_malloc0 (sizeof (*rule));
+  rule->type = type;
+  rule->lineno = lineno;
+  rule->value = g_strdup (value);
+  rule->desc = g_strdup (desc);
+  g_ptr_array_add (policy->rules, rule);
+  return rule;
 }
 
 /**
- * @brief Parse one line of a pettern file
+ * @brief Compile one line of a pattern file
  *
+ * @param policy   The compiled pattern file to add the rule to.
  * @param line     A null terminated buffer with the content of the line.
  *                 The line terminator has already been stripped. It may
  *                 be modified after return.
@@ -222,17 +451,11 @@ search_file (const char *fname, const char *password)
  * @param lineno   The current line number for error reporting
  * @param descp    Pointer to a variable holding the current description
  *                 string or NULL for no description.
- * @param password The password to check.
- * @param username The username to check.
- *
- * @return NULL on success or a malloced string with an error
- *         description.
  */
-static char *
-parse_pattern_line (char *line, const char *fname, int lineno, char **descp,
-                    const char *password, const char *username)
+static void
+compile_pattern_line (struct pwpolicy *policy, char *line, const char *fname,
+                      int lineno, char **descp)
 {
-  char *ret = NULL;
   char *p;
   size_t n;
 
@@ -241,9 +464,7 @@ parse_pattern_line (char *line, const char *fname, int lineno, char **descp,
     line++;
 
   if (!*line) /* Empty line.  */
-    {
-      ret = NULL;
-    }
+    ;
   else if (*line == '#' && line[1] == '+') /* Processing instruction.  */
     {
       line += 2;
@@ -261,89 +482,172 @@ parse_pattern_line (char *line, const char *fname, int lineno, char **descp,
           *descp = NULL;
         }
       else if ((p = is_keyword (line, "search")))
-        {
-          int sret;
-
-          sret = search_file (p, password);
-          if (sret == -1)
-            {
-              g_warning ("error searching '%s' (requested at line %d): %s", p,
-                         lineno, g_strerror (errno));
-              ret = policy_checking_failed ();
-            }
-          else if (sret && *descp)
-            ret = g_strdup_printf ("Weak password (%s)", *descp);
-          else if (sret)
-            ret = g_strdup_printf ("Weak password (found in '%s')", p);
-          else
-            ret = NULL;
-        }
+        pwpolicy_add_rule (policy, RULE_SEARCH, lineno, p, *descp);
       else if (is_keyword (line, "username"))
-        {
-          /* Fixme: The include check is case sensitive and the strcmp
-             does only work with ascii.  Changing this required a bit
-             more more (g_utf8_casefold) and also requires checking
-             for valid utf8 sequences in the password and all pattern.  */
-          if (!username)
-            ret = NULL;
-          else if (!g_ascii_strcasecmp (password, username))
-            ret = g_strdup_printf ("Weak password (%s)",
-                                   "user name matches password");
-          else if (strstr (password, username))
-            ret = g_strdup_printf ("Weak password (%s)",
-                                   "user name is part of the password");
-          else if (strstr (username, password))
-            ret = g_strdup_printf ("Weak password (%s)",
-                                   "password is part of the user name");
-          else
-            ret = NULL;
-        }
+        pwpolicy_add_rule (policy, RULE_USERNAME, lineno, NULL, NULL);
       else
-        {
-          g_warning ("error reading '%s', line %d: %s", fname, lineno,
-                     "unknown processing instruction");
-          ret = policy_checking_failed ();
-        }
+        pwpolicy_add_rule (policy, RULE_ERROR, lineno,
+                           "unknown processing instruction", NULL);
     }
   else if (*line == '#') /* Comment */
-    {
-      ret = NULL;
-    }
+    ;
   else if (*line == '/'
            || (*line == '!' && line[1] == '/')) /* Regular expression.  */
     {
+      struct pwpolicy_rule *rule;
+      GError *error = NULL;
       int rev = (*line == '!');
+
       if (rev)
         line++;
       line++;
       n = strlen (line);
       if (n && line[n - 1] == '/')
         line[n - 1] = 0;
-      if (((!g_regex_match_simple (line, password, G_REGEX_CASELESS, 0)) ^ rev))
-        ret = NULL;
-      else if (*descp)
-        ret = g_strdup_printf ("Weak password (%s)", *descp);
-      else
-        ret =
-          g_strdup_printf ("Weak password (see '%s' line %d)", fname, lineno);
+      rule = pwpolicy_add_rule (policy, RULE_REGEX, lineno, line, *descp);
+      rule->invert = rev;
+      rule->regex = g_regex_new (line, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0,
+                                 &error);
+      if (!rule->regex)
+        {
+          /* Never matches, as with g_regex_match_simple before.  */
+          g_warning ("error reading '%s', line %d: %s", fname, lineno,
+                     error->message);
+          g_error_free (error);
+        }
     }
   else /* Simple string.  */
+    pwpolicy_add_rule (policy, RULE_STRING, lineno, line, *descp);
+}
+
+/**
+ * @brief Compile the pattern file.
+ *
+ * A line that cannot be read is compiled into a final rule that fails
+ * the check, so that the rules before it still apply first.
+ *
+ * @param fp     The opened pattern file.
+ * @param fname  The name of the pattern file for error reporting.
+ *
+ * @return The compiled pattern file.
+ */
+static struct pwpolicy *
+compile_pattern_file (FILE *fp, const char *fname)
+{
+  struct pwpolicy *policy;
+  int lineno;
+  char line[256];
+  char *desc = NULL;
+
+  policy = g_malloc0 (sizeof (*policy));
+  policy->rules = g_ptr_array_new_with_free_func (pwpolicy_rule_free);
+  lineno = 0;
+  while (fgets (line, DIM (line) - 1, fp))
     {
-      if (g_ascii_strcasecmp (line, password))
-        ret = NULL;
-      else if (*descp)
-        ret = g_strdup_printf ("Weak password (%s)", *descp);
-      else
-        ret =
-          g_strdup_printf ("Weak password (see '%s' line %d)", fname, lineno);
+      size_t len;
+
+      lineno++;
+      len = strlen (line);
+      if (!len || line[len - 1] != '\n')
+        {
+          pwpolicy_add_rule (policy, RULE_ERROR, lineno,
+                             len ? "line too long" : "line without a LF",
+                             NULL);
+          break;
+        }
+      line[--len] = 0; /* Chop the LF. */
+      if (len && line[len - 1] == '\r')
+        line[--len] = 0; /* Chop an optional CR. */
+      compile_pattern_line (policy, line, fname, lineno, &desc);
+
+      bzero (line, sizeof (line));
     }
 
-  return ret;
+  g_free (desc);
+  return policy;
+}
+
+/**
+ * @brief Check a password against one compiled rule
+ *
+ * @param rule     The rule.
+ * @param fname    The name of the pattern file for error reporting
+ * @param password The password to check.
+ * @param username The username to check.
+ *
+ * @return NULL on success or a malloced string with an error
+ *         description.
+ */
+static char *
+check_rule (const struct pwpolicy_rule *rule, const char *fname,
+            const char *password, const char *username)
+{
+  gboolean matched;
+  int sret;
+
+  switch (rule->type)
+    {
+    case RULE_SEARCH:
+      sret = search_file (rule->value, password);
+      if (sret == -1)
+        {
+          g_warning ("error searching '%s' (requested at line %d): %s",
+                     rule->value, rule->lineno, g_strerror (errno));
+          return policy_checking_failed ();
+        }
+      else if (sret && rule->desc)
+        return g_strdup_printf ("Weak password (%s)", rule->desc);
+      else if (sret)
+        return g_strdup_printf ("Weak password (found in '%s')", rule->value);
+      return NULL;
+
+    case RULE_USERNAME:
+      /* Fixme: The include check is case sensitive and the strcmp
+         does only work with ascii.  Changing this required a bit
+         more more (g_utf8_casefold) and also requires checking
+         for valid utf8 sequences in the password and all pattern.  */
+      if (!username)
+        return NULL;
+      else if (!g_ascii_strcasecmp (password, username))
+        return g_strdup_printf ("Weak password (%s)",
+                                "user name matches password");
+      else if (strstr (password, username))
+        return g_strdup_printf ("Weak password (%s)",
+                                "user name is part of the password");
+      else if (strstr (username, password))
+        return g_strdup_printf ("Weak password (%s)",
+                                "password is part of the user name");
+      return NULL;
+
+    case RULE_ERROR:
+      g_warning ("error reading '%s', line %d: %s", fname, rule->lineno,
+                 rule->value);
+      return policy_checking_failed ();
+
+    case RULE_REGEX:
+      matched = rule->regex && g_regex_match (rule->regex, password, 0, NULL);
+      if (!matched ^ rule->invert)
+        return NULL;
+      break;
+
+    case RULE_STRING:
+      if (g_ascii_strcasecmp (rule->value, password))
+        return NULL;
+      break;
+    }
+
+  if (rule->desc)
+    return g_strdup_printf ("Weak password (%s)", rule->desc);
+  return g_strdup_printf ("Weak password (see '%s' line %d)", fname,
+                          rule->lineno);
 }
 
 /**
  * @brief Validate a password against the pattern file
  *
+ * The pattern file is compiled on first use and compiled again only when
+ * its inode, size or modification time change.
+ *
  * @param[in] password  The password to check
  * @param[in] username  The user name or NULL.  This is used to check
  *                      the passphrase against the user name.
@@ -357,9 +661,8 @@ gvm_validate_password (const char *password, const char *username)
   const char *patternfile = PWPOLICY_FILE_NAME;
   char *ret;
   FILE *fp;
-  int lineno;
-  char line[256];
-  char *desc = NULL;
+  struct stat st;
+  guint i;
 
   if (disable_password_policy)
     return NULL;
@@ -368,39 +671,32 @@ gvm_validate_password (const char *password, const char *username)
     return g_strdup ("Empty password");
 
   fp = fopen (patternfile, "r");
-  if (!fp)
+  if (!fp || fstat (fileno (fp), &st))
     {
       g_warning ("error opening '%s': %s", patternfile, g_strerror (errno));
+      if (fp)
+        fclose (fp);
       return policy_checking_failed ();
     }
-  lineno = 0;
-  ret = NULL;
-  while (fgets (line, DIM (line) - 1, fp))
-    {
-      size_t len;
 
-      lineno++;
-      len = strlen (line);
-      if (!len || line[len - 1] != '\n')
-        {
-          g_warning ("error reading '%s', line %d: %s", patternfile, lineno,
-                     len ? "line too long" : "line without a LF");
-          ret = policy_checking_failed ();
-          break;
-        }
-      line[--len] = 0; /* Chop the LF. */
-      if (len && line[len - 1] == '\r')
-        line[--len] = 0; /* Chop an optional CR. */
-      ret = parse_pattern_line (line, patternfile, lineno, &desc, password,
-                                username);
-      if (ret)
-        break;
-
-      bzero (line, sizeof (line));
+  G_LOCK (pwpolicy);
+  if (!pwpolicy || pwpolicy->dev != st.st_dev || pwpolicy->ino != st.st_ino
+      || pwpolicy->size != st.st_size || pwpolicy->mtime != st.st_mtime)
+    {
+      pwpolicy_free (pwpolicy);
+      pwpolicy = compile_pattern_file (fp, patternfile);
+      pwpolicy->dev = st.st_dev;
+      pwpolicy->ino = st.st_ino;
+      pwpolicy->size = st.st_size;
+      pwpolicy->mtime = st.st_mtime;
     }
-
   fclose (fp);
-  g_free (desc);
+
+  ret = NULL;
+  for (i = 0; i < pwpolicy->rules->len && !ret; i++)
+    ret = check_rule (g_ptr_array_index (pwpolicy->rules, i), patternfile,
+                      password, username);
+  G_UNLOCK (pwpolicy);
   return ret;
 }
 
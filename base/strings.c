@@ -25,7 +25,173 @@
 #include "strings.h"
 
 #include <assert.h> /* for assert */
-#include <glib.h>   /* for g_free, g_strconcat, gchar, g_strdup, g_strndup */
+#include <glib.h>   /* for g_free, g_realloc, gchar, g_strdup, g_strndup */
+#include <string.h> /* for memcpy, memset, strlen */
+
+/**
+ * @brief Smallest buffer a string builder allocates.
+ */
+#define STRBUF_MIN_SIZE 64
+
+/**
+ * @brief memset that the compiler may not drop as a dead store.
+ */
+static void *(*volatile secure_memset) (void *, int, size_t) = memset;
+
+/**
+ * @brief Overwrite memory with zeros, e.g. before freeing a secret.
+ *
+ * Unlike a plain memset this is not optimised away when the memory is
+ * freed right afterwards.
+ *
+ * @param[in]  mem     The memory.  May be NULL.
+ * @param[in]  length  Number of bytes to zero.
+ */
+void
+gvm_secure_zero (void *mem, gsize length)
+{
+  if (mem)
+    secure_memset (mem, 0, length);
+}
+
+/**
+ * @brief Initialise an empty string builder.
+ *
+ * @param[out] buf     The builder.
+ * @param[in]  secure  Whether to zero the contents whenever a buffer is
+ *                     released, for builders that hold secrets.
+ */
+void
+gvm_strbuf_init (gvm_strbuf_t *buf, int secure)
+{
+  buf->str = NULL;
+  buf->len = 0;
+  buf->size = 0;
+  buf->secure = secure;
+}
+
+/**
+ * @brief Release the buffer of a string builder, zeroing it if secure.
+ *
+ * @param[in]  buf  The builder.
+ */
+static void
+strbuf_release (gvm_strbuf_t *buf)
+{
+  if (buf->secure)
+    gvm_secure_zero (buf->str, buf->size);
+  g_free (buf->str);
+}
+
+/**
+ * @brief Make a string builder take over an existing string.
+ *
+ * Any previous contents of the builder are freed.
+ *
+ * @param[in]  buf     The builder.
+ * @param[in]  string  Dynamically allocated string, or NULL.  The builder
+ *                     takes ownership of it.
+ */
+void
+gvm_strbuf_adopt (gvm_strbuf_t *buf, gchar *string)
+{
+  strbuf_release (buf);
+  buf->str = string;
+  buf->len = string ? strlen (string) : 0;
+  buf->size = string ? buf->len + 1 : 0;
+}
+
+/**
+ * @brief Append a string of a known length to a string builder.
+ *
+ * The string does not have to be NULL terminated.
+ *
+ * @param[in]  buf     The builder.
+ * @param[in]  string  The string to append.
+ * @param[in]  length  The length of string.
+ */
+void
+gvm_strbuf_append_text (gvm_strbuf_t *buf, const gchar *string, gsize length)
+{
+  gsize needed;
+
+  needed = buf->len + length + 1;
+  if (needed > buf->size)
+    {
+      gsize size;
+
+      size = buf->size < STRBUF_MIN_SIZE ? STRBUF_MIN_SIZE : buf->size;
+      while (size < needed)
+        size *= 2;
+
+      if (buf->secure)
+        {
+          gchar *str;
+
+          /* Copy by hand, realloc would leave the old buffer behind. */
+          str = g_malloc (size);
+          if (buf->str)
+            memcpy (str, buf->str, buf->len);
+          strbuf_release (buf);
+          buf->str = str;
+        }
+      else
+        buf->str = g_realloc (buf->str, size);
+      buf->size = size;
+    }
+
+  memcpy (buf->str + buf->len, string, length);
+  buf->len += length;
+  buf->str[buf->len] = '\0';
+}
+
+/**
+ * @brief Append a string to a string builder.
+ *
+ * @param[in]  buf     The builder.
+ * @param[in]  string  The NULL terminated string to append.
+ */
+void
+gvm_strbuf_append (gvm_strbuf_t *buf, const gchar *string)
+{
+  gvm_strbuf_append_text (buf, string, strlen (string));
+}
+
+/**
+ * @brief Take the string out of a string builder.
+ *
+ * The builder is left empty and can be reused.
+ *
+ * @param[in]  buf  The builder.
+ *
+ * @return The built string, or NULL if nothing was appended.  Free with
+ *         g_free.
+ */
+gchar *
+gvm_strbuf_steal (gvm_strbuf_t *buf)
+{
+  gchar *str;
+
+  str = buf->str;
+  buf->str = NULL;
+  buf->len = 0;
+  buf->size = 0;
+  return str;
+}
+
+/**
+ * @brief Free the contents of a string builder.
+ *
+ * The builder is left empty and can be reused.
+ *
+ * @param[in]  buf  The builder.
+ */
+void
+gvm_strbuf_free (gvm_strbuf_t *buf)
+{
+  strbuf_release (buf);
+  gvm_strbuf_steal (buf);
+}
 
 /**
  * @brief Append a string to a string variable.
@@ -36,6 +202,9 @@
  * string that is the concatenation of the two, freeing the old string.  It is
  * up to the caller to free the given string if it was dynamically allocated.
  *
+ * Each call copies the whole variable, use a gvm_strbuf_t to build a string
+ * from many pieces.
+ *
  * @param[in]  var     The address of a string variable, that is, a pointer to
  *                     a string.
  * @param[in]  string  The string to append to the string in the variable.
@@ -44,11 +213,7 @@ void
 gvm_append_string (gchar **var, const gchar *string)
 {
   if (*var)
-    {
-      char *old = *var;
-      *var = g_strconcat (old, string, NULL);
-      g_free (old);
-    }
+    gvm_append_text (var, string, strlen (string));
   else
     *var = g_strdup (string);
 }
@@ -65,6 +230,9 @@ gvm_append_string (gchar **var, const gchar *string)
  * The string must be NULL terminated, and the given length must be the
  * actual length of the string.
  *
+ * Each call may copy the whole variable, use a gvm_strbuf_t to build a
+ * string from many pieces.
+ *
  * @param[in]  var     The address of a string variable, that is, a pointer to
  *                     a string.
  * @param[in]  string  The string to append to the string in the variable.
@@ -75,9 +243,11 @@ gvm_append_text (gchar **var, const gchar *string, gsize length)
 {
   if (*var)
     {
-      char *old = *var;
-      *var = g_strconcat (old, string, NULL);
-      g_free (old);
+      gsize old_length = strlen (*var);
+
+      *var = g_realloc (*var, old_length + length + 1);
+      memcpy (*var + old_length, string, length);
+      (*var)[old_length + length] = '\0';
     }
   else
     *var = g_strndup (string, length);
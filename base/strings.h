@@ -27,6 +27,36 @@
 
 #include <glib.h>
 
+/**
+ * @brief A string builder with amortised appends.
+ *
+ * The buffer grows geometrically, so building a string from N pieces costs
+ * O(N) copies instead of the O(N^2) of repeated gvm_append_string calls.
+ */
+typedef struct
+{
+  gchar *str;  ///< The NULL terminated contents, or NULL when empty.
+  gsize len;   ///< Length of str.
+  gsize size;  ///< Allocated size of str.
+  int secure;  ///< Whether to zero buffers before they are released.
+} gvm_strbuf_t;
+
+void
+gvm_strbuf_init (gvm_strbuf_t *, int);
+void
+gvm_strbuf_adopt (gvm_strbuf_t *, gchar *);
+void
+gvm_strbuf_append (gvm_strbuf_t *, const gchar *);
+void
+gvm_strbuf_append_text (gvm_strbuf_t *, const gchar *, gsize);
+gchar *
+gvm_strbuf_steal (gvm_strbuf_t *);
+void
+gvm_strbuf_free (gvm_strbuf_t *);
+
+void
+gvm_secure_zero (void *, gsize);
+
 void
 gvm_append_string (gchar **, const gchar *);
 void
@@ -0,0 +1,733 @@
+/* Copyright (C) 2019 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * @brief Microbenchmarks of the hot paths of the libraries.
+ *
+ * Each benchmark is calibrated to run for at least the minimum time, then
+ * repeated.  One result is printed per benchmark, as a line of JSON, with the
+ * median, lowest and highest time per operation of the repetitions.
+ *
+ * The NVT cache benchmarks only run when a Redis socket is given.  They add
+ * and delete NVTs under OIDs of their own in the NVT cache of that server.
+ */
+
+#include "../base/hosts.h"        /* for gvm_hosts_new_with_max */
+#include "../base/logging.h"      /* for gvm_log_func */
+#include "../base/networking.h"   /* for port_range_ranges */
+#include "../base/nvti.h"         /* for nvti_new */
+#include "../util/compressutils.h" /* for gvm_compress */
+#include "../util/nvticache.h"    /* for nvticache_add */
+#include "../util/xmlutils.h"     /* for parse_entity */
+
+#include <glib.h>     /* for g_option_context_new */
+#include <stdio.h>    /* for printf */
+#include <stdlib.h>   /* for qsort */
+#include <string.h>   /* for strstr */
+#include <time.h>     /* for clock_gettime */
+#include <unistd.h>   /* for unlink */
+
+/**
+ * @brief Number of NVTs of the NVT cache benchmarks.
+ */
+#define BENCH_NVT_COUNT 2000
+
+/**
+ * @brief OID prefix of the NVTs of the NVT cache benchmarks.
+ */
+#define BENCH_NVT_OID "1.3.6.1.4.1.25623.1.999."
+
+/**
+ * @brief State of a running benchmark.
+ */
+typedef struct
+{
+  gpointer data;    /**< Data of the benchmark. */
+  gint64 elapsed;   /**< Time spent in the timed part, in nanoseconds. */
+  gint64 start;     /**< Start of the timed part, 0 if paused. */
+} bench_t;
+
+/**
+ * @brief Operation of a benchmark.
+ */
+typedef void (*bench_func_t) (bench_t *);
+
+static gchar *filter = NULL;     /**< Substring of the benchmarks to run. */
+static gint min_time = 200;      /**< Minimum time of a repetition, in ms. */
+static gint repetitions = 5;     /**< Number of repetitions. */
+static gchar *kb_path = NULL;    /**< Path of the Redis socket. */
+static gchar *output = NULL;     /**< File to write the results to. */
+
+/**
+ * @brief Get the monotonic time.
+ *
+ * @return Time in nanoseconds.
+ */
+static gint64
+bench_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Stop timing the running benchmark, to exclude its setup.
+ *
+ * @param bench  Running benchmark.
+ */
+static void
+bench_pause (bench_t *bench)
+{
+  if (bench->start)
+    bench->elapsed += bench_now () - bench->start;
+  bench->start = 0;
+}
+
+/**
+ * @brief Start timing the running benchmark again.
+ *
+ * @param bench  Running benchmark.
+ */
+static void
+bench_resume (bench_t *bench)
+{
+  if (bench->start == 0)
+    bench->start = bench_now ();
+}
+
+/**
+ * @brief Run an operation a number of times.
+ *
+ * @param func        Operation.
+ * @param data        Data of the operation.
+ * @param iterations  Number of runs.
+ *
+ * @return Time spent in the timed part, in nanoseconds.
+ */
+static gint64
+bench_loop (bench_func_t func, gpointer data, guint64 iterations)
+{
+  bench_t bench = {data, 0, 0};
+  guint64 i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      bench_resume (&bench);
+      func (&bench);
+    }
+  bench_pause (&bench);
+  return bench.elapsed;
+}
+
+/**
+ * @brief Compare two durations, for qsort.
+ *
+ * @param one  First duration.
+ * @param two  Second duration.
+ *
+ * @return Comparison result.
+ */
+static int
+bench_cmp (const void *one, const void *two)
+{
+  double a = *(const double *) one, b = *(const double *) two;
+
+  return (a > b) - (a < b);
+}
+
+/**
+ * @brief Run a benchmark and print its result.
+ *
+ * @param name   Name of the benchmark.
+ * @param func   Operation.
+ * @param data   Data of the operation.
+ * @param bytes  Bytes processed by an operation, 0 if not relevant.
+ */
+static void
+bench_run (const char *name, bench_func_t func, gpointer data, size_t bytes)
+{
+  guint64 iterations = 1;
+  double *results;
+  gint64 elapsed;
+  int i;
+
+  if (filter && !strstr (name, filter))
+    return;
+
+  /* Warm up, then grow the iterations until a run takes min_time. */
+  elapsed = bench_loop (func, data, 1);
+  while (elapsed < (gint64) min_time * 1000000 && iterations < G_MAXUINT32)
+    {
+      if (elapsed <= 0)
+        iterations *= 10;
+      else
+        iterations = MAX (iterations + 1,
+                          (guint64) (iterations * 1.2 * min_time * 1000000
+                                     / elapsed));
+      elapsed = bench_loop (func, data, iterations);
+    }
+
+  results = g_malloc_n (repetitions, sizeof (double));
+  for (i = 0; i < repetitions; i++)
+    results[i] = (double) bench_loop (func, data, iterations) / iterations;
+  qsort (results, repetitions, sizeof (double), bench_cmp);
+
+  printf ("{\"name\": \"%s\", \"iterations\": %" G_GUINT64_FORMAT
+          ", \"repetitions\": %d, \"ns_per_op\": %.1f, \"ns_per_op_min\": %.1f"
+          ", \"ns_per_op_max\": %.1f",
+          name, iterations, repetitions, results[repetitions / 2], results[0],
+          results[repetitions - 1]);
+  if (bytes)
+    printf (", \"mb_per_s\": %.1f",
+            bytes * 1000.0 / results[repetitions / 2]);
+  printf ("}\n");
+  fflush (stdout);
+  g_free (results);
+}
+
+/**
+ * @brief Print that a benchmark was skipped.
+ *
+ * @param name    Name of the benchmark.
+ * @param reason  Why it was skipped.
+ */
+static void
+bench_skip (const char *name, const char *reason)
+{
+  if (filter && !strstr (name, filter))
+    return;
+  printf ("{\"name\": \"%s\", \"skipped\": \"%s\"}\n", name, reason);
+}
+
+/* Hosts. */
+
+/**
+ * @brief Parse a hosts specification.
+ *
+ * @param bench  Running benchmark, with the specification as data.
+ */
+static void
+bench_hosts_new (bench_t *bench)
+{
+  gvm_hosts_free (gvm_hosts_new_with_max (bench->data, 0));
+}
+
+/**
+ * @brief Exclude hosts from a parsed specification.
+ *
+ * @param bench  Running benchmark, with the two specifications as data.
+ */
+static void
+bench_hosts_exclude (bench_t *bench)
+{
+  char **specs = bench->data;
+  gvm_hosts_t *hosts;
+
+  bench_pause (bench);
+  hosts = gvm_hosts_new_with_max (specs[0], 0);
+  bench_resume (bench);
+  gvm_hosts_exclude (hosts, specs[1]);
+  bench_pause (bench);
+  gvm_hosts_free (hosts);
+}
+
+/**
+ * @brief Run the hosts benchmarks.
+ */
+static void
+bench_hosts (void)
+{
+  GString *list;
+  char *exclude[2];
+  int i;
+
+  bench_run ("hosts/new_with_max/ipv4_cidr16", bench_hosts_new,
+             "10.0.0.0/16", 0);
+  bench_run ("hosts/new_with_max/ipv4_ranges", bench_hosts_new,
+             "192.168.0-255.1-254", 0);
+  bench_run ("hosts/new_with_max/ipv6_cidr112", bench_hosts_new,
+             "2001:db8::/112", 0);
+
+  /* Deduplication is part of the parsing, so it is measured on a list
+   * where every address is given twice. */
+  list = g_string_new (NULL);
+  for (i = 0; i < 20000; i++)
+    g_string_append_printf (list, "%s10.%d.%d.%d", i ? "," : "",
+                            (i / 2) >> 16 & 255, (i / 2) >> 8 & 255,
+                            (i / 2) & 255);
+  bench_run ("hosts/new_with_max/ipv4_list_duplicates", bench_hosts_new,
+             list->str, 0);
+  g_string_free (list, TRUE);
+
+  exclude[0] = "10.0.0.0/16";
+  exclude[1] = "10.0.0.0/17,10.0.200.0-10.0.210.255";
+  bench_run ("hosts/exclude/ipv4_cidr16", bench_hosts_exclude, exclude, 0);
+  exclude[0] = "2001:db8::/112";
+  exclude[1] = "2001:db8::/113";
+  bench_run ("hosts/exclude/ipv6_cidr112", bench_hosts_exclude, exclude, 0);
+}
+
+/* Ports. */
+
+/**
+ * @brief Parse a port range.
+ *
+ * @param bench  Running benchmark, with the port range as data.
+ */
+static void
+bench_port_range_ranges (bench_t *bench)
+{
+  array_free (port_range_ranges (bench->data));
+}
+
+/**
+ * @brief Look up all the TCP ports in parsed port ranges.
+ *
+ * @param bench  Running benchmark, with the ranges as data.
+ */
+static void
+bench_port_in_port_ranges (bench_t *bench)
+{
+  int port, found = 0;
+
+  for (port = 1; port <= 65535; port++)
+    found += port_in_port_ranges (port, PORT_PROTOCOL_TCP, bench->data);
+  if (found < 0)
+    abort ();
+}
+
+/**
+ * @brief Run the ports benchmarks.
+ */
+static void
+bench_ports (void)
+{
+  GString *spec;
+  array_t *ranges;
+  int port;
+
+  bench_run ("ports/port_range_ranges/full", bench_port_range_ranges,
+             "T:1-65535,U:1-65535", 0);
+
+  /* A port list with many small ranges, like the default lists. */
+  spec = g_string_new ("T:");
+  for (port = 1; port < 65535; port += 7)
+    g_string_append_printf (spec, "%s%d-%d", port > 1 ? "," : "", port,
+                            port + 2);
+  g_string_append (spec, ",U:53,67-69,123,161-162,500,514,1900,5353");
+  bench_run ("ports/port_range_ranges/many", bench_port_range_ranges,
+             spec->str, 0);
+
+  ranges = port_range_ranges (spec->str);
+  bench_run ("ports/port_in_port_ranges/all_tcp", bench_port_in_port_ranges,
+             ranges, 0);
+  array_free (ranges);
+  g_string_free (spec, TRUE);
+}
+
+/* XML. */
+
+/**
+ * @brief Build a GMP response of a given size.
+ *
+ * @param size  Minimum size in bytes.
+ *
+ * @return The response.
+ */
+static GString *
+bench_gmp_response (size_t size)
+{
+  GString *xml;
+  int i;
+
+  xml = g_string_new ("<get_results_response status=\"200\""
+                      " status_text=\"OK\">");
+  for (i = 0; xml->len < size; i++)
+    g_string_append_printf (
+      xml,
+      "<result id=\"%08x-1c1b-4b4a-9a1c-%012d\">"
+      "<name>Test result %d</name>"
+      "<owner><name>admin</name></owner>"
+      "<host>10.0.%d.%d<asset asset_id=\"%08x\"/></host>"
+      "<port>%d/tcp</port>"
+      "<nvt oid=\"1.3.6.1.4.1.25623.1.0.%d\"><type>nvt</type>"
+      "<name>Check &amp; report %d</name><family>General</family>"
+      "<cvss_base>%d.0</cvss_base>"
+      "<tags>cvss_base_vector=AV:N/AC:L/Au:N/C:P/I:P/A:P|summary=Summary"
+      " of the test &lt;%d&gt;|solution_type=VendorFix</tags></nvt>"
+      "<threat>Medium</threat><severity>%d.0</severity>"
+      "<description>Installed version: %d.%d\n"
+      "Fixed version: %d.%d\n</description></result>",
+      i, i, i, i / 256 % 256, i % 256, i, i % 65535 + 1, 100000 + i, i,
+      i % 10, i, i % 10, i % 7, i % 13, i % 7, i % 13 + 1);
+  g_string_append (xml, "</get_results_response>");
+  return xml;
+}
+
+/**
+ * @brief Parse an XML document.
+ *
+ * @param bench  Running benchmark, with the document as data.
+ */
+static void
+bench_parse_entity (bench_t *bench)
+{
+  entity_t entity = NULL;
+
+  if (parse_entity (bench->data, &entity))
+    abort ();
+  bench_pause (bench);
+  free_entity (entity);
+}
+
+/**
+ * @brief Parse an XML document into an arena.
+ *
+ * @param bench  Running benchmark, with the document as data.
+ */
+static void
+bench_parse_entity_arena (bench_t *bench)
+{
+  entity_t entity = NULL;
+
+  if (parse_entity_arena (bench->data, &entity))
+    abort ();
+  bench_pause (bench);
+  free_entity (entity);
+}
+
+/**
+ * @brief Run the XML benchmarks.
+ */
+static void
+bench_xml (void)
+{
+  GString *xml;
+
+  xml = bench_gmp_response (4 * 1024 * 1024);
+  bench_run ("xml/parse_entity/gmp_4mb", bench_parse_entity, xml->str,
+             xml->len);
+  bench_run ("xml/parse_entity_arena/gmp_4mb", bench_parse_entity_arena,
+             xml->str, xml->len);
+  g_string_free (xml, TRUE);
+}
+
+/* Compression. */
+
+/**
+ * @brief Compress a buffer.
+ *
+ * @param bench  Running benchmark, with the buffer as data.
+ */
+static void
+bench_compress (bench_t *bench)
+{
+  GString *buffer = bench->data;
+  unsigned long len;
+
+  g_free (gvm_compress (buffer->str, buffer->len, &len));
+}
+
+/**
+ * @brief Run the compression benchmarks.
+ */
+static void
+bench_compression (void)
+{
+  GString *xml;
+
+  xml = bench_gmp_response (4 * 1024 * 1024);
+  bench_run ("compress/gvm_compress/gmp_4mb", bench_compress, xml, xml->len);
+  g_string_free (xml, TRUE);
+}
+
+/* Logging. */
+
+/**
+ * @brief Log a batch of messages.
+ *
+ * @param bench  Running benchmark, with the log configuration as data.
+ */
+static void
+bench_log_func (bench_t *bench)
+{
+  int i;
+
+  for (i = 0; i < 1000; i++)
+    gvm_log_func ("bench", G_LOG_LEVEL_MESSAGE,
+                  "Benchmark message with some average length text",
+                  bench->data);
+}
+
+/**
+ * @brief Run the logging benchmarks.
+ */
+static void
+bench_logging (void)
+{
+  GSList *config;
+  char *conf_file, *log_file, *contents;
+  int fd;
+
+  fd = g_file_open_tmp ("gvm-bench-XXXXXX.log", &log_file, NULL);
+  if (fd < 0)
+    {
+      bench_skip ("log/gvm_log_func/file_1000", "no temporary file");
+      return;
+    }
+  close (fd);
+  fd = g_file_open_tmp ("gvm-bench-XXXXXX.conf", &conf_file, NULL);
+  if (fd < 0)
+    {
+      bench_skip ("log/gvm_log_func/file_1000", "no temporary file");
+      unlink (log_file);
+      g_free (log_file);
+      return;
+    }
+  close (fd);
+  contents = g_strdup_printf ("[bench]\nprepend=%%t %%s %%p\n"
+                              "prepend_time_format=%%Y-%%m-%%d %%Hh%%M.%%S"
+                              " %%Z\nfile=%s\nlevel=128\n",
+                              log_file);
+  g_file_set_contents (conf_file, contents, -1, NULL);
+  g_free (contents);
+
+  config = load_log_configuration (conf_file);
+  bench_run ("log/gvm_log_func/file_1000", bench_log_func, config, 0);
+  free_log_configuration (config);
+
+  unlink (conf_file);
+  unlink (log_file);
+  g_free (conf_file);
+  g_free (log_file);
+}
+
+/* NVT cache. */
+
+/**
+ * @brief Build a NVT Info for the NVT cache benchmarks.
+ *
+ * @param i  Number of the NVT.
+ *
+ * @return NVT Info.
+ */
+static nvti_t *
+bench_nvti (int i)
+{
+  nvti_t *nvti;
+  char *str;
+
+  nvti = nvti_new ();
+  str = g_strdup_printf (BENCH_NVT_OID "%d", i);
+  nvti_set_oid (nvti, str);
+  g_free (str);
+  str = g_strdup_printf ("Benchmark NVT %d", i);
+  nvti_set_name (nvti, str);
+  g_free (str);
+  nvti_set_tag (nvti, "cvss_base_vector=AV:N/AC:L/Au:N/C:P/I:P/A:P|summary="
+                      "Benchmark NVT|solution_type=VendorFix");
+  nvti_set_dependencies (nvti, "find_service.nasl, gb_bench_detect.nasl");
+  nvti_set_required_keys (nvti, "bench/installed");
+  nvti_set_required_ports (nvti, "Services/www, 80");
+  nvti_set_family (nvti, "General");
+  nvti_set_category (nvti, 3);
+  nvti_set_timeout (nvti, 0);
+  nvti_add_refs (nvti, "cve", "CVE-2019-0001, CVE-2019-0002", "");
+  nvti_add_refs (nvti, "url", "https://example.com/advisory", "");
+  nvti_add_pref (nvti, nvtpref_new (1, "Login", "entry", ""));
+  nvti_add_pref (nvti, nvtpref_new (2, "Password", "password", ""));
+  return nvti;
+}
+
+/**
+ * @brief Add the NVTs of the NVT cache benchmarks.
+ *
+ * @param bench  Running benchmark, with the NVT Infos as data.
+ */
+static void
+bench_nvticache_add (bench_t *bench)
+{
+  nvti_t **nvtis = bench->data;
+  char filename[64];
+  int i;
+
+  for (i = 0; i < BENCH_NVT_COUNT; i++)
+    {
+      g_snprintf (filename, sizeof (filename), "bench/bench_%d.nasl", i);
+      nvticache_add (nvtis[i], filename);
+    }
+}
+
+/**
+ * @brief Get single fields of the NVTs of the NVT cache benchmarks.
+ *
+ * @param bench  Running benchmark, with the NVT Infos as data.
+ */
+static void
+bench_nvticache_get_fields (bench_t *bench)
+{
+  nvti_t **nvtis = bench->data;
+  int i;
+
+  for (i = 0; i < BENCH_NVT_COUNT; i++)
+    {
+      const char *oid = nvti_oid (nvtis[i]);
+
+      g_free (nvticache_get_name (oid));
+      g_free (nvticache_get_family (oid));
+      nvticache_get_category (oid);
+    }
+}
+
+/**
+ * @brief Get the preferences of the NVTs of the NVT cache benchmarks.
+ *
+ * @param bench  Running benchmark, with the NVT Infos as data.
+ */
+static void
+bench_nvticache_get_prefs (bench_t *bench)
+{
+  nvti_t **nvtis = bench->data;
+  int i;
+
+  for (i = 0; i < BENCH_NVT_COUNT; i++)
+    g_slist_free_full (nvticache_get_prefs (nvti_oid (nvtis[i])),
+                       (GDestroyNotify) nvtpref_free);
+}
+
+/**
+ * @brief Get the NVTs of the NVT cache benchmarks.
+ *
+ * @param bench  Running benchmark, with the NVT Infos as data.
+ */
+static void
+bench_nvticache_get_nvt (bench_t *bench)
+{
+  nvti_t **nvtis = bench->data;
+  int i;
+
+  for (i = 0; i < BENCH_NVT_COUNT; i++)
+    nvti_free (nvticache_get_nvt (nvti_oid (nvtis[i])));
+}
+
+/**
+ * @brief Run the NVT cache benchmarks.
+ */
+static void
+bench_nvticache (void)
+{
+  nvti_t *nvtis[BENCH_NVT_COUNT];
+  char *src;
+  int i;
+
+  if (kb_path == NULL)
+    {
+      bench_skip ("nvticache/add", "no --kb-path");
+      bench_skip ("nvticache/get_fields", "no --kb-path");
+      bench_skip ("nvticache/get_prefs", "no --kb-path");
+      bench_skip ("nvticache/get_nvt", "no --kb-path");
+      return;
+    }
+
+  src = g_dir_make_tmp ("gvm-bench-XXXXXX", NULL);
+  if (src == NULL || nvticache_init (src, kb_path))
+    {
+      bench_skip ("nvticache/add", "no NVT cache");
+      g_free (src);
+      return;
+    }
+  for (i = 0; i < BENCH_NVT_COUNT; i++)
+    nvtis[i] = bench_nvti (i);
+
+  bench_run ("nvticache/add", bench_nvticache_add, nvtis, 0);
+  bench_run ("nvticache/get_fields", bench_nvticache_get_fields, nvtis, 0);
+  bench_run ("nvticache/get_prefs", bench_nvticache_get_prefs, nvtis, 0);
+  bench_run ("nvticache/get_nvt", bench_nvticache_get_nvt, nvtis, 0);
+
+  for (i = 0; i < BENCH_NVT_COUNT; i++)
+    {
+      nvticache_delete (nvti_oid (nvtis[i]));
+      nvti_free (nvtis[i]);
+    }
+  g_rmdir (src);
+  g_free (src);
+}
+
+/**
+ * @brief Run the benchmarks.
+ *
+ * @param argc  Number of arguments.
+ * @param argv  Arguments.
+ *
+ * @return 0 on success, 1 on usage error.
+ */
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  static GOptionEntry entries[] = {
+    {"filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+     "Only run the benchmarks whose name contains <string>", "<string>"},
+    {"min-time", 't', 0, G_OPTION_ARG_INT, &min_time,
+     "Minimum time of a repetition, in milliseconds (default 200)", "<ms>"},
+    {"repetitions", 'r', 0, G_OPTION_ARG_INT, &repetitions,
+     "Number of repetitions (default 5)", "<number>"},
+    {"kb-path", 'k', 0, G_OPTION_ARG_STRING, &kb_path,
+     "Redis socket for the NVT cache benchmarks", "<path>"},
+    {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+     "Write the results to <file> instead of the standard output", "<file>"},
+    {NULL, 0, 0, 0, NULL, NULL, NULL}};
+
+  context = g_option_context_new ("- run the libgvm benchmarks");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      g_error_free (error);
+      g_option_context_free (context);
+      return 1;
+    }
+  g_option_context_free (context);
+  if (min_time <= 0 || repetitions <= 0)
+    {
+      fprintf (stderr, "--min-time and --repetitions must be positive\n");
+      return 1;
+    }
+  if (output && freopen (output, "w", stdout) == NULL)
+    {
+      perror (output);
+      return 1;
+    }
+
+  bench_hosts ();
+  bench_ports ();
+  bench_xml ();
+  bench_compression ();
+  bench_logging ();
+  bench_nvticache ();
+
+  g_free (filter);
+  g_free (kb_path);
+  g_free (output);
+  return 0;
+}
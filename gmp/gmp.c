@@ -31,9 +31,11 @@
 
 #include "../util/serverutils.h" /* for gvm_server_sendf, gvm_server_sendf_xml */
 
-#include <errno.h>  /* for ERANGE, errno */
-#include <stdlib.h> /* for NULL, strtol, atoi */
-#include <string.h> /* for strlen, strdup */
+#include <errno.h>   /* for ERANGE, errno */
+#include <stdarg.h>  /* for va_list */
+#include <stdlib.h>  /* for NULL, strtol, atoi */
+#include <string.h>  /* for strlen, strdup */
+#include <sys/uio.h> /* for struct iovec */
 
 #undef G_LOG_DOMAIN
 /**
@@ -1331,27 +1333,16 @@ gmp_get_targets (gnutls_session_t *session, const char *id, int tasks,
 }
 
 /**
- * @brief Get a report (generic version).
- *
- * FIXME: Using the according opts it should be possible to generate
- * any type of get_reports request defined by the spec.
+ * @brief Send a get_reports command.
  *
  * @param[in]  session   Pointer to GNUTLS session.
  * @param[in]  opts      Struct containing the options to apply.
- * @param[out] response  Report.  On success contains GET_REPORT response.
  *
- * @return 0 on success, 2 on timeout, -1 or GMP response code on error.
+ * @return 0 on success, -1 on error.
  */
-int
-gmp_get_report_ext (gnutls_session_t *session, gmp_get_report_opts_t opts,
-                    entity_t *response)
+static int
+gmp_send_get_report (gnutls_session_t *session, gmp_get_report_opts_t opts)
 {
-  int ret;
-  const char *status_code;
-
-  if (response == NULL)
-    return -1;
-
   if (gvm_server_sendf (
         session,
         "<get_reports"
@@ -1396,6 +1387,33 @@ gmp_get_report_ext (gnutls_session_t *session, gmp_get_report_opts_t opts,
         GMP_FMT_BOOL_ATTRIB (opts, result_hosts_only),
         GMP_FMT_BOOL_ATTRIB (opts, ignore_pagination)))
     return -1;
+  return 0;
+}
+
+/**
+ * @brief Get a report (generic version).
+ *
+ * FIXME: Using the according opts it should be possible to generate
+ * any type of get_reports request defined by the spec.
+ *
+ * @param[in]  session   Pointer to GNUTLS session.
+ * @param[in]  opts      Struct containing the options to apply.
+ * @param[out] response  Report.  On success contains GET_REPORT response.
+ *
+ * @return 0 on success, 2 on timeout, -1 or GMP response code on error.
+ */
+int
+gmp_get_report_ext (gnutls_session_t *session, gmp_get_report_opts_t opts,
+                    entity_t *response)
+{
+  int ret;
+  const char *status_code;
+
+  if (response == NULL)
+    return -1;
+
+  if (gmp_send_get_report (session, opts))
+    return -1;
 
   *response = NULL;
   switch (try_read_entity (session, opts.timeout, response))
@@ -1430,6 +1448,126 @@ gmp_get_report_ext (gnutls_session_t *session, gmp_get_report_opts_t opts,
   return ret;
 }
 
+/**
+ * @brief Data for streaming a report.
+ */
+typedef struct
+{
+  gmp_report_result_func_t func; ///< Function to call for each result.
+  gpointer data;                  ///< Data for the function.
+  gchar *status;                  ///< Status of the response.
+} gmp_report_stream_t;
+
+/**
+ * @brief Record the status of a streamed get_reports response.
+ *
+ * @param[in]  name    Element name.
+ * @param[in]  names   Attribute names.
+ * @param[in]  values  Attribute values.
+ * @param[in]  depth   Depth of the element.
+ * @param[in]  data    Report stream.
+ */
+static void
+gmp_report_stream_start (const gchar *name, const gchar **names,
+                         const gchar **values, int depth, gpointer data)
+{
+  gmp_report_stream_t *stream = data;
+
+  (void) name;
+  if (depth)
+    return;
+  for (; *names; names++, values++)
+    if (strcmp (*names, "status") == 0)
+      {
+        g_free (stream->status);
+        stream->status = g_strdup (*values);
+      }
+}
+
+/**
+ * @brief Pass a streamed result on to the caller.
+ *
+ * @param[in]  result  Result.
+ * @param[in]  depth   Depth of the result.
+ * @param[in]  data    Report stream.
+ */
+static void
+gmp_report_stream_result (entity_t result, int depth, gpointer data)
+{
+  gmp_report_stream_t *stream = data;
+
+  (void) depth;
+  if (stream->status && stream->status[0] == '2')
+    stream->func (result, stream->data);
+  free_entity (result);
+}
+
+/**
+ * @brief Get a report, streaming the results.
+ *
+ * Like gmp_get_report_ext, except that the response is parsed as it arrives
+ * and each result is passed to a function, instead of the whole report being
+ * read into memory.  Everything in the report besides the results is skipped.
+ *
+ * @param[in]  session   Pointer to GNUTLS session.
+ * @param[in]  opts      Struct containing the options to apply.
+ * @param[in]  func      Function to call for each result.  The result is only
+ *                       valid during the call.
+ * @param[in]  data      Data for func.
+ *
+ * @return 0 on success, 2 on timeout, -1 or GMP response code on error.
+ */
+int
+gmp_get_report_stream (gnutls_session_t *session, gmp_get_report_opts_t opts,
+                       gmp_report_result_func_t func, gpointer data)
+{
+  static const gchar *capture[] = {"result", NULL};
+  xml_stream_handlers_t handlers = {0};
+  gmp_report_stream_t stream;
+  int ret;
+
+  if (func == NULL)
+    return -1;
+
+  if (gmp_send_get_report (session, opts))
+    return -1;
+
+  handlers.start_element = gmp_report_stream_start;
+  handlers.entity = gmp_report_stream_result;
+  handlers.capture = capture;
+  stream.func = func;
+  stream.data = data;
+  stream.status = NULL;
+
+  switch (try_read_xml_stream (session, opts.timeout, &handlers, &stream))
+    {
+    case 0:
+      break;
+    case -4:
+      g_free (stream.status);
+      return 2;
+    default:
+      g_free (stream.status);
+      return -1;
+    }
+
+  /* Check the response. */
+
+  if (stream.status == NULL || strlen (stream.status) == 0)
+    ret = -1;
+  else if (stream.status[0] == '2')
+    ret = 0;
+  else
+    {
+      errno = 0;
+      ret = (int) strtol (stream.status, NULL, 10);
+      if (errno == ERANGE)
+        ret = -1;
+    }
+  g_free (stream.status);
+  return ret;
+}
+
 /**
  * @brief Delete a port list.
  *
@@ -1993,3 +2131,277 @@ gmp_get_system_reports_ext (gnutls_session_t *session,
   /* Read and check the response. */
   return gmp_check_response (session, reports);
 }
+
+/* Batches. */
+
+/**
+ * @brief Maximum number of batch commands written before reading responses.
+ */
+#define GMP_BATCH_WINDOW 64
+
+/**
+ * @brief Maximum size of the batch commands written before reading
+ *        responses, in bytes.
+ *
+ * Keeps the requests in flight small enough for the socket buffers, so that
+ * the manager never blocks writing responses while we block writing
+ * requests.
+ */
+#define GMP_BATCH_WINDOW_SIZE 32768
+
+/**
+ * @brief Batch of GMP commands.
+ */
+struct gmp_batch
+{
+  GString *commands;   ///< Commands, back to back.
+  GArray *ends;        ///< Offset of the end of each command in commands.
+  GArray *statuses;    ///< Status of each response.
+  GPtrArray *entities; ///< Response entity of each command.
+};
+
+/**
+ * @brief Create a new batch of GMP commands.
+ *
+ * @return New batch.  Free with gmp_batch_free.
+ */
+gmp_batch_t *
+gmp_batch_new (void)
+{
+  gmp_batch_t *batch;
+
+  batch = g_malloc0 (sizeof (*batch));
+  batch->commands = g_string_new (NULL);
+  batch->ends = g_array_new (FALSE, FALSE, sizeof (gsize));
+  batch->statuses = g_array_new (FALSE, FALSE, sizeof (int));
+  batch->entities = g_ptr_array_new_with_free_func ((GDestroyNotify) free_entity);
+  return batch;
+}
+
+/**
+ * @brief Free a batch of GMP commands, including the response entities.
+ *
+ * @param[in]  batch  Batch.
+ */
+void
+gmp_batch_free (gmp_batch_t *batch)
+{
+  if (batch == NULL)
+    return;
+  g_string_free (batch->commands, TRUE);
+  g_array_free (batch->ends, TRUE);
+  g_array_free (batch->statuses, TRUE);
+  g_ptr_array_free (batch->entities, TRUE);
+  g_free (batch);
+}
+
+/**
+ * @brief Record the end of a command just appended to a batch.
+ *
+ * @param[in]  batch  Batch.
+ *
+ * @return Index of the command in the batch.
+ */
+static guint
+gmp_batch_end_command (gmp_batch_t *batch)
+{
+  gsize end;
+  int status;
+
+  end = batch->commands->len;
+  status = -1;
+  g_array_append_val (batch->ends, end);
+  g_array_append_val (batch->statuses, status);
+  g_ptr_array_add (batch->entities, NULL);
+  return batch->ends->len - 1;
+}
+
+/**
+ * @brief Queue a command in a batch.
+ *
+ * @param[in]  batch   Batch.
+ * @param[in]  format  printf-style format string for the command.
+ *
+ * @return Index of the command in the batch.
+ */
+guint
+gmp_batch_add (gmp_batch_t *batch, const char *format, ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  g_string_append_vprintf (batch->commands, format, args);
+  va_end (args);
+  return gmp_batch_end_command (batch);
+}
+
+/**
+ * @brief Queue a command in a batch, XML escaping the arguments.
+ *
+ * @param[in]  batch   Batch.
+ * @param[in]  format  printf-style format string for the command.
+ *
+ * @return Index of the command in the batch.
+ */
+guint
+gmp_batch_add_xml (gmp_batch_t *batch, const char *format, ...)
+{
+  va_list args;
+  gchar *command;
+
+  va_start (args, format);
+  command = g_markup_vprintf_escaped (format, args);
+  va_end (args);
+  g_string_append (batch->commands, command);
+  g_free (command);
+  return gmp_batch_end_command (batch);
+}
+
+/**
+ * @brief Get the offset of the start of a command in a batch.
+ *
+ * @param[in]  batch  Batch.
+ * @param[in]  index  Index of the command.
+ *
+ * @return Offset of the command in the commands of the batch.
+ */
+static gsize
+gmp_batch_start (gmp_batch_t *batch, guint index)
+{
+  return index ? g_array_index (batch->ends, gsize, index - 1) : 0;
+}
+
+/**
+ * @brief Send the queued commands of a batch and read the responses.
+ *
+ * The commands are written back to back, a window of them at a time, instead
+ * of waiting for each response in turn.  The responses are matched to the
+ * commands in order.  Results of an earlier run are dropped.
+ *
+ * @param[in]  batch       Batch.
+ * @param[in]  connection  Connection.
+ *
+ * @return 0 if every command succeeded, 1 if a command failed with a GMP
+ *         error, -1 if the connection failed.  After a connection failure
+ *         the commands without a response have status -1.
+ */
+int
+gmp_batch_run (gmp_batch_t *batch, gvm_connection_t *connection)
+{
+  GPtrArray *responses;
+  guint count, sent, received;
+  int ret;
+
+  count = batch->ends->len;
+  for (received = 0; received < count; received++)
+    {
+      g_array_index (batch->statuses, int, received) = -1;
+      free_entity (g_ptr_array_index (batch->entities, received));
+      g_ptr_array_index (batch->entities, received) = NULL;
+    }
+
+  ret = 0;
+  responses = g_ptr_array_new ();
+  sent = received = 0;
+  while (received < count)
+    {
+      struct iovec iov;
+      gsize start, end;
+      int read_ret;
+      guint index;
+
+      /* Write a window of commands in one go. */
+
+      start = gmp_batch_start (batch, sent);
+      end = start;
+      while (sent < count && sent - received < GMP_BATCH_WINDOW
+             && (end == start
+                 || g_array_index (batch->ends, gsize, sent) - start
+                      <= GMP_BATCH_WINDOW_SIZE))
+        end = g_array_index (batch->ends, gsize, sent++);
+      iov.iov_base = batch->commands->str + start;
+      iov.iov_len = end - start;
+      if (gvm_connection_sendv (connection, &iov, 1))
+        {
+          ret = -1;
+          break;
+        }
+
+      /* Read the responses to the window. */
+
+      g_ptr_array_set_size (responses, 0);
+      read_ret = read_entities_c (connection, sent - received, responses);
+      for (index = 0; index < responses->len; index++, received++)
+        {
+          entity_t entity;
+          const char *status;
+
+          entity = g_ptr_array_index (responses, index);
+          g_ptr_array_index (batch->entities, received) = entity;
+          status = entity_attribute (entity, "status");
+          if (status && strlen (status))
+            {
+              errno = 0;
+              g_array_index (batch->statuses, int, received) =
+                (int) strtol (status, NULL, 10);
+              if (errno == ERANGE)
+                g_array_index (batch->statuses, int, received) = -1;
+            }
+          if (status == NULL || status[0] != '2')
+            ret = 1;
+        }
+      if (read_ret)
+        {
+          ret = -1;
+          break;
+        }
+    }
+  g_ptr_array_free (responses, TRUE);
+
+  return ret;
+}
+
+/**
+ * @brief Get the number of commands in a batch.
+ *
+ * @param[in]  batch  Batch.
+ *
+ * @return Number of commands.
+ */
+guint
+gmp_batch_count (gmp_batch_t *batch)
+{
+  return batch->ends->len;
+}
+
+/**
+ * @brief Get the response status of a command in a batch.
+ *
+ * @param[in]  batch  Batch.
+ * @param[in]  index  Index of the command.
+ *
+ * @return GMP status code of the response, -1 if there is no valid response.
+ */
+int
+gmp_batch_status (gmp_batch_t *batch, guint index)
+{
+  if (index >= batch->ends->len)
+    return -1;
+  return g_array_index (batch->statuses, int, index);
+}
+
+/**
+ * @brief Get the response entity of a command in a batch.
+ *
+ * @param[in]  batch  Batch.
+ * @param[in]  index  Index of the command.
+ *
+ * @return Response entity, owned by the batch, or NULL if there is none.
+ */
+entity_t
+gmp_batch_entity (gmp_batch_t *batch, guint index)
+{
+  if (index >= batch->ends->len)
+    return NULL;
+  return g_ptr_array_index (batch->entities, index);
+}
@@ -34,6 +34,11 @@
 #include <gnutls/gnutls.h> /* for gnutls_session_t */
 #include <stddef.h>        /* for NULL */
 
+/**
+ * @brief Batch of GMP commands sent back to back on one connection.
+ */
+typedef struct gmp_batch gmp_batch_t;
+
 /**
  * @brief Struct holding options for authentication.
  */
@@ -54,6 +59,11 @@ typedef struct
 static const gmp_authenticate_info_opts_t gmp_authenticate_info_opts_defaults =
   {0, NULL, NULL, NULL, NULL, NULL, NULL};
 
+/**
+ * @brief Function called for each result of a streamed report.
+ */
+typedef void (*gmp_report_result_func_t) (entity_t, gpointer);
+
 /**
  * @brief Struct holding options for gmp get_report command.
  */
@@ -351,6 +361,10 @@ gmp_get_targets (gnutls_session_t *, const char *, int, int, entity_t *);
 int
 gmp_get_report_ext (gnutls_session_t *, gmp_get_report_opts_t, entity_t *);
 
+int
+gmp_get_report_stream (gnutls_session_t *, gmp_get_report_opts_t,
+                       gmp_report_result_func_t, gpointer);
+
 int
 gmp_delete_port_list_ext (gnutls_session_t *, const char *, gmp_delete_opts_t);
 
@@ -400,4 +414,30 @@ int
 gmp_get_system_reports_ext (gnutls_session_t *, gmp_get_system_reports_opts_t,
                             entity_t *);
 
+gmp_batch_t *
+gmp_batch_new (void);
+
+void
+gmp_batch_free (gmp_batch_t *);
+
+guint
+gmp_batch_add (gmp_batch_t *, const char *, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+guint
+gmp_batch_add_xml (gmp_batch_t *, const char *, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+int
+gmp_batch_run (gmp_batch_t *, gvm_connection_t *);
+
+guint
+gmp_batch_count (gmp_batch_t *);
+
+int
+gmp_batch_status (gmp_batch_t *, guint);
+
+entity_t
+gmp_batch_entity (gmp_batch_t *, guint);
+
 #endif /* not _GVM_GMP_H */
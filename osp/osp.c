@@ -28,13 +28,17 @@
 #include "../util/serverutils.h" /* for gvm_server_close, gvm_server_open_w... */
 
 #include <assert.h>        /* for assert */
+#include <errno.h>         /* for errno, EAGAIN, EINTR */
+#include <fcntl.h>         /* for fcntl, F_GETFL, F_SETFL, O_NONBLOCK */
 #include <gnutls/gnutls.h> /* for gnutls_session_int, gnutls_session_t */
+#include <poll.h>          /* for poll, POLLIN */
 #include <stdarg.h>        /* for va_list */
 #include <stdlib.h>        /* for NULL, atoi */
 #include <string.h>        /* for strcmp, strlen, strncpy */
 #include <sys/socket.h>    /* for AF_UNIX, connect, socket, SOCK_STREAM */
+#include <sys/uio.h>       /* for struct iovec */
 #include <sys/un.h>        /* for sockaddr_un, sa_family_t */
-#include <unistd.h>        /* for close */
+#include <unistd.h>        /* for close, getpid */
 
 #undef G_LOG_DOMAIN
 /**
@@ -42,6 +46,11 @@
  */
 #define G_LOG_DOMAIN "lib  osp"
 
+/**
+ * @brief Max number of idle connections kept in the connection pool.
+ */
+#define OSP_POOL_MAX_IDLE 32
+
 /**
  * @brief Struct holding options for OSP connection.
  */
@@ -51,8 +60,26 @@ struct osp_connection
   int socket;               /**< Socket. */
   char *host;               /**< Host. */
   int port;                 /**< Port. */
+  gchar *pool_key;          /**< Server and credentials, if from the pool. */
+  pid_t pid;                /**< Process which opened the connection. */
+  struct osp_async *async;  /**< Non-blocking state, if attached. */
 };
 
+/**
+ * @brief Idle connections of the connection pool, most recent first.
+ */
+static GQueue osp_pool = G_QUEUE_INIT;
+
+/**
+ * @brief Lock of the connection pool.
+ */
+static GMutex osp_pool_lock;
+
+/**
+ * @brief Process which owns the idle connections of the connection pool.
+ */
+static pid_t osp_pool_pid = 0;
+
 /**
  * @brief Struct holding options for OSP parameters.
  */
@@ -127,6 +154,7 @@ osp_connection_new (const char *host, int port, const char *cacert,
 
   connection->host = g_strdup (host);
   connection->port = port;
+  connection->pid = getpid ();
   return connection;
 }
 
@@ -185,14 +213,211 @@ osp_connection_close (osp_connection_t *connection)
   if (!connection)
     return;
 
+  osp_async_detach (connection);
   if (*connection->host == '/')
     close (connection->socket);
+  else if (connection->pid != getpid ())
+    {
+      /* Inherited through fork(): the TLS session belongs to the parent,
+         so only free it here, without shutting it down. */
+      close (connection->socket);
+      gnutls_deinit (connection->session);
+    }
   else
     gvm_server_close (connection->socket, connection->session);
   g_free (connection->host);
+  g_free (connection->pool_key);
   g_free (connection);
 }
 
+/**
+ * @brief Get the key of a server and credentials in the connection pool.
+ *
+ * The credentials are only kept as a digest.
+ *
+ * @param[in]   host    Host of OSP server.
+ * @param[in]   port    Port of OSP server.
+ * @param[in]   cacert  CA public key.
+ * @param[in]   cert    Client public key.
+ * @param[in]   key     Client private key.
+ *
+ * @return Key, free with g_free.
+ */
+static gchar *
+osp_pool_key (const char *host, int port, const char *cacert,
+              const char *cert, const char *key)
+{
+  GChecksum *checksum;
+  gchar *pool_key;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) (cacert ? cacert : ""), -1);
+  g_checksum_update (checksum, (const guchar *) "", 1);
+  g_checksum_update (checksum, (const guchar *) (cert ? cert : ""), -1);
+  g_checksum_update (checksum, (const guchar *) "", 1);
+  g_checksum_update (checksum, (const guchar *) (key ? key : ""), -1);
+  pool_key = g_strdup_printf ("%s:%d:%s", host ? host : "", port,
+                              g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+  return pool_key;
+}
+
+/**
+ * @brief Check whether an idle connection can still be used.
+ *
+ * An idle connection has nothing to read, so a readable socket means that
+ * the server closed it, or left data that would be taken as the response to
+ * the next command.
+ *
+ * @param[in]   connection  Idle connection.
+ *
+ * @return TRUE if the connection can be used, FALSE otherwise.
+ */
+static gboolean
+osp_connection_idle_usable (osp_connection_t *connection)
+{
+  struct pollfd pfd;
+
+  if (*connection->host != '/'
+      && gnutls_record_check_pending (connection->session))
+    return FALSE;
+  pfd.fd = connection->socket;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  return poll (&pfd, 1, 0) == 0;
+}
+
+/**
+ * @brief Take the idle connections inherited through fork() out of the
+ *        connection pool, so that they are never shared between processes.
+ *
+ * Must be called with the pool locked.
+ *
+ * @return Inherited connections, to be closed with osp_connection_close.
+ */
+static GSList *
+osp_pool_take_inherited (void)
+{
+  osp_connection_t *connection;
+  GSList *inherited = NULL;
+
+  if (osp_pool_pid != getpid ())
+    {
+      while ((connection = g_queue_pop_head (&osp_pool)))
+        inherited = g_slist_prepend (inherited, connection);
+      osp_pool_pid = getpid ();
+    }
+  return inherited;
+}
+
+/**
+ * @brief Get a connection to an OSP server from the connection pool.
+ *
+ * Reuses an idle connection to the same server with the same credentials,
+ * opening a new one if there is none.  Idle connections inherited through
+ * fork() are closed, never reused.  Give the connection back with
+ * osp_connection_pool_release, or close it with osp_connection_close.
+ *
+ * @param[in]   host    Host of OSP server.
+ * @param[in]   port    Port of OSP server.
+ * @param[in]   cacert  CA public key.
+ * @param[in]   cert    Client public key.
+ * @param[in]   key     Client private key.
+ *
+ * @return Connection, NULL if error.
+ */
+osp_connection_t *
+osp_connection_pool_get (const char *host, int port, const char *cacert,
+                         const char *cert, const char *key)
+{
+  osp_connection_t *connection = NULL;
+  GSList *stale = NULL;
+  gchar *pool_key;
+  GList *link;
+
+  pool_key = osp_pool_key (host, port, cacert, cert, key);
+
+  g_mutex_lock (&osp_pool_lock);
+  stale = osp_pool_take_inherited ();
+  link = osp_pool.head;
+  while (link && connection == NULL)
+    {
+      GList *next = link->next;
+      osp_connection_t *idle = link->data;
+
+      if (strcmp (idle->pool_key, pool_key) == 0)
+        {
+          g_queue_delete_link (&osp_pool, link);
+          if (osp_connection_idle_usable (idle))
+            connection = idle;
+          else
+            stale = g_slist_prepend (stale, idle);
+        }
+      link = next;
+    }
+  g_mutex_unlock (&osp_pool_lock);
+
+  g_slist_free_full (stale, (GDestroyNotify) osp_connection_close);
+  if (connection)
+    {
+      g_free (pool_key);
+      return connection;
+    }
+
+  connection = osp_connection_new (host, port, cacert, cert, key);
+  if (connection)
+    connection->pool_key = pool_key;
+  else
+    g_free (pool_key);
+  return connection;
+}
+
+/**
+ * @brief Give a connection from osp_connection_pool_get back to the pool.
+ *
+ * Only release connections that are in a clean state, after a complete
+ * response.  Connections that are not from the pool are closed.
+ *
+ * @param[in]   connection  Connection.
+ */
+void
+osp_connection_pool_release (osp_connection_t *connection)
+{
+  GSList *dropped;
+
+  if (!connection)
+    return;
+  if (connection->pool_key == NULL || connection->async
+      || connection->pid != getpid ())
+    {
+      osp_connection_close (connection);
+      return;
+    }
+
+  g_mutex_lock (&osp_pool_lock);
+  dropped = osp_pool_take_inherited ();
+  g_queue_push_head (&osp_pool, connection);
+  if (g_queue_get_length (&osp_pool) > OSP_POOL_MAX_IDLE)
+    dropped = g_slist_prepend (dropped, g_queue_pop_tail (&osp_pool));
+  g_mutex_unlock (&osp_pool_lock);
+
+  g_slist_free_full (dropped, (GDestroyNotify) osp_connection_close);
+}
+
+/**
+ * @brief Close all the idle connections of the connection pool.
+ */
+void
+osp_connection_pool_clear (void)
+{
+  osp_connection_t *connection;
+
+  g_mutex_lock (&osp_pool_lock);
+  while ((connection = g_queue_pop_head (&osp_pool)))
+    osp_connection_close (connection);
+  g_mutex_unlock (&osp_pool_lock);
+}
+
 /**
  * @brief Get the scanner version from an OSP server.
  *
@@ -347,6 +572,176 @@ osp_get_vts (osp_connection_t *connection, entity_t *vts)
   return 0;
 }
 
+/**
+ * @brief Describe an OSP connection as a GVM connection.
+ *
+ * @param[in]   connection  Connection to an OSP server.
+ * @param[out]  gvm         GVM connection to fill.  Only the fields needed
+ *                          for sending and reading are set.
+ */
+static void
+osp_connection_gvm (osp_connection_t *connection, gvm_connection_t *gvm)
+{
+  memset (gvm, 0, sizeof (*gvm));
+  gvm->tls = *connection->host != '/';
+  gvm->socket = connection->socket;
+  gvm->session = connection->session;
+}
+
+/**
+ * @brief Data for streaming VTs.
+ */
+typedef struct
+{
+  osp_vt_func_t func; /**< Function to call for each VT. */
+  gpointer data;      /**< Data for the function. */
+  int status;         /**< Status of the response. */
+} osp_vts_stream_t;
+
+/**
+ * @brief Record the status of a streamed get_vts response.
+ *
+ * @param[in]  name    Element name.
+ * @param[in]  names   Attribute names.
+ * @param[in]  values  Attribute values.
+ * @param[in]  depth   Depth of the element.
+ * @param[in]  data    VTs stream.
+ */
+static void
+osp_vts_stream_start (const gchar *name, const gchar **names,
+                      const gchar **values, int depth, gpointer data)
+{
+  osp_vts_stream_t *stream = data;
+
+  (void) name;
+  if (depth)
+    return;
+  for (; *names; names++, values++)
+    if (strcmp (*names, "status") == 0)
+      stream->status = atoi (*values);
+}
+
+/**
+ * @brief Pass a streamed VT on to the caller.
+ *
+ * @param[in]  vt     VT.
+ * @param[in]  depth  Depth of the VT.
+ * @param[in]  data   VTs stream.
+ */
+static void
+osp_vts_stream_vt (entity_t vt, int depth, gpointer data)
+{
+  osp_vts_stream_t *stream = data;
+
+  (void) depth;
+  if (stream->status == 200)
+    stream->func (vt, stream->data);
+  free_entity (vt);
+}
+
+/**
+ * @brief Get the VTs from an OSP server, one at a time.
+ *
+ * The response is parsed as it arrives and each VT is passed to a function,
+ * instead of the whole feed being read into memory.
+ *
+ * @param[in]   connection  Connection to an OSP server.
+ * @param[in]   filter      VT filter, for example "modification_time>N", or
+ *                          NULL for all VTs.
+ * @param[in]   func        Function to call for each VT.  The VT is only
+ *                          valid during the call.
+ * @param[in]   data        Data for func.
+ *
+ * @return 0 if success, 1 if error.
+ */
+int
+osp_get_vts_stream (osp_connection_t *connection, const char *filter,
+                    osp_vt_func_t func, gpointer data)
+{
+  static const gchar *capture[] = {"vt", NULL};
+  xml_stream_handlers_t handlers = {0};
+  osp_vts_stream_t stream;
+  gvm_connection_t gvm;
+  struct iovec iov;
+  gchar *command;
+  int rc;
+
+  if (!connection || !func)
+    return 1;
+
+  if (filter)
+    command = g_markup_printf_escaped ("<get_vts filter='%s'/>", filter);
+  else
+    command = g_strdup ("<get_vts/>");
+
+  osp_connection_gvm (connection, &gvm);
+  iov.iov_base = command;
+  iov.iov_len = strlen (command);
+  rc = gvm_connection_sendv (&gvm, &iov, 1);
+  g_free (command);
+  if (rc)
+    return 1;
+
+  handlers.start_element = osp_vts_stream_start;
+  handlers.entity = osp_vts_stream_vt;
+  handlers.capture = capture;
+  stream.func = func;
+  stream.data = data;
+  stream.status = 0;
+
+  if (try_read_xml_stream_c (&gvm, 0, &handlers, &stream))
+    return 1;
+  if (stream.status != 200)
+    {
+      g_warning ("%s: get_vts failed with status %d.", __FUNCTION__,
+                 stream.status);
+      return 1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Get the VTs from an OSP server, if they changed.
+ *
+ * Compares the VTs version of the server with the version of the last sync,
+ * so that an unchanged feed is skipped without transferring any VT.
+ *
+ * @param[in]   connection   Connection to an OSP server.
+ * @param[in]   known        VTs version of the last sync, or NULL.
+ * @param[out]  vts_version  Current VTs version of the server, or NULL.
+ * @param[in]   filter       VT filter, for example "modification_time>N" to
+ *                           get only the VTs changed since the last sync, or
+ *                           NULL for all VTs.
+ * @param[in]   func         Function to call for each VT.
+ * @param[in]   data         Data for func.
+ *
+ * @return 0 if VTs were fetched, 2 if the VTs version is unchanged, 1 if
+ *         error.
+ */
+int
+osp_get_vts_update (osp_connection_t *connection, const char *known,
+                    char **vts_version, const char *filter,
+                    osp_vt_func_t func, gpointer data)
+{
+  char *version;
+  int rc;
+
+  version = NULL;
+  if (osp_get_vts_version (connection, &version))
+    return 1;
+
+  if (known && strcmp (known, version) == 0)
+    rc = 2;
+  else
+    rc = osp_get_vts_stream (connection, filter, func, data);
+
+  if (vts_version && rc != 1)
+    *vts_version = version;
+  else
+    g_free (version);
+  return rc;
+}
+
 /**
  * @brief Delete a scan from an OSP server.
  *
@@ -435,6 +830,170 @@ osp_get_scan (osp_connection_t *connection, const char *scan_id,
   return progress;
 }
 
+/**
+ * @brief Data for streaming scan results.
+ */
+typedef struct
+{
+  osp_result_func_t func; /**< Function to call for each result. */
+  gpointer data;          /**< Data for the function. */
+  int skip;               /**< Number of results to skip. */
+  int count;              /**< Number of results seen. */
+  int progress;           /**< Scan progress, -1 if no scan seen. */
+  gchar *status_text;     /**< Status text of the response. */
+} osp_results_stream_t;
+
+/**
+ * @brief Record the status and scan progress of a streamed get_scans response.
+ *
+ * @param[in]  name    Element name.
+ * @param[in]  names   Attribute names.
+ * @param[in]  values  Attribute values.
+ * @param[in]  depth   Depth of the element.
+ * @param[in]  data    Results stream.
+ */
+static void
+osp_results_stream_start (const gchar *name, const gchar **names,
+                          const gchar **values, int depth, gpointer data)
+{
+  osp_results_stream_t *stream = data;
+
+  if (depth == 0)
+    {
+      for (; *names; names++, values++)
+        if (strcmp (*names, "status_text") == 0)
+          {
+            g_free (stream->status_text);
+            stream->status_text = g_strdup (*values);
+          }
+    }
+  else if (depth == 1 && strcmp (name, "scan") == 0)
+    {
+      stream->progress = 0;
+      for (; *names; names++, values++)
+        if (strcmp (*names, "progress") == 0)
+          stream->progress = atoi (*values);
+    }
+}
+
+/**
+ * @brief Pass a streamed result on to the caller, unless it was seen before.
+ *
+ * @param[in]  entity  Result element.
+ * @param[in]  depth   Depth of the result.
+ * @param[in]  data    Results stream.
+ */
+static void
+osp_results_stream_result (entity_t entity, int depth, gpointer data)
+{
+  osp_results_stream_t *stream = data;
+
+  (void) depth;
+  if (stream->progress >= 0 && stream->count++ >= stream->skip)
+    {
+      osp_result_t result;
+
+      result.type = entity_attribute (entity, "type");
+      result.name = entity_attribute (entity, "name");
+      result.host = entity_attribute (entity, "host");
+      result.hostname = entity_attribute (entity, "hostname");
+      result.test_id = entity_attribute (entity, "test_id");
+      result.port = entity_attribute (entity, "port");
+      result.severity = entity_attribute (entity, "severity");
+      result.qod = entity_attribute (entity, "qod");
+      result.value = entity_text (entity);
+      stream->func (&result, stream->data);
+    }
+  free_entity (entity);
+}
+
+/**
+ * @brief Get the new results of a scan from an OSP server.
+ *
+ * The response is parsed as it arrives, and each new result is passed to a
+ * function as a record, instead of the whole scan being returned as a
+ * string.
+ *
+ * With pop, the server drops the results it returns, so every poll only
+ * transfers the results since the last one.  Without it, the results before
+ * the cursor are transferred but skipped.
+ *
+ * @param[in]   connection  Connection to an OSP server.
+ * @param[in]   scan_id     ID of scan to get.
+ * @param[in]   pop         Whether to ask the server to pop the results.
+ * @param[in]   cursor      Number of results already seen, updated to include
+ *                          the new results.  Start at 0.  NULL for all.
+ * @param[in]   func        Function to call for each new result.  The result
+ *                          is only valid during the call.
+ * @param[in]   data        Data for func.
+ * @param[out]  error       Pointer to error, if any.
+ *
+ * @return Scan progress if success, -1 if error.
+ */
+int
+osp_get_scan_results (osp_connection_t *connection, const char *scan_id,
+                      int pop, int *cursor, osp_result_func_t func,
+                      gpointer data, char **error)
+{
+  static const gchar *capture[] = {"result", NULL};
+  xml_stream_handlers_t handlers = {0};
+  osp_results_stream_t stream;
+  gvm_connection_t gvm;
+  struct iovec iov;
+  gchar *command;
+  int rc;
+
+  assert (connection);
+  assert (scan_id);
+  assert (func);
+
+  command = g_markup_printf_escaped (
+    "<get_scans scan_id='%s' details='1' pop_results='%d'/>", scan_id,
+    pop ? 1 : 0);
+  osp_connection_gvm (connection, &gvm);
+  iov.iov_base = command;
+  iov.iov_len = strlen (command);
+  rc = gvm_connection_sendv (&gvm, &iov, 1);
+  g_free (command);
+  if (rc)
+    {
+      if (error)
+        *error = g_strdup ("Couldn't send get_scans command to scanner");
+      return -1;
+    }
+
+  handlers.start_element = osp_results_stream_start;
+  handlers.entity = osp_results_stream_result;
+  handlers.capture = capture;
+  stream.func = func;
+  stream.data = data;
+  stream.skip = (cursor && !pop) ? *cursor : 0;
+  stream.count = 0;
+  stream.progress = -1;
+  stream.status_text = NULL;
+
+  if (try_read_xml_stream_c (&gvm, 0, &handlers, &stream))
+    {
+      if (error)
+        *error = g_strdup ("Couldn't read get_scans response from scanner");
+      g_free (stream.status_text);
+      return -1;
+    }
+  if (stream.progress < 0)
+    {
+      if (error)
+        *error = g_strdup (stream.status_text ? stream.status_text
+                                              : "No scan in response");
+      g_free (stream.status_text);
+      return -1;
+    }
+  g_free (stream.status_text);
+
+  if (cursor)
+    *cursor = pop ? 0 : MAX (stream.count, stream.skip);
+  return stream.progress;
+}
+
 /**
  * @brief Stop a scan on an OSP server.
  *
@@ -791,3 +1350,492 @@ osp_param_free (osp_param_t *param)
   g_free (param->def);
   g_free (param);
 }
+
+/**
+ * @brief Size of the buffer for reading responses on a non-blocking
+ *        connection.
+ */
+#define OSP_ASYNC_READ_SIZE 16384
+
+/**
+ * @brief Command waiting for its response on a non-blocking connection.
+ */
+typedef struct
+{
+  osp_async_cb cb; /**< Callback to call with the response. */
+  void *data;      /**< User data for the callback. */
+} osp_async_request_t;
+
+/**
+ * @brief GLib source driving a non-blocking OSP connection.
+ */
+struct osp_async
+{
+  GSource source;               /**< Parent source. */
+  osp_connection_t *connection; /**< Connection. */
+  gpointer tag;                 /**< Tag of the socket, NULL once failed. */
+  GString *out;                 /**< Commands still to be written. */
+  gsize out_offset;             /**< Start of the unwritten part of out. */
+  GQueue requests;              /**< Commands waiting for a response. */
+  GMarkupParseContext *parser;  /**< Parser of the responses. */
+  context_data_t context;       /**< Response being parsed. */
+};
+
+/**
+ * @brief Update the events watched by the source of a connection.
+ *
+ * @param[in]  async  Non-blocking state.
+ */
+static void
+osp_async_update (struct osp_async *async)
+{
+  GIOCondition events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+
+  if (async->tag == NULL)
+    return;
+  if (async->out_offset < async->out->len)
+    events |= G_IO_OUT;
+  g_source_modify_unix_fd ((GSource *) async, async->tag, events);
+}
+
+/**
+ * @brief Fail all the commands waiting for a response.
+ *
+ * @param[in]  async  Non-blocking state.
+ */
+static void
+osp_async_fail_requests (struct osp_async *async)
+{
+  osp_async_request_t *request;
+
+  while ((request = g_queue_pop_head (&async->requests)))
+    {
+      request->cb (async->connection, -1, NULL, request->data);
+      g_free (request);
+    }
+}
+
+/**
+ * @brief Stop driving a connection after an error, failing the commands.
+ *
+ * @param[in]  async  Non-blocking state.
+ */
+static void
+osp_async_fail (struct osp_async *async)
+{
+  if (async->tag)
+    {
+      g_source_remove_unix_fd ((GSource *) async, async->tag);
+      async->tag = NULL;
+    }
+  osp_async_fail_requests (async);
+}
+
+/**
+ * @brief Handle the start of an element of a response.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  attribute_names   XML attribute name.
+ * @param[in]  attribute_values  XML attribute values.
+ * @param[in]  user_data         Non-blocking state.
+ * @param[in]  error             Error parameter.
+ */
+static void
+osp_async_start_element (GMarkupParseContext *context,
+                         const gchar *element_name,
+                         const gchar **attribute_names,
+                         const gchar **attribute_values, gpointer user_data,
+                         GError **error)
+{
+  struct osp_async *async = user_data;
+
+  (void) context;
+  (void) error;
+  xml_handle_start_element (&async->context, element_name, attribute_names,
+                            attribute_values);
+}
+
+/**
+ * @brief Handle the end of an element of a response.
+ *
+ * When a response is complete, it is passed to the callback of the oldest
+ * command.
+ *
+ * @param[in]  context       Parser context.
+ * @param[in]  element_name  XML element name.
+ * @param[in]  user_data     Non-blocking state.
+ * @param[in]  error         Error parameter.
+ */
+static void
+osp_async_end_element (GMarkupParseContext *context, const gchar *element_name,
+                       gpointer user_data, GError **error)
+{
+  struct osp_async *async = user_data;
+  osp_async_request_t *request;
+  entity_t response;
+
+  (void) context;
+  (void) error;
+  xml_handle_end_element (&async->context, element_name);
+  if (async->context.done == FALSE)
+    return;
+
+  response = async->context.first->data;
+  g_slist_free_1 (async->context.first);
+  async->context.first = NULL;
+  async->context.done = FALSE;
+
+  request = g_queue_pop_head (&async->requests);
+  if (request)
+    {
+      request->cb (async->connection, 0, response, request->data);
+      g_free (request);
+    }
+  else
+    g_warning ("%s: Response without a command: %s", __FUNCTION__,
+               element_name);
+  free_entity (response);
+}
+
+/**
+ * @brief Handle text of a response.
+ *
+ * @param[in]  context    Parser context.
+ * @param[in]  text       The text.
+ * @param[in]  text_len   Length of the text.
+ * @param[in]  user_data  Non-blocking state.
+ * @param[in]  error      Error parameter.
+ */
+static void
+osp_async_text (GMarkupParseContext *context, const gchar *text,
+                gsize text_len, gpointer user_data, GError **error)
+{
+  struct osp_async *async = user_data;
+
+  (void) context;
+  (void) error;
+  /* Drop the text between responses. */
+  if (async->context.current)
+    xml_handle_text (&async->context, text, text_len);
+}
+
+/**
+ * @brief Parser of the responses on a non-blocking connection.
+ */
+static GMarkupParser osp_async_parser = {
+  osp_async_start_element, osp_async_end_element, osp_async_text, NULL, NULL};
+
+/**
+ * @brief Write as much of the queued commands as the socket takes.
+ *
+ * @param[in]  async  Non-blocking state.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+osp_async_write (struct osp_async *async)
+{
+  osp_connection_t *connection = async->connection;
+
+  while (async->out_offset < async->out->len)
+    {
+      const char *buffer = async->out->str + async->out_offset;
+      gsize left = async->out->len - async->out_offset;
+      ssize_t count;
+
+      if (*connection->host == '/')
+        {
+          count = write (connection->socket, buffer, left);
+          if (count < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              if (errno == EAGAIN)
+                break;
+              g_warning ("%s: Failed to write to scanner: %s", __FUNCTION__,
+                         strerror (errno));
+              return -1;
+            }
+        }
+      else
+        {
+          count = gnutls_record_send (connection->session, buffer, left);
+          if (count == GNUTLS_E_INTERRUPTED)
+            continue;
+          if (count == GNUTLS_E_AGAIN)
+            break;
+          if (count < 0)
+            {
+              g_warning ("%s: Failed to write to scanner: %s", __FUNCTION__,
+                         gnutls_strerror (count));
+              return -1;
+            }
+        }
+      async->out_offset += count;
+    }
+
+  if (async->out_offset == async->out->len)
+    {
+      g_string_truncate (async->out, 0);
+      async->out_offset = 0;
+    }
+  osp_async_update (async);
+  return 0;
+}
+
+/**
+ * @brief Read and parse what the socket has, calling the callbacks of the
+ *        complete responses.
+ *
+ * @param[in]  async  Non-blocking state.
+ *
+ * @return 0 on success, -1 on error or end of file.
+ */
+static int
+osp_async_read (struct osp_async *async)
+{
+  osp_connection_t *connection = async->connection;
+  char buffer[OSP_ASYNC_READ_SIZE];
+
+  while (1)
+    {
+      GError *error = NULL;
+      ssize_t count;
+
+      if (*connection->host == '/')
+        {
+          count = read (connection->socket, buffer, sizeof (buffer));
+          if (count < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              if (errno == EAGAIN)
+                return 0;
+              g_warning ("%s: Failed to read from scanner: %s", __FUNCTION__,
+                         strerror (errno));
+              return -1;
+            }
+        }
+      else
+        {
+          count = gnutls_record_recv (connection->session, buffer,
+                                      sizeof (buffer));
+          if (count == GNUTLS_E_INTERRUPTED || count == GNUTLS_E_REHANDSHAKE)
+            continue;
+          if (count == GNUTLS_E_AGAIN)
+            return 0;
+          if (count < 0)
+            {
+              g_warning ("%s: Failed to read from scanner: %s", __FUNCTION__,
+                         gnutls_strerror (count));
+              return -1;
+            }
+        }
+      if (count == 0)
+        {
+          if (g_queue_get_length (&async->requests))
+            g_warning ("%s: Scanner closed connection", __FUNCTION__);
+          return -1;
+        }
+
+      g_markup_parse_context_parse (async->parser, buffer, count, &error);
+      if (error)
+        {
+          g_warning ("%s: Failed to parse response: %s", __FUNCTION__,
+                     error->message);
+          g_error_free (error);
+          return -1;
+        }
+    }
+}
+
+/**
+ * @brief Check whether the socket of a non-blocking connection is ready.
+ *
+ * @param[in]  source  Source.
+ *
+ * @return TRUE if the source is to be dispatched.
+ */
+static gboolean
+osp_async_check (GSource *source)
+{
+  struct osp_async *async = (struct osp_async *) source;
+
+  return async->tag && g_source_query_unix_fd (source, async->tag) != 0;
+}
+
+/**
+ * @brief Handle the ready socket of a non-blocking connection.
+ *
+ * @param[in]  source    Source.
+ * @param[in]  callback  Unused.
+ * @param[in]  data      Unused.
+ *
+ * @return G_SOURCE_CONTINUE.
+ */
+static gboolean
+osp_async_dispatch (GSource *source, GSourceFunc callback, gpointer data)
+{
+  struct osp_async *async = (struct osp_async *) source;
+  GIOCondition ready;
+
+  (void) callback;
+  (void) data;
+  ready = g_source_query_unix_fd (source, async->tag);
+  if ((ready & G_IO_OUT) && osp_async_write (async))
+    osp_async_fail (async);
+  if (async->tag && (ready & (G_IO_IN | G_IO_HUP | G_IO_ERR))
+      && osp_async_read (async))
+    osp_async_fail (async);
+  return G_SOURCE_CONTINUE;
+}
+
+/**
+ * @brief Functions of the GLib source of a non-blocking connection.
+ */
+static GSourceFuncs osp_async_source_funcs = {
+  NULL, osp_async_check, osp_async_dispatch, NULL, NULL, NULL};
+
+/**
+ * @brief Drive an OSP connection from a GLib main context.
+ *
+ * The connection becomes non-blocking: commands are queued with
+ * osp_async_send_command and their responses are passed to callbacks as they
+ * arrive, so one thread can drive many scanners.  The blocking functions must
+ * not be used on the connection until osp_async_detach.
+ *
+ * @param[in]  connection  Connection to an OSP server.
+ * @param[in]  context     Main context, NULL for the default one.
+ *
+ * @return 0 on success, -1 on error or if already attached.
+ */
+int
+osp_async_attach (osp_connection_t *connection, GMainContext *context)
+{
+  struct osp_async *async;
+  int flags;
+
+  if (!connection || connection->async)
+    return -1;
+
+  flags = fcntl (connection->socket, F_GETFL);
+  if (flags == -1
+      || fcntl (connection->socket, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+      g_warning ("%s: Failed to set socket flags: %s", __FUNCTION__,
+                 strerror (errno));
+      return -1;
+    }
+
+  async = (struct osp_async *) g_source_new (&osp_async_source_funcs,
+                                             sizeof (struct osp_async));
+  async->connection = connection;
+  async->out = g_string_new (NULL);
+  async->out_offset = 0;
+  g_queue_init (&async->requests);
+  async->context.first = NULL;
+  async->context.current = NULL;
+  async->context.done = FALSE;
+  async->parser =
+    g_markup_parse_context_new (&osp_async_parser, 0, async, NULL);
+  async->tag = g_source_add_unix_fd ((GSource *) async, connection->socket,
+                                     G_IO_IN | G_IO_HUP | G_IO_ERR);
+  connection->async = async;
+  g_source_attach ((GSource *) async, context);
+  return 0;
+}
+
+/**
+ * @brief Stop driving an OSP connection from a main context.
+ *
+ * The connection is blocking again.  The commands still waiting for a response
+ * are failed.
+ *
+ * @param[in]  connection  Connection to an OSP server.
+ */
+void
+osp_async_detach (osp_connection_t *connection)
+{
+  struct osp_async *async;
+  int flags;
+
+  if (!connection || connection->async == NULL)
+    return;
+
+  async = connection->async;
+  osp_async_fail (async);
+  connection->async = NULL;
+
+  if (async->context.first)
+    {
+      /* Free the partial response, and the stack of open elements, which
+       * ends with the root. */
+      free_entity (async->context.first->data);
+      g_slist_free (async->context.current);
+    }
+  g_markup_parse_context_free (async->parser);
+  g_string_free (async->out, TRUE);
+  g_source_destroy ((GSource *) async);
+  g_source_unref ((GSource *) async);
+
+  flags = fcntl (connection->socket, F_GETFL);
+  if (flags != -1)
+    fcntl (connection->socket, F_SETFL, flags & ~O_NONBLOCK);
+}
+
+/**
+ * @brief Queue a command on a non-blocking OSP connection.
+ *
+ * Commands can be queued on many connections, and several on each one.  The
+ * responses of a connection arrive in the order of its commands.  The
+ * callback may queue more commands, but must not detach or close the
+ * connection.
+ *
+ * @param[in]  connection  Connection to an OSP server, attached with
+ *                         osp_async_attach.
+ * @param[in]  cb          Callback to call with the response.
+ * @param[in]  data        User data for the callback.
+ * @param[in]  fmt         OSP Command to send.
+ *
+ * @return 0 on success, -1 if the connection is not attached or failed.
+ */
+int
+osp_async_send_command (osp_connection_t *connection, osp_async_cb cb,
+                        void *data, const char *fmt, ...)
+{
+  osp_async_request_t *request;
+  struct osp_async *async;
+  va_list ap;
+
+  if (!connection || !cb || !fmt || connection->async == NULL
+      || connection->async->tag == NULL)
+    return -1;
+
+  async = connection->async;
+  va_start (ap, fmt);
+  g_string_append_vprintf (async->out, fmt, ap);
+  va_end (ap);
+
+  request = g_malloc (sizeof (*request));
+  request->cb = cb;
+  request->data = data;
+  g_queue_push_tail (&async->requests, request);
+  osp_async_update (async);
+  return 0;
+}
+
+/**
+ * @brief Get the number of commands waiting for a response.
+ *
+ * @param[in]  connection  Connection to an OSP server.
+ *
+ * @return Number of commands.
+ */
+size_t
+osp_async_pending (osp_connection_t *connection)
+{
+  if (!connection || connection->async == NULL)
+    return 0;
+  return g_queue_get_length (&connection->async->requests);
+}
@@ -47,10 +47,58 @@ typedef enum
 
 typedef struct osp_param osp_param_t;
 
+/**
+ * @brief Function called for each VT of a streamed get_vts response.
+ */
+typedef void (*osp_vt_func_t) (entity_t, gpointer);
+
+/**
+ * @brief Result of an OSP scan.
+ *
+ * The strings belong to the response, and are only valid during the call
+ * of the osp_result_func_t.
+ */
+typedef struct
+{
+  const char *type;     /**< Result type, for example "Alarm". */
+  const char *name;     /**< Name. */
+  const char *host;     /**< Host IP. */
+  const char *hostname; /**< Host name. */
+  const char *test_id;  /**< OID of the VT. */
+  const char *port;     /**< Port. */
+  const char *severity; /**< Severity. */
+  const char *qod;      /**< Quality of detection. */
+  const char *value;    /**< Text of the result. */
+} osp_result_t;
+
+/**
+ * @brief Function called for each new result of a scan.
+ */
+typedef void (*osp_result_func_t) (const osp_result_t *, gpointer);
+
+/**
+ * @brief Callback receiving the response to a command on a non-blocking
+ *        connection.
+ *
+ * The status is 0 on success, -1 on error, in which case the response is
+ * NULL.  The response is only valid during the call.
+ */
+typedef void (*osp_async_cb) (osp_connection_t *, int, entity_t, void *);
+
 osp_connection_t *
 osp_connection_new (const char *, int, const char *, const char *,
                     const char *);
 
+osp_connection_t *
+osp_connection_pool_get (const char *, int, const char *, const char *,
+                         const char *);
+
+void
+osp_connection_pool_release (osp_connection_t *);
+
+void
+osp_connection_pool_clear (void);
+
 int
 osp_get_version (osp_connection_t *, char **, char **, char **, char **,
                  char **, char **);
@@ -61,6 +109,13 @@ osp_get_vts_version (osp_connection_t *, char **);
 int
 osp_get_vts (osp_connection_t *, entity_t *);
 
+int
+osp_get_vts_stream (osp_connection_t *, const char *, osp_vt_func_t, gpointer);
+
+int
+osp_get_vts_update (osp_connection_t *, const char *, char **, const char *,
+                    osp_vt_func_t, gpointer);
+
 int
 osp_start_scan (osp_connection_t *, const char *, const char *, GHashTable *,
                 const char *, char **);
@@ -68,6 +123,10 @@ osp_start_scan (osp_connection_t *, const char *, const char *, GHashTable *,
 int
 osp_get_scan (osp_connection_t *, const char *, char **, int, char **);
 
+int
+osp_get_scan_results (osp_connection_t *, const char *, int, int *,
+                      osp_result_func_t, gpointer, char **);
+
 int
 osp_delete_scan (osp_connection_t *, const char *);
 
@@ -104,4 +163,18 @@ osp_param_free (osp_param_t *);
 void
 osp_connection_close (osp_connection_t *);
 
+int
+osp_async_attach (osp_connection_t *, GMainContext *);
+
+void
+osp_async_detach (osp_connection_t *);
+
+int
+osp_async_send_command (osp_connection_t *, osp_async_cb, void *,
+                        const char *, ...)
+  __attribute__ ((__format__ (__printf__, 4, 5)));
+
+size_t
+osp_async_pending (osp_connection_t *);
+
 #endif
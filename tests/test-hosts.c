@@ -22,15 +22,18 @@
  * @brief Stand-alone tool to test module "hosts".
  *
  * This file offers a command line interface to test the functionalities
- * of the hosts object.
+ * of the hosts object. With "--check", it runs self-checks of the parsing,
+ * deduplication, exclusion and slicing of hosts collections instead, which
+ * need no DNS.
  */
 
 #include "../base/hosts.h" /* for gvm_host_type_str, gvm_host_resolve, gvm_... */
 
 #include <arpa/inet.h>  /* for inet_ntop */
-#include <glib.h>       /* for g_free */
+#include <glib.h>       /* for g_free, GHashTable */
 #include <netinet/in.h> /* for INET6_ADDRSTRLEN, INET_ADDRSTRLEN, in6_addr */
 #include <stdio.h>      /* for printf, fprintf, NULL, stderr */
+#include <string.h>     /* for strcmp */
 #include <sys/socket.h> /* for AF_INET, AF_INET6 */
 
 static void
@@ -46,6 +49,254 @@ print_vhosts (gvm_host_t *host)
   if (host->vhosts)
     printf ("\n");
 }
+
+static int failures = 0;
+
+/**
+ * @brief Reports a failed check.
+ */
+#define CHECK(cond)                                                       \
+  do                                                                      \
+    {                                                                     \
+      if (!(cond))                                                        \
+        {                                                                 \
+          fprintf (stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+          failures++;                                                     \
+        }                                                                 \
+    }                                                                     \
+  while (0)
+
+/**
+ * @brief Gets the value of the next host of a collection.
+ *
+ * @param[in] hosts Hosts collection.
+ *
+ * @return Value to free with g_free, NULL at the end of the hosts.
+ */
+static gchar *
+next_str (gvm_hosts_t *hosts)
+{
+  gvm_host_t *host = gvm_hosts_next (hosts);
+
+  return host ? gvm_host_value_str (host) : NULL;
+}
+
+/**
+ * @brief Iterates over the rest of a collection, adding the host values to a
+ * set.
+ *
+ * @param[in] hosts Hosts collection.
+ * @param[in] seen  Set of host values.
+ *
+ * @return Number of hosts iterated over, -1 if one was already in the set.
+ */
+static int
+collect (gvm_hosts_t *hosts, GHashTable *seen)
+{
+  gchar *str;
+  int count = 0, dup = 0;
+
+  while ((str = next_str (hosts)))
+    {
+      if (!g_hash_table_add (seen, str))
+        dup = 1;
+      count++;
+    }
+  return dup ? -1 : count;
+}
+
+/**
+ * @brief Gets whether an address is in a hosts collection.
+ *
+ * @param[in] hosts Hosts collection.
+ * @param[in] str   Single address.
+ *
+ * @return 1 if it is, 0 otherwise.
+ */
+static int
+in_hosts (gvm_hosts_t *hosts, const char *str)
+{
+  gvm_hosts_t *single = gvm_hosts_new (str);
+  int ret = gvm_host_in_hosts (gvm_hosts_next (single), NULL, hosts);
+
+  gvm_hosts_free (single);
+  return ret;
+}
+
+static void
+check_parse (void)
+{
+  gvm_hosts_t *hosts;
+  gchar *str;
+
+  hosts = gvm_hosts_new ("192.168.0.1-10");
+  CHECK (gvm_hosts_count (hosts) == 10);
+  str = next_str (hosts);
+  CHECK (str && !strcmp (str, "192.168.0.1"));
+  g_free (str);
+  gvm_hosts_free (hosts);
+
+  /* Network and broadcast addresses are skipped. */
+  hosts = gvm_hosts_new ("192.168.0.0/24");
+  CHECK (gvm_hosts_count (hosts) == 254);
+  str = next_str (hosts);
+  CHECK (str && !strcmp (str, "192.168.0.1"));
+  g_free (str);
+  gvm_hosts_free (hosts);
+
+  hosts = gvm_hosts_new ("10.0.0.1-10.0.1.0, ::1, 2001:db8::1-ff, Host.Test");
+  CHECK (gvm_hosts_count (hosts) == 256 + 1 + 255 + 1);
+  CHECK (in_hosts (hosts, "10.0.0.255"));
+  CHECK (in_hosts (hosts, "2001:db8::80"));
+  CHECK (!in_hosts (hosts, "10.0.1.1"));
+  CHECK (!in_hosts (hosts, "2001:db8::100"));
+  gvm_hosts_free (hosts);
+
+  CHECK (gvm_hosts_new ("192.168.0.1/33") == NULL);
+  CHECK (gvm_hosts_new ("192.168.0.1, a b") == NULL);
+  CHECK (gvm_hosts_new_with_max ("192.168.0.1-10", 5) == NULL);
+}
+
+static void
+check_dedup (void)
+{
+  gvm_hosts_t *hosts;
+  GHashTable *seen;
+  gchar *str;
+
+  /* The first occurrence of each host is kept, in place. */
+  hosts = gvm_hosts_new ("10.0.0.5-15, 10.0.0.1-10, host.test, HOST.test");
+  CHECK (gvm_hosts_count (hosts) == 16);
+  CHECK (gvm_hosts_removed (hosts) == 7);
+  str = next_str (hosts);
+  CHECK (str && !strcmp (str, "10.0.0.5"));
+  g_free (str);
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  CHECK (collect (hosts, seen) == 15);
+  g_hash_table_destroy (seen);
+  gvm_hosts_free (hosts);
+
+  /* Sorted collections give addresses in ascending order. */
+  hosts = gvm_hosts_new_sorted ("10.0.0.9, 10.0.0.1-10, 10.0.0.3", 0);
+  CHECK (gvm_hosts_count (hosts) == 10);
+  CHECK (gvm_hosts_removed (hosts) == 2);
+  str = next_str (hosts);
+  CHECK (str && !strcmp (str, "10.0.0.1"));
+  g_free (str);
+  gvm_hosts_free (hosts);
+}
+
+static void
+check_exclude (void)
+{
+  gvm_hosts_t *hosts;
+  gvm_hosts_stream_t *stream;
+  gvm_host_t *host;
+  int count;
+
+  hosts = gvm_hosts_new ("10.0.0.1-20, host.test");
+  CHECK (gvm_hosts_exclude (hosts, "10.0.0.5-9, 10.0.0.15, Host.Test, ::1")
+         == 7);
+  CHECK (gvm_hosts_count (hosts) == 14);
+  CHECK (gvm_hosts_removed (hosts) == 7);
+  CHECK (in_hosts (hosts, "10.0.0.4"));
+  CHECK (!in_hosts (hosts, "10.0.0.7"));
+  CHECK (!in_hosts (hosts, "10.0.0.15"));
+  CHECK (in_hosts (hosts, "10.0.0.16"));
+  CHECK (gvm_hosts_exclude (hosts, "10.0.0.0/24") == 14);
+  CHECK (gvm_hosts_count (hosts) == 0);
+  CHECK (gvm_hosts_next (hosts) == NULL);
+  CHECK (gvm_hosts_exclude (hosts, "a b") == -1);
+  gvm_hosts_free (hosts);
+
+  stream = gvm_hosts_stream_new ("10.0.0.1-20, host.test", "10.0.0.5-9");
+  CHECK (stream != NULL);
+  count = 0;
+  while ((host = gvm_hosts_stream_next (stream)))
+    count++;
+  CHECK (count == 16);
+  gvm_hosts_stream_free (stream);
+}
+
+/**
+ * @brief Checks that the slices of a collection are disjoint, balanced and
+ * hold all its hosts.
+ *
+ * @param[in] hosts   Hosts collection.
+ * @param[in] slices  Number of slices.
+ * @param[in] strided Whether slices are strided.
+ */
+static void
+check_slices (gvm_hosts_t *hosts, unsigned int slices, int strided)
+{
+  GHashTable *seen;
+  unsigned int slice, total = 0;
+
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (slice = 0; slice < slices; slice++)
+    {
+      size_t count;
+
+      CHECK (gvm_hosts_slice (hosts, slice, slices, strided, &count) == 0);
+      CHECK (count == gvm_hosts_count (hosts) / slices
+                        + (slice < gvm_hosts_count (hosts) % slices));
+      CHECK (collect (hosts, seen) == (int) count);
+      total += count;
+    }
+  CHECK (total == gvm_hosts_count (hosts));
+  CHECK (g_hash_table_size (seen) == gvm_hosts_count (hosts));
+  g_hash_table_destroy (seen);
+  CHECK (gvm_hosts_slice (hosts, slices, slices, strided, NULL) == -1);
+  CHECK (gvm_hosts_slice (hosts, 0, 1, 0, NULL) == 0);
+}
+
+static void
+check_slice (void)
+{
+  gvm_hosts_t *hosts;
+  GHashTable *seen;
+  gchar *str;
+
+  hosts = gvm_hosts_new ("10.0.0.1-10, host.test, 10.0.1.0/30");
+  CHECK (gvm_hosts_count (hosts) == 13);
+  check_slices (hosts, 3, 0);
+  check_slices (hosts, 3, 1);
+  check_slices (hosts, 13, 0);
+  check_slices (hosts, 20, 1);
+
+  gvm_hosts_reverse (hosts);
+  str = next_str (hosts);
+  CHECK (str && !strcmp (str, "10.0.1.2"));
+  g_free (str);
+  check_slices (hosts, 4, 0);
+  gvm_hosts_reverse (hosts);
+
+  /* A seeded shuffle is a permutation, the same in every worker. */
+  gvm_hosts_shuffle_with_seed (hosts, 42);
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  CHECK (collect (hosts, seen) == 13);
+  g_hash_table_destroy (seen);
+  check_slices (hosts, 5, 1);
+  gvm_hosts_free (hosts);
+}
+
+/**
+ * @brief Runs the self-checks.
+ *
+ * @return 0 if they all passed, 1 otherwise.
+ */
+static int
+check (void)
+{
+  check_parse ();
+  check_dedup ();
+  check_exclude ();
+  check_slice ();
+  if (failures)
+    fprintf (stderr, "%d check(s) failed.\n", failures);
+  return failures ? 1 : 0;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -55,6 +306,8 @@ main (int argc, char **argv)
 
   if (argc < 2)
     return 1;
+  if (!strcmp (argv[1], "--check"))
+    return check ();
   hosts = gvm_hosts_new (argv[1]);
   if (hosts == NULL)
     return 1;
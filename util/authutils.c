@@ -25,7 +25,8 @@
 #include "authutils.h"
 
 #include <gcrypt.h> /* for gcry_md_get_algo_dlen, gcry_control, gcry_md_alg... */
-#include <string.h> /* for strcmp */
+#include <stdlib.h> /* for strtoul */
+#include <string.h> /* for strcmp, strlen, memset */
 
 #undef G_LOG_DOMAIN
 /**
@@ -46,6 +47,58 @@ static const gchar *authentication_methods[] = {"file", "ldap_connect",
  */
 static gboolean initialized = FALSE;
 
+/**
+ * @brief Prefix of hashes made with the PBKDF2 key derivation.
+ *
+ * The full form is "$pbkdf2-sha256$ITERATIONS$SALT$HASH", with SALT and
+ * HASH in hex.
+ */
+#define AUTH_PBKDF2_PREFIX "$pbkdf2-sha256$"
+
+/**
+ * @brief PBKDF2 iterations for new hashes, 0 for the classic MD5 hashes.
+ */
+static unsigned int kdf_iterations = 0;
+
+/**
+ * @brief An entry of the verification cache.
+ */
+typedef struct
+{
+  gchar *key;     ///< Keyed hash of the credentials, in hex.
+  gint64 expires; ///< Monotonic time at which the entry expires.
+} auth_cache_entry_t;
+
+/**
+ * @brief Seconds a successful verification stays cached, 0 to disable.
+ */
+static unsigned int auth_cache_ttl = 0;
+
+/**
+ * @brief Maximum number of cached verifications.
+ */
+static unsigned int auth_cache_max = 0;
+
+/**
+ * @brief Secret key of the cache hashes, created when the cache is enabled.
+ */
+static guchar auth_cache_secret[32];
+
+/**
+ * @brief Cached verifications, keyed by auth_cache_entry_t key.
+ */
+static GHashTable *auth_cache = NULL;
+
+/**
+ * @brief Cached verifications, oldest first.
+ */
+static GQueue auth_cache_order = G_QUEUE_INIT;
+
+/**
+ * @brief Lock for the verification cache.
+ */
+G_LOCK_DEFINE_STATIC (auth_cache);
+
 /**
  * @brief Return whether libraries has been compiled with LDAP support.
  *
@@ -186,6 +239,293 @@ digest_hex (int gcrypt_algorithm, const guchar *digest)
   return hex;
 }
 
+/**
+ * @brief Set the key derivation used for new password hashes.
+ *
+ * With 0 iterations \ref get_password_hashes makes the classic salted MD5
+ * hashes.  Otherwise it uses PBKDF2 with SHA-256 and the given number of
+ * iterations, trading login throughput for resistance to guessing.
+ * \ref gvm_authenticate_classic verifies both kinds, whatever is set here.
+ *
+ * @param iterations  PBKDF2 iterations, 0 for the classic hashes.
+ */
+void
+gvm_auth_set_kdf_iterations (unsigned int iterations)
+{
+  kdf_iterations = iterations;
+}
+
+/**
+ * @brief Configure the cache of successful verifications.
+ *
+ * \ref gvm_authenticate_classic remembers successful verifications in
+ * memory only, under a keyed hash of the username, password and stored
+ * hash.  An entry is used until it is ttl seconds old, a changed password
+ * hash never matches an old entry.  At most max_entries are kept, the
+ * oldest are dropped first.  The cache is disabled by default.
+ *
+ * @param ttl          Seconds an entry is valid, 0 to disable and clear the
+ *                     cache.
+ * @param max_entries  Maximum number of entries, 0 to disable and clear the
+ *                     cache.
+ */
+void
+gvm_auth_set_cache (unsigned int ttl, unsigned int max_entries)
+{
+  auth_cache_entry_t *entry;
+
+  G_LOCK (auth_cache);
+  while ((entry = g_queue_pop_head (&auth_cache_order)))
+    {
+      g_hash_table_remove (auth_cache, entry->key);
+      g_free (entry->key);
+      g_free (entry);
+    }
+  if (ttl && max_entries)
+    {
+      if (!auth_cache)
+        auth_cache = g_hash_table_new (g_str_hash, g_str_equal);
+      gcry_randomize (auth_cache_secret, sizeof (auth_cache_secret),
+                      GCRY_STRONG_RANDOM);
+    }
+  auth_cache_ttl = max_entries ? ttl : 0;
+  auth_cache_max = max_entries;
+  G_UNLOCK (auth_cache);
+}
+
+/**
+ * @brief Compute the cache key of a credential triple.
+ *
+ * @param username  Username.
+ * @param password  Password.
+ * @param hash_arg  Hash.
+ *
+ * @return HMAC-SHA256 of the arguments in hex, NULL on error.
+ */
+static gchar *
+auth_cache_key (const gchar *username, const gchar *password,
+                const gchar *hash_arg)
+{
+  gcry_md_hd_t hd;
+  gchar *key;
+
+  if (gcry_md_open (&hd, GCRY_MD_SHA256,
+                    GCRY_MD_FLAG_HMAC | GCRY_MD_FLAG_SECURE))
+    return NULL;
+  if (gcry_md_setkey (hd, auth_cache_secret, sizeof (auth_cache_secret)))
+    {
+      gcry_md_close (hd);
+      return NULL;
+    }
+  /* Include the terminators, so that the fields cannot run into each
+   * other. */
+  if (username == NULL)
+    username = "";
+  gcry_md_write (hd, username, strlen (username) + 1);
+  gcry_md_write (hd, password, strlen (password) + 1);
+  gcry_md_write (hd, hash_arg, strlen (hash_arg) + 1);
+  key = digest_hex (GCRY_MD_SHA256, gcry_md_read (hd, GCRY_MD_SHA256));
+  gcry_md_close (hd);
+  return key;
+}
+
+/**
+ * @brief Drop expired and surplus entries from the verification cache.
+ *
+ * Entries expire in the order they were added, so only the head of the
+ * queue needs checking.  Must be called with the cache locked.
+ *
+ * @param now    Current monotonic time.
+ * @param space  Number of entries to make room for.
+ */
+static void
+auth_cache_expire (gint64 now, guint space)
+{
+  auth_cache_entry_t *entry;
+
+  while ((entry = g_queue_peek_head (&auth_cache_order))
+         && (entry->expires <= now
+             || auth_cache_order.length + space > auth_cache_max))
+    {
+      g_queue_pop_head (&auth_cache_order);
+      g_hash_table_remove (auth_cache, entry->key);
+      g_free (entry->key);
+      g_free (entry);
+    }
+}
+
+/**
+ * @brief Check whether a verification is cached.
+ *
+ * @param key  Cache key of the credentials.
+ *
+ * @return 1 if cached, else 0.
+ */
+static int
+auth_cache_lookup (const gchar *key)
+{
+  int found;
+
+  G_LOCK (auth_cache);
+  if (auth_cache_ttl == 0)
+    found = 0;
+  else
+    {
+      auth_cache_expire (g_get_monotonic_time (), 0);
+      found = g_hash_table_contains (auth_cache, key);
+    }
+  G_UNLOCK (auth_cache);
+  return found;
+}
+
+/**
+ * @brief Remember a successful verification.
+ *
+ * @param key  Cache key of the credentials.
+ */
+static void
+auth_cache_add (const gchar *key)
+{
+  auth_cache_entry_t *entry;
+  gint64 now;
+
+  G_LOCK (auth_cache);
+  if (auth_cache_ttl && !g_hash_table_contains (auth_cache, key))
+    {
+      now = g_get_monotonic_time ();
+      auth_cache_expire (now, 1);
+      entry = g_malloc (sizeof (*entry));
+      entry->key = g_strdup (key);
+      entry->expires = now + (gint64) auth_cache_ttl * G_USEC_PER_SEC;
+      g_queue_push_tail (&auth_cache_order, entry);
+      g_hash_table_add (auth_cache, entry->key);
+    }
+  G_UNLOCK (auth_cache);
+}
+
+/**
+ * @brief Compare two strings in time independent of where they differ.
+ *
+ * @param a  First string.
+ * @param b  Second string.
+ *
+ * @return 0 if equal, else 1.
+ */
+static int
+auth_strcmp_const (const gchar *a, const gchar *b)
+{
+  size_t len, i;
+  guchar diff;
+
+  len = strlen (a);
+  if (len != strlen (b))
+    return 1;
+  diff = 0;
+  for (i = 0; i < len; i++)
+    diff |= a[i] ^ b[i];
+  return diff ? 1 : 0;
+}
+
+/**
+ * @brief Derive the PBKDF2 hash of a password.
+ *
+ * @param password    The password in plaintext.
+ * @param salt_hex    The salt, in hex.
+ * @param iterations  Number of iterations.
+ *
+ * @return The derived key in hex, NULL on error.
+ */
+static gchar *
+pbkdf2_hex (const gchar *password, const gchar *salt_hex,
+            unsigned long iterations)
+{
+  guchar key[32];
+  gcry_error_t err;
+  gchar *hex;
+
+  err = gcry_kdf_derive (password, strlen (password), GCRY_KDF_PBKDF2,
+                         GCRY_MD_SHA256, salt_hex, strlen (salt_hex),
+                         iterations, sizeof (key), key);
+  if (err)
+    {
+      g_warning ("%s: key derivation failed: %s", __FUNCTION__,
+                 gcry_strerror (err));
+      return NULL;
+    }
+  hex = digest_hex (GCRY_MD_SHA256, key);
+  memset (key, 0, sizeof (key));
+  return hex;
+}
+
+/**
+ * @brief Generate a PBKDF2 password hash.
+ *
+ * @param password    The password in plaintext.
+ * @param iterations  Number of iterations.
+ *
+ * @return The hash in the \ref AUTH_PBKDF2_PREFIX form, NULL on error.
+ */
+static gchar *
+get_password_hashes_pbkdf2 (const gchar *password, unsigned int iterations)
+{
+  guchar salt[16];
+  gchar salt_hex[sizeof (salt) * 2 + 1];
+  gchar *hash_hex, *hashes_out;
+  unsigned int i;
+
+  gcry_create_nonce (salt, sizeof (salt));
+  for (i = 0; i < sizeof (salt); i++)
+    g_snprintf (salt_hex + i * 2, 3, "%02x", salt[i]);
+
+  hash_hex = pbkdf2_hex (password, salt_hex, iterations);
+  if (hash_hex == NULL)
+    return NULL;
+  hashes_out = g_strdup_printf (AUTH_PBKDF2_PREFIX "%u$%s$%s", iterations,
+                                salt_hex, hash_hex);
+  g_free (hash_hex);
+  return hashes_out;
+}
+
+/**
+ * @brief Verify a password against a PBKDF2 password hash.
+ *
+ * @param password  The password in plaintext.
+ * @param hash_arg  Hash in the \ref AUTH_PBKDF2_PREFIX form.
+ *
+ * @return 0 authentication success, 1 authentication failure, -1 error.
+ */
+static int
+authenticate_pbkdf2 (const gchar *password, const gchar *hash_arg)
+{
+  gchar **split, *end, *hash_hex;
+  unsigned long iterations;
+  int ret;
+
+  split = g_strsplit (hash_arg + strlen (AUTH_PBKDF2_PREFIX), "$", 3);
+  if (g_strv_length (split) != 3 || !*split[1])
+    {
+      g_warning ("Failed to split auth contents.");
+      g_strfreev (split);
+      return -1;
+    }
+  iterations = strtoul (split[0], &end, 10);
+  if (*end || iterations == 0)
+    {
+      g_warning ("Invalid iterations in auth contents.");
+      g_strfreev (split);
+      return -1;
+    }
+
+  hash_hex = pbkdf2_hex (password, split[1], iterations);
+  if (hash_hex == NULL)
+    ret = -1;
+  else
+    ret = auth_strcmp_const (hash_hex, g_strchomp (split[2]));
+  g_free (hash_hex);
+  g_strfreev (split);
+  return ret;
+}
+
 /**
  * @brief Generate a pair of md5 hashes to be used in the "auth/hash"
  * file for the user.
@@ -194,6 +534,9 @@ digest_hex (int gcrypt_algorithm, const guchar *digest)
  * is the message digest of (currently) 256 bytes of random data. h_1 is the
  * message digest of h_2 concatenated with the password in plaintext.
  *
+ * When \ref gvm_auth_set_kdf_iterations set a number of iterations, a
+ * PBKDF2 hash is generated instead.
+ *
  * @param password The password in plaintext.
  *
  * @return A pointer to a gchar containing the two hashes separated by a
@@ -204,6 +547,9 @@ get_password_hashes (const gchar *password)
 {
   g_assert (password);
 
+  if (kdf_iterations)
+    return get_password_hashes_pbkdf2 (password, kdf_iterations);
+
   unsigned char *nonce_buffer[256];
   guchar *seed = g_malloc0 (gcry_md_get_algo_dlen (GCRY_MD_MD5));
   gchar *seed_hex = NULL;
@@ -231,17 +577,15 @@ get_password_hashes (const gchar *password)
 }
 
 /**
- * @brief Authenticate a credential pair against user file contents.
+ * @brief Authenticate a credential pair against classic MD5 hashes.
  *
- * @param username  Username.
  * @param password  Password.
  * @param hash_arg  Hash.
  *
  * @return 0 authentication success, 1 authentication failure, -1 error.
  */
-int
-gvm_authenticate_classic (const gchar *username, const gchar *password,
-                          const gchar *hash_arg)
+static int
+authenticate_md5 (const gchar *password, const gchar *hash_arg)
 {
   int gcrypt_algorithm = GCRY_MD_MD5; // FIX whatever configure used
   int ret;
@@ -249,9 +593,6 @@ gvm_authenticate_classic (const gchar *username, const gchar *password,
   guchar *hash;
   gchar *hash_hex, **seed_hex, **split;
 
-  (void) username;
-  if (hash_arg == NULL)
-    return 1;
   actual = g_strdup (hash_arg);
 
   split = g_strsplit_set (g_strchomp (actual), " ", 2);
@@ -281,3 +622,46 @@ gvm_authenticate_classic (const gchar *username, const gchar *password,
   g_free (actual);
   return ret;
 }
+
+/**
+ * @brief Authenticate a credential pair against user file contents.
+ *
+ * Accepts both the classic MD5 hashes and PBKDF2 hashes.  Successful
+ * verifications are cached when \ref gvm_auth_set_cache enabled the cache.
+ *
+ * @param username  Username.
+ * @param password  Password.
+ * @param hash_arg  Hash.
+ *
+ * @return 0 authentication success, 1 authentication failure, -1 error.
+ */
+int
+gvm_authenticate_classic (const gchar *username, const gchar *password,
+                          const gchar *hash_arg)
+{
+  gchar *key = NULL;
+  int ret;
+
+  if (hash_arg == NULL)
+    return 1;
+
+  if (auth_cache_ttl)
+    {
+      key = auth_cache_key (username, password, hash_arg);
+      if (key && auth_cache_lookup (key))
+        {
+          g_free (key);
+          return 0;
+        }
+    }
+
+  if (g_str_has_prefix (hash_arg, AUTH_PBKDF2_PREFIX))
+    ret = authenticate_pbkdf2 (password, hash_arg);
+  else
+    ret = authenticate_md5 (password, hash_arg);
+
+  if (ret == 0 && key)
+    auth_cache_add (key);
+  g_free (key);
+  return ret;
+}
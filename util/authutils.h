@@ -55,6 +55,12 @@ gvm_authenticate_classic (const gchar *, const gchar *, const gchar *);
 gchar *
 get_password_hashes (const gchar *);
 
+void
+gvm_auth_set_kdf_iterations (unsigned int);
+
+void
+gvm_auth_set_cache (unsigned int, unsigned int);
+
 gchar *
 digest_hex (int, const guchar *);
 
@@ -31,8 +31,59 @@
 
 #include "compressutils.h"
 
-#include <glib.h> /* for g_free, g_malloc0 */
-#include <zlib.h> /* for z_stream, Z_NULL, Z_OK, Z_BUF_ERROR, Z_STREAM_END */
+#include <errno.h>  /* for errno, EINTR */
+#include <glib.h>   /* for g_free, g_malloc */
+#include <limits.h> /* for INT_MAX */
+#include <stdio.h>  /* for fwrite */
+#include <string.h> /* for memcmp, memcpy, strerror */
+#include <unistd.h> /* for write */
+#include <zlib.h>   /* for z_stream, Z_NULL, Z_OK, Z_BUF_ERROR, Z_STREAM_END */
+#ifdef HAVE_ZSTD
+#include <zstd.h> /* for ZSTD_compress, ZSTD_decompress */
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h> /* for LZ4_compress_default, LZ4_decompress_safe */
+#endif
+
+#undef G_LOG_DOMAIN
+/**
+ * @brief GLib log domain.
+ */
+#define G_LOG_DOMAIN "lib  compress"
+
+/**
+ * @brief Room for the empty block of a sync flush, beyond deflateBound.
+ */
+#define COMPRESS_FLUSH_SIZE 16
+
+/**
+ * @brief Magic bytes at the start of a frame of gvm_compress_frame.
+ */
+#define COMPRESS_FRAME_MAGIC "GVZ"
+
+/**
+ * @brief Size of the frame header: magic, codec, and 64 bit little endian
+ *        length of the uncompressed data.
+ */
+#define COMPRESS_FRAME_HEADER_SIZE 12
+
+/**
+ * @brief Size of the output buffer of a compression stream.
+ */
+#define COMPRESS_STREAM_CHUNK_SIZE 65536
+
+/**
+ * @brief Compression or decompression stream.
+ */
+struct gvm_compress_stream
+{
+  z_stream strm;            /**< zlib stream. */
+  int inflate;              /**< Whether decompressing. */
+  int ended;                /**< Whether the end of the stream was reached. */
+  gvm_compress_sink_t sink; /**< Function to write the output to. */
+  void *sink_data;          /**< Data for the sink. */
+  unsigned char *buffer;    /**< Output buffer. */
+};
 
 /**
  * @brief Compresses data in src buffer.
@@ -46,14 +97,11 @@
 void *
 gvm_compress (const void *src, unsigned long srclen, unsigned long *dstlen)
 {
-  unsigned long buflen = srclen * 2;
+  unsigned long buflen = 0;
 
   if (src == NULL || dstlen == NULL)
     return NULL;
 
-  if (buflen < 30)
-    buflen = 30;
-
   while (1)
     {
       int err;
@@ -74,7 +122,12 @@ gvm_compress (const void *src, unsigned long srclen, unsigned long *dstlen)
       if (deflateInit (&strm, Z_DEFAULT_COMPRESSION) != Z_OK)
         return NULL;
 
-      buffer = g_malloc0 (buflen);
+      /* The bound is for a finished stream, the sync flush adds an empty
+       * block instead of the end of the stream. */
+      if (buflen == 0)
+        buflen = deflateBound (&strm, srclen) + COMPRESS_FLUSH_SIZE;
+
+      buffer = g_malloc (buflen);
       strm.avail_out = buflen;
       strm.next_out = buffer;
 
@@ -115,41 +168,45 @@ void *
 gvm_uncompress (const void *src, unsigned long srclen, unsigned long *dstlen)
 {
   unsigned long buflen = srclen * 2;
+  char *buffer;
+  z_stream strm;
 
   if (src == NULL || dstlen == NULL)
     return NULL;
 
-  while (1)
-    {
-      int err;
-      void *buffer;
-      z_stream strm;
+  if (buflen < 30)
+    buflen = 30;
 
-      /* Initialize inflate state */
-      strm.zalloc = Z_NULL;
-      strm.zfree = Z_NULL;
-      strm.opaque = Z_NULL;
-      strm.avail_in = srclen;
+  /* Initialize inflate state */
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  strm.avail_in = srclen;
 #ifdef z_const
-      strm.next_in = src;
+  strm.next_in = src;
 #else
-      /* Workaround for older zlib. */
-      strm.next_in = (void *) src;
+  /* Workaround for older zlib. */
+  strm.next_in = (void *) src;
 #endif
-      /*
-       * From: http://www.zlib.net/manual.html
-       * Add 32 to windowBits to enable zlib and gzip decoding with automatic
-       * header detection.
-       */
-      if (inflateInit2 (&strm, 15 + 32) != Z_OK)
-        return NULL;
+  /*
+   * From: http://www.zlib.net/manual.html
+   * Add 32 to windowBits to enable zlib and gzip decoding with automatic
+   * header detection.
+   */
+  if (inflateInit2 (&strm, 15 + 32) != Z_OK)
+    return NULL;
 
-      buffer = g_malloc0 (buflen);
-      strm.avail_out = buflen;
-      strm.next_out = buffer;
+  buffer = g_malloc (buflen);
+  strm.avail_out = buflen;
+  strm.next_out = (Bytef *) buffer;
+
+  /* Grow the buffer as it fills, carrying on with the same stream instead
+   * of inflating again from the start. */
+  while (1)
+    {
+      int err;
 
       err = inflate (&strm, Z_SYNC_FLUSH);
-      inflateEnd (&strm);
       switch (err)
         {
         case Z_OK:
@@ -157,15 +214,26 @@ gvm_uncompress (const void *src, unsigned long srclen, unsigned long *dstlen)
           if (strm.avail_out != 0)
             {
               *dstlen = strm.total_out;
+              inflateEnd (&strm);
               return buffer;
             }
           /* Fallthrough. */
         case Z_BUF_ERROR:
-          g_free (buffer);
+          if (strm.avail_out != 0)
+            {
+              /* No progress possible, the input is truncated. */
+              inflateEnd (&strm);
+              g_free (buffer);
+              return NULL;
+            }
+          buffer = g_realloc (buffer, buflen * 2);
+          strm.next_out = (Bytef *) buffer + buflen;
+          strm.avail_out = buflen;
           buflen *= 2;
           break;
 
         default:
+          inflateEnd (&strm);
           g_free (buffer);
           return NULL;
         }
@@ -185,16 +253,13 @@ void *
 gvm_compress_gzipheader (const void *src, unsigned long srclen,
                          unsigned long *dstlen)
 {
-  unsigned long buflen = srclen * 2;
+  unsigned long buflen = 0;
   int windowsBits = 15;
   int GZIP_ENCODING = 16;
 
   if (src == NULL || dstlen == NULL)
     return NULL;
 
-  if (buflen < 30)
-    buflen = 30;
-
   while (1)
     {
       int err;
@@ -218,7 +283,10 @@ gvm_compress_gzipheader (const void *src, unsigned long srclen,
           != Z_OK)
         return NULL;
 
-      buffer = g_malloc0 (buflen);
+      if (buflen == 0)
+        buflen = deflateBound (&strm, srclen);
+
+      buffer = g_malloc (buflen);
       strm.avail_out = buflen;
       strm.next_out = buffer;
 
@@ -245,3 +313,495 @@ gvm_compress_gzipheader (const void *src, unsigned long srclen,
         }
     }
 }
+
+/**
+ * @brief Create a compression stream.
+ *
+ * @param[in]  gzip       Whether to write the gzip format, else the zlib
+ *                        format.
+ * @param[in]  sink       Function to write the compressed data to.
+ * @param[in]  sink_data  Data for the sink, for example the GString of
+ *                        gvm_compress_sink_gstring.
+ *
+ * @return New stream, to free with gvm_compress_stream_free, NULL on error.
+ */
+gvm_compress_stream_t *
+gvm_compress_stream_new (int gzip, gvm_compress_sink_t sink, void *sink_data)
+{
+  gvm_compress_stream_t *stream;
+
+  if (sink == NULL)
+    return NULL;
+
+  stream = g_malloc0 (sizeof (*stream));
+  stream->strm.zalloc = Z_NULL;
+  stream->strm.zfree = Z_NULL;
+  stream->strm.opaque = Z_NULL;
+  if (deflateInit2 (&stream->strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                    gzip ? 15 | 16 : 15, 8, Z_DEFAULT_STRATEGY)
+      != Z_OK)
+    {
+      g_free (stream);
+      return NULL;
+    }
+  stream->sink = sink;
+  stream->sink_data = sink_data;
+  stream->buffer = g_malloc (COMPRESS_STREAM_CHUNK_SIZE);
+  return stream;
+}
+
+/**
+ * @brief Create a decompression stream.
+ *
+ * The zlib and gzip formats are both accepted.
+ *
+ * @param[in]  sink       Function to write the uncompressed data to.
+ * @param[in]  sink_data  Data for the sink.
+ *
+ * @return New stream, to free with gvm_compress_stream_free, NULL on error.
+ */
+gvm_compress_stream_t *
+gvm_uncompress_stream_new (gvm_compress_sink_t sink, void *sink_data)
+{
+  gvm_compress_stream_t *stream;
+
+  if (sink == NULL)
+    return NULL;
+
+  stream = g_malloc0 (sizeof (*stream));
+  stream->strm.zalloc = Z_NULL;
+  stream->strm.zfree = Z_NULL;
+  stream->strm.opaque = Z_NULL;
+  stream->strm.avail_in = 0;
+  stream->strm.next_in = Z_NULL;
+  if (inflateInit2 (&stream->strm, 15 + 32) != Z_OK)
+    {
+      g_free (stream);
+      return NULL;
+    }
+  stream->inflate = 1;
+  stream->sink = sink;
+  stream->sink_data = sink_data;
+  stream->buffer = g_malloc (COMPRESS_STREAM_CHUNK_SIZE);
+  return stream;
+}
+
+/**
+ * @brief Run the input of a stream through zlib, writing the output to the
+ *        sink a buffer at a time.
+ *
+ * @param[in]  stream  Stream.
+ * @param[in]  flush   zlib flush mode.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+gvm_compress_stream_run (gvm_compress_stream_t *stream, int flush)
+{
+  while (stream->ended == 0)
+    {
+      int err;
+      size_t count;
+
+      stream->strm.next_out = stream->buffer;
+      stream->strm.avail_out = COMPRESS_STREAM_CHUNK_SIZE;
+      if (stream->inflate)
+        err = inflate (&stream->strm, flush);
+      else
+        err = deflate (&stream->strm, flush);
+      if (err == Z_STREAM_END)
+        stream->ended = 1;
+      else if (err != Z_OK && err != Z_BUF_ERROR)
+        {
+          g_warning ("%s: %s", __FUNCTION__,
+                     stream->strm.msg ? stream->strm.msg : "zlib error");
+          return -1;
+        }
+
+      count = COMPRESS_STREAM_CHUNK_SIZE - stream->strm.avail_out;
+      if (count && stream->sink (stream->buffer, count, stream->sink_data))
+        return -1;
+
+      /* Done once zlib has room left over, so holds nothing back. */
+      if (stream->strm.avail_out != 0 && stream->strm.avail_in == 0)
+        break;
+      if (count == 0)
+        {
+          /* No progress possible, the input is truncated. */
+          if (flush == Z_FINISH)
+            return -1;
+          break;
+        }
+    }
+  return 0;
+}
+
+/**
+ * @brief Feed data to a stream.
+ *
+ * The output is written to the sink as it becomes available.
+ *
+ * @param[in]  stream  Stream.
+ * @param[in]  src     Data.
+ * @param[in]  srclen  Length of data.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_compress_stream_feed (gvm_compress_stream_t *stream, const void *src,
+                          size_t srclen)
+{
+  if (stream == NULL || (src == NULL && srclen))
+    return -1;
+
+  while (srclen)
+    {
+      /* avail_in is only an unsigned int. */
+      uInt chunk = srclen > G_MAXUINT ? G_MAXUINT : srclen;
+
+#ifdef z_const
+      stream->strm.next_in = src;
+#else
+      /* Workaround for older zlib. */
+      stream->strm.next_in = (void *) src;
+#endif
+      stream->strm.avail_in = chunk;
+      if (gvm_compress_stream_run (stream, Z_NO_FLUSH))
+        return -1;
+      /* Data after the end of a compressed stream is ignored. */
+      if (stream->ended)
+        break;
+      src = (const char *) src + chunk;
+      srclen -= chunk;
+    }
+  return 0;
+}
+
+/**
+ * @brief Finish a stream, writing the rest of the output to the sink.
+ *
+ * @param[in]  stream  Stream.
+ *
+ * @return 0 on success, -1 on error.  For decompression, an input that
+ *         lacks the end of the compressed stream, like the output of
+ *         gvm_compress, is not an error.
+ */
+int
+gvm_compress_stream_finish (gvm_compress_stream_t *stream)
+{
+  if (stream == NULL)
+    return -1;
+
+  stream->strm.next_in = Z_NULL;
+  stream->strm.avail_in = 0;
+  if (stream->inflate)
+    return gvm_compress_stream_run (stream, Z_SYNC_FLUSH);
+  return gvm_compress_stream_run (stream, Z_FINISH);
+}
+
+/**
+ * @brief Free a stream.
+ *
+ * @param[in]  stream  Stream.
+ */
+void
+gvm_compress_stream_free (gvm_compress_stream_t *stream)
+{
+  if (stream == NULL)
+    return;
+  if (stream->inflate)
+    inflateEnd (&stream->strm);
+  else
+    deflateEnd (&stream->strm);
+  g_free (stream->buffer);
+  g_free (stream);
+}
+
+/**
+ * @brief Sink writing to a GString.
+ *
+ * @param[in]  data    Data to write.
+ * @param[in]  length  Length of data.
+ * @param[in]  string  GString to append to.
+ *
+ * @return 0.
+ */
+int
+gvm_compress_sink_gstring (const void *data, size_t length, void *string)
+{
+  g_string_append_len (string, data, length);
+  return 0;
+}
+
+/**
+ * @brief Sink writing to a FILE.
+ *
+ * @param[in]  data    Data to write.
+ * @param[in]  length  Length of data.
+ * @param[in]  file    FILE to write to.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_compress_sink_file (const void *data, size_t length, void *file)
+{
+  if (fwrite (data, 1, length, file) != length)
+    {
+      g_warning ("%s: Failed to write: %s", __FUNCTION__, strerror (errno));
+      return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Sink writing to a file descriptor.
+ *
+ * @param[in]  data    Data to write.
+ * @param[in]  length  Length of data.
+ * @param[in]  fd      File descriptor, stored with GINT_TO_POINTER.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_compress_sink_fd (const void *data, size_t length, void *fd)
+{
+  while (length)
+    {
+      ssize_t count;
+
+      count = write (GPOINTER_TO_INT (fd), data, length);
+      if (count < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_warning ("%s: Failed to write: %s", __FUNCTION__,
+                     strerror (errno));
+          return -1;
+        }
+      data = (const char *) data + count;
+      length -= count;
+    }
+  return 0;
+}
+
+/**
+ * @brief Whether a codec was built in.
+ *
+ * @param[in]  codec  Codec.
+ *
+ * @return 1 if the codec is available, 0 otherwise.
+ */
+int
+gvm_compress_codec_available (gvm_compress_codec_t codec)
+{
+  switch (codec)
+    {
+    case GVM_COMPRESS_CODEC_ZLIB:
+      return 1;
+#ifdef HAVE_ZSTD
+    case GVM_COMPRESS_CODEC_ZSTD:
+      return 1;
+#endif
+#ifdef HAVE_LZ4
+    case GVM_COMPRESS_CODEC_LZ4:
+      return 1;
+#endif
+    default:
+      return 0;
+    }
+}
+
+/**
+ * @brief Compresses data in src buffer with a codec, in a framed format.
+ *
+ * The frame starts with a header naming the codec and the length of the
+ * data, so that gvm_uncompress_frame can uncompress it whichever codec was
+ * used.  Faster codecs trade compression ratio for speed.
+ *
+ * @param[in]   codec   Codec to compress with.
+ * @param[in]   src     Buffer of data to compress.
+ * @param[in]   srclen  Length of data to compress.
+ * @param[out]  dstlen  Length of compressed data.
+ *
+ * @return Pointer to compressed data if success, NULL otherwise, also if the
+ *         codec is not available.
+ */
+void *
+gvm_compress_frame (gvm_compress_codec_t codec, const void *src,
+                    unsigned long srclen, unsigned long *dstlen)
+{
+  unsigned char *buffer;
+  size_t bound, length;
+  guint64 size;
+
+  if (src == NULL || dstlen == NULL)
+    return NULL;
+
+  switch (codec)
+    {
+    case GVM_COMPRESS_CODEC_ZLIB:
+      bound = compressBound (srclen);
+      break;
+#ifdef HAVE_ZSTD
+    case GVM_COMPRESS_CODEC_ZSTD:
+      bound = ZSTD_compressBound (srclen);
+      break;
+#endif
+#ifdef HAVE_LZ4
+    case GVM_COMPRESS_CODEC_LZ4:
+      if (srclen > LZ4_MAX_INPUT_SIZE)
+        return NULL;
+      bound = LZ4_compressBound (srclen);
+      break;
+#endif
+    default:
+      g_warning ("%s: Codec %d not available", __FUNCTION__, codec);
+      return NULL;
+    }
+
+  buffer = g_malloc (COMPRESS_FRAME_HEADER_SIZE + bound);
+  memcpy (buffer, COMPRESS_FRAME_MAGIC, 3);
+  buffer[3] = codec;
+  size = GUINT64_TO_LE ((guint64) srclen);
+  memcpy (buffer + 4, &size, sizeof (size));
+
+  switch (codec)
+    {
+    case GVM_COMPRESS_CODEC_ZLIB:
+      {
+        uLongf zlength = bound;
+
+        if (compress2 (buffer + COMPRESS_FRAME_HEADER_SIZE, &zlength, src,
+                       srclen, Z_DEFAULT_COMPRESSION)
+            != Z_OK)
+          {
+            g_free (buffer);
+            return NULL;
+          }
+        length = zlength;
+        break;
+      }
+#ifdef HAVE_ZSTD
+    case GVM_COMPRESS_CODEC_ZSTD:
+      length = ZSTD_compress (buffer + COMPRESS_FRAME_HEADER_SIZE, bound, src,
+                              srclen, ZSTD_CLEVEL_DEFAULT);
+      if (ZSTD_isError (length))
+        {
+          g_free (buffer);
+          return NULL;
+        }
+      break;
+#endif
+#ifdef HAVE_LZ4
+    case GVM_COMPRESS_CODEC_LZ4:
+      {
+        int lz4_length;
+
+        lz4_length = LZ4_compress_default (
+          src, (char *) buffer + COMPRESS_FRAME_HEADER_SIZE, srclen, bound);
+        if (lz4_length <= 0)
+          {
+            g_free (buffer);
+            return NULL;
+          }
+        length = lz4_length;
+        break;
+      }
+#endif
+    default:
+      g_free (buffer);
+      return NULL;
+    }
+
+  *dstlen = COMPRESS_FRAME_HEADER_SIZE + length;
+  return buffer;
+}
+
+/**
+ * @brief Uncompresses data in src buffer, detecting the codec.
+ *
+ * Takes the output of gvm_compress_frame with any codec, as well as data in
+ * the zlib or gzip formats, like gvm_uncompress.
+ *
+ * @param[in]   src     Buffer of data to uncompress.
+ * @param[in]   srclen  Length of data to uncompress.
+ * @param[out]  dstlen  Length of uncompressed data.
+ *
+ * @return Pointer to uncompressed data if success, NULL otherwise.
+ */
+void *
+gvm_uncompress_frame (const void *src, unsigned long srclen,
+                      unsigned long *dstlen)
+{
+  const unsigned char *frame = src;
+  const unsigned char *data;
+  unsigned long datalen;
+  unsigned char *buffer;
+  guint64 size;
+
+  if (src == NULL || dstlen == NULL)
+    return NULL;
+
+  if (srclen < COMPRESS_FRAME_HEADER_SIZE
+      || memcmp (frame, COMPRESS_FRAME_MAGIC, 3))
+    return gvm_uncompress (src, srclen, dstlen);
+
+  memcpy (&size, frame + 4, sizeof (size));
+  size = GUINT64_FROM_LE (size);
+  data = frame + COMPRESS_FRAME_HEADER_SIZE;
+  datalen = srclen - COMPRESS_FRAME_HEADER_SIZE;
+  if (size > G_MAXSIZE - 1)
+    return NULL;
+
+  /* One more byte, so that empty data still gets a buffer. */
+  buffer = g_try_malloc (size + 1);
+  if (buffer == NULL)
+    {
+      g_warning ("%s: Frame too large: %" G_GUINT64_FORMAT, __FUNCTION__,
+                 size);
+      return NULL;
+    }
+
+  switch (frame[3])
+    {
+    case GVM_COMPRESS_CODEC_ZLIB:
+      {
+        uLongf zlength = size;
+
+        if (uncompress (buffer, &zlength, data, datalen) != Z_OK
+            || zlength != size)
+          goto fail;
+        break;
+      }
+#ifdef HAVE_ZSTD
+    case GVM_COMPRESS_CODEC_ZSTD:
+      {
+        size_t length;
+
+        length = ZSTD_decompress (buffer, size, data, datalen);
+        if (ZSTD_isError (length) || length != size)
+          goto fail;
+        break;
+      }
+#endif
+#ifdef HAVE_LZ4
+    case GVM_COMPRESS_CODEC_LZ4:
+      if (size > LZ4_MAX_INPUT_SIZE || datalen > INT_MAX
+          || LZ4_decompress_safe ((const char *) data, (char *) buffer,
+                                  datalen, size)
+               != (int) size)
+        goto fail;
+      break;
+#endif
+    default:
+      g_warning ("%s: Codec %d not available", __FUNCTION__, frame[3]);
+      goto fail;
+    }
+
+  *dstlen = size;
+  return buffer;
+
+fail:
+  g_free (buffer);
+  return NULL;
+}
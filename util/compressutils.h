@@ -25,6 +25,33 @@
 #ifndef _GVM_COMPRESSUTILS_H
 #define _GVM_COMPRESSUTILS_H
 
+#include <stddef.h> /* for size_t */
+
+/**
+ * @brief Codecs of gvm_compress_frame.
+ *
+ * The values are stored in the frames, so must not change.
+ */
+typedef enum
+{
+  GVM_COMPRESS_CODEC_ZLIB = 1, /**< zlib deflate, always available. */
+  GVM_COMPRESS_CODEC_ZSTD = 2, /**< Zstandard, if built with zstd. */
+  GVM_COMPRESS_CODEC_LZ4 = 3,  /**< LZ4, fastest, if built with lz4. */
+} gvm_compress_codec_t;
+
+/**
+ * @brief Compression or decompression stream.
+ */
+typedef struct gvm_compress_stream gvm_compress_stream_t;
+
+/**
+ * @brief Function a stream writes its output to.
+ *
+ * Gets the data, its length and the sink data of the stream.  Returns 0 on
+ * success, -1 on error.
+ */
+typedef int (*gvm_compress_sink_t) (const void *, size_t, void *);
+
 void *
 gvm_compress (const void *, unsigned long, unsigned long *);
 
@@ -34,4 +61,38 @@ gvm_compress_gzipheader (const void *, unsigned long, unsigned long *);
 void *
 gvm_uncompress (const void *, unsigned long, unsigned long *);
 
+int
+gvm_compress_codec_available (gvm_compress_codec_t);
+
+void *
+gvm_compress_frame (gvm_compress_codec_t, const void *, unsigned long,
+                    unsigned long *);
+
+void *
+gvm_uncompress_frame (const void *, unsigned long, unsigned long *);
+
+gvm_compress_stream_t *
+gvm_compress_stream_new (int, gvm_compress_sink_t, void *);
+
+gvm_compress_stream_t *
+gvm_uncompress_stream_new (gvm_compress_sink_t, void *);
+
+int
+gvm_compress_stream_feed (gvm_compress_stream_t *, const void *, size_t);
+
+int
+gvm_compress_stream_finish (gvm_compress_stream_t *);
+
+void
+gvm_compress_stream_free (gvm_compress_stream_t *);
+
+int
+gvm_compress_sink_gstring (const void *, size_t, void *);
+
+int
+gvm_compress_sink_file (const void *, size_t, void *);
+
+int
+gvm_compress_sink_fd (const void *, size_t, void *);
+
 #endif /* not _GVM_COMPRESSUTILS_H */
@@ -27,13 +27,22 @@
 
 #include "fileutils.h"
 
+#include <dirent.h>      /* for fdopendir, readdir, DT_DIR */
 #include <errno.h>       /* for errno */
+#include <fcntl.h>       /* for open, openat, O_RDONLY, O_CLOEXEC */
 #include <gio/gio.h>     /* for g_file_new_for_path, GFile */
-#include <glib/gstdio.h> /* for g_lstat, g_remove */
+#include <glib/gstdio.h> /* for g_lstat, g_remove, g_stat */
 #include <glib/gtypes.h> /* for gsize */
+#include <stdio.h>       /* for rename */
 #include <string.h>      /* for strlen, memset, strcmp */
+#include <sys/ioctl.h>   /* for ioctl */
 #include <sys/stat.h>    /* for stat, S_ISDIR */
 #include <time.h>        /* for tm, strptime, localtime, time, time_t */
+#include <unistd.h>      /* for close, ftruncate, read, unlinkat */
+#ifdef __linux__
+#include <linux/fs.h>     /* for FICLONE */
+#include <sys/sendfile.h> /* for sendfile */
+#endif
 
 /**
  * @brief Checks whether a file is a directory or not.
@@ -63,11 +72,112 @@ gvm_file_check_is_dir (const char *name)
   return (S_ISDIR (sb.st_mode));
 }
 
+/**
+ * @brief Remove a directory entry that turned out, or is known, to be a
+ *        directory.
+ *
+ * @param[in]  parent_fd  Descriptor of the parent directory.
+ * @param[in]  name       Name of the directory in the parent.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+file_remove_dir_at (int parent_fd, const char *name);
+
+/**
+ * @brief Remove the entries of a directory, recursively.
+ *
+ * Works relative to the directory descriptor, so the paths of the entries
+ * are never built.
+ *
+ * @param[in]  fd      Descriptor of the directory.
+ * @param[in]  subdir  Function for the subdirectories, for example to remove
+ *                     them in another thread.  NULL to remove them right
+ *                     away.
+ * @param[in]  data    Data for subdir.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+file_remove_entries_at (int fd, void (*subdir) (int, const char *, void *),
+                        void *data)
+{
+  struct dirent *entry;
+  DIR *dir;
+  int dir_fd, ret = 0;
+
+  /* closedir closes the descriptor it gets. */
+  dir_fd = dup (fd);
+  if (dir_fd == -1 || (dir = fdopendir (dir_fd)) == NULL)
+    {
+      g_warning ("%s: fdopendir failed - %s\n", __FUNCTION__,
+                 g_strerror (errno));
+      if (dir_fd != -1)
+        close (dir_fd);
+      return -1;
+    }
+
+  while ((entry = readdir (dir)))
+    {
+      const char *name = entry->d_name;
+      gboolean is_dir;
+
+      if (strcmp (name, ".") == 0 || strcmp (name, "..") == 0)
+        continue;
+
+      is_dir = entry->d_type == DT_DIR;
+      if (is_dir == FALSE && unlinkat (fd, name, 0))
+        {
+          /* Linux says EISDIR for directories, POSIX EPERM. */
+          if (errno != EISDIR && errno != EPERM)
+            {
+              g_warning ("%s: Failed to remove %s - %s\n", __FUNCTION__,
+                         name, g_strerror (errno));
+              ret = -1;
+              continue;
+            }
+          is_dir = TRUE;
+        }
+      if (is_dir == FALSE)
+        continue;
+      if (subdir)
+        subdir (fd, name, data);
+      else if (file_remove_dir_at (fd, name))
+        ret = -1;
+    }
+  closedir (dir);
+  return ret;
+}
+
+static int
+file_remove_dir_at (int parent_fd, const char *name)
+{
+  int fd, ret;
+
+  fd = openat (parent_fd, name,
+               O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd == -1)
+    {
+      g_warning ("%s: Failed to open %s - %s\n", __FUNCTION__, name,
+                 g_strerror (errno));
+      return -1;
+    }
+  ret = file_remove_entries_at (fd, NULL, NULL);
+  close (fd);
+  if (ret == 0 && unlinkat (parent_fd, name, AT_REMOVEDIR))
+    {
+      g_warning ("%s: Failed to remove %s - %s\n", __FUNCTION__, name,
+                 g_strerror (errno));
+      ret = -1;
+    }
+  return ret;
+}
+
 /**
  * @brief Recursively removes files and directories.
  *
- * This function will recursively call itself to delete a path and any
- * contents of this path.
+ * The tree is walked with openat and unlinkat, relative to the descriptor
+ * of each directory.
  *
  * @param[in]  pathname  The name of the file to be deleted from the filesystem.
  *
@@ -78,37 +188,345 @@ gvm_file_remove_recurse (const gchar *pathname)
 {
   if (gvm_file_check_is_dir (pathname) == 1)
     {
-      GError *error = NULL;
-      GDir *directory = g_dir_open (pathname, 0, &error);
-
-      if (directory == NULL)
+      if (file_remove_dir_at (AT_FDCWD, pathname))
         {
-          g_warning ("g_dir_open(%s) failed - %s\n", pathname, error->message);
-          g_error_free (error);
+          g_warning ("Failed to remove %s!", pathname);
           return -1;
         }
-      else
+      return 0;
+    }
+
+  return g_remove (pathname);
+}
+
+/**
+ * @brief Shared state of a parallel removal.
+ */
+typedef struct
+{
+  GThreadPool *pool; /**< Workers. */
+  GMutex lock;       /**< Lock for done. */
+  GCond cond;        /**< Signalled when done. */
+  gboolean done;     /**< Whether the whole tree is removed. */
+  gint failed;       /**< Whether anything failed. */
+} file_remove_t;
+
+/**
+ * @brief Directory of a parallel removal.
+ *
+ * A directory is removed once it is scanned and all its subdirectories are
+ * removed, so its descriptor stays open until then, for the subdirectories
+ * to work relative to.
+ */
+typedef struct file_remove_dir
+{
+  struct file_remove_dir *parent; /**< Parent, NULL for the top. */
+  int parent_fd;                  /**< Descriptor of the parent. */
+  gchar *name;                    /**< Name in the parent. */
+  int fd;                         /**< Descriptor, once open. */
+  int depth;                      /**< Depth in the tree. */
+  gint refs;                      /**< Scan and subdirectories pending. */
+  file_remove_t *remove;          /**< Shared state. */
+} file_remove_dir_t;
+
+/**
+ * @brief Drop a reference to a directory of a parallel removal, removing
+ *        it with the last one.
+ *
+ * @param[in]  dir  Directory.
+ */
+static void
+file_remove_dir_unref (file_remove_dir_t *dir)
+{
+  while (dir && g_atomic_int_dec_and_test (&dir->refs))
+    {
+      file_remove_dir_t *parent = dir->parent;
+      file_remove_t *remove = dir->remove;
+
+      if (dir->fd != -1)
+        close (dir->fd);
+      if (g_atomic_int_get (&remove->failed) == 0
+          && unlinkat (dir->parent_fd, dir->name, AT_REMOVEDIR))
+        {
+          g_warning ("%s: Failed to remove %s - %s\n", __FUNCTION__,
+                     dir->name, g_strerror (errno));
+          g_atomic_int_set (&remove->failed, 1);
+        }
+      g_free (dir->name);
+      g_free (dir);
+      if (parent == NULL)
         {
-          int ret = 0;
-          const gchar *entry = NULL;
+          g_mutex_lock (&remove->lock);
+          remove->done = TRUE;
+          g_cond_signal (&remove->cond);
+          g_mutex_unlock (&remove->lock);
+        }
+      dir = parent;
+    }
+}
 
-          while ((entry = g_dir_read_name (directory)) && (ret == 0))
-            {
-              gchar *entry_path = g_build_filename (pathname, entry, NULL);
-              ret = gvm_file_remove_recurse (entry_path);
-              g_free (entry_path);
-              if (ret != 0)
-                {
-                  g_warning ("Failed to remove %s from %s!", entry, pathname);
-                  g_dir_close (directory);
-                  return ret;
-                }
-            }
-          g_dir_close (directory);
+/**
+ * @brief Queue a subdirectory of a parallel removal.
+ *
+ * @param[in]  fd    Descriptor of the parent.
+ * @param[in]  name  Name of the subdirectory.
+ * @param[in]  data  Parent.
+ */
+static void
+file_remove_subdir (int fd, const char *name, void *data)
+{
+  file_remove_dir_t *parent = data;
+  file_remove_dir_t *dir;
+
+  dir = g_malloc (sizeof (*dir));
+  dir->parent = parent;
+  dir->parent_fd = fd;
+  dir->name = g_strdup (name);
+  dir->fd = -1;
+  dir->depth = parent->depth + 1;
+  dir->refs = 1;
+  dir->remove = parent->remove;
+  g_atomic_int_inc (&parent->refs);
+  g_thread_pool_push (parent->remove->pool, dir, NULL);
+}
+
+/**
+ * @brief Scan a directory of a parallel removal, in a worker.
+ *
+ * @param[in]  data       Directory.
+ * @param[in]  user_data  Unused.
+ */
+static void
+file_remove_worker (gpointer data, gpointer user_data)
+{
+  file_remove_dir_t *dir = data;
+
+  (void) user_data;
+  dir->fd = openat (dir->parent_fd, dir->name,
+                    O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (dir->fd == -1)
+    {
+      g_warning ("%s: Failed to open %s - %s\n", __FUNCTION__, dir->name,
+                 g_strerror (errno));
+      g_atomic_int_set (&dir->remove->failed, 1);
+    }
+  else if (file_remove_entries_at (dir->fd, file_remove_subdir, dir))
+    g_atomic_int_set (&dir->remove->failed, 1);
+  file_remove_dir_unref (dir);
+}
+
+/**
+ * @brief Order the directories of a parallel removal, deepest first.
+ *
+ * Finishing subtrees before starting new ones keeps few directories open.
+ *
+ * @param[in]  a          Directory.
+ * @param[in]  b          Directory.
+ * @param[in]  user_data  Unused.
+ *
+ * @return Negative if a goes first, positive if b does.
+ */
+static gint
+file_remove_compare (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  (void) user_data;
+  return ((const file_remove_dir_t *) b)->depth
+         - ((const file_remove_dir_t *) a)->depth;
+}
+
+/**
+ * @brief Recursively removes files and directories, with worker threads.
+ *
+ * Like gvm_file_remove_recurse, except that subtrees are removed in
+ * parallel, which is much faster on network storage.
+ *
+ * @param[in]  pathname  The name of the file to be deleted from the filesystem.
+ * @param[in]  workers   Number of worker threads.  1 or less to work in the
+ *                       calling thread, like gvm_file_remove_recurse.
+ *
+ * @return 0 if the name was successfully deleted, -1 if an error occurred.
+ */
+int
+gvm_file_remove_recurse_parallel (const gchar *pathname, int workers)
+{
+  file_remove_dir_t *top;
+  file_remove_t remove;
+
+  if (workers <= 1 || gvm_file_check_is_dir (pathname) != 1)
+    return gvm_file_remove_recurse (pathname);
+
+  remove.pool = g_thread_pool_new (file_remove_worker, NULL, workers, TRUE,
+                                   NULL);
+  if (remove.pool == NULL)
+    return gvm_file_remove_recurse (pathname);
+  g_thread_pool_set_sort_function (remove.pool, file_remove_compare, NULL);
+  g_mutex_init (&remove.lock);
+  g_cond_init (&remove.cond);
+  remove.done = FALSE;
+  remove.failed = 0;
+
+  top = g_malloc (sizeof (*top));
+  top->parent = NULL;
+  top->parent_fd = AT_FDCWD;
+  top->name = g_strdup (pathname);
+  top->fd = -1;
+  top->depth = 0;
+  top->refs = 1;
+  top->remove = &remove;
+  g_thread_pool_push (remove.pool, top, NULL);
+
+  g_mutex_lock (&remove.lock);
+  while (remove.done == FALSE)
+    g_cond_wait (&remove.cond, &remove.lock);
+  g_mutex_unlock (&remove.lock);
+
+  g_thread_pool_free (remove.pool, FALSE, TRUE);
+  g_mutex_clear (&remove.lock);
+  g_cond_clear (&remove.cond);
+  if (remove.failed)
+    {
+      g_warning ("Failed to remove %s!", pathname);
+      return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Most bytes copied by one copy_file_range or sendfile call.
+ */
+#define FILE_COPY_CHUNK 0x40000000
+
+/**
+ * @brief Copy the data of a file to another one, within the kernel.
+ *
+ * Tries a reflink first, which shares the blocks on filesystems that support
+ * it, then copy_file_range, then sendfile.  The data is copied up to the end
+ * of the source file, whatever its size, as files of procfs and sysfs have a
+ * size of 0 or of a page.
+ *
+ * @param[in]  in   Source file descriptor, at offset 0.
+ * @param[in]  out  Destination file descriptor, empty.
+ *
+ * @return 0 on success, 1 if the kernel can't copy these files, that is the
+ *         caller should fall back to copying in user space, -1 on error.
+ */
+static int
+file_copy_kernel (int in, int out)
+{
+#ifdef __linux__
+  off_t done = 0;
+#endif
+
+#ifdef FICLONE
+  if (ioctl (out, FICLONE, in) == 0)
+    return 0;
+#endif
+
+#ifdef __linux__
+  for (;;)
+    {
+      ssize_t count;
+
+      count = copy_file_range (in, NULL, out, NULL, FILE_COPY_CHUNK, 0);
+      if (count < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          if (done == 0
+              && (errno == EXDEV || errno == ENOSYS || errno == EINVAL
+                  || errno == EOPNOTSUPP || errno == EBADF))
+            break;
+          return -1;
         }
+      if (count == 0)
+        break;
+      done += count;
     }
+  if (done)
+    return 0;
 
-  return g_remove (pathname);
+  /* Nothing copied yet: some kernels copy nothing from pseudo files without
+   * failing, so an empty source can not be told apart from one of those. */
+  for (;;)
+    {
+      ssize_t count;
+
+      count = sendfile (out, in, NULL, FILE_COPY_CHUNK);
+      if (count < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          if (done == 0 && (errno == ENOSYS || errno == EINVAL))
+            return 1;
+          return -1;
+        }
+      if (count == 0)
+        return done ? 0 : 1;
+      done += count;
+    }
+#else
+  (void) in;
+  (void) out;
+  return 1;
+#endif
+}
+
+/**
+ * @brief Copy a regular file without passing the data through user space.
+ *
+ * @param[in]  source_file  Source file name.
+ * @param[in]  dest_file    Destination file name.
+ *
+ * @return 0 on success, 1 if the file has to be copied another way, -1 on
+ *         error.
+ */
+static int
+file_copy_fast (const gchar *source_file, const gchar *dest_file)
+{
+  struct stat sb, db;
+  int in, out, ret;
+
+  in = open (source_file, O_RDONLY | O_CLOEXEC);
+  if (in == -1)
+    return 1;
+  if (fstat (in, &sb) || !S_ISREG (sb.st_mode))
+    {
+      close (in);
+      return 1;
+    }
+  /* Truncated only once known not to be the source, or a link to it. */
+  out = open (dest_file, O_WRONLY | O_CREAT | O_CLOEXEC, sb.st_mode & 0777);
+  if (out == -1)
+    {
+      close (in);
+      return 1;
+    }
+  if (fstat (out, &db) == 0 && db.st_dev == sb.st_dev
+      && db.st_ino == sb.st_ino)
+    {
+      g_warning ("%s: %s and %s are the same file\n", __FUNCTION__,
+                 source_file, dest_file);
+      close (out);
+      close (in);
+      return -1;
+    }
+  if (ftruncate (out, 0))
+    {
+      close (out);
+      close (in);
+      return 1;
+    }
+
+  ret = file_copy_kernel (in, out);
+  if (ret == 0 && close (out))
+    ret = -1;
+  else if (ret)
+    close (out);
+  close (in);
+  if (ret == -1)
+    g_warning ("%s: Failed to copy %s to %s - %s\n", __FUNCTION__,
+               source_file, dest_file, g_strerror (errno));
+  return ret;
 }
 
 /**
@@ -116,6 +534,9 @@ gvm_file_remove_recurse (const gchar *pathname)
  *
  * If the destination file does exist already, it will be overwritten.
  *
+ * Regular files are copied within the kernel where possible, by reflink,
+ * copy_file_range or sendfile.
+ *
  * @param[in]  source_file  Source file name.
  * @param[in]  dest_file    Destination file name.
  *
@@ -128,6 +549,16 @@ gvm_file_copy (const gchar *source_file, const gchar *dest_file)
   GFile *sfile, *dfile;
   GError *error;
 
+  switch (file_copy_fast (source_file, dest_file))
+    {
+    case 0:
+      return TRUE;
+    case -1:
+      return FALSE;
+    default:
+      break;
+    }
+
   sfile = g_file_new_for_path (source_file);
   dfile = g_file_new_for_path (dest_file);
   error = NULL;
@@ -151,6 +582,9 @@ gvm_file_copy (const gchar *source_file, const gchar *dest_file)
  *
  * If the destination file does exist already, it will be overwritten.
  *
+ * Within a filesystem the file is renamed.  Across filesystems, regular
+ * files are copied like gvm_file_copy and then removed.
+ *
  * @param[in]  source_file  Source file name.
  * @param[in]  dest_file    Destination file name.
  *
@@ -163,6 +597,23 @@ gvm_file_move (const gchar *source_file, const gchar *dest_file)
   GFile *sfile, *dfile;
   GError *error;
 
+  if (rename (source_file, dest_file) == 0)
+    return TRUE;
+  if (errno == EXDEV)
+    switch (file_copy_fast (source_file, dest_file))
+      {
+      case 0:
+        if (g_remove (source_file) == 0)
+          return TRUE;
+        g_warning ("%s: Failed to remove %s - %s\n", __FUNCTION__,
+                   source_file, g_strerror (errno));
+        return FALSE;
+      case -1:
+        return FALSE;
+      default:
+        break;
+      }
+
   sfile = g_file_new_for_path (source_file);
   dfile = g_file_new_for_path (dest_file);
   error = NULL;
@@ -181,6 +632,93 @@ gvm_file_move (const gchar *source_file, const gchar *dest_file)
   return rc;
 }
 
+/**
+ * @brief Size of the chunks of a file read for base64 encoding.
+ *
+ * A multiple of 3, so that each chunk encodes to whole base64 groups.
+ */
+#define FILE_BASE64_CHUNK_SIZE 49152
+
+/**
+ * @brief Stream the content of a file in base64 format.
+ *
+ * The file is read and encoded a chunk at a time, so neither the file nor
+ * its encoding is ever held in memory whole.
+ *
+ * @param[in]  path  Path to file.
+ * @param[in]  sink  Function to write the encoded chunks to.
+ * @param[in]  data  Data for the sink.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_file_base64_stream (const char *path, gvm_file_sink_t sink, void *data)
+{
+  guchar *buffer;
+  gchar *encoded;
+  gint state = 0, save = 0;
+  gsize length;
+  int fd, ret = 0;
+
+  fd = open (path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return -1;
+
+  buffer = g_malloc (FILE_BASE64_CHUNK_SIZE);
+  /* The size g_base64_encode_step needs for the largest chunk. */
+  encoded = g_malloc ((FILE_BASE64_CHUNK_SIZE / 3 + 1) * 4 + 4);
+  while (1)
+    {
+      ssize_t count;
+
+      count = read (fd, buffer, FILE_BASE64_CHUNK_SIZE);
+      if (count < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          ret = -1;
+          break;
+        }
+      if (count == 0)
+        break;
+      length = g_base64_encode_step (buffer, count, FALSE, encoded, &state,
+                                     &save);
+      if (length && sink (encoded, length, data))
+        {
+          ret = -1;
+          break;
+        }
+    }
+
+  if (ret == 0)
+    {
+      length = g_base64_encode_close (FALSE, encoded, &state, &save);
+      if (length && sink (encoded, length, data))
+        ret = -1;
+    }
+
+  g_free (encoded);
+  g_free (buffer);
+  close (fd);
+  return ret;
+}
+
+/**
+ * @brief Append data to a GString, as a gvm_file_sink_t.
+ *
+ * @param[in]  data    Data.
+ * @param[in]  length  Length of data.
+ * @param[in]  string  GString.
+ *
+ * @return 0.
+ */
+static int
+file_sink_gstring (const char *data, size_t length, void *string)
+{
+  g_string_append_len (string, data, length);
+  return 0;
+}
+
 /**
  * @brief Get the content of a file in base64 format.
  *
@@ -191,18 +729,19 @@ gvm_file_move (const gchar *source_file, const gchar *dest_file)
 char *
 gvm_file_as_base64 (const char *path)
 {
-  GError *error = NULL;
-  char *content, *encoded;
-  gsize len;
+  GString *encoded;
+  struct stat sb;
 
-  if (!g_file_get_contents (path, &content, &len, &error))
+  /* Size the string for the whole encoding up front. */
+  if (g_stat (path, &sb))
+    return NULL;
+  encoded = g_string_sized_new ((sb.st_size / 3 + 1) * 4 + 1);
+  if (gvm_file_base64_stream (path, file_sink_gstring, encoded))
     {
-      g_error_free (error);
+      g_string_free (encoded, TRUE);
       return NULL;
     }
-  encoded = g_base64_encode ((guchar *) content, len);
-  g_free (content);
-  return encoded;
+  return g_string_free (encoded, FALSE);
 }
 
 /**
@@ -29,12 +29,23 @@
 
 #include <glib.h>
 
+/**
+ * @brief Function that file data is streamed to.
+ *
+ * Gets the data, its length and the sink data.  Returns 0 on success, -1 on
+ * error.
+ */
+typedef int (*gvm_file_sink_t) (const char *, size_t, void *);
+
 int
 gvm_file_check_is_dir (const char *name);
 
 int
 gvm_file_remove_recurse (const gchar *pathname);
 
+int
+gvm_file_remove_recurse_parallel (const gchar *, int);
+
 gboolean
 gvm_file_copy (const gchar *, const gchar *);
 
@@ -44,6 +55,9 @@ gvm_file_move (const gchar *, const gchar *);
 char *
 gvm_file_as_base64 (const char *);
 
+int
+gvm_file_base64_stream (const char *, gvm_file_sink_t, void *);
+
 gchar *
 gvm_export_file_name (const char *, const char *, const char *, const char *,
                       const char *, const char *, const char *, const char *);
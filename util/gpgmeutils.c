@@ -32,7 +32,7 @@
 #include <stdlib.h>    /* for mkdtemp */
 #include <string.h>    /* for strlen */
 #include <sys/stat.h>  /* for mkdir */
-#include <unistd.h>    /* for access, F_OK */
+#include <unistd.h>    /* for access, F_OK, getpid */
 
 #undef G_LOG_DOMAIN
 /**
@@ -246,7 +246,7 @@ gvm_gpg_import_from_string (gpgme_ctx_t ctx, const char *key_str,
  * @param[in]  ctx        The GPGME context.
  * @param[in]  uid_email  The recipient email address to look for.
  *
- * @return  The key as a gpgme_key_t.
+ * @return  The key as a gpgme_key_t, to be released with gpgme_key_unref.
  */
 static gpgme_key_t
 find_email_encryption_key (gpgme_ctx_t ctx, const char *uid_email)
@@ -292,8 +292,13 @@ find_email_encryption_key (gpgme_ctx_t ctx, const char *uid_email)
         }
 
       if (recipient_found == FALSE)
-        gpgme_op_keylist_next (ctx, &key);
+        {
+          gpgme_key_unref (key);
+          gpgme_op_keylist_next (ctx, &key);
+        }
     }
+  gpgme_op_keylist_end (ctx);
+  g_free (bracket_email);
 
   if (recipient_found)
     return key;
@@ -304,6 +309,343 @@ find_email_encryption_key (gpgme_ctx_t ctx, const char *uid_email)
     }
 }
 
+/**
+ * @brief A temporary GnuPG home with an imported key or certificate.
+ */
+typedef struct
+{
+  gchar *id;        ///< Protocol and checksum of the key data.
+  gchar *dir;       ///< The temporary GnuPG home directory.
+  gpgme_ctx_t ctx;  ///< Context using the directory.
+  GHashTable *keys; ///< Encryption keys found, by recipient email.
+  GMutex lock;      ///< Serializes the use of ctx.
+  guint refs;       ///< References, including one while cached.
+  gint64 last_used; ///< Monotonic time the keyring was last acquired.
+  pid_t pid;        ///< Process which created the directory.
+} gpg_keyring_t;
+
+/**
+ * @brief Maximum number of cached keyrings, 0 to disable caching.
+ */
+static guint gpg_cache_max = 0;
+
+/**
+ * @brief Seconds after which an unused keyring is dropped from the cache.
+ */
+static guint gpg_cache_idle_timeout = 0;
+
+/**
+ * @brief Cached keyrings, keyed by their id.
+ */
+static GHashTable *gpg_cache = NULL;
+
+/**
+ * @brief Lock for the cache and the reference counts.
+ */
+static GMutex gpg_cache_lock;
+
+/**
+ * @brief Process the cached keyrings belong to.
+ */
+static pid_t gpg_cache_pid = 0;
+
+/**
+ * @brief Free a keyring and remove its directory.
+ *
+ * The directory of a keyring inherited through fork() is left to the
+ * process which created it.
+ *
+ * @param[in]  keyring  The keyring.
+ */
+static void
+gpg_keyring_free (gpg_keyring_t *keyring)
+{
+  g_hash_table_destroy (keyring->keys);
+  gpgme_release (keyring->ctx);
+  if (keyring->pid == getpid ())
+    gvm_file_remove_recurse (keyring->dir);
+  g_mutex_clear (&keyring->lock);
+  g_free (keyring->dir);
+  g_free (keyring->id);
+  g_free (keyring);
+}
+
+/**
+ * @brief Set up a temporary GnuPG home and import a key or certificate.
+ *
+ * @param[in]  id         Id of the keyring.
+ * @param[in]  key_str    String containing the public key or certificate.
+ * @param[in]  key_len    Length of key / certificate, -1 to use strlen.
+ * @param[in]  protocol   The protocol to use, e.g. OpenPGP or CMS.
+ * @param[in]  data_type  The expected GPGME buffered data type.
+ *
+ * @return The keyring with one reference, NULL on error.
+ */
+static gpg_keyring_t *
+gpg_keyring_new (const gchar *id, const char *key_str, ssize_t key_len,
+                 gpgme_protocol_t protocol, gpgme_data_type_t data_type)
+{
+  gpg_keyring_t *keyring;
+  gchar *dir;
+
+  // Create temporary GPG home directory, set up context
+  dir = g_strdup ("/tmp/gvmd-gpg-XXXXXX");
+  if (mkdtemp (dir) == NULL)
+    {
+      g_warning ("%s: mkdtemp failed\n", __FUNCTION__);
+      g_free (dir);
+      return NULL;
+    }
+
+  keyring = g_malloc0 (sizeof (*keyring));
+  keyring->id = g_strdup (id);
+  keyring->dir = dir;
+  keyring->keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify) gpgme_key_unref);
+  g_mutex_init (&keyring->lock);
+  keyring->refs = 1;
+  keyring->pid = getpid ();
+
+  gpgme_new (&keyring->ctx);
+
+  if (protocol == GPGME_PROTOCOL_CMS)
+    gpgme_set_armor (keyring->ctx, 0);
+  else
+    gpgme_set_armor (keyring->ctx, 1);
+
+  gpgme_ctx_set_engine_info (keyring->ctx, protocol, NULL, dir);
+  gpgme_set_protocol (keyring->ctx, protocol);
+
+  // Import public key into context
+  if (gvm_gpg_import_from_string (keyring->ctx, key_str, key_len, data_type))
+    {
+      g_warning ("%s: Import of %s failed", __FUNCTION__,
+                 protocol == GPGME_PROTOCOL_CMS ? "certificate"
+                                                : "public key");
+      gpg_keyring_free (keyring);
+      return NULL;
+    }
+
+  return keyring;
+}
+
+/**
+ * @brief Drop a reference to a keyring, freeing it with the last one.
+ *
+ * @param[in]  keyring  The keyring.
+ */
+static void
+gpg_keyring_unref (gpg_keyring_t *keyring)
+{
+  gboolean last;
+
+  g_mutex_lock (&gpg_cache_lock);
+  last = --keyring->refs == 0;
+  g_mutex_unlock (&gpg_cache_lock);
+  if (last)
+    gpg_keyring_free (keyring);
+}
+
+/**
+ * @brief Take the expired keyrings out of the cache.
+ *
+ * Must be called with the cache locked.
+ *
+ * @param[in] all  Whether to take all keyrings.
+ *
+ * @return Taken keyrings, to be released with gpg_keyring_unref.
+ */
+static GList *
+gpg_cache_expire (gboolean all)
+{
+  GHashTableIter iter;
+  gpointer value;
+  gint64 limit;
+  GList *expired = NULL;
+
+  if (gpg_cache == NULL)
+    return NULL;
+
+  limit = g_get_monotonic_time ()
+          - (gint64) gpg_cache_idle_timeout * G_USEC_PER_SEC;
+  g_hash_table_iter_init (&iter, gpg_cache);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      gpg_keyring_t *keyring = value;
+
+      if (all || (gpg_cache_idle_timeout && keyring->last_used < limit))
+        {
+          g_hash_table_iter_steal (&iter);
+          expired = g_list_prepend (expired, keyring);
+        }
+    }
+  return expired;
+}
+
+/**
+ * @brief Take the keyrings inherited through fork() out of the cache, so
+ *        that they are never shared between processes.
+ *
+ * Must be called with the cache locked.
+ *
+ * @return Inherited keyrings, to be released with gpg_keyring_unref.  Their
+ *         directories are kept.
+ */
+static GList *
+gpg_cache_take_inherited (void)
+{
+  if (gpg_cache_pid == getpid ())
+    return NULL;
+
+  gpg_cache_pid = getpid ();
+  return gpg_cache_expire (TRUE);
+}
+
+/**
+ * @brief Take the least recently used keyring out of the cache.
+ *
+ * Must be called with the cache locked.
+ *
+ * @return The keyring, to be released with gpg_keyring_unref.
+ */
+static gpg_keyring_t *
+gpg_cache_evict (void)
+{
+  GHashTableIter iter;
+  gpointer value;
+  gpg_keyring_t *oldest = NULL;
+
+  g_hash_table_iter_init (&iter, gpg_cache);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      gpg_keyring_t *keyring = value;
+
+      if (oldest == NULL || keyring->last_used < oldest->last_used)
+        oldest = keyring;
+    }
+  if (oldest)
+    g_hash_table_steal (gpg_cache, oldest->id);
+  return oldest;
+}
+
+/**
+ * @brief Configure caching of prepared GnuPG homes for encryption.
+ *
+ * With caching, gvm_pgp_pubkey_encrypt_stream and gvm_smime_encrypt_stream
+ * keep the temporary GnuPG home, GPGME context and imported key of each
+ * key or certificate, so that repeated encryptions to the same recipient
+ * skip the setup and the import.  The key data is identified by its
+ * SHA-256 checksum.  Encryptions with the same key are serialized, as a
+ * GPGME context may only be used by one thread at a time.
+ *
+ * At most max_entries keys are kept, the least recently used one is
+ * dropped first.  Keys unused for idle_timeout seconds are dropped, if
+ * idle_timeout is not 0.  Caching is disabled by default.  Disable it
+ * before exiting, to remove the temporary directories.  A forked child
+ * starts with an empty cache and leaves the inherited directories to its
+ * parent.
+ *
+ * @param[in] max_entries   Keys to keep, 0 to disable caching and drop
+ *                          the cached keys.
+ * @param[in] idle_timeout  Seconds an unused key is kept, 0 for no limit.
+ */
+void
+gvm_gpgme_set_cache (unsigned int max_entries, unsigned int idle_timeout)
+{
+  GList *expired;
+
+  g_mutex_lock (&gpg_cache_lock);
+  gpg_cache_max = max_entries;
+  gpg_cache_idle_timeout = idle_timeout;
+  if (gpg_cache == NULL)
+    gpg_cache = g_hash_table_new (g_str_hash, g_str_equal);
+  expired = g_list_concat (gpg_cache_take_inherited (),
+                           gpg_cache_expire (max_entries == 0));
+  while (g_hash_table_size (gpg_cache) > gpg_cache_max)
+    expired = g_list_prepend (expired, gpg_cache_evict ());
+  g_mutex_unlock (&gpg_cache_lock);
+  g_list_free_full (expired, (GDestroyNotify) gpg_keyring_unref);
+}
+
+/**
+ * @brief Get the keyring of a key or certificate.
+ *
+ * The keyring is taken from the cache if caching is enabled, and set up
+ * and added to it otherwise.
+ *
+ * @param[in]  key_str    String containing the public key or certificate.
+ * @param[in]  key_len    Length of key / certificate, -1 to use strlen.
+ * @param[in]  protocol   The protocol to use, e.g. OpenPGP or CMS.
+ * @param[in]  data_type  The expected GPGME buffered data type.
+ *
+ * @return The keyring, to be released with gpg_keyring_unref.  NULL on
+ *         error.
+ */
+static gpg_keyring_t *
+gpg_keyring_acquire (const char *key_str, ssize_t key_len,
+                     gpgme_protocol_t protocol, gpgme_data_type_t data_type)
+{
+  gpg_keyring_t *keyring, *cached;
+  gchar *checksum, *id;
+  GList *expired;
+
+  if (key_len < 0)
+    key_len = strlen (key_str);
+  checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                          (const guchar *) key_str, key_len);
+  id = g_strdup_printf ("%d:%s", protocol, checksum);
+  g_free (checksum);
+
+  g_mutex_lock (&gpg_cache_lock);
+  expired =
+    g_list_concat (gpg_cache_take_inherited (), gpg_cache_expire (FALSE));
+  keyring = gpg_cache ? g_hash_table_lookup (gpg_cache, id) : NULL;
+  if (keyring)
+    {
+      keyring->refs++;
+      keyring->last_used = g_get_monotonic_time ();
+    }
+  g_mutex_unlock (&gpg_cache_lock);
+  g_list_free_full (expired, (GDestroyNotify) gpg_keyring_unref);
+
+  if (keyring)
+    {
+      g_free (id);
+      return keyring;
+    }
+
+  /* Import outside the lock, it is slow. */
+  keyring = gpg_keyring_new (id, key_str, key_len, protocol, data_type);
+  g_free (id);
+  if (keyring == NULL)
+    return NULL;
+
+  expired = NULL;
+  g_mutex_lock (&gpg_cache_lock);
+  keyring->last_used = g_get_monotonic_time ();
+  if (gpg_cache_max)
+    {
+      cached = g_hash_table_lookup (gpg_cache, keyring->id);
+      if (cached)
+        {
+          /* Another thread was faster. */
+          expired = g_list_prepend (expired, keyring);
+          keyring = cached;
+          keyring->refs++;
+        }
+      else
+        {
+          while (g_hash_table_size (gpg_cache) >= gpg_cache_max)
+            expired = g_list_prepend (expired, gpg_cache_evict ());
+          keyring->refs++;
+          g_hash_table_insert (gpg_cache, keyring->id, keyring);
+        }
+    }
+  g_mutex_unlock (&gpg_cache_lock);
+  g_list_free_full (expired, (GDestroyNotify) gpg_keyring_unref);
+  return keyring;
+}
+
 /**
  * @brief Encrypt a stream for a PGP public key, writing to another stream.
  *
@@ -325,8 +667,7 @@ encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
                          const char *uid_email, gpgme_protocol_t protocol,
                          gpgme_data_type_t data_type)
 {
-  char gpg_temp_dir[] = "/tmp/gvmd-gpg-XXXXXX";
-  gpgme_ctx_t ctx;
+  gpg_keyring_t *keyring;
   gpgme_data_t plain_data, encrypted_data;
   gpgme_key_t key;
   gpgme_key_t keys[2] = {NULL, NULL};
@@ -346,42 +687,27 @@ encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
   else
     key_type_str = "public key";
 
-  // Create temporary GPG home directory, set up context and encryption flags
-  if (mkdtemp (gpg_temp_dir) == NULL)
-    {
-      g_warning ("%s: mkdtemp failed\n", __FUNCTION__);
-      return -1;
-    }
-
-  gpgme_new (&ctx);
-
-  if (protocol == GPGME_PROTOCOL_CMS)
-    gpgme_set_armor (ctx, 0);
-  else
-    gpgme_set_armor (ctx, 1);
-
-  gpgme_ctx_set_engine_info (ctx, protocol, NULL, gpg_temp_dir);
-  gpgme_set_protocol (ctx, protocol);
+  keyring = gpg_keyring_acquire (key_str, key_len, protocol, data_type);
+  if (keyring == NULL)
+    return -1;
   encrypt_flags = GPGME_ENCRYPT_ALWAYS_TRUST | GPGME_ENCRYPT_NO_COMPRESS;
 
-  // Import public key into context
-  if (gvm_gpg_import_from_string (ctx, key_str, key_len, data_type))
-    {
-      g_warning ("%s: Import of %s failed", __FUNCTION__, key_type_str);
-      gpgme_release (ctx);
-      gvm_file_remove_recurse (gpg_temp_dir);
-      return -1;
-    }
+  g_mutex_lock (&keyring->lock);
 
   // Get imported public key
-  key = find_email_encryption_key (ctx, uid_email);
+  key = g_hash_table_lookup (keyring->keys, uid_email);
   if (key == NULL)
     {
-      g_warning ("%s: Could not find %s for encryption", __FUNCTION__,
-                 key_type_str);
-      gpgme_release (ctx);
-      gvm_file_remove_recurse (gpg_temp_dir);
-      return -1;
+      key = find_email_encryption_key (keyring->ctx, uid_email);
+      if (key == NULL)
+        {
+          g_warning ("%s: Could not find %s for encryption", __FUNCTION__,
+                     key_type_str);
+          g_mutex_unlock (&keyring->lock);
+          gpg_keyring_unref (keyring);
+          return -1;
+        }
+      g_hash_table_insert (keyring->keys, g_strdup (uid_email), key);
     }
   keys[0] = key;
 
@@ -393,24 +719,21 @@ encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
     gpgme_data_set_encoding (encrypted_data, GPGME_DATA_ENCODING_BASE64);
 
   // Encrypt data
-  err = gpgme_op_encrypt (ctx, keys, encrypt_flags, plain_data, encrypted_data);
+  err = gpgme_op_encrypt (keyring->ctx, keys, encrypt_flags, plain_data,
+                          encrypted_data);
+
+  gpgme_data_release (plain_data);
+  gpgme_data_release (encrypted_data);
+  g_mutex_unlock (&keyring->lock);
+  gpg_keyring_unref (keyring);
 
   if (err)
     {
       g_warning ("%s: Encryption failed: %s", __FUNCTION__,
                  gpgme_strerror (err));
-      gpgme_data_release (plain_data);
-      gpgme_data_release (encrypted_data);
-      gpgme_release (ctx);
-      gvm_file_remove_recurse (gpg_temp_dir);
       return -1;
     }
 
-  gpgme_data_release (plain_data);
-  gpgme_data_release (encrypted_data);
-  gpgme_release (ctx);
-  gvm_file_remove_recurse (gpg_temp_dir);
-
   return 0;
 }
 
@@ -40,6 +40,9 @@ int
 gvm_gpg_import_from_string (gpgme_ctx_t, const char *, ssize_t,
                             gpgme_data_type_t);
 
+void
+gvm_gpgme_set_cache (unsigned int, unsigned int);
+
 int
 gvm_pgp_pubkey_encrypt_stream (FILE *, FILE *, const char *, const char *,
                                ssize_t);
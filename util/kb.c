@@ -29,10 +29,12 @@
 #include <errno.h> /* for ENOMEM, EINVAL, EPROTO, EALREADY, ECONN... */
 #include <glib.h>  /* for g_log, g_free */
 #include <hiredis/hiredis.h> /* for redisReply, freeReplyObject, redisCommand */
+#include <pthread.h>         /* for pthread_atfork */
 #include <stdbool.h>         /* for bool, true, false */
 #include <stdio.h>
-#include <stdlib.h> /* for atoi */
+#include <stdlib.h> /* for atoi, strtoull */
 #include <string.h> /* for strlen, strerror, strncpy, memset */
+#include <unistd.h> /* for getpid */
 
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN "lib  kb"
@@ -49,6 +51,59 @@
  */
 #define GLOBAL_DBINDEX_NAME "GVM.__GlobalDBIndex"
 
+/**
+ * @brief Number of keys to ask Redis to look at per SCAN step.
+ */
+#define KB_SCAN_COUNT 1000
+
+/**
+ * @brief Number of batched commands after which their replies are read.
+ */
+#define KB_BATCH_MAX 1024
+
+/**
+ * @brief Maximum number of idle connections kept per Redis server socket.
+ */
+#define KB_POOL_MAX 4
+
+/**
+ * @brief Interval at which the end of a background save is checked, in
+ *        microseconds.
+ */
+#define KB_SAVE_POLL_INTERVAL 100000
+
+/**
+ * @brief Longest wait for the end of a background save, in microseconds.
+ */
+#define KB_SAVE_TIMEOUT (600 * G_USEC_PER_SEC)
+
+/**
+ * @brief Names of the fields of a NVT hash, indexed by kb_nvt_pos.
+ *
+ * NVT_TIMESTAMP_POS and NVT_OID_POS are stored in the filename:FILE list in
+ * both layouts.
+ */
+static const char *nvt_hash_fields[] = {
+  [NVT_FILENAME_POS] = "filename",
+  [NVT_REQUIRED_KEYS_POS] = "required_keys",
+  [NVT_MANDATORY_KEYS_POS] = "mandatory_keys",
+  [NVT_EXCLUDED_KEYS_POS] = "excluded_keys",
+  [NVT_REQUIRED_UDP_PORTS_POS] = "required_udp_ports",
+  [NVT_REQUIRED_PORTS_POS] = "required_ports",
+  [NVT_DEPENDENCIES_POS] = "dependencies",
+  [NVT_TAGS_POS] = "tags",
+  [NVT_CVES_POS] = "cves",
+  [NVT_BIDS_POS] = "bids",
+  [NVT_XREFS_POS] = "xrefs",
+  [NVT_CATEGORY_POS] = "category",
+  [NVT_TIMEOUT_POS] = "timeout",
+  [NVT_FAMILY_POS] = "family",
+  [NVT_NAME_POS] = "name",
+  [NVT_TIMESTAMP_POS] = NULL,
+  [NVT_OID_POS] = NULL,
+  [NVT_PREFS_POS] = "prefs",
+};
+
 static const struct kb_operations KBRedisOperations;
 
 /**
@@ -62,6 +117,14 @@ struct kb_redis
   unsigned int max_db; /**< Max # of databases. */
   unsigned int db;     /**< Namespace ID number, 0 if uninitialized. */
   redisContext *rctx;  /**< Redis client context. */
+  int batch;           /**< Whether write commands are being batched. */
+  int batch_rc;        /**< Error status of the batched commands so far. */
+  unsigned int pending; /**< Number of batched replies not read yet. */
+  int unique_script;   /**< Whether the unique insert script is loaded on the
+                            connection, -1 if scripts are not supported. */
+  int nvt_layout;      /**< enum kb_nvt_layout of the NVTs, 0 for
+                            KB_NVT_LAYOUT_LIST. */
+  pid_t pid;           /**< Process which opened the Redis context. */
   char path[0];        /**< Path to the server socket. */
 };
 #define redis_kb(__kb) ((struct kb_redis *) (__kb))
@@ -72,7 +135,277 @@ static int redis_lnk_reset (kb_t);
 static int
 redis_flush_all (kb_t, const char *);
 static redisReply *
-redis_cmd (struct kb_redis *kbr, const char *fmt, ...);
+redis_cmd_at (struct kb_redis *kbr, const char *op, const char *fmt, ...);
+static int
+redis_write_at (struct kb_redis *kbr, const char *op, const char *fmt, ...);
+
+/**
+ * @brief Execute a redis command, accounted to the calling function in the
+ *        KB statistics.
+ */
+#define redis_cmd(kbr, ...) redis_cmd_at (kbr, __func__, __VA_ARGS__)
+
+/**
+ * @brief Execute a redis write command, accounted to the calling function in
+ *        the KB statistics.
+ */
+#define redis_write(kbr, ...) redis_write_at (kbr, __func__, __VA_ARGS__)
+static void
+redis_batch_sync (struct kb_redis *);
+
+/**
+ * @brief Per server socket state shared by the KB handles of a process.
+ */
+struct redis_pool
+{
+  GSList *idle;        /**< Idle Redis contexts, selected on DB 0. */
+  unsigned int max_db; /**< Max # of databases, 0 if not fetched yet. */
+  int lazy_free;       /**< 1 if the server supports UNLINK and FLUSHDB ASYNC,
+                            -1 if not, 0 if not checked yet. */
+};
+
+/**
+ * @brief Table of server socket path to struct redis_pool.
+ */
+static GHashTable *redis_pools = NULL;
+
+/**
+ * @brief Process which owns the contexts in redis_pools.
+ */
+static pid_t redis_pools_pid = 0;
+
+/**
+ * @brief Lock of redis_pools and of the pools in it, as KB handles of
+ *        several threads may connect and reconnect concurrently.
+ */
+static GMutex redis_pools_lock;
+
+/**
+ * @brief Re-initialize redis_pools_lock in a forked child, in case another
+ *        thread of the parent held it at the time of the fork.
+ */
+static void
+redis_pools_atfork_child (void)
+{
+  g_mutex_init (&redis_pools_lock);
+}
+
+/**
+ * @brief Free a struct redis_pool and close its idle contexts.
+ * @param[in] data  Pool to free.
+ */
+static void
+redis_pool_free (gpointer data)
+{
+  struct redis_pool *pool = data;
+
+  g_slist_free_full (pool->idle, (GDestroyNotify) redisFree);
+  g_free (pool);
+}
+
+/**
+ * @brief Get the pool of a server socket. Idle contexts inherited through
+ *        fork() are dropped, so that they are never shared between processes.
+ *        Must be called with redis_pools_lock held, which also protects the
+ *        returned pool.
+ * @param[in] path  Path to the server socket.
+ * @return Pool of the server socket.
+ */
+static struct redis_pool *
+redis_pool_get (const char *path)
+{
+  struct redis_pool *pool;
+
+  if (redis_pools && redis_pools_pid != getpid ())
+    {
+      g_hash_table_destroy (redis_pools);
+      redis_pools = NULL;
+    }
+  if (redis_pools == NULL)
+    {
+      if (redis_pools_pid == 0)
+        pthread_atfork (NULL, NULL, redis_pools_atfork_child);
+      redis_pools = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           redis_pool_free);
+      redis_pools_pid = getpid ();
+    }
+
+  pool = g_hash_table_lookup (redis_pools, path);
+  if (pool == NULL)
+    {
+      pool = g_malloc0 (sizeof (struct redis_pool));
+      g_hash_table_insert (redis_pools, g_strdup (path), pool);
+    }
+  return pool;
+}
+
+/**
+ * @brief Connect a KB handle to its server, reusing an idle context when
+ *        possible.
+ * @param[in] kbr Subclass of struct kb to connect. The context is left on
+ *                DB 0.
+ * @return 0 on success, -1 on connection error.
+ */
+static int
+redis_connect (struct kb_redis *kbr)
+{
+  struct redis_pool *pool;
+
+  for (;;)
+    {
+      redisContext *ctx = NULL;
+      redisReply *rep;
+
+      g_mutex_lock (&redis_pools_lock);
+      pool = redis_pool_get (kbr->path);
+      if (pool->idle)
+        {
+          ctx = pool->idle->data;
+          pool->idle = g_slist_delete_link (pool->idle, pool->idle);
+        }
+      g_mutex_unlock (&redis_pools_lock);
+      if (ctx == NULL)
+        break;
+
+      /* Also checks that the server didn't drop the connection meanwhile. */
+      rep = redisCommand (ctx, "SELECT 0");
+      if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
+        {
+          if (rep != NULL)
+            freeReplyObject (rep);
+          redisFree (ctx);
+          continue;
+        }
+      freeReplyObject (rep);
+      kbr->rctx = ctx;
+      kbr->pid = getpid ();
+      return 0;
+    }
+
+  kbr->rctx = redisConnectUnix (kbr->path);
+  if (kbr->rctx == NULL || kbr->rctx->err)
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+             "%s: redis connection error: %s", __func__,
+             kbr->rctx ? kbr->rctx->errstr : strerror (ENOMEM));
+      redisFree (kbr->rctx);
+      kbr->rctx = NULL;
+      return -1;
+    }
+  kbr->pid = getpid ();
+  return 0;
+}
+
+/**
+ * @brief Disconnect a KB handle from its server. The context goes back to
+ *        the pool if it is healthy and was opened by the current process.
+ * @param[in] kbr Subclass of struct kb to disconnect.
+ */
+static void
+redis_disconnect (struct kb_redis *kbr)
+{
+  struct redis_pool *pool;
+  redisContext *ctx = kbr->rctx;
+
+  if (ctx == NULL)
+    return;
+  kbr->rctx = NULL;
+  kbr->unique_script = 0;
+
+  if (ctx->err || kbr->pending > 0 || kbr->pid != getpid ())
+    {
+      redisFree (ctx);
+      return;
+    }
+
+  g_mutex_lock (&redis_pools_lock);
+  pool = redis_pool_get (kbr->path);
+  if (g_slist_length (pool->idle) < KB_POOL_MAX)
+    {
+      pool->idle = g_slist_prepend (pool->idle, ctx);
+      ctx = NULL;
+    }
+  g_mutex_unlock (&redis_pools_lock);
+  if (ctx)
+    redisFree (ctx);
+}
+
+/**
+ * @brief Select a DB on the context of a KB handle.
+ * @param[in] kbr   Subclass of struct kb.
+ * @param[in] index DB index.
+ * @return 0 on success, -1 on error.
+ */
+static int
+redis_select (struct kb_redis *kbr, unsigned int index)
+{
+  redisReply *rep;
+  int rc = 0;
+
+  rep = redisCommand (kbr->rctx, "SELECT %u", index);
+  if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
+    rc = -1;
+  if (rep != NULL)
+    freeReplyObject (rep);
+
+  return rc;
+}
+
+/**
+ * @brief Compare two DB indexes.
+ * @param[in] a First index.
+ * @param[in] b Second index.
+ * @return Negative, 0 or positive like strcmp.
+ */
+static gint
+redis_index_cmp (gconstpointer a, gconstpointer b)
+{
+  unsigned int ia = *(const unsigned int *) a, ib = *(const unsigned int *) b;
+
+  return ia < ib ? -1 : ia > ib;
+}
+
+/**
+ * @brief Get the indexes of the DBs in use, in one round trip.
+ * @param[in] kbr Subclass of struct kb, its context selected on DB 0.
+ * @return Sorted array of indexes to free with g_array_free, NULL on error.
+ */
+static GArray *
+redis_used_indexes (struct kb_redis *kbr)
+{
+  GArray *indexes;
+  redisReply *rep;
+  size_t i;
+
+  rep = redisCommand (kbr->rctx, "HGETALL %s", GLOBAL_DBINDEX_NAME);
+  if (rep == NULL || rep->type != REDIS_REPLY_ARRAY)
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+             "%s: cannot retrieve the used DBs: %s", __func__,
+             rep ? rep->str : kbr->rctx->errstr);
+      if (rep != NULL)
+        freeReplyObject (rep);
+      return NULL;
+    }
+
+  indexes = g_array_sized_new (FALSE, FALSE, sizeof (unsigned int),
+                               rep->elements / 2);
+  /* Fields and values alternate, the fields are the DB indexes. */
+  for (i = 0; i + 1 < rep->elements; i += 2)
+    {
+      unsigned int index;
+
+      if (rep->element[i]->type != REDIS_REPLY_STRING)
+        continue;
+      index = (unsigned int) atoi (rep->element[i]->str);
+      if (index > 0)
+        g_array_append_val (indexes, index);
+    }
+  g_array_sort (indexes, redis_index_cmp);
+
+  freeReplyObject (rep);
+  return indexes;
+}
 
 /**
  * @brief Attempt to atomically acquire ownership of a database.
@@ -113,6 +446,16 @@ fetch_max_db_index (struct kb_redis *kbr)
   int rc = 0;
   redisContext *ctx = kbr->rctx;
   redisReply *rep = NULL;
+  unsigned int max_db;
+
+  g_mutex_lock (&redis_pools_lock);
+  max_db = redis_pool_get (kbr->path)->max_db;
+  g_mutex_unlock (&redis_pools_lock);
+  if (max_db)
+    {
+      kbr->max_db = max_db;
+      return 0;
+    }
 
   rep = redisCommand (ctx, "CONFIG GET databases");
   if (rep == NULL)
@@ -134,6 +477,9 @@ fetch_max_db_index (struct kb_redis *kbr)
   if (rep->elements == 2)
     {
       kbr->max_db = (unsigned) atoi (rep->element[1]->str);
+      g_mutex_lock (&redis_pools_lock);
+      redis_pool_get (kbr->path)->max_db = kbr->max_db;
+      g_mutex_unlock (&redis_pools_lock);
     }
   else
     {
@@ -260,23 +606,14 @@ get_redis_ctx (struct kb_redis *kbr)
   if (kbr->rctx != NULL)
     return 0;
 
-  kbr->rctx = redisConnectUnix (kbr->path);
-  if (kbr->rctx == NULL || kbr->rctx->err)
-    {
-      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
-             "%s: redis connection error: %s", __func__,
-             kbr->rctx ? kbr->rctx->errstr : strerror (ENOMEM));
-      redisFree (kbr->rctx);
-      kbr->rctx = NULL;
-      return -1;
-    }
+  if (redis_connect (kbr))
+    return -1;
 
   rc = select_database (kbr);
   if (rc)
     {
       g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL, "No redis DB available");
-      redisFree (kbr->rctx);
-      kbr->rctx = NULL;
+      redis_disconnect (kbr);
       return -2;
     }
 
@@ -337,12 +674,7 @@ redis_delete (kb_t kb)
 
   redis_delete_all (kbr);
   redis_release_db (kbr);
-
-  if (kbr->rctx != NULL)
-    {
-      redisFree (kbr->rctx);
-      kbr->rctx = NULL;
-    }
+  redis_disconnect (kbr);
 
   g_free (kb);
   return 0;
@@ -404,33 +736,23 @@ static kb_t
 redis_direct_conn (const char *kb_path, const int kb_index)
 {
   struct kb_redis *kbr;
-  redisReply *rep;
 
   kbr = g_malloc0 (sizeof (struct kb_redis) + strlen (kb_path) + 1);
   kbr->kb.kb_ops = &KBRedisOperations;
   strncpy (kbr->path, kb_path, strlen (kb_path));
 
-  kbr->rctx = redisConnectUnix (kbr->path);
-  if (kbr->rctx == NULL || kbr->rctx->err)
+  if (redis_connect (kbr))
     {
-      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
-             "%s: redis connection error: %s", __func__,
-             kbr->rctx ? kbr->rctx->errstr : strerror (ENOMEM));
-      redisFree (kbr->rctx);
       g_free (kbr);
       return NULL;
     }
   kbr->db = kb_index;
-  rep = redisCommand (kbr->rctx, "SELECT %d", kb_index);
-  if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
+  if (redis_select (kbr, kb_index))
     {
-      if (rep != NULL)
-        freeReplyObject (rep);
-      redisFree (kbr->rctx);
-      kbr->rctx = NULL;
+      redis_disconnect (kbr);
+      g_free (kbr);
       return NULL;
     }
-  freeReplyObject (rep);
   return (kb_t) kbr;
 }
 
@@ -444,70 +766,64 @@ static kb_t
 redis_find (const char *kb_path, const char *key)
 {
   struct kb_redis *kbr;
-  unsigned int i = 1;
+  GArray *indexes;
+  unsigned int i;
 
   kbr = g_malloc0 (sizeof (struct kb_redis) + strlen (kb_path) + 1);
   kbr->kb.kb_ops = &KBRedisOperations;
   strncpy (kbr->path, kb_path, strlen (kb_path));
 
-  do
+  if (redis_connect (kbr))
     {
-      redisReply *rep;
+      g_free (kbr);
+      return NULL;
+    }
+  fetch_max_db_index (kbr);
 
-      kbr->rctx = redisConnectUnix (kbr->path);
-      if (kbr->rctx == NULL || kbr->rctx->err)
-        {
-          g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
-                 "%s: redis connection error: %s", __func__,
-                 kbr->rctx ? kbr->rctx->errstr : strerror (ENOMEM));
-          redisFree (kbr->rctx);
-          g_free (kbr);
-          return NULL;
-        }
+  indexes = key ? redis_used_indexes (kbr) : NULL;
+  for (i = 0; indexes && i < indexes->len; i++)
+    {
+      char *tmp;
 
-      if (kbr->max_db == 0)
-        fetch_max_db_index (kbr);
+      kbr->db = g_array_index (indexes, unsigned int, i);
+      /* The context may have been reset by a failed command. */
+      if ((kbr->rctx == NULL && get_redis_ctx (kbr))
+          || redis_select (kbr, kbr->db))
+        continue;
 
-      kbr->db = i;
-      rep = redisCommand (kbr->rctx, "HEXISTS %s %d", GLOBAL_DBINDEX_NAME, i);
-      if (rep == NULL || rep->type != REDIS_REPLY_INTEGER || rep->integer != 1)
+      tmp = kb_item_get_str (&kbr->kb, key);
+      if (tmp)
         {
-          if (rep != NULL)
-            freeReplyObject (rep);
-          i++;
-          redisFree (kbr->rctx);
-          kbr->rctx = NULL;
-          continue;
-        }
-      freeReplyObject (rep);
-      rep = redisCommand (kbr->rctx, "SELECT %u", i);
-      if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
-        {
-          redisFree (kbr->rctx);
-          kbr->rctx = NULL;
-        }
-      else
-        {
-          freeReplyObject (rep);
-          if (key)
-            {
-              char *tmp = kb_item_get_str (&kbr->kb, key);
-              if (tmp)
-                {
-                  g_free (tmp);
-                  return (kb_t) kbr;
-                }
-            }
-          redisFree (kbr->rctx);
+          g_free (tmp);
+          g_array_free (indexes, TRUE);
+          return (kb_t) kbr;
         }
-      i++;
     }
-  while (i < kbr->max_db);
 
+  if (indexes)
+    g_array_free (indexes, TRUE);
+  redis_disconnect (kbr);
   g_free (kbr);
   return NULL;
 }
 
+/**
+ * @brief Single allocation holding the items built from one redis reply.
+ *
+ * The items are laid out right after this header, followed by their string
+ * values. The block is freed along with its last item.
+ */
+struct kb_item_arena
+{
+  size_t refs; /**< Number of items of the block not freed yet. */
+};
+
+/**
+ * @brief Round a size up to the alignment of struct kb_item.
+ */
+#define KB_ITEM_ALIGN(size) \
+  (((size) + sizeof (void *) - 1) & ~(sizeof (void *) - 1))
+
 /**
  * @brief Release a KB item (or a list).
  * @param[in] item Item or list to be release
@@ -520,129 +836,471 @@ kb_item_free (struct kb_item *item)
       struct kb_item *next;
 
       next = item->next;
-      if (item->type == KB_TYPE_STR && item->v_str != NULL)
-        g_free (item->v_str);
-      g_free (item);
+      if (item->arena)
+        {
+          if (--item->arena->refs == 0)
+            g_free (item->arena);
+        }
+      else
+        {
+          if (item->type == KB_TYPE_STR && item->v_str != NULL)
+            g_free (item->v_str);
+          g_free (item);
+        }
       item = next;
     }
 }
 
 /**
- * @brief Give a single KB item.
- * @param[in] name Name of the item.
- * @param[in] elt A redisReply element where to fetch the item.
+ * @brief Build KB items from redis reply elements, in a single allocation.
+ * @param[in] name Name of the items.
+ * @param[in] elts Redis reply elements where to fetch the items. Only the
+ *                 leading string and integer elements are used.
+ * @param[in] count Number of elements.
  * @param[in] force_int To force string to integer conversion.
- * @return Single retrieve kb_item on success, NULL otherwise.
+ * @param[out] tail Last item of the list. Can be NULL.
+ * @return List of kb_items in reverse order of the elements, NULL if there
+ *         is none.
  */
 static struct kb_item *
-redis2kbitem_single (const char *name, const redisReply *elt, int force_int)
+redis2kbitem_arena (const char *name, redisReply *const *elts, size_t count,
+                    int force_int, struct kb_item **tail)
 {
-  struct kb_item *item;
-  size_t namelen;
-
-  if (elt->type != REDIS_REPLY_STRING && elt->type != REDIS_REPLY_INTEGER)
-    return NULL;
+  struct kb_item_arena *arena;
+  struct kb_item *kbi = NULL;
+  size_t i, namelen, itemsize, size;
+  char *items, *strings;
 
   namelen = strlen (name) + 1;
-
-  item = g_malloc0 (sizeof (struct kb_item) + namelen);
-  if (elt->type == REDIS_REPLY_INTEGER)
-    {
-      item->type = KB_TYPE_INT;
-      item->v_int = elt->integer;
-    }
-  else if (force_int)
-    {
-      item->type = KB_TYPE_INT;
-      item->v_int = atoi (elt->str);
-    }
-  else
+  itemsize = KB_ITEM_ALIGN (sizeof (struct kb_item) + namelen);
+  size = 0;
+  for (i = 0; i < count; i++)
     {
-      item->type = KB_TYPE_STR;
-      item->v_str = g_memdup (elt->str, elt->len + 1);
-      item->len = elt->len;
+      if (elts[i]->type == REDIS_REPLY_STRING && !force_int)
+        size += elts[i]->len + 1;
+      else if (elts[i]->type != REDIS_REPLY_STRING
+               && elts[i]->type != REDIS_REPLY_INTEGER)
+        break;
     }
+  count = i;
+  if (count == 0)
+    return NULL;
 
-  item->next = NULL;
-  item->namelen = namelen;
-  strncpy (item->name, name, namelen);
+  arena = g_malloc (KB_ITEM_ALIGN (sizeof (struct kb_item_arena))
+                    + count * itemsize + size);
+  arena->refs = count;
+  items = (char *) arena + KB_ITEM_ALIGN (sizeof (struct kb_item_arena));
+  strings = items + count * itemsize;
 
-  return item;
-}
+  for (i = 0; i < count; i++)
+    {
+      const redisReply *elt = elts[i];
+      struct kb_item *item = (struct kb_item *) (items + i * itemsize);
 
-/**
- * @brief Fetch a KB item or list from a redis Reply.
- * @param[in] name Name of the item.
- * @param[in] rep A redisReply element where to fetch the item.
- * @return kb_item or list on success, NULL otherwise.
+      memset (item, 0, sizeof (struct kb_item));
+      if (elt->type == REDIS_REPLY_INTEGER)
+        {
+          item->type = KB_TYPE_INT;
+          item->v_int = elt->integer;
+        }
+      else if (force_int)
+        {
+          item->type = KB_TYPE_INT;
+          item->v_int = atoi (elt->str);
+        }
+      else
+        {
+          item->type = KB_TYPE_STR;
+          item->v_str = strings;
+          item->len = elt->len;
+          memcpy (strings, elt->str, elt->len + 1);
+          strings += elt->len + 1;
+        }
+
+      item->arena = arena;
+      item->namelen = namelen;
+      memcpy (item->name, name, namelen);
+      item->next = kbi;
+      kbi = item;
+    }
+
+  if (tail)
+    *tail = (struct kb_item *) items;
+  return kbi;
+}
+
+/**
+ * @brief Give a single KB item.
+ * @param[in] name Name of the item.
+ * @param[in] elt A redisReply element where to fetch the item.
+ * @param[in] force_int To force string to integer conversion.
+ * @return Single retrieve kb_item on success, NULL otherwise.
  */
 static struct kb_item *
-redis2kbitem (const char *name, const redisReply *rep)
+redis2kbitem_single (const char *name, redisReply *elt, int force_int)
 {
-  struct kb_item *kbi;
-
-  kbi = NULL;
+  return redis2kbitem_arena (name, &elt, 1, force_int, NULL);
+}
 
+/**
+ * @brief Fetch a KB item or list from a redis Reply.
+ * @param[in] name Name of the item.
+ * @param[in] rep A redisReply element where to fetch the item.
+ * @param[out] tail Last item of the list. Can be NULL.
+ * @return kb_item or list on success, NULL otherwise.
+ */
+static struct kb_item *
+redis2kbitem (const char *name, redisReply *rep, struct kb_item **tail)
+{
   switch (rep->type)
     {
-      unsigned int i;
-
     case REDIS_REPLY_STRING:
     case REDIS_REPLY_INTEGER:
-      kbi = redis2kbitem_single (name, rep, 0);
-      break;
+      return redis2kbitem_arena (name, &rep, 1, 0, tail);
 
     case REDIS_REPLY_ARRAY:
-      for (i = 0; i < rep->elements; i++)
-        {
-          struct kb_item *tmpitem;
-
-          tmpitem = redis2kbitem_single (name, rep->element[i], 0);
-          if (tmpitem == NULL)
-            break;
-
-          if (kbi != NULL)
-            {
-              tmpitem->next = kbi;
-              kbi = tmpitem;
-            }
-          else
-            kbi = tmpitem;
-        }
-      break;
+      return redis2kbitem_arena (name, rep->element, rep->elements, 0, tail);
 
     case REDIS_REPLY_NIL:
     case REDIS_REPLY_STATUS:
     case REDIS_REPLY_ERROR:
     default:
-      break;
+      return NULL;
     }
+}
 
-  return kbi;
+/**
+ * @brief Number of latency buckets per power of two in the KB statistics.
+ */
+#define KB_STATS_SUB_BUCKETS 8
+
+/**
+ * @brief Number of latency buckets in the KB statistics.
+ */
+#define KB_STATS_BUCKETS (KB_STATS_SUB_BUCKETS * 36)
+
+/**
+ * @brief Statistics of the commands sent by a function of the implementation.
+ */
+struct redis_op_stats
+{
+  kb_op_stats_t stats;                       /**< Counters, name unset. */
+  unsigned long histogram[KB_STATS_BUCKETS]; /**< Round trips per latency
+                                                  bucket. */
+};
+
+/**
+ * @brief Whether the KB statistics are kept.
+ */
+static volatile int redis_stats_enabled = 0;
+
+/**
+ * @brief Table of function name to struct redis_op_stats.
+ */
+static GHashTable *redis_stats = NULL;
+
+/**
+ * @brief Number of connection resets.
+ */
+static unsigned long redis_stats_lnk_reset = 0;
+
+/**
+ * @brief Lock of redis_stats and redis_stats_lnk_reset.
+ */
+static GMutex redis_stats_lock;
+
+/**
+ * @brief Get the latency bucket of a round trip.
+ *
+ * Latencies are bucketed with KB_STATS_SUB_BUCKETS buckets per power of two,
+ * so bucket bounds are within 1 / KB_STATS_SUB_BUCKETS of the latency.
+ *
+ * @param[in] usec  Latency in microseconds.
+ * @return Bucket.
+ */
+static int
+redis_stats_bucket (gint64 usec)
+{
+  int msb, bucket;
+
+  if (usec < KB_STATS_SUB_BUCKETS)
+    return usec < 0 ? 0 : usec;
+  msb = g_bit_nth_msf (usec, -1);
+  bucket = (msb - 2) * KB_STATS_SUB_BUCKETS
+           + ((usec >> (msb - 3)) & (KB_STATS_SUB_BUCKETS - 1));
+  return MIN (bucket, KB_STATS_BUCKETS - 1);
+}
+
+/**
+ * @brief Get the highest latency of a latency bucket.
+ * @param[in] bucket  Bucket.
+ * @return Latency in microseconds.
+ */
+static unsigned long
+redis_stats_bucket_max (int bucket)
+{
+  int shift;
+
+  if (bucket < KB_STATS_SUB_BUCKETS)
+    return bucket;
+  shift = bucket / KB_STATS_SUB_BUCKETS - 1;
+  return ((unsigned long) (KB_STATS_SUB_BUCKETS
+                           + bucket % KB_STATS_SUB_BUCKETS + 1)
+          << shift)
+         - 1;
+}
+
+/**
+ * @brief Start timing a round trip for the KB statistics.
+ * @return Start time, 0 if the statistics are not kept.
+ */
+static gint64
+redis_stats_start (void)
+{
+  return redis_stats_enabled ? g_get_monotonic_time () : 0;
+}
+
+/**
+ * @brief Get the size of a reply for the KB statistics.
+ * @param[in] rep  Reply. Can be NULL.
+ * @return Size of the strings of the reply in bytes, 0 if the statistics are
+ *         not kept.
+ */
+static size_t
+redis_stats_reply_size (const redisReply *rep)
+{
+  size_t size, i;
+
+  if (!redis_stats_enabled || rep == NULL)
+    return 0;
+  size = rep->type == REDIS_REPLY_INTEGER ? sizeof (rep->integer) : rep->len;
+  if (rep->type == REDIS_REPLY_ARRAY)
+    for (i = 0; i < rep->elements; i++)
+      size += redis_stats_reply_size (rep->element[i]);
+  return size;
+}
+
+/**
+ * @brief Account commands in the KB statistics.
+ * @param[in] op          Name of the function that sent the commands.
+ * @param[in] start       Start time of the round trip from
+ *                        redis_stats_start(), 0 if the commands were only
+ *                        queued.
+ * @param[in] calls       Number of commands.
+ * @param[in] bytes       Size of the replies.
+ * @param[in] errors      Number of errors.
+ * @param[in] reconnects  Number of connection resets.
+ */
+static void
+redis_stats_record (const char *op, gint64 start, unsigned int calls,
+                    size_t bytes, unsigned int errors, unsigned int reconnects)
+{
+  struct redis_op_stats *entry;
+
+  if (!redis_stats_enabled)
+    return;
+
+  g_mutex_lock (&redis_stats_lock);
+  if (redis_stats == NULL)
+    redis_stats = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+  entry = g_hash_table_lookup (redis_stats, op);
+  if (entry == NULL)
+    {
+      entry = g_malloc0 (sizeof (*entry));
+      g_hash_table_insert (redis_stats, (gpointer) op, entry);
+    }
+  entry->stats.calls += calls;
+  entry->stats.bytes += bytes;
+  entry->stats.errors += errors;
+  entry->stats.reconnects += reconnects;
+  if (start)
+    {
+      gint64 usec = g_get_monotonic_time () - start;
+
+      entry->stats.round_trips++;
+      entry->stats.total += usec;
+      entry->stats.max = MAX (entry->stats.max, (unsigned long) usec);
+      entry->histogram[redis_stats_bucket (usec)]++;
+    }
+  g_mutex_unlock (&redis_stats_lock);
+}
+
+/**
+ * @brief Get a percentile of the latency of the round trips of an operation.
+ * @param[in] entry       Statistics of the operation.
+ * @param[in] percentile  Percentile, between 0 and 100.
+ * @return Upper bound of the latency, in microseconds.
+ */
+static unsigned long
+redis_stats_percentile (const struct redis_op_stats *entry, int percentile)
+{
+  unsigned long rank, seen = 0;
+  int bucket;
+
+  if (entry->stats.round_trips == 0)
+    return 0;
+  rank = (entry->stats.round_trips * percentile + 99) / 100;
+  for (bucket = 0; bucket < KB_STATS_BUCKETS - 1; bucket++)
+    {
+      seen += entry->histogram[bucket];
+      if (seen >= rank)
+        break;
+    }
+  return MIN (redis_stats_bucket_max (bucket), entry->stats.max);
+}
+
+/**
+ * @brief Start or stop keeping statistics of the KB operations.
+ *
+ * The statistics are kept for the whole process, for all KB handles.
+ *
+ * @param[in] enable  Whether to keep the statistics.
+ */
+void
+kb_stats_enable (int enable)
+{
+  redis_stats_enabled = !!enable;
+}
+
+/**
+ * @brief Clear the statistics of the KB operations.
+ */
+void
+kb_stats_reset (void)
+{
+  g_mutex_lock (&redis_stats_lock);
+  if (redis_stats)
+    g_hash_table_remove_all (redis_stats);
+  redis_stats_lnk_reset = 0;
+  g_mutex_unlock (&redis_stats_lock);
+}
+
+/**
+ * @brief Compare operations by decreasing total latency.
+ * @param[in] one  First kb_op_stats_t.
+ * @param[in] two  Second kb_op_stats_t.
+ * @return Comparison result, as for qsort().
+ */
+static int
+redis_stats_cmp (const void *one, const void *two)
+{
+  const kb_op_stats_t *a = one, *b = two;
+
+  if (a->total != b->total)
+    return a->total < b->total ? 1 : -1;
+  return strcmp (a->name, b->name);
+}
+
+/**
+ * @brief Get the statistics of the KB operations.
+ *
+ * The statistics are only kept after a call to kb_stats_enable().
+ *
+ * @return Statistics to be freed with kb_stats_free().
+ */
+kb_stats_t *
+kb_get_stats (void)
+{
+  kb_stats_t *stats;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  stats = g_malloc0 (sizeof (*stats));
+  g_mutex_lock (&redis_stats_lock);
+  stats->lnk_reset = redis_stats_lnk_reset;
+  if (redis_stats)
+    {
+      stats->ops =
+        g_malloc0_n (g_hash_table_size (redis_stats) ?: 1, sizeof (*stats->ops));
+      g_hash_table_iter_init (&iter, redis_stats);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          const struct redis_op_stats *entry = value;
+          kb_op_stats_t *op = &stats->ops[stats->count++];
+          const char *name = key;
+
+          *op = entry->stats;
+          if (g_str_has_prefix (name, "redis_"))
+            name += strlen ("redis_");
+          op->name = g_strdup (name);
+          op->p50 = redis_stats_percentile (entry, 50);
+          op->p99 = redis_stats_percentile (entry, 99);
+        }
+    }
+  g_mutex_unlock (&redis_stats_lock);
+  if (stats->count)
+    qsort (stats->ops, stats->count, sizeof (*stats->ops), redis_stats_cmp);
+
+  return stats;
+}
+
+/**
+ * @brief Release statistics of the KB operations.
+ * @param[in] stats  Statistics from kb_get_stats().
+ */
+void
+kb_stats_free (kb_stats_t *stats)
+{
+  size_t i;
+
+  if (stats == NULL)
+    return;
+  for (i = 0; i < stats->count; i++)
+    g_free (stats->ops[i].name);
+  g_free (stats->ops);
+  g_free (stats);
+}
+
+/**
+ * @brief Log the statistics of the KB operations, one message per operation.
+ */
+void
+kb_stats_log (void)
+{
+  kb_stats_t *stats;
+  size_t i;
+
+  stats = kb_get_stats ();
+  g_message ("KB statistics: %zu operations, %lu connection resets",
+             stats->count, stats->lnk_reset);
+  for (i = 0; i < stats->count; i++)
+    {
+      const kb_op_stats_t *op = &stats->ops[i];
+
+      g_message ("KB statistics: %s: %lu calls, %lu round trips, %lu errors,"
+                 " %lu reconnects, %llu bytes, %llu us total, p50 %lu us,"
+                 " p99 %lu us, max %lu us",
+                 op->name, op->calls, op->round_trips, op->errors,
+                 op->reconnects, op->bytes, op->total, op->p50, op->p99,
+                 op->max);
+    }
+  kb_stats_free (stats);
 }
 
 /**
  * @brief Execute a redis command and get a redis reply.
  * @param[in] kbr Subclass of struct kb to connect to.
- * @param[in] fmt Formatted variable argument list with the cmd to be executed.
+ * @param[in] op  Name of the calling function, for the KB statistics.
+ * @param[in] fmt Format string with the cmd to be executed.
+ * @param[in] ap  Arguments for the format string.
  * @return Redis reply on success, NULL otherwise.
  */
 static redisReply *
-redis_cmd (struct kb_redis *kbr, const char *fmt, ...)
+redis_vcmd (struct kb_redis *kbr, const char *op, const char *fmt, va_list ap)
 {
   redisReply *rep;
-  va_list ap, aq;
+  va_list aq;
   int retry = 0;
 
-  va_start (ap, fmt);
+  redis_batch_sync (kbr);
   do
     {
+      gint64 start;
+
       if (get_redis_ctx (kbr) < 0)
-        {
-          va_end (ap);
-          return NULL;
-        }
+        return NULL;
 
+      start = redis_stats_start ();
       va_copy (aq, ap);
       rep = redisvCommand (kbr->rctx, fmt, aq);
       va_end (aq);
@@ -652,19 +1310,140 @@ redis_cmd (struct kb_redis *kbr, const char *fmt, ...)
           if (rep != NULL)
             freeReplyObject (rep);
 
+          redis_stats_record (op, start, 1, 0, 1, 1);
           redis_lnk_reset ((kb_t) kbr);
           retry = !retry;
         }
       else
-        retry = 0;
+        {
+          redis_stats_record (op, start, 1, redis_stats_reply_size (rep),
+                              rep == NULL || rep->type == REDIS_REPLY_ERROR,
+                              0);
+          retry = 0;
+        }
     }
   while (retry);
 
+  return rep;
+}
+
+/**
+ * @brief Execute a redis command and get a redis reply.
+ * @param[in] kbr Subclass of struct kb to connect to.
+ * @param[in] op  Name of the calling function, for the KB statistics.
+ * @param[in] fmt Formatted variable argument list with the cmd to be executed.
+ * @return Redis reply on success, NULL otherwise.
+ */
+static redisReply *
+redis_cmd_at (struct kb_redis *kbr, const char *op, const char *fmt, ...)
+{
+  redisReply *rep;
+  va_list ap;
+
+  va_start (ap, fmt);
+  rep = redis_vcmd (kbr, op, fmt, ap);
   va_end (ap);
 
   return rep;
 }
 
+/**
+ * @brief Read the replies of the batched commands sent so far.
+ * @param[in] kbr Subclass of struct kb.
+ * @return 0 if all the commands succeeded, -1 otherwise.
+ */
+static int
+redis_drain (struct kb_redis *kbr)
+{
+  int rc = 0;
+  unsigned int errors = 0;
+  size_t bytes = 0;
+  gint64 start;
+
+  start = redis_stats_start ();
+  while (kbr->pending > 0)
+    {
+      redisReply *rep = NULL;
+
+      kbr->pending--;
+      if (redisGetReply (kbr->rctx, (void **) &rep) != REDIS_OK || !rep)
+        {
+          /* The remaining replies are lost with the connection. */
+          g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                 "%s: redis connection error: %s", __func__,
+                 kbr->rctx->errstr);
+          redis_stats_record (__func__, start, 0, bytes, errors + 1, 1);
+          redis_lnk_reset ((kb_t) kbr);
+          return -1;
+        }
+      if (rep->type == REDIS_REPLY_ERROR)
+        {
+          rc = -1;
+          errors++;
+        }
+      bytes += redis_stats_reply_size (rep);
+      freeReplyObject (rep);
+    }
+  redis_stats_record (__func__, start, 0, bytes, errors, 0);
+
+  return rc;
+}
+
+/**
+ * @brief Read the pending replies of a batch, so that the connection can be
+ *        used for a synchronous command.
+ * @param[in] kbr Subclass of struct kb.
+ */
+static void
+redis_batch_sync (struct kb_redis *kbr)
+{
+  if (kbr->pending > 0 && redis_drain (kbr))
+    kbr->batch_rc = -1;
+}
+
+/**
+ * @brief Execute a redis write command. In batch mode, the command is only
+ *        queued and its reply is checked by redis_batch_commit().
+ * @param[in] kbr Subclass of struct kb to connect to.
+ * @param[in] op  Name of the calling function, for the KB statistics.
+ * @param[in] fmt Formatted variable argument list with the cmd to be executed.
+ * @return 0 on success, -1 on error.
+ */
+static int
+redis_write_at (struct kb_redis *kbr, const char *op, const char *fmt, ...)
+{
+  va_list ap;
+  int rc = 0;
+
+  va_start (ap, fmt);
+  if (kbr->batch)
+    {
+      if (get_redis_ctx (kbr) < 0
+          || redisvAppendCommand (kbr->rctx, fmt, ap) != REDIS_OK)
+        rc = -1;
+      else
+        {
+          /* The round trip is accounted to redis_drain(). */
+          redis_stats_record (op, 0, 1, 0, 0, 0);
+          if (++kbr->pending >= KB_BATCH_MAX)
+            redis_batch_sync (kbr);
+        }
+    }
+  else
+    {
+      redisReply *rep;
+
+      rep = redis_vcmd (kbr, op, fmt, ap);
+      if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
+        rc = -1;
+      if (rep != NULL)
+        freeReplyObject (rep);
+    }
+  va_end (ap);
+
+  return rc;
+}
+
 /**
  * @brief Get a single KB element.
  * @param[in] kb KB handle where to fetch the item.
@@ -701,27 +1480,29 @@ out:
 
 /**
  * @brief Get a single KB string item.
+ *
+ * The value is copied straight from the reply: items share their values
+ * with the block they are allocated in, so a value cannot outlive its item.
+ *
  * @param[in] kb  KB handle where to fetch the item.
  * @param[in] name  Name of the element to retrieve.
- * @return A struct kb_item to be freed with kb_item_free() or NULL if no
- *         element was found or on error.
+ * @return A string to be freed with g_free() or NULL if no element was
+ *         found or on error.
  */
 static char *
 redis_get_str (kb_t kb, const char *name)
 {
-  struct kb_item *kbi;
-
-  kbi = redis_get_single (kb, name, KB_TYPE_STR);
-  if (kbi != NULL)
-    {
-      char *res;
+  struct kb_redis *kbr;
+  redisReply *rep;
+  char *res = NULL;
 
-      res = kbi->v_str;
-      kbi->v_str = NULL;
-      kb_item_free (kbi);
-      return res;
-    }
-  return NULL;
+  kbr = redis_kb (kb);
+  rep = redis_cmd (kbr, "LINDEX %s -1", name);
+  if (rep != NULL && rep->type == REDIS_REPLY_STRING)
+    res = g_strndup (rep->str, rep->len);
+  if (rep != NULL)
+    freeReplyObject (rep);
+  return res;
 }
 
 /**
@@ -734,19 +1515,7 @@ redis_get_str (kb_t kb, const char *name)
 static int
 redis_push_str (kb_t kb, const char *name, const char *value)
 {
-  struct kb_redis *kbr;
-  redisReply *rep = NULL;
-  int rc = 0;
-
-  kbr = redis_kb (kb);
-  rep = redis_cmd (kbr, "LPUSH %s %s", name, value);
-  if (!rep || rep->type == REDIS_REPLY_ERROR)
-    rc = -1;
-
-  if (rep)
-    freeReplyObject (rep);
-
-  return rc;
+  return redis_write (redis_kb (kb), "LPUSH %s %s", name, value);
 }
 
 /**
@@ -813,11 +1582,15 @@ redis_get_nvt (kb_t kb, const char *oid, enum kb_nvt_pos position)
   char *res = NULL;
 
   kbr = redis_kb (kb);
-  if (position >= NVT_TIMESTAMP_POS)
+  if (position == NVT_TIMESTAMP_POS || position == NVT_OID_POS)
     rep = redis_cmd (kbr, "LINDEX filename:%s %d", oid,
                      position - NVT_TIMESTAMP_POS);
-  else
+  else if (kbr->nvt_layout == KB_NVT_LAYOUT_HASH)
+    rep = redis_cmd (kbr, "HGET nvt:%s %s", oid, nvt_hash_fields[position]);
+  else if (position < NVT_TIMESTAMP_POS)
     rep = redis_cmd (kbr, "LINDEX nvt:%s %d", oid, position);
+  else
+    return NULL;
   if (!rep)
     return NULL;
   if (rep->type == REDIS_REPLY_INTEGER)
@@ -829,6 +1602,68 @@ redis_get_nvt (kb_t kb, const char *oid, enum kb_nvt_pos position)
   return res;
 }
 
+/**
+ * @brief Build the HMGET command getting fields of a NVT hash.
+ * @param[in]  mask       NVT_FIELD() bits of the fields to get.
+ * @param[out] positions  Positions of the fields, in the order of the reply.
+ *                        At least NVT_PREFS_POS + 1 long.
+ * @param[out] count      Number of fields.
+ * @return Command format, with a %s for the OID, to be freed with g_free().
+ */
+static char *
+redis_nvt_hmget_fmt (unsigned int mask, int *positions, int *count)
+{
+  GString *fmt;
+  int pos;
+
+  fmt = g_string_new ("HMGET nvt:%s");
+  *count = 0;
+  for (pos = 0; pos <= NVT_PREFS_POS; pos++)
+    if (mask & NVT_FIELD (pos) && nvt_hash_fields[pos])
+      {
+        g_string_append_printf (fmt, " %s", nvt_hash_fields[pos]);
+        positions[(*count)++] = pos;
+      }
+  return g_string_free (fmt, FALSE);
+}
+
+/**
+ * @brief Build a NVT Info from its fields.
+ * @param[in] oid       OID of the NVT.
+ * @param[in] elements  Fields up to NVT_NAME_POS, indexed by kb_nvt_pos.
+ * @return NVT Info, NULL if a field is missing.
+ */
+static nvti_t *
+redis_nvti_from_reply (const char *oid, redisReply **elements)
+{
+  nvti_t *nvti;
+  int pos;
+
+  for (pos = 0; pos <= NVT_NAME_POS; pos++)
+    if (elements[pos]->type != REDIS_REPLY_STRING)
+      return NULL;
+
+  nvti = nvti_new ();
+  nvti_set_oid (nvti, oid);
+  nvti_set_required_keys (nvti, elements[NVT_REQUIRED_KEYS_POS]->str);
+  nvti_set_mandatory_keys (nvti, elements[NVT_MANDATORY_KEYS_POS]->str);
+  nvti_set_excluded_keys (nvti, elements[NVT_EXCLUDED_KEYS_POS]->str);
+  nvti_set_required_udp_ports (nvti,
+                               elements[NVT_REQUIRED_UDP_PORTS_POS]->str);
+  nvti_set_required_ports (nvti, elements[NVT_REQUIRED_PORTS_POS]->str);
+  nvti_set_dependencies (nvti, elements[NVT_DEPENDENCIES_POS]->str);
+  nvti_set_tag (nvti, elements[NVT_TAGS_POS]->str);
+  nvti_add_refs (nvti, "cve", elements[NVT_CVES_POS]->str, "");
+  nvti_add_refs (nvti, "bid", elements[NVT_BIDS_POS]->str, "");
+  nvti_add_refs (nvti, NULL, elements[NVT_XREFS_POS]->str, "");
+  nvti_set_category (nvti, atoi (elements[NVT_CATEGORY_POS]->str));
+  nvti_set_timeout (nvti, atoi (elements[NVT_TIMEOUT_POS]->str));
+  nvti_set_family (nvti, elements[NVT_FAMILY_POS]->str);
+  nvti_set_name (nvti, elements[NVT_NAME_POS]->str);
+
+  return nvti;
+}
+
 /**
  * @brief Get a full NVT.
  * @param[in] kb        KB handle where to store the nvt.
@@ -840,41 +1675,147 @@ redis_get_nvt_all (kb_t kb, const char *oid)
 {
   struct kb_redis *kbr;
   redisReply *rep;
+  nvti_t *nvti = NULL;
 
   kbr = redis_kb (kb);
-  rep =
-    redis_cmd (kbr, "LRANGE nvt:%s %d %d", oid, NVT_FILENAME_POS, NVT_NAME_POS);
+  if (kbr->nvt_layout == KB_NVT_LAYOUT_HASH)
+    {
+      int positions[NVT_PREFS_POS + 1], count;
+      char *fmt;
+
+      /* Fields are requested in kb_nvt_pos order, like in the list. */
+      fmt = redis_nvt_hmget_fmt (NVT_FIELD (NVT_NAME_POS + 1) - 1, positions,
+                                 &count);
+      rep = redis_cmd (kbr, fmt, oid);
+      g_free (fmt);
+    }
+  else
+    rep = redis_cmd (kbr, "LRANGE nvt:%s %d %d", oid, NVT_FILENAME_POS,
+                     NVT_NAME_POS);
   if (!rep)
     return NULL;
-  if (rep->type != REDIS_REPLY_ARRAY || rep->elements != NVT_NAME_POS + 1)
+  if (rep->type == REDIS_REPLY_ARRAY && rep->elements == NVT_NAME_POS + 1)
+    nvti = redis_nvti_from_reply (oid, rep->element);
+  freeReplyObject (rep);
+  return nvti;
+}
+
+/**
+ * @brief Release an array of NVT fields.
+ * @param[in] fields  Array to release.
+ * @param[in] count   Number of elements in the array.
+ */
+void
+kb_nvt_fields_free (kb_nvt_fields_t *fields, size_t count)
+{
+  size_t i;
+  int pos;
+
+  if (fields == NULL)
+    return;
+
+  for (i = 0; i < count; i++)
     {
-      freeReplyObject (rep);
-      return NULL;
+      for (pos = 0; pos < NVT_TIMESTAMP_POS; pos++)
+        g_free (fields[i].field[pos]);
+      g_free (fields[i].prefs);
     }
+  g_free (fields);
+}
+
+/**
+ * @brief Get fields of many NVTs at once.
+ * @param[in] kb        KB handle where the NVTs are stored.
+ * @param[in] oids      OIDs of the NVTs to get.
+ * @param[in] count     Number of OIDs.
+ * @param[in] mask      NVT_FIELD() bits of the fields to get.
+ * @return Array of count fields structures, in the order of oids, to be freed
+ *         with kb_nvt_fields_free(). NULL on error.
+ */
+static kb_nvt_fields_t *
+redis_get_nvt_fields (kb_t kb, const char **oids, size_t count,
+                      unsigned int mask)
+{
+  struct kb_redis *kbr;
+  kb_nvt_fields_t *fields;
+  size_t i, done;
+  int positions[NVT_PREFS_POS + 1], last = 0, nfields = 0;
+  char *fmt = NULL;
+
+  kbr = redis_kb (kb);
+  if (kbr->nvt_layout == KB_NVT_LAYOUT_HASH)
+    mask &= (NVT_FIELD (NVT_TIMESTAMP_POS) - 1) | NVT_FIELD (NVT_PREFS_POS);
+  else
+    mask &= NVT_FIELD (NVT_TIMESTAMP_POS) - 1;
+  if (oids == NULL || mask == 0)
+    return NULL;
+
+  if (kbr->nvt_layout == KB_NVT_LAYOUT_HASH)
+    fmt = redis_nvt_hmget_fmt (mask, positions, &nfields);
   else
+    /* Only fetch the list up to the last requested field. */
+    for (last = NVT_TIMESTAMP_POS - 1; !(mask & NVT_FIELD (last)); last--)
+      ;
+
+  redis_batch_sync (kbr);
+  if (get_redis_ctx (kbr) < 0)
+    {
+      g_free (fmt);
+      return NULL;
+    }
+
+  fields = g_malloc0_n (count ?: 1, sizeof (kb_nvt_fields_t));
+  for (done = 0; done < count; done += KB_BATCH_MAX)
     {
-      nvti_t *nvti = nvti_new ();
-
-      nvti_set_oid (nvti, oid);
-      nvti_set_required_keys (nvti, rep->element[NVT_REQUIRED_KEYS_POS]->str);
-      nvti_set_mandatory_keys (nvti, rep->element[NVT_MANDATORY_KEYS_POS]->str);
-      nvti_set_excluded_keys (nvti, rep->element[NVT_EXCLUDED_KEYS_POS]->str);
-      nvti_set_required_udp_ports (
-        nvti, rep->element[NVT_REQUIRED_UDP_PORTS_POS]->str);
-      nvti_set_required_ports (nvti, rep->element[NVT_REQUIRED_PORTS_POS]->str);
-      nvti_set_dependencies (nvti, rep->element[NVT_DEPENDENCIES_POS]->str);
-      nvti_set_tag (nvti, rep->element[NVT_TAGS_POS]->str);
-      nvti_add_refs (nvti, "cve", rep->element[NVT_CVES_POS]->str, "");
-      nvti_add_refs (nvti, "bid", rep->element[NVT_BIDS_POS]->str, "");
-      nvti_add_refs (nvti, NULL, rep->element[NVT_XREFS_POS]->str, "");
-      nvti_set_category (nvti, atoi (rep->element[NVT_CATEGORY_POS]->str));
-      nvti_set_timeout (nvti, atoi (rep->element[NVT_TIMEOUT_POS]->str));
-      nvti_set_family (nvti, rep->element[NVT_FAMILY_POS]->str);
-      nvti_set_name (nvti, rep->element[NVT_NAME_POS]->str);
+      size_t chunk = MIN (count - done, KB_BATCH_MAX), bytes = 0;
+      gint64 start = redis_stats_start ();
 
-      freeReplyObject (rep);
-      return nvti;
+      for (i = done; i < done + chunk; i++)
+        if (fmt)
+          redisAppendCommand (kbr->rctx, fmt, oids[i]);
+        else
+          redisAppendCommand (kbr->rctx, "LRANGE nvt:%s 0 %d", oids[i], last);
+
+      for (i = done; i < done + chunk; i++)
+        {
+          redisReply *rep = NULL;
+          int pos;
+
+          if (redisGetReply (kbr->rctx, (void **) &rep) != REDIS_OK || !rep)
+            {
+              g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                     "%s: redis connection error: %s", __func__,
+                     kbr->rctx->errstr);
+              redis_stats_record (__func__, start, chunk, bytes, 1, 1);
+              redis_lnk_reset (kb);
+              kb_nvt_fields_free (fields, count);
+              g_free (fmt);
+              return NULL;
+            }
+          bytes += redis_stats_reply_size (rep);
+          if (rep->type == REDIS_REPLY_ARRAY && fmt)
+            for (pos = 0; pos < (int) rep->elements && pos < nfields; pos++)
+              {
+                if (rep->element[pos]->type != REDIS_REPLY_STRING)
+                  continue;
+                if (positions[pos] == NVT_PREFS_POS)
+                  fields[i].prefs = g_strdup (rep->element[pos]->str);
+                else
+                  fields[i].field[positions[pos]] =
+                    g_strdup (rep->element[pos]->str);
+              }
+          else if (rep->type == REDIS_REPLY_ARRAY)
+            for (pos = 0; pos < (int) rep->elements && pos <= last; pos++)
+              if (mask & NVT_FIELD (pos)
+                  && rep->element[pos]->type == REDIS_REPLY_STRING)
+                fields[i].field[pos] = g_strdup (rep->element[pos]->str);
+          freeReplyObject (rep);
+        }
+      redis_stats_record (__func__, start, chunk, bytes, 0, 0);
     }
+
+  g_free (fmt);
+  return fields;
 }
 
 /**
@@ -897,13 +1838,162 @@ redis_get_all (kb_t kb, const char *name)
   if (rep == NULL)
     return NULL;
 
-  kbi = redis2kbitem (name, rep);
+  kbi = redis2kbitem (name, rep, NULL);
 
   freeReplyObject (rep);
 
   return kbi;
 }
 
+/**
+ * @brief Run one step of a SCAN iteration over the keys matching a pattern.
+ * @param[in] kbr  Subclass of struct kb where to run the command.
+ * @param[in] pattern  '*' pattern of the keys to retrieve.
+ * @param[in,out] cursor  SCAN cursor, updated with the cursor to continue from.
+ * @return Redis reply with the keys array as second element, NULL on error.
+ */
+static redisReply *
+redis_scan (struct kb_redis *kbr, const char *pattern,
+            unsigned long long *cursor)
+{
+  redisReply *rep;
+
+  rep = redis_cmd (kbr, "SCAN %llu MATCH %s COUNT %d", *cursor, pattern,
+                   KB_SCAN_COUNT);
+  if (rep == NULL)
+    return NULL;
+  if (rep->type != REDIS_REPLY_ARRAY || rep->elements != 2
+      || rep->element[0]->type != REDIS_REPLY_STRING
+      || rep->element[1]->type != REDIS_REPLY_ARRAY)
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+             "%s: unexpected reply to SCAN for '%s'", __func__, pattern);
+      freeReplyObject (rep);
+      return NULL;
+    }
+
+  *cursor = strtoull (rep->element[0]->str, NULL, 10);
+  return rep;
+}
+
+/**
+ * @brief Fetch the items stored under a set of keys in one pipeline.
+ * @param[in] kbr  Subclass of struct kb where to fetch the items.
+ * @param[in] keys  Names of the keys to fetch.
+ * @param[in] count  Number of keys.
+ * @param[out] last  Last item of the list. Can be NULL.
+ * @return Linked struct kb_item instances to be freed with kb_item_free() or
+ *         NULL if no element was found or on error.
+ */
+static struct kb_item *
+redis_fetch_keys (struct kb_redis *kbr, const char **keys, size_t count,
+                  struct kb_item **last)
+{
+  struct kb_item *kbi = NULL;
+  size_t i, bytes = 0;
+  unsigned int errors = 0;
+  gint64 start;
+
+  redis_batch_sync (kbr);
+  if (count == 0 || get_redis_ctx (kbr) < 0)
+    return NULL;
+  start = redis_stats_start ();
+  for (i = 0; i < count; i++)
+    redisAppendCommand (kbr->rctx, "LRANGE %s 0 -1", keys[i]);
+
+  for (i = 0; i < count; i++)
+    {
+      struct kb_item *tmp, *tail;
+      redisReply *rep_range = NULL;
+
+      if (redisGetReply (kbr->rctx, (void **) &rep_range) != REDIS_OK
+          || rep_range == NULL)
+        {
+          errors++;
+          continue;
+        }
+      bytes += redis_stats_reply_size (rep_range);
+      tmp = redis2kbitem (keys[i], rep_range, &tail);
+      freeReplyObject (rep_range);
+      if (!tmp)
+        continue;
+
+      if (kbi == NULL && last)
+        *last = tail;
+      tail->next = kbi;
+      kbi = tmp;
+    }
+  redis_stats_record (__func__, start, count, bytes, errors, 0);
+
+  return kbi;
+}
+
+/**
+ * @brief Get the items stored under the keys of one SCAN reply.
+ * @param[in] kbr  Subclass of struct kb where to fetch the items.
+ * @param[in] rep  SCAN reply holding the keys.
+ * @param[in] seen  Set of the keys already fetched, to skip the duplicates
+ *                  SCAN may return. Updated with the new keys. Can be NULL.
+ * @param[out] last  Last item of the list. Can be NULL.
+ * @return Linked struct kb_item instances to be freed with kb_item_free() or
+ *         NULL if no element was found or on error.
+ */
+static struct kb_item *
+redis_fetch_scanned (struct kb_redis *kbr, const redisReply *rep,
+                     GHashTable *seen, struct kb_item **last)
+{
+  const redisReply *keys = rep->element[1];
+  const char **names;
+  struct kb_item *kbi;
+  size_t i, count = 0;
+
+  names = g_malloc0_n (keys->elements + 1, sizeof (char *));
+  for (i = 0; i < keys->elements; i++)
+    {
+      if (keys->element[i]->type != REDIS_REPLY_STRING)
+        continue;
+      if (seen)
+        {
+          if (g_hash_table_contains (seen, keys->element[i]->str))
+            continue;
+          g_hash_table_add (seen, g_strdup (keys->element[i]->str));
+        }
+      names[count++] = keys->element[i]->str;
+    }
+
+  kbi = redis_fetch_keys (kbr, names, count, last);
+  g_free (names);
+  return kbi;
+}
+
+/**
+ * @brief Get one batch of the items stored under a given pattern.
+ * @param[in] kb  KB handle where to fetch the items.
+ * @param[in] pattern  '*' pattern of the elements to retrieve.
+ * @param[in,out] cursor  Iteration cursor. Set to 0 when done or on error.
+ * @return Linked struct kb_item instances to be freed with kb_item_free() or
+ *         NULL if no element was found in this batch or on error.
+ */
+static struct kb_item *
+redis_iter_pattern (kb_t kb, const char *pattern, unsigned long long *cursor)
+{
+  struct kb_redis *kbr;
+  struct kb_item *kbi;
+  redisReply *rep;
+
+  kbr = redis_kb (kb);
+  rep = redis_scan (kbr, pattern, cursor);
+  if (!rep)
+    {
+      *cursor = 0;
+      return NULL;
+    }
+
+  kbi = redis_fetch_scanned (kbr, rep, NULL, NULL);
+  freeReplyObject (rep);
+  return kbi;
+}
+
 /**
  * @brief Get all items stored under a given pattern.
  * @param[in] kb  KB handle where to fetch the items.
@@ -916,145 +2006,347 @@ redis_get_pattern (kb_t kb, const char *pattern)
 {
   struct kb_redis *kbr;
   struct kb_item *kbi = NULL;
-  redisReply *rep;
-  unsigned int i;
+  unsigned long long cursor = 0;
+  GHashTable *seen;
 
   kbr = redis_kb (kb);
-  rep = redis_cmd (kbr, "KEYS %s", pattern);
-  if (!rep)
-    return NULL;
-  if (rep->type != REDIS_REPLY_ARRAY)
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  do
     {
+      struct kb_item *batch, *tail;
+      redisReply *rep;
+
+      rep = redis_scan (kbr, pattern, &cursor);
+      if (!rep)
+        break;
+      batch = redis_fetch_scanned (kbr, rep, seen, &tail);
       freeReplyObject (rep);
-      return NULL;
+      if (!batch)
+        continue;
+
+      tail->next = kbi;
+      kbi = batch;
     }
+  while (cursor != 0);
 
-  if (get_redis_ctx (kbr) < 0)
-    return NULL;
-  for (i = 0; i < rep->elements; i++)
-    redisAppendCommand (kbr->rctx, "LRANGE %s 0 -1", rep->element[i]->str);
+  g_hash_table_destroy (seen);
+  return kbi;
+}
 
-  for (i = 0; i < rep->elements; i++)
+/**
+ * @brief Collect the names of all the keys matching a pattern.
+ * @param[in] kbr  Subclass of struct kb where to look for the keys.
+ * @param[in] pattern  '*' pattern of the keys to retrieve.
+ * @return Set of the key names to be freed with g_hash_table_destroy(), NULL
+ *         on error.
+ */
+static GHashTable *
+redis_scan_keys (struct kb_redis *kbr, const char *pattern)
+{
+  unsigned long long cursor = 0;
+  GHashTable *keys;
+
+  keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  do
     {
-      struct kb_item *tmp;
-      redisReply *rep_range;
+      redisReply *rep;
+      size_t i;
 
-      redisGetReply (kbr->rctx, (void **) &rep_range);
+      rep = redis_scan (kbr, pattern, &cursor);
       if (!rep)
-        continue;
-      tmp = redis2kbitem (rep->element[i]->str, rep_range);
-      if (!tmp)
         {
-          freeReplyObject (rep_range);
-          continue;
+          g_hash_table_destroy (keys);
+          return NULL;
         }
-
-      if (kbi)
+      for (i = 0; i < rep->element[1]->elements; i++)
         {
-          struct kb_item *tmp2;
+          redisReply *elt = rep->element[1]->element[i];
 
-          tmp2 = tmp;
-          while (tmp->next)
-            tmp = tmp->next;
-          tmp->next = kbi;
-          kbi = tmp2;
+          if (elt->type == REDIS_REPLY_STRING)
+            g_hash_table_add (keys, g_strdup (elt->str));
         }
-      else
-        kbi = tmp;
-      freeReplyObject (rep_range);
+      freeReplyObject (rep);
     }
+  while (cursor != 0);
 
-  freeReplyObject (rep);
-  return kbi;
+  return keys;
+}
+
+/**
+ * @brief Get all NVT OIDs.
+ * @param[in] kb  KB handle where to fetch the items.
+ * @return Linked list of all OIDs or NULL.
+ */
+static GSList *
+redis_get_oids (kb_t kb)
+{
+  GHashTable *keys;
+  GHashTableIter iter;
+  gpointer key;
+  GSList *list = NULL;
+
+  keys = redis_scan_keys (redis_kb (kb), "nvt:*");
+  if (!keys)
+    return NULL;
+
+  /* Fetch OID values from key names nvt:OID. */
+  g_hash_table_iter_init (&iter, keys);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    list = g_slist_prepend (list, g_strdup ((char *) key + 4));
+  g_hash_table_destroy (keys);
+
+  return list;
+}
+
+/**
+ * @brief Count all items stored under a given pattern.
+ *
+ * @param[in] kb  KB handle where to count the items.
+ * @param[in] pattern  '*' pattern of the elements to count.
+ *
+ * @return Count of items.
+ */
+static size_t
+redis_count (kb_t kb, const char *pattern)
+{
+  GHashTable *keys;
+  size_t count;
+
+  keys = redis_scan_keys (redis_kb (kb), pattern);
+  if (keys == NULL)
+    return 0;
+
+  count = g_hash_table_size (keys);
+  g_hash_table_destroy (keys);
+  return count;
+}
+
+/**
+ * @brief Get a field of the INFO reply of the server.
+ * @param[in] kbr      Subclass of struct kb.
+ * @param[in] section  INFO section holding the field.
+ * @param[in] field    Name of the field.
+ * @return Value of the field to be freed with g_free(), NULL if not found or
+ *         on error.
+ */
+static char *
+redis_info_field (struct kb_redis *kbr, const char *section,
+                  const char *field)
+{
+  redisReply *rep;
+  char *value = NULL;
+
+  rep = redis_cmd (kbr, "INFO %s", section);
+  if (rep && rep->type == REDIS_REPLY_STRING)
+    {
+      char *line = rep->str;
+      size_t field_len = strlen (field);
+
+      while (line && *line)
+        {
+          if (strncmp (line, field, field_len) == 0 && line[field_len] == ':')
+            {
+              line += field_len + 1;
+              value = g_strndup (line, strcspn (line, "\r\n"));
+              break;
+            }
+          line = strchr (line, '\n');
+          if (line)
+            line++;
+        }
+    }
+  if (rep)
+    freeReplyObject (rep);
+  return value;
 }
 
 /**
- * @brief Get all NVT OIDs.
- * @param[in] kb  KB handle where to fetch the items.
- * @return Linked list of all OIDs or NULL.
+ * @brief Check whether the server frees memory in the background, with
+ *        UNLINK and FLUSHDB ASYNC, which appeared in Redis 4.0.
+ * @param[in] kbr  Subclass of struct kb.
+ * @return 1 if so, 0 otherwise.
  */
-static GSList *
-redis_get_oids (kb_t kb)
+static int
+redis_lazy_free (struct kb_redis *kbr)
 {
-  struct kb_redis *kbr;
-  redisReply *rep;
-  GSList *list = NULL;
-  size_t i;
-
-  kbr = redis_kb (kb);
-  rep = redis_cmd (kbr, "KEYS nvt:*");
-  if (!rep)
-    return NULL;
+  char *version;
+  int lazy_free;
 
-  if (rep->type != REDIS_REPLY_ARRAY)
+  g_mutex_lock (&redis_pools_lock);
+  lazy_free = redis_pool_get (kbr->path)->lazy_free;
+  g_mutex_unlock (&redis_pools_lock);
+  if (lazy_free == 0)
     {
-      freeReplyObject (rep);
-      return NULL;
+      version = redis_info_field (kbr, "server", "redis_version");
+      if (version == NULL)
+        return 0;
+      lazy_free = atoi (version) >= 4 ? 1 : -1;
+      g_free (version);
+      g_mutex_lock (&redis_pools_lock);
+      redis_pool_get (kbr->path)->lazy_free = lazy_free;
+      g_mutex_unlock (&redis_pools_lock);
     }
+  return lazy_free > 0;
+}
 
-  /* Fetch OID values from key names nvt:OID. */
-  for (i = 0; i < rep->elements; i++)
-    list = g_slist_prepend (list, g_strdup (rep->element[i]->str + 4));
-  freeReplyObject (rep);
+/**
+ * @brief Delete all entries under a given name. The memory is freed in the
+ *        background when the server supports it.
+ * @param[in] kb  KB handle where to store the item.
+ * @param[in] name  Item name.
+ * @return 0 on success, non-null on error.
+ */
+static int
+redis_del_items (kb_t kb, const char *name)
+{
+  struct kb_redis *kbr = redis_kb (kb);
 
-  return list;
+  /* UNLINK frees large values in the background. */
+  return redis_write (kbr, "%s %s", redis_lazy_free (kbr) ? "UNLINK" : "DEL",
+                      name);
 }
 
 /**
- * @brief Count all items stored under a given pattern.
+ * @brief Script appending a value to a list unless it is already in it.
  *
- * @param[in] kb  KB handle where to count the items.
- * @param[in] pattern  '*' pattern of the elements to count.
+ * The value is looked up in the list itself, from its end, so that the list
+ * stays the only state and other writers of the KB need not know about the
+ * script.  A value that is already present is moved to the end of the list,
+ * unless it is there already.  Without LPOS, before Redis 6.0.6, the value
+ * is moved with LREM and RPUSH as the plain insert does.  Returns 1 if the
+ * value was present, 0 otherwise.
+ */
+static const char *redis_unique_script =
+  "local pos = redis.pcall('LPOS', KEYS[1], ARGV[1], 'RANK', -1)\n"
+  "if type(pos) == 'table' then\n"
+  "  local found = redis.call('LREM', KEYS[1], 1, ARGV[1])\n"
+  "  redis.call('RPUSH', KEYS[1], ARGV[1])\n"
+  "  return found\n"
+  "end\n"
+  "if not pos then\n"
+  "  redis.call('RPUSH', KEYS[1], ARGV[1])\n"
+  "  return 0\n"
+  "end\n"
+  "if pos ~= redis.call('LLEN', KEYS[1]) - 1 then\n"
+  "  redis.call('LREM', KEYS[1], 1, ARGV[1])\n"
+  "  redis.call('RPUSH', KEYS[1], ARGV[1])\n"
+  "end\n"
+  "return 1\n";
+
+/**
+ * @brief Get the SHA1 digest of the unique insert script, for EVALSHA.
  *
- * @return Count of items.
+ * @return Digest, as hexadecimal string.
  */
-static size_t
-redis_count (kb_t kb, const char *pattern)
+static const char *
+redis_unique_sha (void)
 {
-  struct kb_redis *kbr;
-  redisReply *rep;
-  size_t count;
+  static gsize sha = 0;
 
-  kbr = redis_kb (kb);
+  if (g_once_init_enter (&sha))
+    g_once_init_leave (&sha,
+                       (gsize) g_compute_checksum_for_string (
+                         G_CHECKSUM_SHA1, redis_unique_script, -1));
+  return (const char *) sha;
+}
 
-  rep = redis_cmd (kbr, "KEYS %s", pattern);
-  if (rep == NULL)
-    return 0;
+/**
+ * @brief Check whether an error reply means that scripts are not supported.
+ * @param[in] rep  Error reply.
+ * @return 1 if scripts are not supported, 0 otherwise.
+ */
+static int
+redis_unique_unsupported (const redisReply *rep)
+{
+  return strstr (rep->str, "unknown command") || strstr (rep->str, "disabled");
+}
 
-  if (rep->type != REDIS_REPLY_ARRAY)
-    {
-      freeReplyObject (rep);
-      return 0;
-    }
+/**
+ * @brief Load the unique insert script on the server, once per connection.
+ * @param[in] kbr  Subclass of struct kb.
+ * @return 0 on success, -1 on error or if scripts are not supported.
+ */
+static int
+redis_unique_load (struct kb_redis *kbr)
+{
+  redisReply *rep;
 
-  count = rep->elements;
+  if (kbr->unique_script)
+    return kbr->unique_script > 0 ? 0 : -1;
+
+  rep = redis_cmd (kbr, "SCRIPT LOAD %s", redis_unique_script);
+  if (rep == NULL)
+    return -1;
+  if (rep->type == REDIS_REPLY_STRING)
+    kbr->unique_script = 1;
+  else if (rep->type == REDIS_REPLY_ERROR && redis_unique_unsupported (rep))
+    kbr->unique_script = -1;
   freeReplyObject (rep);
-  return count;
+  return kbr->unique_script > 0 ? 0 : -1;
 }
 
 /**
- * @brief Delete all entries under a given name.
- * @param[in] kb  KB handle where to store the item.
- * @param[in] name  Item name.
- * @return 0 on success, non-null on error.
+ * @brief Append a value to a list unless it is already in it, atomically on
+ *        the server.
+ *
+ * The list is searched from its end, where values inserted again are
+ * usually found, and is not written to when the value already ends it.
+ *
+ * @param[in] kbr    Subclass of struct kb.
+ * @param[in] name   Item name.
+ * @param[in] value  Item value.
+ * @param[in] len    Value length.
+ * @return 0 on success, -1 on error, -2 if scripts are not supported by the
+ *         server, in which case the caller must fall back to LREM and RPUSH.
  */
 static int
-redis_del_items (kb_t kb, const char *name)
+redis_add_unique (struct kb_redis *kbr, const char *name, const char *value,
+                  size_t len)
 {
-  struct kb_redis *kbr;
   redisReply *rep;
-  int rc = 0;
 
-  kbr = redis_kb (kb);
+  if (kbr->unique_script < 0)
+    return -2;
 
-  rep = redis_cmd (kbr, "DEL %s", name);
-  if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
-    rc = -1;
+  if (kbr->batch)
+    {
+      if (redis_unique_load (kbr))
+        return kbr->unique_script < 0 ? -2 : -1;
+      return redis_write (kbr, "EVALSHA %s 1 %s %b", redis_unique_sha (),
+                          name, value, len)
+               ? -1
+               : 0;
+    }
 
-  if (rep != NULL)
-    freeReplyObject (rep);
+  rep = redis_cmd (kbr, "EVALSHA %s 1 %s %b", redis_unique_sha (), name,
+                   value, len);
+  if (rep && rep->type == REDIS_REPLY_ERROR
+      && strncmp (rep->str, "NOSCRIPT", 8) == 0)
+    {
+      /* EVAL also caches the script for the next EVALSHA. */
+      freeReplyObject (rep);
+      rep = redis_cmd (kbr, "EVAL %s 1 %s %b", redis_unique_script, name,
+                       value, len);
+    }
+  if (rep == NULL)
+    return -1;
+  if (rep->type == REDIS_REPLY_ERROR)
+    {
+      int rc = -1;
 
-  return rc;
+      if (redis_unique_unsupported (rep))
+        {
+          kbr->unique_script = -1;
+          rc = -2;
+        }
+      freeReplyObject (rep);
+      return rc;
+    }
+  if (rep->type == REDIS_REPLY_INTEGER && rep->integer == 1)
+    g_debug ("Key '%s' already contained value '%.*s'", name, (int) len,
+             value);
+  freeReplyObject (rep);
+  return 0;
 }
 
 /**
@@ -1072,11 +2364,27 @@ redis_add_str_unique (kb_t kb, const char *name, const char *str, size_t len)
   redisReply *rep = NULL;
   int rc = 0;
   redisContext *ctx;
+  gint64 start;
 
   kbr = redis_kb (kb);
+  rc = redis_add_unique (kbr, name, str, len ? len : strlen (str));
+  if (rc != -2)
+    return rc;
+  rc = 0;
+  if (kbr->batch)
+    {
+      if (len == 0)
+        rc = redis_write (kbr, "LREM %s 1 %s", name, str)
+             || redis_write (kbr, "RPUSH %s %s", name, str);
+      else
+        rc = redis_write (kbr, "LREM %s 1 %b", name, str, len)
+             || redis_write (kbr, "RPUSH %s %b", name, str, len);
+      return rc ? -1 : 0;
+    }
   if (get_redis_ctx (kbr) < 0)
     return -1;
   ctx = kbr->rctx;
+  start = redis_stats_start ();
 
   /* Some VTs still rely on values being unique (ie. a value inserted multiple
    * times, will only be present once.)
@@ -1108,6 +2416,7 @@ redis_add_str_unique (kb_t kb, const char *name, const char *str, size_t len)
   if (rep != NULL)
     freeReplyObject (rep);
 
+  redis_stats_record (__func__, start, 2, 0, rc != 0, 0);
   return rc;
 }
 
@@ -1123,20 +2432,11 @@ static int
 redis_add_str (kb_t kb, const char *name, const char *str, size_t len)
 {
   struct kb_redis *kbr;
-  redisReply *rep;
-  int rc = 0;
 
   kbr = redis_kb (kb);
   if (len == 0)
-    rep = redis_cmd (kbr, "RPUSH %s %s", name, str);
-  else
-    rep = redis_cmd (kbr, "RPUSH %s %b", name, str, len);
-  if (!rep || rep->type == REDIS_REPLY_ERROR)
-    rc = -1;
-
-  if (rep)
-    freeReplyObject (rep);
-  return rc;
+    return redis_write (kbr, "RPUSH %s %s", name, str);
+  return redis_write (kbr, "RPUSH %s %b", name, str, len);
 }
 
 /**
@@ -1153,12 +2453,24 @@ redis_set_str (kb_t kb, const char *name, const char *val, size_t len)
   struct kb_redis *kbr;
   redisReply *rep = NULL;
   redisContext *ctx;
+  gint64 start;
   int rc = 0, i = 4;
 
   kbr = redis_kb (kb);
+  if (kbr->batch)
+    {
+      rc = redis_write (kbr, "MULTI") || redis_write (kbr, "DEL %s", name);
+      if (len == 0)
+        rc = rc || redis_write (kbr, "RPUSH %s %s", name, val);
+      else
+        rc = rc || redis_write (kbr, "RPUSH %s %b", name, val, len);
+      rc = rc || redis_write (kbr, "EXEC");
+      return rc ? -1 : 0;
+    }
   if (get_redis_ctx (kbr) < 0)
     return -1;
   ctx = kbr->rctx;
+  start = redis_stats_start ();
   redisAppendCommand (ctx, "MULTI");
   redisAppendCommand (ctx, "DEL %s", name);
   if (len == 0)
@@ -1175,6 +2487,7 @@ redis_set_str (kb_t kb, const char *name, const char *val, size_t len)
         freeReplyObject (rep);
     }
 
+  redis_stats_record (__func__, start, 4, 0, rc != 0, 0);
   return rc;
 }
 
@@ -1192,11 +2505,25 @@ redis_add_int_unique (kb_t kb, const char *name, int val)
   redisReply *rep;
   int rc = 0;
   redisContext *ctx;
+  gint64 start;
+  char str[16];
 
   kbr = redis_kb (kb);
+  g_snprintf (str, sizeof (str), "%d", val);
+  rc = redis_add_unique (kbr, name, str, strlen (str));
+  if (rc != -2)
+    return rc;
+  rc = 0;
+  if (kbr->batch)
+    {
+      rc = redis_write (kbr, "LREM %s 1 %d", name, val)
+           || redis_write (kbr, "RPUSH %s %d", name, val);
+      return rc ? -1 : 0;
+    }
   if (get_redis_ctx (kbr) < 0)
     return -1;
   ctx = kbr->rctx;
+  start = redis_stats_start ();
   redisAppendCommand (ctx, "LREM %s 1 %d", name, val);
   redisAppendCommand (ctx, "RPUSH %s %d", name, val);
   redisGetReply (ctx, (void **) &rep);
@@ -1214,6 +2541,7 @@ out:
   if (rep != NULL)
     freeReplyObject (rep);
 
+  redis_stats_record (__func__, start, 2, 0, rc != 0, 0);
   return rc;
 }
 
@@ -1227,16 +2555,7 @@ out:
 static int
 redis_add_int (kb_t kb, const char *name, int val)
 {
-  redisReply *rep;
-  int rc = 0;
-
-  rep = redis_cmd (redis_kb (kb), "RPUSH %s %d", name, val);
-  if (!rep || rep->type == REDIS_REPLY_ERROR)
-    rc = -1;
-  if (rep)
-    freeReplyObject (rep);
-
-  return rc;
+  return redis_write (redis_kb (kb), "RPUSH %s %d", name, val);
 }
 
 /**
@@ -1252,12 +2571,21 @@ redis_set_int (kb_t kb, const char *name, int val)
   struct kb_redis *kbr;
   redisReply *rep = NULL;
   redisContext *ctx;
+  gint64 start;
   int rc = 0, i = 4;
 
   kbr = redis_kb (kb);
+  if (kbr->batch)
+    {
+      rc = redis_write (kbr, "MULTI") || redis_write (kbr, "DEL %s", name)
+           || redis_write (kbr, "RPUSH %s %d", name, val)
+           || redis_write (kbr, "EXEC");
+      return rc ? -1 : 0;
+    }
   if (get_redis_ctx (redis_kb (kb)) < 0)
     return -1;
   ctx = kbr->rctx;
+  start = redis_stats_start ();
   redisAppendCommand (ctx, "MULTI");
   redisAppendCommand (ctx, "DEL %s", name);
   redisAppendCommand (ctx, "RPUSH %s %d", name, val);
@@ -1271,9 +2599,50 @@ redis_set_int (kb_t kb, const char *name, int val)
         freeReplyObject (rep);
     }
 
+  redis_stats_record (__func__, start, 4, 0, rc != 0, 0);
   return rc;
 }
 
+/**
+ * @brief Append a length-prefixed string to packed NVT preferences.
+ * @param[in] packed  Packed preferences.
+ * @param[in] str     String to append.
+ */
+static void
+redis_pack_str (GString *packed, const char *str)
+{
+  size_t len = strlen (str ?: "");
+
+  g_string_append_printf (packed, "%zu:", len);
+  g_string_append_len (packed, str ?: "", len);
+}
+
+/**
+ * @brief Pack the preferences of a NVT, for KB_NVT_LAYOUT_HASH.
+ * @param[in] nvt  NVT.
+ * @return Packed preferences, to be freed with g_string_free().
+ */
+static GString *
+redis_pack_prefs (const nvti_t *nvt)
+{
+  GString *packed;
+  guint i;
+
+  packed = g_string_new (NULL);
+  for (i = 0; i < nvti_pref_len (nvt); i++)
+    {
+      const nvtpref_t *pref = nvti_pref (nvt, i);
+      char id[16];
+
+      g_snprintf (id, sizeof (id), "%d", pref->id);
+      redis_pack_str (packed, id);
+      redis_pack_str (packed, pref->name);
+      redis_pack_str (packed, pref->type);
+      redis_pack_str (packed, pref->dflt);
+    }
+  return packed;
+}
+
 /**
  * @brief Insert a new nvt.
  * @param[in] kb        KB handle where to store the nvt.
@@ -1285,9 +2654,8 @@ static int
 redis_add_nvt (kb_t kb, const nvti_t *nvt, const char *filename)
 {
   struct kb_redis *kbr;
-  redisReply *rep = NULL;
   int rc = 0;
-  GSList *element;
+  guint i;
   gchar *cves, *bids, *xrefs;
 
   if (!nvt || !filename)
@@ -1298,50 +2666,81 @@ redis_add_nvt (kb_t kb, const nvti_t *nvt, const char *filename)
   xrefs = nvti_refs (nvt, NULL, "cve,bid", 1);
 
   kbr = redis_kb (kb);
-  rep = redis_cmd (
-    kbr, "RPUSH nvt:%s %s %s %s %s %s %s %s %s %s %s %s %d %d %s %s",
-    nvti_oid (nvt), filename, nvti_required_keys (nvt) ?: "",
-    nvti_mandatory_keys (nvt) ?: "", nvti_excluded_keys (nvt) ?: "",
-    nvti_required_udp_ports (nvt) ?: "", nvti_required_ports (nvt) ?: "",
-    nvti_dependencies (nvt) ?: "", nvti_tag (nvt) ?: "", cves ?: "",
-    bids ?: "", xrefs ?: "", nvti_category (nvt),
-    nvti_timeout (nvt), nvti_family (nvt), nvti_name (nvt));
+  if (kbr->nvt_layout == KB_NVT_LAYOUT_HASH)
+    {
+      GString *prefs = redis_pack_prefs (nvt);
+
+      if (redis_write (
+            kbr,
+            "HMSET nvt:%s filename %s required_keys %s mandatory_keys %s"
+            " excluded_keys %s required_udp_ports %s required_ports %s"
+            " dependencies %s tags %s cves %s bids %s xrefs %s category %d"
+            " timeout %d family %s name %s prefs %b",
+            nvti_oid (nvt), filename, nvti_required_keys (nvt) ?: "",
+            nvti_mandatory_keys (nvt) ?: "", nvti_excluded_keys (nvt) ?: "",
+            nvti_required_udp_ports (nvt) ?: "",
+            nvti_required_ports (nvt) ?: "", nvti_dependencies (nvt) ?: "",
+            nvti_tag (nvt) ?: "", cves ?: "", bids ?: "", xrefs ?: "",
+            nvti_category (nvt), nvti_timeout (nvt), nvti_family (nvt) ?: "",
+            nvti_name (nvt) ?: "", prefs->str, prefs->len))
+        rc = -1;
+      g_string_free (prefs, TRUE);
+    }
+  else if (redis_write (
+             kbr,
+             "RPUSH nvt:%s %s %s %s %s %s %s %s %s %s %s %s %d %d %s %s",
+             nvti_oid (nvt), filename, nvti_required_keys (nvt) ?: "",
+             nvti_mandatory_keys (nvt) ?: "", nvti_excluded_keys (nvt) ?: "",
+             nvti_required_udp_ports (nvt) ?: "",
+             nvti_required_ports (nvt) ?: "", nvti_dependencies (nvt) ?: "",
+             nvti_tag (nvt) ?: "", cves ?: "", bids ?: "", xrefs ?: "",
+             nvti_category (nvt), nvti_timeout (nvt), nvti_family (nvt),
+             nvti_name (nvt)))
+    rc = -1;
   g_free (cves);
   g_free (bids);
   g_free (xrefs);
-  if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
-    rc = -1;
-  if (rep != NULL)
-    freeReplyObject (rep);
 
-  element = nvt->prefs;
-  if (g_slist_length (element))
-    rep = redis_cmd (kbr, "DEL oid:%s:prefs", nvti_oid (nvt));
-  while (element)
+  if (kbr->nvt_layout != KB_NVT_LAYOUT_HASH)
     {
-      nvtpref_t *pref = element->data;
-
-      rep = redis_cmd (kbr, "RPUSH oid:%s:prefs %d|||%s|||%s|||%s",
-                       nvti_oid (nvt), pref->id, pref->name, pref->type,
-                       pref->dflt);
-      if (!rep || rep->type == REDIS_REPLY_ERROR)
+      if (nvti_pref_len (nvt)
+          && redis_write (kbr, "DEL oid:%s:prefs", nvti_oid (nvt)))
         rc = -1;
-      if (rep)
-        freeReplyObject (rep);
-      element = element->next;
+      for (i = 0; i < nvti_pref_len (nvt); i++)
+        {
+          const nvtpref_t *pref = nvti_pref (nvt, i);
+
+          if (redis_write (kbr, "RPUSH oid:%s:prefs %d|||%s|||%s|||%s",
+                           nvti_oid (nvt), pref->id, pref->name, pref->type,
+                           pref->dflt))
+            rc = -1;
+        }
     }
-  rep = redis_cmd (kbr, "RPUSH filename:%s %lu %s", filename, time (NULL),
-                   nvti_oid (nvt));
-  if (!rep || rep->type == REDIS_REPLY_ERROR)
+  if (redis_write (kbr, "RPUSH filename:%s %lu %s", filename, time (NULL),
+                   nvti_oid (nvt)))
     rc = -1;
-  if (rep)
-    freeReplyObject (rep);
   return rc;
 }
 
+/**
+ * @brief Select the layout the NVTs are read and written with.
+ * @param[in] kb      KB handle where NVTs are stored.
+ * @param[in] layout  Layout of the NVTs.
+ * @return 0 on success, -1 if the layout is unknown.
+ */
+static int
+redis_set_nvt_layout (kb_t kb, enum kb_nvt_layout layout)
+{
+  if (layout != KB_NVT_LAYOUT_LIST && layout != KB_NVT_LAYOUT_HASH)
+    return -1;
+  redis_kb (kb)->nvt_layout = layout;
+  return 0;
+}
+
 /**
  * @brief Reset connection to the KB. This is called after each fork() to make
- *        sure connections aren't shared between concurrent processes.
+ *        sure connections aren't shared between concurrent processes. Idle
+ *        pooled connections inherited from the parent are dropped as well.
  * @param[in] kb KB handle.
  * @return 0 on success, non-null on error.
  */
@@ -1351,16 +2750,67 @@ redis_lnk_reset (kb_t kb)
   struct kb_redis *kbr;
 
   kbr = redis_kb (kb);
-
-  if (kbr->rctx != NULL)
+  if (redis_stats_enabled)
     {
-      redisFree (kbr->rctx);
-      kbr->rctx = NULL;
+      g_mutex_lock (&redis_stats_lock);
+      redis_stats_lnk_reset++;
+      g_mutex_unlock (&redis_stats_lock);
     }
 
+  /* Replies of batched commands are lost with the connection. */
+  if (kbr->pending > 0)
+    kbr->batch_rc = -1;
+  redis_disconnect (kbr);
+  kbr->pending = 0;
+  /* Drop the idle contexts inherited from the parent process, if any. */
+  g_mutex_lock (&redis_pools_lock);
+  redis_pool_get (kbr->path);
+  g_mutex_unlock (&redis_pools_lock);
+
+  return 0;
+}
+
+/**
+ * @brief Start batching the write commands sent to the KB.
+ * @param[in] kb KB handle.
+ * @return 0 on success, -1 if a batch is already started.
+ */
+static int
+redis_batch_begin (kb_t kb)
+{
+  struct kb_redis *kbr;
+
+  kbr = redis_kb (kb);
+  if (kbr->batch)
+    return -1;
+
+  kbr->batch = 1;
+  kbr->batch_rc = 0;
   return 0;
 }
 
+/**
+ * @brief Send the batched write commands and check their replies.
+ * @param[in] kb KB handle.
+ * @return 0 if all the batched commands succeeded, -1 otherwise.
+ */
+static int
+redis_batch_commit (kb_t kb)
+{
+  struct kb_redis *kbr;
+  int rc;
+
+  kbr = redis_kb (kb);
+  if (!kbr->batch)
+    return -1;
+
+  redis_batch_sync (kbr);
+  rc = kbr->batch_rc;
+  kbr->batch = 0;
+  kbr->batch_rc = 0;
+  return rc;
+}
+
 /**
  * @brief Flush all the KB's content. Delete all namespaces.
  * @param[in] kb        KB handle.
@@ -1370,100 +2820,137 @@ redis_lnk_reset (kb_t kb)
 static int
 redis_flush_all (kb_t kb, const char *except)
 {
-  unsigned int i = 1;
   struct kb_redis *kbr;
+  GArray *indexes;
+  unsigned int i;
 
   kbr = redis_kb (kb);
-  if (kbr->rctx)
-    redisFree (kbr->rctx);
+  redis_lnk_reset (kb);
+  kbr->batch = 0;
 
   g_debug ("%s: deleting all DBs at %s except %s", __func__, kbr->path, except);
-  do
+  if (redis_connect (kbr))
+    return -1;
+  indexes = redis_used_indexes (kbr);
+  if (indexes == NULL)
     {
-      redisReply *rep;
+      redis_disconnect (kbr);
+      return -1;
+    }
 
-      kbr->rctx = redisConnectUnix (kbr->path);
-      if (kbr->rctx == NULL || kbr->rctx->err)
-        {
-          g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
-                 "%s: redis connection error: %s", __func__,
-                 kbr->rctx ? kbr->rctx->errstr : strerror (ENOMEM));
-          redisFree (kbr->rctx);
-          kbr->rctx = NULL;
-          return -1;
-        }
+  for (i = 0; i < indexes->len; i++)
+    {
+      kbr->db = g_array_index (indexes, unsigned int, i);
+      if ((kbr->rctx == NULL && get_redis_ctx (kbr))
+          || redis_select (kbr, kbr->db))
+        continue;
 
-      kbr->db = i;
-      rep = redisCommand (kbr->rctx, "HEXISTS %s %d", GLOBAL_DBINDEX_NAME, i);
-      if (rep == NULL || rep->type != REDIS_REPLY_INTEGER || rep->integer != 1)
+      /* Don't remove DB if it has "except" key. */
+      if (except)
         {
-          freeReplyObject (rep);
-          redisFree (kbr->rctx);
-          i++;
-          continue;
-        }
-      freeReplyObject (rep);
-      rep = redisCommand (kbr->rctx, "SELECT %u", i);
-      if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
-        {
-          freeReplyObject (rep);
-          redisFree (kbr->rctx);
-          kbr->rctx = NULL;
-        }
-      else
-        {
-          freeReplyObject (rep);
-          /* Don't remove DB if it has "except" key. */
-          if (except)
+          char *tmp = kb_item_get_str (kb, except);
+          if (tmp)
             {
-              char *tmp = kb_item_get_str (kb, except);
-              if (tmp)
-                {
-                  g_free (tmp);
-                  i++;
-                  redisFree (kbr->rctx);
-                  continue;
-                }
+              g_free (tmp);
+              continue;
             }
-          redis_delete_all (kbr);
-          redis_release_db (kbr);
-          redisFree (kbr->rctx);
         }
-      i++;
+      redis_delete_all (kbr);
+      redis_release_db (kbr);
     }
-  while (i < kbr->max_db);
 
+  g_array_free (indexes, TRUE);
+  redis_disconnect (kbr);
   g_free (kb);
   return 0;
 }
 
+/**
+ * @brief Wait for the end of the background save running on the server.
+ * @param[in] kbr       Subclass of struct kb.
+ * @param[in] deadline  Monotonic time to give up at, in microseconds.
+ * @return 0 once no background save runs, -1 on error or timeout.
+ */
+static int
+redis_save_wait (struct kb_redis *kbr, gint64 deadline)
+{
+  char *status;
+
+  while ((status = redis_info_field (kbr, "persistence",
+                                     "rdb_bgsave_in_progress"))
+         && strcmp (status, "0"))
+    {
+      g_free (status);
+      if (g_get_monotonic_time () >= deadline)
+        {
+          g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                 "%s: background save still running after %d s", __func__,
+                 (int) (KB_SAVE_TIMEOUT / G_USEC_PER_SEC));
+          return -1;
+        }
+      g_usleep (KB_SAVE_POLL_INTERVAL);
+    }
+  if (status == NULL)
+    return -1;
+  g_free (status);
+  return 0;
+}
+
 /**
  * @brief Save all the elements from the KB.
+ *
+ * The save runs in the background on the server, so that it does not block
+ * the other clients, and its end is then waited for, up to KB_SAVE_TIMEOUT.
+ *
  * @param[in] kb        KB handle.
  * @return 0 on success, -1 on error.
  */
 int
 redis_save (kb_t kb)
 {
-  int rc;
+  int rc, retry;
   redisReply *rep;
   struct kb_redis *kbr;
+  char *status;
+  gint64 deadline;
 
   kbr = redis_kb (kb);
   g_debug ("%s: saving all elements from KB #%u", __func__, kbr->db);
-  rep = redis_cmd (kbr, "SAVE");
-  if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
+  deadline = g_get_monotonic_time () + KB_SAVE_TIMEOUT;
+  for (retry = 0; retry < 2; retry++)
     {
-      rc = -1;
-      goto err_cleanup;
+      rep = redis_cmd (kbr, "BGSAVE");
+      if (rep == NULL)
+        return -1;
+      if (rep->type == REDIS_REPLY_STATUS)
+        break;
+      if (rep->type != REDIS_REPLY_ERROR
+          || !strstr (rep->str, "Background save already in progress"))
+        {
+          /* As when the server cannot fork, or rewrites the AOF. */
+          freeReplyObject (rep);
+          rep = redis_cmd (kbr, "SAVE");
+          rc = rep && rep->type == REDIS_REPLY_STATUS ? 0 : -1;
+          if (rep != NULL)
+            freeReplyObject (rep);
+          return rc;
+        }
+      /* A save started before the changes to save: wait and start another. */
+      freeReplyObject (rep);
+      rep = NULL;
+      if (redis_save_wait (kbr, deadline))
+        return -1;
     }
+  if (rep == NULL)
+    return -1;
+  freeReplyObject (rep);
 
-  rc = 0;
-
-err_cleanup:
-  if (rep != NULL)
-    freeReplyObject (rep);
+  if (redis_save_wait (kbr, deadline))
+    return -1;
 
+  status = redis_info_field (kbr, "persistence", "rdb_last_bgsave_status");
+  rc = status && !strcmp (status, "ok") ? 0 : -1;
+  g_free (status);
   return rc;
 }
 
@@ -1488,7 +2975,8 @@ redis_delete_all (struct kb_redis *kbr)
     return -1;
 
   g_debug ("%s: deleting all elements from KB #%u", __func__, kbr->db);
-  rep = redis_cmd (kbr, "FLUSHDB");
+  /* The DB is empty right away, the memory is freed in the background. */
+  rep = redis_cmd (kbr, redis_lazy_free (kbr) ? "FLUSHDB ASYNC" : "FLUSHDB");
   if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
     {
       rc = -1;
@@ -1539,6 +3027,11 @@ static const struct kb_operations KBRedisOperations = {
   .kb_flush = redis_flush_all,
   .kb_direct_conn = redis_direct_conn,
   .kb_get_kb_index = redis_get_kb_index,
+  .kb_batch_begin = redis_batch_begin,
+  .kb_batch_commit = redis_batch_commit,
+  .kb_get_nvt_fields = redis_get_nvt_fields,
+  .kb_iter_pattern = redis_iter_pattern,
+  .kb_set_nvt_layout = redis_set_nvt_layout,
 };
 
 const struct kb_operations *KBDefaultOperations = &KBRedisOperations;
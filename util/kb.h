@@ -70,8 +70,81 @@ enum kb_nvt_pos
   NVT_NAME_POS,
   NVT_TIMESTAMP_POS,
   NVT_OID_POS,
+  NVT_PREFS_POS, /**< Packed preferences, KB_NVT_LAYOUT_HASH only. */
 };
 
+/**
+ * @brief Layouts of the NVTs in a KB.
+ *
+ * With KB_NVT_LAYOUT_LIST, the fields of a NVT are stored in a list under
+ * nvt:OID, indexed by kb_nvt_pos, and its preferences in a list under
+ * oid:OID:prefs, as "id|||name|||type|||default" strings.
+ *
+ * With KB_NVT_LAYOUT_HASH, the fields are stored in a hash under nvt:OID, one
+ * named field per kb_nvt_pos, the preferences included.  The preferences are
+ * packed in a single value, each of them as its id, name, type and default
+ * value, each of these as "<length>:<bytes>".
+ */
+enum kb_nvt_layout
+{
+  KB_NVT_LAYOUT_LIST = 1, /**< Positional lists. */
+  KB_NVT_LAYOUT_HASH = 2, /**< Hashes with named fields. */
+};
+
+/**
+ * @brief Bit of a kb_nvt_pos in a mask of NVT fields.
+ */
+#define NVT_FIELD(pos) (1U << (pos))
+
+/**
+ * @brief Fields of a NVT, as fetched in bulk with kb_nvt_get_fields().
+ */
+typedef struct
+{
+  char *field[NVT_TIMESTAMP_POS]; /**< Values, indexed by kb_nvt_pos. NULL
+                                       if not requested or not found. */
+  char *prefs;                    /**< Packed preferences, with
+                                       NVT_FIELD (NVT_PREFS_POS). */
+} kb_nvt_fields_t;
+
+/**
+ * @brief Statistics of the commands a KB operation sent to the server.
+ */
+typedef struct
+{
+  char *name;                /**< Name of the operation, as in kb_operations
+                                  without the "kb_" prefix, or of the helper
+                                  that sent the commands. */
+  unsigned long calls;       /**< Number of commands sent. */
+  unsigned long round_trips; /**< Number of round trips, a pipeline of
+                                  commands being a single one. */
+  unsigned long errors;      /**< Number of error replies and failed round
+                                  trips. */
+  unsigned long reconnects;  /**< Connection resets after failed round
+                                  trips. */
+  unsigned long long bytes;  /**< Size of the replies, in bytes. */
+  unsigned long long total;  /**< Total latency of the round trips, in
+                                  microseconds. */
+  unsigned long p50;         /**< Median latency of a round trip, in
+                                  microseconds. */
+  unsigned long p99;         /**< 99th percentile of the latency of a round
+                                  trip, in microseconds. */
+  unsigned long max;         /**< Highest latency of a round trip, in
+                                  microseconds. */
+} kb_op_stats_t;
+
+/**
+ * @brief Statistics of the KB operations of the process.
+ */
+typedef struct
+{
+  kb_op_stats_t *ops;      /**< Operations, by decreasing total latency. */
+  size_t count;            /**< Number of operations. */
+  unsigned long lnk_reset; /**< Number of connection resets. */
+} kb_stats_t;
+
+struct kb_item_arena;
+
 /**
  * @brief Knowledge base item (defined by name, type (int/char*) and value).
  *        Implemented as a singly linked list
@@ -90,7 +163,9 @@ struct kb_item
   struct kb_item *next; /**< Next item in list. */
 
   size_t namelen; /**< Name length (including final NULL byte). */
-  char name[0];   /**< Name of this knowledge base item.  */
+  struct kb_item_arena *arena; /**< Block holding the item and its value,
+                                    NULL if they are allocated separately. */
+  char name[0]; /**< Name of this knowledge base item.  */
 };
 
 struct kb_operations;
@@ -216,6 +291,26 @@ struct kb_operations
   int (*kb_lnk_reset) (kb_t);           /**< Reset connection to KB. */
   int (*kb_flush) (kb_t, const char *); /**< Flush redis DB. */
   int (*kb_get_kb_index) (kb_t);        /**< Get kb index. */
+
+  /* Added after gvm-libs 11.0, keep new members at the end. */
+  int (*kb_batch_begin) (kb_t);  /**< Start batching writes. */
+  int (*kb_batch_commit) (kb_t); /**< Send batched writes. */
+  /**
+   * Function provided by an implementation to get fields of many NVTs.
+   */
+  kb_nvt_fields_t *(*kb_get_nvt_fields) (kb_t, const char **, size_t,
+                                         unsigned int);
+  /**
+   * Function provided by an implementation to get one batch of items
+   * stored under a given pattern, starting at a given cursor.
+   */
+  struct kb_item *(*kb_iter_pattern) (kb_t, const char *,
+                                      unsigned long long *);
+  /**
+   * Function provided by an implementation to select the layout of the
+   * NVTs.
+   */
+  int (*kb_set_nvt_layout) (kb_t, enum kb_nvt_layout);
 };
 
 /**
@@ -231,6 +326,27 @@ extern const struct kb_operations *KBDefaultOperations;
 void
 kb_item_free (struct kb_item *);
 
+/**
+ * @brief Release an array of NVT fields.
+ */
+void
+kb_nvt_fields_free (kb_nvt_fields_t *, size_t);
+
+void
+kb_stats_enable (int);
+
+void
+kb_stats_reset (void);
+
+kb_stats_t *
+kb_get_stats (void);
+
+void
+kb_stats_free (kb_stats_t *);
+
+void
+kb_stats_log (void);
+
 /**
  * @brief Initialize a new Knowledge Base object.
  * @param[in] kb  Reference to a kb_t to initialize.
@@ -380,6 +496,31 @@ kb_item_get_pattern (kb_t kb, const char *pattern)
   return kb->kb_ops->kb_get_pattern (kb, pattern);
 }
 
+/**
+ * @brief Get one batch of the items stored under a given pattern.
+ *
+ * The iteration is cursor based and doesn't block the KB for the whole
+ * keyspace. Set @a cursor to 0 before the first call, the iteration is
+ * complete once it is set back to 0. A batch may be empty while the iteration
+ * is still going on, and an element may be returned in more than one batch.
+ *
+ * @param[in] kb  KB handle where to fetch the items.
+ * @param[in] pattern  '*' pattern of the elements to retrieve.
+ * @param[in,out] cursor  Iteration cursor. Set to 0 when done or on error.
+ * @return Linked struct kb_item instances to be freed with kb_item_free() or
+ *         NULL if no element was found in this batch or on error.
+ */
+static inline struct kb_item *
+kb_item_iter_pattern (kb_t kb, const char *pattern, unsigned long long *cursor)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+  assert (kb->kb_ops->kb_iter_pattern);
+  assert (cursor);
+
+  return kb->kb_ops->kb_iter_pattern (kb, pattern, cursor);
+}
+
 /**
  * @brief Push a new value under a given key.
  * @param[in] kb    KB handle where to store the item.
@@ -587,6 +728,43 @@ kb_nvt_get_all (kb_t kb, const char *oid)
   return kb->kb_ops->kb_get_nvt_all (kb, oid);
 }
 
+/**
+ * @brief Get fields of many NVTs at once.
+ * @param[in] kb        KB handle where the NVTs are stored.
+ * @param[in] oids      OIDs of the NVTs to get.
+ * @param[in] count     Number of OIDs.
+ * @param[in] mask      NVT_FIELD() bits of the fields to get. Only positions
+ *                      lower than NVT_TIMESTAMP_POS are supported, and
+ *                      NVT_PREFS_POS with KB_NVT_LAYOUT_HASH.
+ * @return Array of count fields structures, in the order of oids, to be freed
+ *         with kb_nvt_fields_free(). NULL on error.
+ */
+static inline kb_nvt_fields_t *
+kb_nvt_get_fields (kb_t kb, const char **oids, size_t count, unsigned int mask)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+  assert (kb->kb_ops->kb_get_nvt_fields);
+
+  return kb->kb_ops->kb_get_nvt_fields (kb, oids, count, mask);
+}
+
+/**
+ * @brief Select the layout the NVTs are read and written with.
+ * @param[in] kb      KB handle where NVTs are stored.
+ * @param[in] layout  Layout of the NVTs. KB_NVT_LAYOUT_LIST by default.
+ * @return 0 on success, non-null on error.
+ */
+static inline int
+kb_nvt_set_layout (kb_t kb, enum kb_nvt_layout layout)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+  assert (kb->kb_ops->kb_set_nvt_layout);
+
+  return kb->kb_ops->kb_set_nvt_layout (kb, layout);
+}
+
 /**
  * @brief Get list of NVT OIDs.
  * @param[in] kb        KB handle where NVTs are stored.
@@ -639,7 +817,8 @@ kb_save (kb_t kb)
 
 /**
  * @brief Reset connection to the KB. This is called after each fork() to make
- *        sure connections aren't shared between concurrent processes.
+ *        sure connections aren't shared between concurrent processes. Idle
+ *        pooled connections inherited from the parent are dropped as well.
  * @param[in] kb  KB handle.
  * @return 0 on success, non-null on error.
  */
@@ -657,6 +836,50 @@ kb_lnk_reset (kb_t kb)
   return rc;
 }
 
+/**
+ * @brief Start batching the write operations on the KB.
+ *
+ * Until kb_batch_commit() is called, the write operations are queued and sent
+ * in bulk instead of waiting for each reply. Their return value then only
+ * tells whether queueing succeeded. Read operations stay synchronous and
+ * can be mixed with batched writes.
+ *
+ * @param[in] kb  KB handle.
+ * @return 0 on success, non-null on error.
+ */
+static inline int
+kb_batch_begin (kb_t kb)
+{
+  int rc = 0;
+
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (kb->kb_ops->kb_batch_begin != NULL)
+    rc = kb->kb_ops->kb_batch_begin (kb);
+
+  return rc;
+}
+
+/**
+ * @brief Send the batched write operations and check their results.
+ * @param[in] kb  KB handle.
+ * @return 0 if all batched operations succeeded, non-null on error.
+ */
+static inline int
+kb_batch_commit (kb_t kb)
+{
+  int rc = 0;
+
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (kb->kb_ops->kb_batch_commit != NULL)
+    rc = kb->kb_ops->kb_batch_commit (kb);
+
+  return rc;
+}
+
 /**
  * @brief Flush all the KB's content. Delete all namespaces.
  * @param[in] kb        KB handle.
@@ -0,0 +1,662 @@
+/* Copyright (C) 2014-2019 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * @brief Non-blocking knowledge base API - Redis backend.
+ *
+ * Commands are queued on a hiredis asynchronous context and their replies
+ * are handed to callbacks as they arrive, so that a single process can keep
+ * many KB operations in flight. The context is driven either by a GLib main
+ * context (kb_async_attach()) or by any event loop the caller attaches to
+ * the hiredis context returned by kb_async_redis_context().
+ */
+
+#include "kbasync.h"
+
+#include <hiredis/async.h> /* for redisAsyncContext, redisAsyncCommand */
+#include <stdlib.h>        /* for atoi */
+#include <string.h>        /* for memcpy */
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "lib  kb"
+
+/**
+ * @brief Non-blocking connection to a KB.
+ */
+struct kb_async
+{
+  redisAsyncContext *actx; /**< Redis asynchronous context. */
+  GSource *source;         /**< GLib source driving actx, if attached. */
+  unsigned int db;         /**< Namespace ID number. */
+  size_t pending;          /**< Number of commands waiting for a reply. */
+};
+
+/**
+ * @brief GLib source watching the socket of a Redis asynchronous context.
+ */
+typedef struct
+{
+  GSource source;          /**< Parent source. */
+  redisAsyncContext *actx; /**< Redis asynchronous context. */
+  gpointer tag;            /**< Tag of the watched socket. */
+  GIOCondition events;     /**< Events hiredis waits for. */
+  struct kb_async *kba;    /**< KB connection owning the source. */
+} kb_async_source_t;
+
+/**
+ * @brief Kind of reply a pending command expects.
+ */
+enum kb_async_request_type
+{
+  KB_ASYNC_STR,
+  KB_ASYNC_INT,
+  KB_ASYNC_ALL,
+  KB_ASYNC_DONE
+};
+
+/**
+ * @brief A command waiting for its reply.
+ */
+struct kb_async_request
+{
+  struct kb_async *kba;             /**< KB connection. */
+  enum kb_async_request_type type;  /**< Kind of callback. */
+  union
+  {
+    kb_async_str_cb str;
+    kb_async_int_cb integer;
+    kb_async_all_cb all;
+    kb_async_done_cb done;
+  } cb;                             /**< Callback to call with the reply. */
+  void *data;                       /**< User data for the callback. */
+  char *name;                       /**< Item name, for KB_ASYNC_ALL. */
+};
+
+/**
+ * @brief Check whether a GLib source has work to do before polling.
+ * @param[in] source  Source.
+ * @param[out] timeout  Poll timeout.
+ * @return FALSE, events are only known after polling.
+ */
+static gboolean
+source_prepare (GSource *source, gint *timeout)
+{
+  (void) source;
+  *timeout = -1;
+  return FALSE;
+}
+
+/**
+ * @brief Check whether the socket of a GLib source is ready.
+ * @param[in] source  Source.
+ * @return TRUE if the source is to be dispatched.
+ */
+static gboolean
+source_check (GSource *source)
+{
+  kb_async_source_t *ksource = (kb_async_source_t *) source;
+
+  return g_source_query_unix_fd (source, ksource->tag) != 0;
+}
+
+/**
+ * @brief Handle the ready socket of a GLib source.
+ * @param[in] source  Source.
+ * @param[in] callback  Unused.
+ * @param[in] data  Unused.
+ * @return G_SOURCE_CONTINUE.
+ */
+static gboolean
+source_dispatch (GSource *source, GSourceFunc callback, gpointer data)
+{
+  kb_async_source_t *ksource = (kb_async_source_t *) source;
+  redisAsyncContext *actx = ksource->actx;
+  GIOCondition ready;
+
+  (void) callback;
+  (void) data;
+  ready = g_source_query_unix_fd (source, ksource->tag);
+  /* Reading may free actx, on error or disconnection. */
+  if (ready & G_IO_OUT)
+    redisAsyncHandleWrite (actx);
+  if (ready & (G_IO_IN | G_IO_HUP | G_IO_ERR) && ksource->actx)
+    redisAsyncHandleRead (actx);
+  return G_SOURCE_CONTINUE;
+}
+
+/**
+ * @brief Functions of the GLib source of a Redis asynchronous context.
+ */
+static GSourceFuncs source_funcs = {
+  source_prepare, source_check, source_dispatch, NULL, NULL, NULL};
+
+/**
+ * @brief Update the events watched by a GLib source.
+ * @param[in] ksource  Source.
+ * @param[in] add  Events to add.
+ * @param[in] del  Events to remove.
+ */
+static void
+source_update (kb_async_source_t *ksource, GIOCondition add, GIOCondition del)
+{
+  ksource->events = (ksource->events | add) & ~del;
+  g_source_modify_unix_fd ((GSource *) ksource, ksource->tag,
+                           ksource->events | G_IO_HUP | G_IO_ERR);
+}
+
+/**
+ * @brief hiredis hook: watch for readability.
+ * @param[in] data  Source.
+ */
+static void
+source_add_read (void *data)
+{
+  source_update (data, G_IO_IN, 0);
+}
+
+/**
+ * @brief hiredis hook: stop watching for readability.
+ * @param[in] data  Source.
+ */
+static void
+source_del_read (void *data)
+{
+  source_update (data, 0, G_IO_IN);
+}
+
+/**
+ * @brief hiredis hook: watch for writability.
+ * @param[in] data  Source.
+ */
+static void
+source_add_write (void *data)
+{
+  source_update (data, G_IO_OUT, 0);
+}
+
+/**
+ * @brief hiredis hook: stop watching for writability.
+ * @param[in] data  Source.
+ */
+static void
+source_del_write (void *data)
+{
+  source_update (data, 0, G_IO_OUT);
+}
+
+/**
+ * @brief hiredis hook: the context is being freed.
+ * @param[in] data  Source.
+ */
+static void
+source_cleanup (void *data)
+{
+  kb_async_source_t *ksource = data;
+
+  ksource->actx = NULL;
+  ksource->kba->source = NULL;
+  g_source_destroy ((GSource *) ksource);
+  g_source_unref ((GSource *) ksource);
+}
+
+/**
+ * @brief hiredis hook: the connection is closed.
+ * @param[in] actx  Redis asynchronous context, freed after the call.
+ * @param[in] status  REDIS_OK on a requested disconnection.
+ */
+static void
+kb_async_disconnected (const redisAsyncContext *actx, int status)
+{
+  struct kb_async *kba = actx->data;
+
+  if (status != REDIS_OK)
+    g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+           "%s: redis connection error: %s", __func__, actx->errstr);
+  kba->actx = NULL;
+}
+
+/**
+ * @brief Check the reply to the SELECT of a new connection.
+ * @param[in] actx  Redis asynchronous context.
+ * @param[in] reply  Reply, NULL on error.
+ * @param[in] data  Unused.
+ */
+static void
+kb_async_selected (redisAsyncContext *actx, void *reply, void *data)
+{
+  redisReply *rep = reply;
+
+  (void) data;
+  if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL, "%s: cannot select KB #%u",
+             __func__, ((struct kb_async *) actx->data)->db);
+      /* Don't let the queued commands run on the wrong DB. */
+      redisAsyncDisconnect (actx);
+    }
+}
+
+/**
+ * @brief Open a non-blocking connection to a KB.
+ *
+ * The connection only makes progress once attached to an event loop, with
+ * kb_async_attach() or through kb_async_redis_context().
+ *
+ * @param[in] kb_path   Path to the server socket.
+ * @param[in] kb_index  Index of the DB of the KB, as returned by
+ *                      kb_get_kb_index().
+ * @return KB connection to free with kb_async_free(), NULL on error.
+ */
+kb_async_t
+kb_async_new (const char *kb_path, int kb_index)
+{
+  struct kb_async *kba;
+
+  if (kb_path == NULL || kb_index <= 0)
+    return NULL;
+
+  kba = g_malloc0 (sizeof (struct kb_async));
+  kba->db = kb_index;
+  kba->actx = redisAsyncConnectUnix (kb_path);
+  if (kba->actx == NULL || kba->actx->err)
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+             "%s: redis connection error: %s", __func__,
+             kba->actx ? kba->actx->errstr : "out of memory");
+      if (kba->actx)
+        redisAsyncFree (kba->actx);
+      g_free (kba);
+      return NULL;
+    }
+  kba->actx->data = kba;
+  redisAsyncSetDisconnectCallback (kba->actx, kb_async_disconnected);
+  redisAsyncCommand (kba->actx, kb_async_selected, NULL, "SELECT %u",
+                     kba->db);
+  return kba;
+}
+
+/**
+ * @brief Drive a KB connection from a GLib main context.
+ * @param[in] kba  KB connection.
+ * @param[in] context  Main context, NULL for the default one.
+ * @return 0 on success, -1 if the connection is closed or already attached.
+ */
+int
+kb_async_attach (kb_async_t kba, GMainContext *context)
+{
+  kb_async_source_t *ksource;
+  redisAsyncContext *actx = kba->actx;
+
+  if (actx == NULL || kba->source || actx->ev.data)
+    return -1;
+
+  ksource = (kb_async_source_t *) g_source_new (&source_funcs,
+                                                sizeof (kb_async_source_t));
+  ksource->actx = actx;
+  ksource->kba = kba;
+  ksource->events = 0;
+  ksource->tag = g_source_add_unix_fd ((GSource *) ksource, actx->c.fd,
+                                       G_IO_HUP | G_IO_ERR);
+  kba->source = (GSource *) ksource;
+
+  actx->ev.data = ksource;
+  actx->ev.addRead = source_add_read;
+  actx->ev.delRead = source_del_read;
+  actx->ev.addWrite = source_add_write;
+  actx->ev.delWrite = source_del_write;
+  actx->ev.cleanup = source_cleanup;
+
+  g_source_attach ((GSource *) ksource, context);
+  /* The SELECT and any command queued so far wait to be written. */
+  source_add_write (ksource);
+  return 0;
+}
+
+/**
+ * @brief Get the hiredis asynchronous context of a KB connection, to drive
+ *        it from another event loop with one of the hiredis adapters.
+ * @param[in] kba  KB connection.
+ * @return redisAsyncContext, NULL if the connection is closed.
+ */
+void *
+kb_async_redis_context (kb_async_t kba)
+{
+  return kba->actx;
+}
+
+/**
+ * @brief Get the number of commands waiting for their reply.
+ * @param[in] kba  KB connection.
+ * @return Number of pending commands.
+ */
+size_t
+kb_async_pending (kb_async_t kba)
+{
+  return kba->pending;
+}
+
+/**
+ * @brief Close a KB connection. The callbacks of the pending commands are
+ *        called with an error.
+ * @param[in] kba  KB connection.
+ */
+void
+kb_async_free (kb_async_t kba)
+{
+  if (kba == NULL)
+    return;
+  if (kba->actx)
+    redisAsyncFree (kba->actx);
+  g_free (kba);
+}
+
+/**
+ * @brief Build a list of KB items from a LRANGE reply.
+ * @param[in] name  Name of the item.
+ * @param[in] rep   Reply.
+ * @return List of items to free with kb_item_free(), NULL if empty.
+ */
+static struct kb_item *
+kb_async_items (const char *name, const redisReply *rep)
+{
+  struct kb_item *items = NULL;
+  size_t i, namelen = strlen (name) + 1;
+
+  for (i = 0; i < rep->elements; i++)
+    {
+      const redisReply *elt = rep->element[i];
+      struct kb_item *item;
+
+      if (elt->type != REDIS_REPLY_STRING)
+        continue;
+      item = g_malloc0 (sizeof (struct kb_item) + namelen);
+      item->type = KB_TYPE_STR;
+      item->v_str = g_memdup (elt->str, elt->len + 1);
+      item->len = elt->len;
+      item->namelen = namelen;
+      memcpy (item->name, name, namelen);
+      item->next = items;
+      items = item;
+    }
+  return items;
+}
+
+/**
+ * @brief Hand the reply of a command to its callback.
+ * @param[in] actx  Redis asynchronous context.
+ * @param[in] reply  Reply, NULL on error or when the connection is closed.
+ * @param[in] privdata  struct kb_async_request of the command.
+ */
+static void
+kb_async_reply (redisAsyncContext *actx, void *reply, void *privdata)
+{
+  struct kb_async_request *req = privdata;
+  redisReply *rep = reply;
+  int ok;
+
+  (void) actx;
+  req->kba->pending--;
+  switch (req->type)
+    {
+    case KB_ASYNC_STR:
+      ok = rep && rep->type == REDIS_REPLY_STRING;
+      req->cb.str (req->kba, ok ? rep->str : NULL, req->data);
+      break;
+    case KB_ASYNC_INT:
+      ok = rep && rep->type == REDIS_REPLY_STRING;
+      req->cb.integer (req->kba, ok ? atoi (rep->str) : 0, ok ? 0 : -1,
+                       req->data);
+      break;
+    case KB_ASYNC_ALL:
+      ok = rep && rep->type == REDIS_REPLY_ARRAY;
+      req->cb.all (req->kba, ok ? kb_async_items (req->name, rep) : NULL,
+                   req->data);
+      break;
+    case KB_ASYNC_DONE:
+      ok = rep && rep->type != REDIS_REPLY_ERROR
+           && rep->type != REDIS_REPLY_NIL;
+      if (req->cb.done)
+        req->cb.done (req->kba, ok ? 0 : -1, req->data);
+      break;
+    }
+  g_free (req->name);
+  g_free (req);
+}
+
+/**
+ * @brief Queue a command whose reply goes to a callback.
+ * @param[in] kba  KB connection.
+ * @param[in] req  Request describing the callback, freed in any case.
+ * @param[in] fmt  Format string of the command.
+ * @return 0 on success, -1 if the connection is closed.
+ */
+static int
+kb_async_cmd (struct kb_async *kba, struct kb_async_request *req,
+              const char *fmt, ...)
+{
+  va_list ap;
+  int rc;
+
+  if (kba->actx == NULL)
+    {
+      g_free (req->name);
+      g_free (req);
+      return -1;
+    }
+
+  req->kba = kba;
+  va_start (ap, fmt);
+  rc = redisvAsyncCommand (kba->actx, kb_async_reply, req, fmt, ap);
+  va_end (ap);
+  if (rc != REDIS_OK)
+    {
+      g_free (req->name);
+      g_free (req);
+      return -1;
+    }
+  kba->pending++;
+  return 0;
+}
+
+/**
+ * @brief Get a single KB string item.
+ * @param[in] kba  KB connection.
+ * @param[in] name  Name of the item.
+ * @param[in] cb  Callback receiving the value.
+ * @param[in] data  User data for the callback.
+ * @return 0 if the command was queued, -1 otherwise.
+ */
+int
+kb_async_get_str (kb_async_t kba, const char *name, kb_async_str_cb cb,
+                  void *data)
+{
+  struct kb_async_request *req;
+
+  req = g_malloc0 (sizeof (struct kb_async_request));
+  req->type = KB_ASYNC_STR;
+  req->cb.str = cb;
+  req->data = data;
+  return kb_async_cmd (kba, req, "LINDEX %s -1", name);
+}
+
+/**
+ * @brief Get a single KB integer item.
+ * @param[in] kba  KB connection.
+ * @param[in] name  Name of the item.
+ * @param[in] cb  Callback receiving the value.
+ * @param[in] data  User data for the callback.
+ * @return 0 if the command was queued, -1 otherwise.
+ */
+int
+kb_async_get_int (kb_async_t kba, const char *name, kb_async_int_cb cb,
+                  void *data)
+{
+  struct kb_async_request *req;
+
+  req = g_malloc0 (sizeof (struct kb_async_request));
+  req->type = KB_ASYNC_INT;
+  req->cb.integer = cb;
+  req->data = data;
+  return kb_async_cmd (kba, req, "LINDEX %s -1", name);
+}
+
+/**
+ * @brief Get all the values of a KB item.
+ * @param[in] kba  KB connection.
+ * @param[in] name  Name of the item.
+ * @param[in] cb  Callback receiving the values.
+ * @param[in] data  User data for the callback.
+ * @return 0 if the command was queued, -1 otherwise.
+ */
+int
+kb_async_get_all (kb_async_t kba, const char *name, kb_async_all_cb cb,
+                  void *data)
+{
+  struct kb_async_request *req;
+
+  req = g_malloc0 (sizeof (struct kb_async_request));
+  req->type = KB_ASYNC_ALL;
+  req->cb.all = cb;
+  req->data = data;
+  req->name = g_strdup (name);
+  return kb_async_cmd (kba, req, "LRANGE %s 0 -1", name);
+}
+
+/**
+ * @brief Create a request for a write command.
+ * @param[in] cb  Callback receiving the status, may be NULL.
+ * @param[in] data  User data for the callback.
+ * @return Request.
+ */
+static struct kb_async_request *
+kb_async_done_request (kb_async_done_cb cb, void *data)
+{
+  struct kb_async_request *req;
+
+  req = g_malloc0 (sizeof (struct kb_async_request));
+  req->type = KB_ASYNC_DONE;
+  req->cb.done = cb;
+  req->data = data;
+  return req;
+}
+
+/**
+ * @brief Insert a new string value under a KB item.
+ * @param[in] kba  KB connection.
+ * @param[in] name  Name of the item.
+ * @param[in] str  Value to add.
+ * @param[in] len  Value length. Used for blobs, 0 for NUL terminated strings.
+ * @param[in] cb  Callback receiving the status, may be NULL.
+ * @param[in] data  User data for the callback.
+ * @return 0 if the command was queued, -1 otherwise.
+ */
+int
+kb_async_add_str (kb_async_t kba, const char *name, const char *str,
+                  size_t len, kb_async_done_cb cb, void *data)
+{
+  struct kb_async_request *req = kb_async_done_request (cb, data);
+
+  if (len == 0)
+    return kb_async_cmd (kba, req, "RPUSH %s %s", name, str);
+  return kb_async_cmd (kba, req, "RPUSH %s %b", name, str, len);
+}
+
+/**
+ * @brief Insert a new integer value under a KB item.
+ * @param[in] kba  KB connection.
+ * @param[in] name  Name of the item.
+ * @param[in] val  Value to add.
+ * @param[in] cb  Callback receiving the status, may be NULL.
+ * @param[in] data  User data for the callback.
+ * @return 0 if the command was queued, -1 otherwise.
+ */
+int
+kb_async_add_int (kb_async_t kba, const char *name, int val,
+                  kb_async_done_cb cb, void *data)
+{
+  return kb_async_cmd (kba, kb_async_done_request (cb, data), "RPUSH %s %d",
+                       name, val);
+}
+
+/**
+ * @brief Queue the start of a transaction replacing a KB item.
+ * @param[in] kba  KB connection.
+ * @param[in] name  Name of the item.
+ * @return 0 if the commands were queued, -1 otherwise.
+ */
+static int
+kb_async_replace (struct kb_async *kba, const char *name)
+{
+  /* Only the reply of EXEC matters, the others are dropped. */
+  if (kba->actx == NULL
+      || redisAsyncCommand (kba->actx, NULL, NULL, "MULTI") != REDIS_OK
+      || redisAsyncCommand (kba->actx, NULL, NULL, "DEL %s", name)
+           != REDIS_OK)
+    return -1;
+  return 0;
+}
+
+/**
+ * @brief Set the string value of a KB item, replacing its values.
+ * @param[in] kba  KB connection.
+ * @param[in] name  Name of the item.
+ * @param[in] val  Value to set.
+ * @param[in] len  Value length. Used for blobs, 0 for NUL terminated strings.
+ * @param[in] cb  Callback receiving the status, may be NULL.
+ * @param[in] data  User data for the callback.
+ * @return 0 if the commands were queued, -1 otherwise.
+ */
+int
+kb_async_set_str (kb_async_t kba, const char *name, const char *val,
+                  size_t len, kb_async_done_cb cb, void *data)
+{
+  int rc;
+
+  if (kb_async_replace (kba, name))
+    return -1;
+  if (len == 0)
+    rc = redisAsyncCommand (kba->actx, NULL, NULL, "RPUSH %s %s", name, val);
+  else
+    rc = redisAsyncCommand (kba->actx, NULL, NULL, "RPUSH %s %b", name, val,
+                            len);
+  if (rc != REDIS_OK)
+    return -1;
+  return kb_async_cmd (kba, kb_async_done_request (cb, data), "EXEC");
+}
+
+/**
+ * @brief Set the integer value of a KB item, replacing its values.
+ * @param[in] kba  KB connection.
+ * @param[in] name  Name of the item.
+ * @param[in] val  Value to set.
+ * @param[in] cb  Callback receiving the status, may be NULL.
+ * @param[in] data  User data for the callback.
+ * @return 0 if the commands were queued, -1 otherwise.
+ */
+int
+kb_async_set_int (kb_async_t kba, const char *name, int val,
+                  kb_async_done_cb cb, void *data)
+{
+  if (kb_async_replace (kba, name)
+      || redisAsyncCommand (kba->actx, NULL, NULL, "RPUSH %s %d", name, val)
+           != REDIS_OK)
+    return -1;
+  return kb_async_cmd (kba, kb_async_done_request (cb, data), "EXEC");
+}
@@ -0,0 +1,106 @@
+/* Copyright (C) 2014-2019 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * @brief Non-blocking knowledge base API - Redis backend.
+ *
+ * This file contains the protos for \ref kbasync.c
+ */
+
+#ifndef _GVM_KBASYNC_H
+#define _GVM_KBASYNC_H
+
+#include "kb.h" /* for struct kb_item */
+
+#include <glib.h> /* for GMainContext */
+
+/**
+ * @brief Non-blocking connection to a KB.
+ */
+typedef struct kb_async *kb_async_t;
+
+/**
+ * @brief Callback receiving a string item.
+ *
+ * The value is NULL if the item doesn't exist or on error. It is only
+ * valid during the call.
+ */
+typedef void (*kb_async_str_cb) (kb_async_t, const char *, void *);
+
+/**
+ * @brief Callback receiving an integer item.
+ *
+ * The status is 0 on success, -1 if the item doesn't exist or on error.
+ */
+typedef void (*kb_async_int_cb) (kb_async_t, int, int, void *);
+
+/**
+ * @brief Callback receiving all the values of an item.
+ *
+ * The list is NULL if the item doesn't exist or on error. It is to be freed
+ * with kb_item_free().
+ */
+typedef void (*kb_async_all_cb) (kb_async_t, struct kb_item *, void *);
+
+/**
+ * @brief Callback receiving the status of a write, 0 on success, -1 on
+ *        error.
+ */
+typedef void (*kb_async_done_cb) (kb_async_t, int, void *);
+
+kb_async_t
+kb_async_new (const char *, int);
+
+int
+kb_async_attach (kb_async_t, GMainContext *);
+
+void *
+kb_async_redis_context (kb_async_t);
+
+size_t
+kb_async_pending (kb_async_t);
+
+void
+kb_async_free (kb_async_t);
+
+int
+kb_async_get_str (kb_async_t, const char *, kb_async_str_cb, void *);
+
+int
+kb_async_get_int (kb_async_t, const char *, kb_async_int_cb, void *);
+
+int
+kb_async_get_all (kb_async_t, const char *, kb_async_all_cb, void *);
+
+int
+kb_async_add_str (kb_async_t, const char *, const char *, size_t,
+                  kb_async_done_cb, void *);
+
+int
+kb_async_add_int (kb_async_t, const char *, int, kb_async_done_cb, void *);
+
+int
+kb_async_set_str (kb_async_t, const char *, const char *, size_t,
+                  kb_async_done_cb, void *);
+
+int
+kb_async_set_int (kb_async_t, const char *, int, kb_async_done_cb, void *);
+
+#endif /* not _GVM_KBASYNC_H */
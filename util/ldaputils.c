@@ -51,185 +51,113 @@
  */
 
 /**
- * @brief Authenticate against an ldap directory server.
+ * @brief Remove a temporary CA certificate file.
  *
- * @param[in] info      Schema and address to use.
- * @param[in] username  Username to authenticate.
- * @param[in] password  Password to use.
- * @param[in] cacert    CA Certificate for LDAP_OPT_X_TLS_CACERTFILE, or NULL.
- *
- * @return 0 authentication success, 1 authentication failure, -1 error.
+ * @param[in]  fd    File descriptor from ldap_auth_cacert_open.
+ * @param[in]  name  Name from ldap_auth_cacert_open.
  */
-int
-ldap_connect_authenticate (
-  const gchar *username, const gchar *password,
-  /*const */ /*ldap_auth_info_t */ void *ldap_auth_info, const gchar *cacert)
+static void
+ldap_auth_cacert_close (gint fd, gchar *name)
 {
-  ldap_auth_info_t info = (ldap_auth_info_t) ldap_auth_info;
-  LDAP *ldap = NULL;
-  gchar *dn = NULL;
-
-  if (info == NULL || username == NULL || password == NULL || !info->ldap_host)
-    {
-      g_debug ("Not attempting ldap_connect: missing parameter.");
-      return -1;
-    }
-
-  dn = ldap_auth_info_auth_dn (info, username);
-
-  ldap = ldap_auth_bind (info->ldap_host, dn, password, !info->allow_plaintext,
-                         cacert);
-
-  if (ldap == NULL)
+  if (fd > -1)
     {
-      g_debug ("Could not bind to ldap host %s", info->ldap_host);
-      return -1;
+      g_unlink (name);
+      close (fd);
+      g_free (name);
     }
-
-  ldap_unbind_ext_s (ldap, NULL, NULL);
-
-  return 0;
 }
 
 /**
- * @brief Create a new ldap authentication schema and info.
+ * @brief Write a CA certificate to a temporary file.
  *
- * @param ldap_host         Host to authenticate against. Might not be NULL,
- *                          but empty.
- * @param auth_dn           DN where the actual user name is to be inserted at
- *                          "%s", e.g. uid=%s,cn=users. Might not be NULL,
- *                          but empty, has to contain a single %s.
- * @param allow_plaintext   If FALSE, require StartTLS initialization to
- *                          succeed.
+ * @param[in]  cacert  CA Certificate for LDAP_OPT_X_TLS_CACERTFILE, or NULL.
+ * @param[out] name    Name of the temporary file, NULL if none was created.
  *
- * @return Fresh ldap_auth_info_t, or NULL on error.  Free with
- *         ldap_auth_info_free.
+ * @return File descriptor of the temporary file, -1 if none was created.
+ *         Remove with ldap_auth_cacert_close.
  */
-ldap_auth_info_t
-ldap_auth_info_new (const gchar *ldap_host, const gchar *auth_dn,
-                    gboolean allow_plaintext)
+static gint
+ldap_auth_cacert_open (const gchar *cacert, gchar **name)
 {
-  // Certain parameters might not be NULL.
-  if (!ldap_host || !auth_dn)
-    return NULL;
-
-  if (ldap_auth_dn_is_good (auth_dn) == FALSE)
-    return NULL;
-
-  ldap_auth_info_t info = g_malloc0 (sizeof (struct ldap_auth_info));
-  info->ldap_host = g_strdup (ldap_host);
-  info->auth_dn = g_strdup (auth_dn);
-  info->allow_plaintext = allow_plaintext;
+  GError *error;
+  gint fd;
 
-  return info;
-}
+  if (cacert == NULL)
+    return -1;
 
-/**
- * @brief Free an ldap_auth_info and all associated memory.
- *
- * @param info ldap_auth_schema_t to free, can be NULL.
- */
-void
-ldap_auth_info_free (ldap_auth_info_t info)
-{
-  if (!info)
-    return;
-
-  g_free (info->ldap_host);
-  g_free (info->auth_dn);
+  error = NULL;
+  fd = g_file_open_tmp (NULL, name, &error);
+  if (fd == -1)
+    {
+      g_warning ("Could not open temp file for LDAP CACERTFILE: %s",
+                 error->message);
+      g_error_free (error);
+    }
+  else
+    {
+      if (g_chmod (*name, 0600))
+        g_warning ("Could not chmod for LDAP CACERTFILE");
 
-  g_free (info);
+      g_file_set_contents (*name, cacert, strlen (cacert), &error);
+      if (error)
+        {
+          g_warning ("Could not write LDAP CACERTFILE: %s", error->message);
+          g_error_free (error);
+          ldap_auth_cacert_close (fd, *name);
+          *name = NULL;
+          fd = -1;
+        }
+    }
+  return fd;
 }
 
 /**
- * @brief Create the dn to authenticate with.
+ * @brief Make a CA certificate file the LDAP CA of a connection.
  *
- * @param info     Info and schema to use.
- * @param username Name of the user.
+ * The CA is set on the connection and a TLS context is created for it,
+ * rather than changing the process-wide CA, so that connections opened
+ * concurrently with different CAs do not interfere.
  *
- * @return Freshly allocated dn or NULL if one of the parameters was NULL. Free
- *         with g_free.
+ * @param[in] ldap  LDAP Handle.
+ * @param[in] name  Name of the CA certificate file, or NULL for the default
+ *                  CA.
  */
-gchar *
-ldap_auth_info_auth_dn (const ldap_auth_info_t info, const gchar *username)
+static void
+ldap_auth_set_cacert (LDAP *ldap, const gchar *name)
 {
-  if (info == NULL || username == NULL)
-    return NULL;
+  int is_server = 0;
 
-  gchar *dn = g_strdup_printf (info->auth_dn, username);
+  if (name == NULL)
+    return;
 
-  return dn;
+  if (ldap_set_option (ldap, LDAP_OPT_X_TLS_CACERTFILE, name)
+        != LDAP_OPT_SUCCESS
+      || ldap_set_option (ldap, LDAP_OPT_X_TLS_NEWCTX, &is_server)
+           != LDAP_OPT_SUCCESS)
+    g_warning ("Could not set LDAP CACERTFILE option.");
 }
 
 /**
- * @brief Setup and bind to an LDAP.
+ * @brief Open an LDAP connection, encrypted if possible.
+ *
+ * Tries StartTLS first and falls back to ldaps.  The CA certificate must
+ * stay in place until the first bind, as ldaps only negotiates then.
  *
  * @param[in] host              Host to connect to.
- * @param[in] userdn            DN to authenticate against
- * @param[in] password          Password for userdn.
  * @param[in] force_encryption  Whether or not to abort if connection
  *                              encryption via StartTLS or ldaps failed.
- * @param[in] cacert            CA Certificate for LDAP_OPT_X_TLS_CACERTFILE,
- *                              or NULL.
+ * @param[in] cacert_file       Name of the CA certificate file, or NULL.
  *
- * @return LDAP Handle or NULL if an error occurred, authentication failed etc.
+ * @return LDAP Handle or NULL if an error occurred.
  */
-LDAP *
-ldap_auth_bind (const gchar *host, const gchar *userdn, const gchar *password,
-                gboolean force_encryption, const gchar *cacert)
+static LDAP *
+ldap_auth_connect (const gchar *host, gboolean force_encryption,
+                   const gchar *cacert_file)
 {
   LDAP *ldap = NULL;
   int ldap_return = 0;
   int ldapv3 = LDAP_VERSION3;
   gchar *ldapuri = NULL;
-  struct berval credential;
-  gchar *name;
-  gint fd;
-
-  if (host == NULL || userdn == NULL || password == NULL)
-    return NULL;
-
-  // Prevent empty password, bind against ADS will succeed with
-  // empty password by default.
-  if (strlen (password) == 0)
-    return NULL;
-
-  if (force_encryption == FALSE)
-    g_warning ("Allowed plaintext LDAP authentication.");
-
-  if (cacert)
-    {
-      GError *error;
-
-      error = NULL;
-      fd = g_file_open_tmp (NULL, &name, &error);
-      if (fd == -1)
-        {
-          g_warning ("Could not open temp file for LDAP CACERTFILE: %s",
-                     error->message);
-          g_error_free (error);
-        }
-      else
-        {
-          if (g_chmod (name, 0600))
-            g_warning ("Could not chmod for LDAP CACERTFILE");
-
-          g_file_set_contents (name, cacert, strlen (cacert), &error);
-          if (error)
-            {
-              g_warning ("Could not write LDAP CACERTFILE: %s", error->message);
-              g_error_free (error);
-            }
-          else
-            {
-              if (ldap_set_option (NULL, LDAP_OPT_X_TLS_CACERTFILE, name)
-                  != LDAP_OPT_SUCCESS)
-                g_warning ("Could not set LDAP CACERTFILE option.");
-            }
-        }
-    }
-  else
-    fd = -1;
 
   ldapuri = g_strconcat ("ldap://", host, NULL);
 
@@ -251,6 +179,7 @@ ldap_auth_bind (const gchar *host, const gchar *userdn, const gchar *password,
       g_free (ldapuri);
       goto fail;
     }
+  ldap_auth_set_cacert (ldap, cacert_file);
 
   ldap_return = ldap_start_tls_s (ldap, NULL, NULL);
   if (ldap_return != LDAP_SUCCESS)
@@ -260,8 +189,12 @@ ldap_auth_bind (const gchar *host, const gchar *userdn, const gchar *password,
       g_free (ldapuri);
       ldapuri = g_strconcat ("ldaps://", host, NULL);
 
+      ldap_unbind_ext_s (ldap, NULL, NULL);
+      ldap = NULL;
       ldap_return = ldap_initialize (&ldap, ldapuri);
-      if (ldap == NULL || ldap_return != LDAP_SUCCESS)
+      if (ldap && ldap_return == LDAP_SUCCESS)
+        ldap_auth_set_cacert (ldap, cacert_file);
+      else
         {
           if (force_encryption == TRUE)
             {
@@ -277,7 +210,9 @@ ldap_auth_bind (const gchar *host, const gchar *userdn, const gchar *password,
                          ldap_err2string (ldap_return));
               g_warning (
                 "Reinit LDAP connection to do plaintext authentication");
-              ldap_unbind_ext_s (ldap, NULL, NULL);
+              if (ldap)
+                ldap_unbind_ext_s (ldap, NULL, NULL);
+              ldap = NULL;
 
               // Note that for connections to default ADS, a failed
               // StartTLS negotiation breaks the future bind, so retry.
@@ -296,7 +231,30 @@ ldap_auth_bind (const gchar *host, const gchar *userdn, const gchar *password,
     g_debug ("LDAP StartTLS initialized.");
 
   g_free (ldapuri);
+  return ldap;
 
+fail:
+  if (ldap)
+    ldap_unbind_ext_s (ldap, NULL, NULL);
+  return NULL;
+}
+
+/**
+ * @brief Bind a user on an open LDAP connection.
+ *
+ * A connection can be bound again for another user, the last bind wins.
+ *
+ * @param[in] ldap      LDAP Handle.
+ * @param[in] userdn    DN to authenticate against
+ * @param[in] password  Password for userdn.
+ *
+ * @return LDAP_SUCCESS, or the LDAP error code of the failed operation.
+ */
+static int
+ldap_auth_bind_user (LDAP *ldap, const gchar *userdn, const gchar *password)
+{
+  int ldap_return = 0;
+  struct berval credential;
   int do_search = 0;
   LDAPDN dn = NULL;
   gchar *use_dn = NULL;
@@ -334,7 +292,8 @@ ldap_auth_bind (const gchar *host, const gchar *userdn, const gchar *password,
         {
           g_warning ("LDAP anonymous authentication failure: %s",
                      ldap_err2string (ldap_return));
-          goto fail;
+          g_strfreev (uid);
+          return ldap_return;
         }
       else
         {
@@ -368,38 +327,492 @@ ldap_auth_bind (const gchar *host, const gchar *userdn, const gchar *password,
   else
     use_dn = g_strdup (userdn);
 
-  if (use_dn != NULL)
+  credential.bv_val = g_strdup (password);
+  credential.bv_len = strlen (password);
+  ldap_return = ldap_sasl_bind_s (ldap, use_dn, LDAP_SASL_SIMPLE, &credential,
+                                  NULL, NULL, NULL);
+  g_free (credential.bv_val);
+  g_free (use_dn);
+  if (ldap_return != LDAP_SUCCESS)
+    g_warning ("LDAP authentication failure: %s.",
+               ldap_err2string (ldap_return));
+  return ldap_return;
+}
+
+/**
+ * @brief An idle pooled LDAP connection.
+ */
+typedef struct
+{
+  LDAP *ldap;       ///< The connection.
+  gint64 last_used; ///< Monotonic time the connection was last released.
+} ldap_pool_conn_t;
+
+/**
+ * @brief Connection pool of one LDAP server.
+ */
+typedef struct
+{
+  GQueue idle; ///< Idle connections, most recently released last.
+  guint open;  ///< Connections open, idle or in use.
+} ldap_pool_t;
+
+/**
+ * @brief Maximum connections per server, 0 to disable pooling.
+ */
+static guint ldap_pool_max = 0;
+
+/**
+ * @brief Seconds after which an idle connection is closed.
+ */
+static guint ldap_pool_idle_timeout = 0;
+
+/**
+ * @brief Pools, keyed by server, encryption and CA certificate.
+ */
+static GHashTable *ldap_pools = NULL;
+
+/**
+ * @brief Lock for the pools.
+ */
+static GMutex ldap_pool_lock;
+
+/**
+ * @brief Signalled when a pooled connection is released or closed.
+ */
+static GCond ldap_pool_cond;
+
+/**
+ * @brief Close idle connections of a list.
+ *
+ * @param[in] conns  List of ldap_pool_conn_t.
+ */
+static void
+ldap_pool_close (GList *conns)
+{
+  GList *iter;
+
+  for (iter = conns; iter; iter = iter->next)
     {
-      credential.bv_val = g_strdup (password);
-      credential.bv_len = strlen (password);
-      ldap_return = ldap_sasl_bind_s (ldap, use_dn, LDAP_SASL_SIMPLE,
-                                      &credential, NULL, NULL, NULL);
-      g_free (credential.bv_val);
-      g_free (use_dn);
-      if (ldap_return != LDAP_SUCCESS)
+      ldap_pool_conn_t *conn = iter->data;
+
+      ldap_unbind_ext_s (conn->ldap, NULL, NULL);
+      g_free (conn);
+    }
+  g_list_free (conns);
+}
+
+/**
+ * @brief Take the expired idle connections out of a pool.
+ *
+ * Must be called with the pools locked.
+ *
+ * @param[in] pool  The pool.
+ * @param[in] all   Whether to take all idle connections.
+ *
+ * @return Taken connections, to be closed with ldap_pool_close.
+ */
+static GList *
+ldap_pool_expire (ldap_pool_t *pool, gboolean all)
+{
+  ldap_pool_conn_t *conn;
+  GList *expired = NULL;
+  gint64 limit;
+
+  limit = g_get_monotonic_time ()
+          - (gint64) ldap_pool_idle_timeout * G_USEC_PER_SEC;
+  while ((conn = g_queue_peek_head (&pool->idle))
+         && (all || conn->last_used <= limit))
+    {
+      g_queue_pop_head (&pool->idle);
+      pool->open--;
+      expired = g_list_prepend (expired, conn);
+    }
+  return expired;
+}
+
+/**
+ * @brief Configure pooling of LDAP connections.
+ *
+ * With pooling, ldap_connect_authenticate keeps the encrypted connections
+ * to each server open and binds the next user on an idle one, so that an
+ * authentication costs a bind instead of a new TCP and TLS setup.  At most
+ * max_connections are open per server, further authentications wait for
+ * a connection.  Connections idle for idle_timeout seconds are closed,
+ * before servers drop them.  Pooling is disabled by default.
+ *
+ * @param[in] max_connections  Connections per server, 0 to disable pooling
+ *                             and close the idle connections.
+ * @param[in] idle_timeout     Seconds an idle connection stays open.
+ */
+void
+ldap_auth_set_pool (unsigned int max_connections, unsigned int idle_timeout)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GList *closed = NULL;
+
+  g_mutex_lock (&ldap_pool_lock);
+  ldap_pool_max = max_connections;
+  ldap_pool_idle_timeout = idle_timeout;
+  if (ldap_pools == NULL)
+    ldap_pools = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_hash_table_iter_init (&iter, ldap_pools);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    closed = g_list_concat (ldap_pool_expire (value, max_connections == 0),
+                            closed);
+  g_cond_broadcast (&ldap_pool_cond);
+  g_mutex_unlock (&ldap_pool_lock);
+  ldap_pool_close (closed);
+}
+
+/**
+ * @brief Get a connection slot from a pool.
+ *
+ * Waits while the pool is at its limit.
+ *
+ * @param[in] key  Key of the pool.
+ *
+ * @return An idle connection, or NULL if the caller must open a new one
+ *         in the slot it was given.
+ */
+static LDAP *
+ldap_pool_acquire (const gchar *key)
+{
+  ldap_pool_t *pool;
+  ldap_pool_conn_t *conn;
+  GList *expired;
+  LDAP *ldap = NULL;
+  gboolean retry = FALSE;
+
+  g_mutex_lock (&ldap_pool_lock);
+  pool = g_hash_table_lookup (ldap_pools, key);
+  if (pool == NULL)
+    {
+      pool = g_malloc0 (sizeof (*pool));
+      g_queue_init (&pool->idle);
+      g_hash_table_insert (ldap_pools, g_strdup (key), pool);
+    }
+  for (;;)
+    {
+      expired = ldap_pool_expire (pool, FALSE);
+      if ((conn = g_queue_pop_tail (&pool->idle)))
         {
-          g_warning ("LDAP authentication failure: %s.",
-                     ldap_err2string (ldap_return));
-          goto fail;
+          ldap = conn->ldap;
+          g_free (conn);
+          break;
+        }
+      if (pool->open < ldap_pool_max || ldap_pool_max == 0)
+        {
+          pool->open++;
+          break;
+        }
+      if (expired)
+        {
+          retry = TRUE;
+          break;
         }
+      g_cond_wait (&ldap_pool_cond, &ldap_pool_lock);
+    }
+  g_mutex_unlock (&ldap_pool_lock);
+  ldap_pool_close (expired);
+  if (retry)
+    /* Closing made room, try again. */
+    return ldap_pool_acquire (key);
+  return ldap;
+}
 
-      if (fd > -1)
+/**
+ * @brief Return a connection slot to a pool.
+ *
+ * @param[in] key   Key of the pool.
+ * @param[in] ldap  Connection to keep for reuse, or NULL to give up the
+ *                  slot.  Closed instead if pooling was disabled meanwhile.
+ */
+static void
+ldap_pool_release (const gchar *key, LDAP *ldap)
+{
+  ldap_pool_t *pool;
+
+  g_mutex_lock (&ldap_pool_lock);
+  pool = g_hash_table_lookup (ldap_pools, key);
+  if (ldap && ldap_pool_max && pool->open <= ldap_pool_max)
+    {
+      ldap_pool_conn_t *conn;
+
+      conn = g_malloc (sizeof (*conn));
+      conn->ldap = ldap;
+      conn->last_used = g_get_monotonic_time ();
+      g_queue_push_tail (&pool->idle, conn);
+      ldap = NULL;
+    }
+  else
+    pool->open--;
+  g_cond_broadcast (&ldap_pool_cond);
+  g_mutex_unlock (&ldap_pool_lock);
+  if (ldap)
+    ldap_unbind_ext_s (ldap, NULL, NULL);
+}
+
+/**
+ * @brief Whether an LDAP error means the connection is unusable.
+ *
+ * @param[in] ldap_return  LDAP error code.
+ *
+ * @return TRUE if the connection should be closed.
+ */
+static gboolean
+ldap_pool_conn_broken (int ldap_return)
+{
+  return ldap_return == LDAP_SERVER_DOWN || ldap_return == LDAP_CONNECT_ERROR
+         || ldap_return == LDAP_UNAVAILABLE || ldap_return == LDAP_TIMEOUT;
+}
+
+/**
+ * @brief Authenticate against an ldap directory server with a pooled
+ *        connection.
+ *
+ * An idle connection the server has dropped meanwhile is closed and the
+ * bind is retried once on a new connection.
+ *
+ * @param[in] info      Schema and address to use.
+ * @param[in] dn        DN to authenticate against.
+ * @param[in] password  Password to use.
+ * @param[in] cacert    CA Certificate for LDAP_OPT_X_TLS_CACERTFILE, or NULL.
+ *
+ * @return 0 authentication success, -1 error or authentication failure.
+ */
+static int
+ldap_pool_authenticate (ldap_auth_info_t info, const gchar *dn,
+                        const gchar *password, const gchar *cacert)
+{
+  gchar *key, *cacert_sum;
+  LDAP *ldap;
+  int ldap_return = LDAP_OTHER, attempt;
+
+  cacert_sum =
+    cacert ? g_compute_checksum_for_string (G_CHECKSUM_SHA256, cacert, -1)
+           : NULL;
+  key = g_strdup_printf ("%s %d %s", info->ldap_host, !info->allow_plaintext,
+                         cacert_sum ? cacert_sum : "");
+  g_free (cacert_sum);
+
+  ldap = ldap_pool_acquire (key);
+  for (attempt = 0;; attempt++)
+    {
+      if (ldap == NULL)
         {
-          g_unlink (name);
-          close (fd);
-          g_free (name);
+          gchar *name = NULL;
+          gint fd;
+
+          fd = ldap_auth_cacert_open (cacert, &name);
+          ldap =
+            ldap_auth_connect (info->ldap_host, !info->allow_plaintext, name);
+          if (ldap)
+            ldap_return = ldap_auth_bind_user (ldap, dn, password);
+          ldap_auth_cacert_close (fd, name);
+          if (ldap == NULL)
+            break;
+          attempt = 1; /* A fresh connection is not retried. */
         }
-      return ldap;
+      else
+        ldap_return = ldap_auth_bind_user (ldap, dn, password);
+
+      if (!ldap_pool_conn_broken (ldap_return) || attempt > 0)
+        break;
+      g_debug ("Pooled LDAP connection to %s closed, reconnecting",
+               info->ldap_host);
+      ldap_unbind_ext_s (ldap, NULL, NULL);
+      ldap = NULL;
     }
 
-fail:
-  if (fd > -1)
+  if (ldap && ldap_pool_conn_broken (ldap_return))
     {
-      g_unlink (name);
-      close (fd);
-      g_free (name);
+      ldap_unbind_ext_s (ldap, NULL, NULL);
+      ldap = NULL;
     }
-  return NULL;
+  ldap_pool_release (key, ldap);
+  g_free (key);
+
+  if (ldap == NULL)
+    {
+      g_debug ("Could not bind to ldap host %s", info->ldap_host);
+      return -1;
+    }
+  return ldap_return == LDAP_SUCCESS ? 0 : -1;
+}
+
+/**
+ * @brief Authenticate against an ldap directory server.
+ *
+ * Uses a pooled connection if ldap_auth_set_pool enabled pooling.
+ *
+ * @param[in] info      Schema and address to use.
+ * @param[in] username  Username to authenticate.
+ * @param[in] password  Password to use.
+ * @param[in] cacert    CA Certificate for LDAP_OPT_X_TLS_CACERTFILE, or NULL.
+ *
+ * @return 0 authentication success, 1 authentication failure, -1 error.
+ */
+int
+ldap_connect_authenticate (
+  const gchar *username, const gchar *password,
+  /*const */ /*ldap_auth_info_t */ void *ldap_auth_info, const gchar *cacert)
+{
+  ldap_auth_info_t info = (ldap_auth_info_t) ldap_auth_info;
+  LDAP *ldap = NULL;
+  gchar *dn = NULL;
+  gboolean pooled;
+
+  if (info == NULL || username == NULL || password == NULL || !info->ldap_host)
+    {
+      g_debug ("Not attempting ldap_connect: missing parameter.");
+      return -1;
+    }
+
+  dn = ldap_auth_info_auth_dn (info, username);
+
+  g_mutex_lock (&ldap_pool_lock);
+  pooled = ldap_pool_max > 0;
+  g_mutex_unlock (&ldap_pool_lock);
+
+  if (pooled && *password)
+    {
+      int ret;
+
+      if (info->allow_plaintext)
+        g_warning ("Allowed plaintext LDAP authentication.");
+      ret = ldap_pool_authenticate (info, dn, password, cacert);
+      g_free (dn);
+      return ret;
+    }
+
+  ldap = ldap_auth_bind (info->ldap_host, dn, password, !info->allow_plaintext,
+                         cacert);
+  g_free (dn);
+
+  if (ldap == NULL)
+    {
+      g_debug ("Could not bind to ldap host %s", info->ldap_host);
+      return -1;
+    }
+
+  ldap_unbind_ext_s (ldap, NULL, NULL);
+
+  return 0;
+}
+
+/**
+ * @brief Create a new ldap authentication schema and info.
+ *
+ * @param ldap_host         Host to authenticate against. Might not be NULL,
+ *                          but empty.
+ * @param auth_dn           DN where the actual user name is to be inserted at
+ *                          "%s", e.g. uid=%s,cn=users. Might not be NULL,
+ *                          but empty, has to contain a single %s.
+ * @param allow_plaintext   If FALSE, require StartTLS initialization to
+ *                          succeed.
+ *
+ * @return Fresh ldap_auth_info_t, or NULL on error.  Free with
+ *         ldap_auth_info_free.
+ */
+ldap_auth_info_t
+ldap_auth_info_new (const gchar *ldap_host, const gchar *auth_dn,
+                    gboolean allow_plaintext)
+{
+  // Certain parameters might not be NULL.
+  if (!ldap_host || !auth_dn)
+    return NULL;
+
+  if (ldap_auth_dn_is_good (auth_dn) == FALSE)
+    return NULL;
+
+  ldap_auth_info_t info = g_malloc0 (sizeof (struct ldap_auth_info));
+  info->ldap_host = g_strdup (ldap_host);
+  info->auth_dn = g_strdup (auth_dn);
+  info->allow_plaintext = allow_plaintext;
+
+  return info;
+}
+
+/**
+ * @brief Free an ldap_auth_info and all associated memory.
+ *
+ * @param info ldap_auth_schema_t to free, can be NULL.
+ */
+void
+ldap_auth_info_free (ldap_auth_info_t info)
+{
+  if (!info)
+    return;
+
+  g_free (info->ldap_host);
+  g_free (info->auth_dn);
+
+  g_free (info);
+}
+
+/**
+ * @brief Create the dn to authenticate with.
+ *
+ * @param info     Info and schema to use.
+ * @param username Name of the user.
+ *
+ * @return Freshly allocated dn or NULL if one of the parameters was NULL. Free
+ *         with g_free.
+ */
+gchar *
+ldap_auth_info_auth_dn (const ldap_auth_info_t info, const gchar *username)
+{
+  if (info == NULL || username == NULL)
+    return NULL;
+
+  gchar *dn = g_strdup_printf (info->auth_dn, username);
+
+  return dn;
+}
+
+/**
+ * @brief Setup and bind to an LDAP.
+ *
+ * @param[in] host              Host to connect to.
+ * @param[in] userdn            DN to authenticate against
+ * @param[in] password          Password for userdn.
+ * @param[in] force_encryption  Whether or not to abort if connection
+ *                              encryption via StartTLS or ldaps failed.
+ * @param[in] cacert            CA Certificate for LDAP_OPT_X_TLS_CACERTFILE,
+ *                              or NULL.
+ *
+ * @return LDAP Handle or NULL if an error occurred, authentication failed etc.
+ */
+LDAP *
+ldap_auth_bind (const gchar *host, const gchar *userdn, const gchar *password,
+                gboolean force_encryption, const gchar *cacert)
+{
+  LDAP *ldap;
+  gchar *name = NULL;
+  gint fd;
+
+  if (host == NULL || userdn == NULL || password == NULL)
+    return NULL;
+
+  // Prevent empty password, bind against ADS will succeed with
+  // empty password by default.
+  if (strlen (password) == 0)
+    return NULL;
+
+  if (force_encryption == FALSE)
+    g_warning ("Allowed plaintext LDAP authentication.");
+
+  fd = ldap_auth_cacert_open (cacert, &name);
+  ldap = ldap_auth_connect (host, force_encryption, name);
+  if (ldap && ldap_auth_bind_user (ldap, userdn, password) != LDAP_SUCCESS)
+    {
+      ldap_unbind_ext_s (ldap, NULL, NULL);
+      ldap = NULL;
+    }
+  ldap_auth_cacert_close (fd, name);
+  return ldap;
 }
 
 /**
@@ -500,6 +913,19 @@ ldap_connect_authenticate (
   return -1;
 }
 
+/**
+ * @brief Dummy function for Manager.
+ *
+ * @param max_connections  Connections per server.
+ * @param idle_timeout     Seconds an idle connection stays open.
+ */
+void
+ldap_auth_set_pool (unsigned int max_connections, unsigned int idle_timeout)
+{
+  (void) max_connections;
+  (void) idle_timeout;
+}
+
 /**
  * @brief Dummy function for Manager.
  *
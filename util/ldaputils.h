@@ -52,6 +52,9 @@ void ldap_auth_info_free (ldap_auth_info_t);
 ldap_auth_info_t
 ldap_auth_info_new (const gchar *, const gchar *, gboolean);
 
+void
+ldap_auth_set_pool (unsigned int, unsigned int);
+
 #ifdef ENABLE_LDAP_AUTH
 
 #include <ldap.h>
@@ -39,6 +39,7 @@
 #include <string.h>   /* for strcmp */
 #include <sys/stat.h> /* for stat, st_mtime */
 #include <time.h>     /* for time, time_t */
+#include <unistd.h>   /* for unlink */
 
 #undef G_LOG_DOMAIN
 /**
@@ -46,9 +47,295 @@
  */
 #define G_LOG_DOMAIN "lib  nvticache"
 
+/**
+ * @brief Magic string at the start of a NVT cache snapshot file.
+ */
+#define SNAPSHOT_MAGIC "GVMNVTS"
+
+/**
+ * @brief Version of the NVT cache snapshot format.
+ */
+#define SNAPSHOT_VERSION 1
+
+/**
+ * @brief Value of the byte order mark of a NVT cache snapshot.
+ */
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+/**
+ * @brief Name of the default NVT cache snapshot.
+ */
+#define SNAPSHOT_FILENAME NVTICACHE_STR ".snapshot"
+
+/**
+ * @brief Header of a NVT cache snapshot file.
+ *
+ * The header is followed by the NVT records, the preference records and the
+ * string table. Integers are stored in host byte order. All strings are
+ * NULL terminated offsets into the string table, offset 0 is "".
+ */
+typedef struct
+{
+  char magic[8];         /**< SNAPSHOT_MAGIC. */
+  guint32 version;       /**< SNAPSHOT_VERSION. */
+  guint32 byte_order;    /**< SNAPSHOT_BYTE_ORDER. */
+  guint32 count;         /**< Number of NVT records. */
+  guint32 pref_count;    /**< Number of preference records. */
+  guint64 strtab_offset; /**< File offset of the string table. */
+  guint64 strtab_size;   /**< Size of the string table. */
+  guint32 feed_version;  /**< Feed version the snapshot was written for. */
+  guint32 reserved;      /**< Padding, 0. */
+} snapshot_header_t;
+
+/**
+ * @brief NVT record of a NVT cache snapshot file.
+ */
+typedef struct
+{
+  guint32 field[NVT_TIMESTAMP_POS]; /**< NVT fields, indexed by kb_nvt_pos. */
+  guint32 oid;                      /**< OID of the NVT. */
+  guint32 first_pref;               /**< Index of the first preference. */
+  guint32 pref_count;               /**< Number of preferences. */
+} snapshot_record_t;
+
+/**
+ * @brief Name of the cache KB item holding the enum kb_nvt_layout of the
+ *        NVTs. The NVTs are in KB_NVT_LAYOUT_LIST if it is missing.
+ */
+#define NVTICACHE_LAYOUT_STR "nvticache_layout"
+
 char *src_path = NULL; /**< The directory of the source files. */
 kb_t cache_kb = NULL;  /**< Cache KB handler. */
 int cache_saved = 1;   /**< If cache was saved. */
+static enum kb_nvt_layout cache_layout =
+  KB_NVT_LAYOUT_LIST; /**< Layout of the NVTs in the cache KB. */
+static char *snapshot_dir = NULL; /**< Directory of the default snapshot. */
+
+/**
+ * @brief Entry of the in-process cache of NVT Infos.
+ */
+typedef struct
+{
+  nvti_t *nvti; /**< Cached NVT Info. */
+  size_t size;  /**< Estimated memory used by the entry. */
+} nvti_cache_entry_t;
+
+/**
+ * @brief In-process LRU cache of NVT Infos, in front of the cache KB.
+ */
+static struct
+{
+  GHashTable *entries;      /**< OID to link in lru. */
+  GQueue lru;               /**< Entries, most recently used first. */
+  size_t size;              /**< Estimated memory used by the entries. */
+  size_t max_size;          /**< Memory limit. 0 if the cache is disabled. */
+  char *feed_version;       /**< Feed version of the cached entries. */
+  nvticache_stats_t stats;  /**< Usage counters. */
+} nvti_cache;
+
+/**
+ * @brief Estimate the memory used by a NVT Info.
+ *
+ * @param nvti  NVT Info.
+ *
+ * @return Size in bytes.
+ */
+static size_t
+nvti_cache_entry_size (const nvti_t *nvti)
+{
+  size_t size;
+  guint i;
+
+  size = sizeof (nvti_cache_entry_t) + sizeof (nvti_t) + sizeof (GList)
+         + strlen (nvti->oid ?: "") + strlen (nvti->name ?: "")
+         + strlen (nvti->tag ?: "")
+         + strlen (nvti->dependencies ?: "")
+         + strlen (nvti->required_keys ?: "")
+         + strlen (nvti->mandatory_keys ?: "")
+         + strlen (nvti->excluded_keys ?: "")
+         + strlen (nvti->required_ports ?: "")
+         + strlen (nvti->required_udp_ports ?: "");
+  /* Types, the family and the CVSS base are interned, so not counted. */
+  for (i = 0; i < nvti_vtref_len (nvti); i++)
+    size += 7 * sizeof (gchar *) + strlen (vtref_id (nvti_vtref (nvti, i)));
+  for (i = 0; i < nvti_pref_len (nvti); i++)
+    {
+      const nvtpref_t *np = nvti_pref (nvti, i);
+
+      size += 3 * sizeof (gpointer) + sizeof (nvtpref_t)
+              + strlen (nvtpref_name (np) ?: "")
+              + strlen (nvtpref_default (np) ?: "");
+    }
+
+  return size;
+}
+
+/**
+ * @brief Drop an entry from the NVT Info cache.
+ *
+ * @param link  Link of the entry in the LRU queue.
+ */
+static void
+nvti_cache_drop (GList *link)
+{
+  nvti_cache_entry_t *entry = link->data;
+
+  g_hash_table_remove (nvti_cache.entries, nvti_oid (entry->nvti));
+  g_queue_delete_link (&nvti_cache.lru, link);
+  nvti_cache.size -= entry->size;
+  nvti_free (entry->nvti);
+  g_free (entry);
+}
+
+/**
+ * @brief Empty the NVT Info cache.
+ */
+static void
+nvti_cache_clear (void)
+{
+  while (nvti_cache.lru.tail)
+    nvti_cache_drop (nvti_cache.lru.tail);
+  g_free (nvti_cache.feed_version);
+  nvti_cache.feed_version = NULL;
+}
+
+/**
+ * @brief Empty the NVT Info cache if it holds entries of another feed.
+ *
+ * @param feed_version  Current feed version.
+ */
+static void
+nvti_cache_check_version (const char *feed_version)
+{
+  if (nvti_cache.feed_version == NULL
+      || !g_strcmp0 (nvti_cache.feed_version, feed_version))
+    return;
+
+  g_debug ("%s: feed version changed from %s to %s, emptying cache",
+           __func__, nvti_cache.feed_version, feed_version);
+  nvti_cache_clear ();
+}
+
+/**
+ * @brief Remove a NVT Info from the NVT Info cache.
+ *
+ * @param oid  OID of the NVT.
+ */
+static void
+nvti_cache_remove (const char *oid)
+{
+  GList *link;
+
+  if (nvti_cache.entries == NULL)
+    return;
+  link = g_hash_table_lookup (nvti_cache.entries, oid);
+  if (link)
+    nvti_cache_drop (link);
+}
+
+/**
+ * @brief Get a copy of a NVT Info from the NVT Info cache.
+ *
+ * @param oid  OID of the NVT.
+ *
+ * @return Copy of the NVT Info, NULL if not cached.
+ */
+static nvti_t *
+nvti_cache_lookup (const char *oid)
+{
+  GList *link;
+
+  link = g_hash_table_lookup (nvti_cache.entries, oid);
+  if (link == NULL)
+    {
+      nvti_cache.stats.misses++;
+      return NULL;
+    }
+
+  nvti_cache.stats.hits++;
+  g_queue_unlink (&nvti_cache.lru, link);
+  g_queue_push_head_link (&nvti_cache.lru, link);
+  return nvti_dup (((nvti_cache_entry_t *) link->data)->nvti);
+}
+
+/**
+ * @brief Add a copy of a NVT Info to the NVT Info cache, evicting the
+ *        least recently used entries if needed.
+ *
+ * @param nvti          NVT Info to add.
+ * @param feed_version  Feed version the NVT Info was read for.
+ */
+static void
+nvti_cache_insert (const nvti_t *nvti, const char *feed_version)
+{
+  nvti_cache_entry_t *entry;
+
+  if (nvti_cache.feed_version == NULL)
+    nvti_cache.feed_version = g_strdup (feed_version);
+
+  entry = g_malloc0 (sizeof (nvti_cache_entry_t));
+  entry->size = nvti_cache_entry_size (nvti);
+  if (entry->size > nvti_cache.max_size)
+    {
+      g_free (entry);
+      return;
+    }
+  entry->nvti = nvti_dup (nvti);
+
+  nvti_cache_remove (nvti_oid (nvti));
+  while (nvti_cache.size + entry->size > nvti_cache.max_size)
+    {
+      nvti_cache_drop (nvti_cache.lru.tail);
+      nvti_cache.stats.evictions++;
+    }
+
+  g_queue_push_head (&nvti_cache.lru, entry);
+  g_hash_table_insert (nvti_cache.entries, nvti_oid (entry->nvti),
+                       nvti_cache.lru.head);
+  nvti_cache.size += entry->size;
+}
+
+/**
+ * @brief Set the memory limit of the in-process NVT Info cache.
+ *
+ * When enabled, nvticache_get_nvt() keeps the NVT Infos it fetched from the
+ * cache KB in memory, up to max_size bytes. The feed version in the cache
+ * KB is checked on each lookup, and the cache emptied when it changes. It is
+ * disabled by default.
+ *
+ * @param max_size  Memory limit in bytes. 0 disables and empties the cache.
+ */
+void
+nvticache_set_cache_size (size_t max_size)
+{
+  if (nvti_cache.entries == NULL)
+    nvti_cache.entries = g_hash_table_new (g_str_hash, g_str_equal);
+
+  nvti_cache.max_size = max_size;
+  while (nvti_cache.size > max_size)
+    {
+      nvti_cache_drop (nvti_cache.lru.tail);
+      nvti_cache.stats.evictions++;
+    }
+  if (max_size == 0)
+    nvti_cache_clear ();
+}
+
+/**
+ * @brief Get the usage counters of the in-process NVT Info cache.
+ *
+ * @param[out] stats  Where to store the counters.
+ */
+void
+nvticache_get_cache_stats (nvticache_stats_t *stats)
+{
+  assert (stats);
+
+  *stats = nvti_cache.stats;
+  stats->entries = nvti_cache.lru.length;
+  stats->size = nvti_cache.size;
+  stats->max_size = nvti_cache.max_size;
+}
 
 /**
  * @brief Return whether the nvt cache is initialized.
@@ -64,6 +351,9 @@ nvticache_initialized (void)
 /**
  * @brief Initializes the nvti cache.
  *
+ * An existing cache is used with the layout it was built with. A fresh cache
+ * is built with KB_NVT_LAYOUT_LIST.
+ *
  * @param src           The directory that contains the nvt files.
  * @param kb_path       Path to kb socket.
  *
@@ -72,20 +362,64 @@ nvticache_initialized (void)
 int
 nvticache_init (const char *src, const char *kb_path)
 {
+  return nvticache_init_layout (src, kb_path, 0);
+}
+
+/**
+ * @brief Initializes the nvti cache, with a given layout of the NVTs.
+ *
+ * KB_NVT_LAYOUT_HASH stores each NVT in a hash with named fields, so getting
+ * a single field is a hash lookup and the preferences come in one value.
+ * An existing cache in another layout is deleted and a fresh one created,
+ * to be filled again.
+ *
+ * @param src           The directory that contains the nvt files.
+ * @param kb_path       Path to kb socket.
+ * @param layout        Layout of the NVTs. 0 to keep the layout of an
+ *                      existing cache, and use KB_NVT_LAYOUT_LIST for a
+ *                      fresh one.
+ *
+ * @return 0 in case of success, anything else indicates an error.
+ */
+int
+nvticache_init_layout (const char *src, const char *kb_path,
+                       enum kb_nvt_layout layout)
+{
+  int current;
+
   assert (src);
 
   if (src_path)
     g_free (src_path);
   src_path = g_strdup (src);
+  nvti_cache_clear ();
   if (cache_kb)
     kb_lnk_reset (cache_kb);
   cache_kb = kb_find (kb_path, NVTICACHE_STR);
   if (cache_kb)
-    return 0;
+    {
+      current = kb_item_get_int (cache_kb, NVTICACHE_LAYOUT_STR);
+      if (current != KB_NVT_LAYOUT_HASH)
+        current = KB_NVT_LAYOUT_LIST;
+      if (layout == 0 || (int) layout == current)
+        {
+          cache_layout = current;
+          return kb_nvt_set_layout (cache_kb, cache_layout);
+        }
+      g_message ("%s: Changing the layout of the NVT cache, deleting it",
+                 __func__);
+      kb_delete (cache_kb);
+      cache_kb = NULL;
+    }
 
+  cache_layout = layout ?: KB_NVT_LAYOUT_LIST;
   if (kb_new (&cache_kb, kb_path)
+      || kb_nvt_set_layout (cache_kb, cache_layout)
+      || kb_item_set_int (cache_kb, NVTICACHE_LAYOUT_STR, cache_layout)
       || kb_item_set_str (cache_kb, NVTICACHE_STR, "0", 0))
     return -1;
+  /* Fresh cache: restore it from the snapshot of the current feed, if any. */
+  nvticache_snapshot_load (NULL);
   return 0;
 }
 
@@ -129,6 +463,67 @@ nvticache_check (const gchar *filename)
   return ret;
 }
 
+/**
+ * @brief Get the NVT files that are not in the cache or not up to date.
+ *
+ * Like nvticache_check() for many files at once: the timestamps of all the
+ * files in the cache are fetched in a single pass over the cache KB, so the
+ * number of round trips does not grow with the number of files.
+ *
+ * @param filenames List of names of NVT files, without the path to the base
+ *                  location of NVTs.
+ *
+ * @return List of the names of the files that are missing or out of date in
+ *         the cache, in the order of filenames. To be freed with
+ *         g_slist_free_full (list, g_free).
+ */
+GSList *
+nvticache_get_stale (GSList *filenames)
+{
+  GHashTable *timestamps;
+  GSList *stale = NULL, *element;
+  unsigned long long cursor = 0;
+  size_t prefix_len = strlen ("filename:");
+
+  assert (cache_kb);
+
+  /* Each filename:<file> key holds the timestamp and the OID. */
+  timestamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  do
+    {
+      struct kb_item *items, *item;
+
+      items = kb_item_iter_pattern (cache_kb, "filename:*", &cursor);
+      for (item = items; item; item = item->next)
+        if (item->type == KB_TYPE_STR && item->v_str[0]
+            && item->v_str[strspn (item->v_str, "0123456789")] == '\0'
+            && strlen (item->name) > prefix_len)
+          g_hash_table_replace (
+            timestamps, g_strdup (item->name + prefix_len),
+            GSIZE_TO_POINTER (strtoul (item->v_str, NULL, 10)));
+      kb_item_free (items);
+    }
+  while (cursor != 0);
+
+  for (element = filenames; element; element = element->next)
+    {
+      gpointer timestamp;
+      char *src_file;
+      struct stat src_stat;
+
+      src_file = g_build_filename (src_path, element->data, NULL);
+      if (!g_hash_table_lookup_extended (timestamps, element->data, NULL,
+                                         &timestamp)
+          || stat (src_file, &src_stat) < 0
+          || (time_t) GPOINTER_TO_SIZE (timestamp) <= src_stat.st_mtime)
+        stale = g_slist_prepend (stale, g_strdup (element->data));
+      g_free (src_file);
+    }
+  g_hash_table_destroy (timestamps);
+
+  return g_slist_reverse (stale);
+}
+
 /**
  * @brief Reset connection to KB. To be called after a fork().
  */
@@ -192,8 +587,10 @@ nvticache_save ()
   if (g_strcmp0 (old_version, feed_version))
     {
       kb_item_set_str (cache_kb, NVTICACHE_STR, feed_version, 0);
+      nvti_cache_check_version (feed_version);
       g_message ("Updated NVT cache from version %s to %s", old_version,
                  feed_version);
+      nvticache_snapshot_write (NULL);
     }
   g_free (old_version);
   g_free (feed_version);
@@ -209,6 +606,10 @@ nvticache_save ()
  *                 "scriptname1.nasl" or even
  *                 "subdir1/subdir2/scriptname2.nasl" )
  *
+ * When adding many NVTs, the calls can be surrounded by kb_batch_begin() and
+ * kb_batch_commit() on nvticache_get_kb(), so that the writes are sent in
+ * bulk.
+ *
  * @return 0 in case of success, anything else indicates an error.
  */
 int
@@ -233,6 +634,8 @@ nvticache_add (const nvti_t *nvti, const char *filename)
     }
   if (dummy)
     nvticache_delete (oid);
+  else
+    nvti_cache_remove (oid);
 
   g_free (dummy);
 
@@ -245,6 +648,297 @@ kb_fail:
   return -1;
 }
 
+/**
+ * @brief Number of NVT Infos a worker of an ingestion writes per batch.
+ */
+#define NVTICACHE_INGEST_BATCH 256
+
+/**
+ * @brief NVT Info queued for ingestion.
+ */
+typedef struct
+{
+  nvti_t *nvti;   /**< NVT Info, owned. */
+  char *filename; /**< Name of the NVT file, relative to src_path. */
+} nvticache_ingest_item_t;
+
+/**
+ * @brief Worker of a parallel ingestion.
+ */
+typedef struct
+{
+  GAsyncQueue *queue; /**< Queued items, and NULL once the ingestion ends. */
+  kb_t kb;            /**< Own connection to the cache KB. */
+  GThread *thread;    /**< Thread of the worker. */
+  int failed;         /**< Number of NVT Infos that could not be added. */
+} nvticache_ingest_worker_t;
+
+/**
+ * @brief Parallel ingestion of NVT Infos into the cache.
+ */
+struct nvticache_ingest
+{
+  nvticache_ingest_worker_t *workers; /**< Workers. */
+  int count;                          /**< Number of workers. */
+};
+
+/**
+ * @brief Free an item of an ingestion.
+ *
+ * @param item  Item.
+ */
+static void
+nvticache_ingest_item_free (nvticache_ingest_item_t *item)
+{
+  nvti_free (item->nvti);
+  g_free (item->filename);
+  g_free (item);
+}
+
+/**
+ * @brief Add a batch of NVT Infos to the cache KB.
+ *
+ * The filenames already stored for the OIDs are fetched with a single
+ * round trip, then the entries they replace are deleted and the NVT Infos
+ * written in one pipelined batch.
+ *
+ * @param worker  Worker.
+ * @param items   Items of the batch.
+ */
+static void
+nvticache_ingest_batch (nvticache_ingest_worker_t *worker, GPtrArray *items)
+{
+  const char **oids;
+  kb_nvt_fields_t *fields;
+  GHashTable *batch_files;
+  guint i;
+
+  oids = g_malloc (items->len * sizeof (*oids));
+  for (i = 0; i < items->len; i++)
+    oids[i] = nvti_oid (
+      ((nvticache_ingest_item_t *) g_ptr_array_index (items, i))->nvti);
+  fields = kb_nvt_get_fields (worker->kb, oids, items->len,
+                              NVT_FIELD (NVT_FILENAME_POS));
+  g_free (oids);
+
+  /* OIDs may repeat within the batch, the last file wins. */
+  batch_files = g_hash_table_new (g_str_hash, g_str_equal);
+  kb_batch_begin (worker->kb);
+  for (i = 0; i < items->len; i++)
+    {
+      nvticache_ingest_item_t *item = g_ptr_array_index (items, i);
+      const char *oid = nvti_oid (item->nvti);
+      const char *previous;
+      char pattern[4096];
+
+      previous = g_hash_table_lookup (batch_files, oid);
+      if (previous == NULL && fields)
+        previous = fields[i].field[NVT_FILENAME_POS];
+
+      if (previous && strcmp (item->filename, previous))
+        {
+          struct stat src_stat;
+          char *src_file = g_build_filename (src_path, previous, NULL);
+
+          /* If .nasl file was duplicated, not moved. */
+          if (stat (src_file, &src_stat) >= 0)
+            g_warning ("NVT %s with duplicate OID %s will be replaced with %s",
+                       src_file, oid, item->filename);
+          g_free (src_file);
+        }
+      if (previous)
+        {
+          if (cache_layout == KB_NVT_LAYOUT_LIST)
+            {
+              g_snprintf (pattern, sizeof (pattern), "oid:%s:prefs", oid);
+              kb_del_items (worker->kb, pattern);
+            }
+          g_snprintf (pattern, sizeof (pattern), "nvt:%s", oid);
+          kb_del_items (worker->kb, pattern);
+          g_snprintf (pattern, sizeof (pattern), "filename:%s", previous);
+          kb_del_items (worker->kb, pattern);
+        }
+
+      if (kb_nvt_add (worker->kb, item->nvti, item->filename))
+        worker->failed++;
+      g_hash_table_insert (batch_files, (gpointer) oid, item->filename);
+    }
+  if (kb_batch_commit (worker->kb))
+    worker->failed += items->len;
+  g_hash_table_destroy (batch_files);
+  if (fields)
+    kb_nvt_fields_free (fields, items->len);
+}
+
+/**
+ * @brief Thread of an ingestion worker.
+ *
+ * @param data  Worker.
+ *
+ * @return NULL.
+ */
+static gpointer
+nvticache_ingest_thread (gpointer data)
+{
+  nvticache_ingest_worker_t *worker = data;
+  GPtrArray *items;
+  gboolean done = FALSE;
+
+  items = g_ptr_array_new_with_free_func (
+    (GDestroyNotify) nvticache_ingest_item_free);
+  while (!done)
+    {
+      nvticache_ingest_item_t *item;
+
+      /* Wait for an item, then take what else is queued, up to a batch. */
+      item = g_async_queue_pop (worker->queue);
+      while (item != (gpointer) worker)
+        {
+          g_ptr_array_add (items, item);
+          if (items->len == NVTICACHE_INGEST_BATCH)
+            break;
+          item = g_async_queue_try_pop (worker->queue);
+          if (item == NULL)
+            break;
+        }
+      done = item == (gpointer) worker;
+
+      if (items->len)
+        {
+          nvticache_ingest_batch (worker, items);
+          g_ptr_array_set_size (items, 0);
+        }
+    }
+  g_ptr_array_free (items, TRUE);
+  return NULL;
+}
+
+/**
+ * @brief Start a parallel ingestion of NVT Infos into the cache.
+ *
+ * Each worker writes over its own connection to the cache KB, in pipelined
+ * batches.  NVT Infos with the same OID go to the same worker, in the order
+ * they were added.
+ *
+ * @param kb_path  Path to the KB socket.
+ * @param workers  Number of worker threads, 0 for the number of processors.
+ *
+ * @return Ingestion, to be ended with nvticache_ingest_finish(), NULL on
+ *         error.
+ */
+nvticache_ingest_t *
+nvticache_ingest_new (const char *kb_path, int workers)
+{
+  nvticache_ingest_t *ingest;
+  int i;
+
+  assert (cache_kb);
+  assert (kb_path);
+
+  if (workers <= 0)
+    workers = g_get_num_processors ();
+
+  ingest = g_malloc0 (sizeof (*ingest));
+  ingest->workers = g_malloc0 (workers * sizeof (*ingest->workers));
+
+  /* The connections are opened up front, so that a failure is reported
+   * before any NVT Info is queued. */
+  for (i = 0; i < workers; i++)
+    {
+      nvticache_ingest_worker_t *worker = &ingest->workers[i];
+
+      worker->kb = kb_direct_conn (kb_path, kb_get_kb_index (cache_kb));
+      if (worker->kb == NULL)
+        break;
+      kb_nvt_set_layout (worker->kb, cache_layout);
+      worker->queue = g_async_queue_new ();
+      worker->thread =
+        g_thread_new ("nvticache", nvticache_ingest_thread, worker);
+      ingest->count++;
+    }
+
+  if (ingest->count < workers)
+    {
+      g_warning ("%s: Failed to connect to the cache KB", __FUNCTION__);
+      nvticache_ingest_finish (ingest);
+      return NULL;
+    }
+  return ingest;
+}
+
+/**
+ * @brief Queue a NVT Info for a parallel ingestion.
+ *
+ * Can be called from several threads at once.
+ *
+ * @param ingest    Ingestion.
+ * @param nvti      The NVT Information to add.  Freed by the ingestion.
+ * @param filename  The name of the original NVT without the path to the base
+ *                  location of NVTs.
+ *
+ * @return 0 in case of success, -1 on error.
+ */
+int
+nvticache_ingest_add (nvticache_ingest_t *ingest, nvti_t *nvti,
+                      const char *filename)
+{
+  nvticache_ingest_item_t *item;
+
+  if (ingest == NULL || nvti == NULL || nvti_oid (nvti) == NULL
+      || filename == NULL)
+    {
+      nvti_free (nvti);
+      return -1;
+    }
+
+  item = g_malloc (sizeof (*item));
+  item->nvti = nvti;
+  item->filename = g_strdup (filename);
+  g_async_queue_push (
+    ingest->workers[g_str_hash (nvti_oid (nvti)) % ingest->count].queue,
+    item);
+  return 0;
+}
+
+/**
+ * @brief End a parallel ingestion.
+ *
+ * Waits until all queued NVT Infos are written.  Must not be called while
+ * nvticache_ingest_add() is still running in other threads.
+ *
+ * @param ingest  Ingestion.
+ *
+ * @return 0 in case of success, -1 if some NVT Infos could not be added.
+ */
+int
+nvticache_ingest_finish (nvticache_ingest_t *ingest)
+{
+  int i, failed = 0;
+
+  if (ingest == NULL)
+    return -1;
+
+  for (i = 0; i < ingest->count; i++)
+    g_async_queue_push (ingest->workers[i].queue, &ingest->workers[i]);
+  for (i = 0; i < ingest->count; i++)
+    {
+      nvticache_ingest_worker_t *worker = &ingest->workers[i];
+
+      g_thread_join (worker->thread);
+      g_async_queue_unref (worker->queue);
+      kb_lnk_reset (worker->kb);
+      g_free (worker->kb);
+      failed += worker->failed;
+    }
+  g_free (ingest->workers);
+  g_free (ingest);
+
+  /* Entries may have been replaced behind the in-process cache. */
+  nvti_cache_clear ();
+  cache_saved = 0;
+  return failed ? -1 : 0;
+}
+
 /**
  * @brief Get the full source filename of an OID.
  *
@@ -513,9 +1207,128 @@ nvticache_get_tags (const char *oid)
  */
 nvti_t *
 nvticache_get_nvt (const char *oid)
+{
+  nvti_t *nvti;
+  char *feed_version;
+
+  assert (cache_kb);
+
+  if (nvti_cache.max_size == 0)
+    return kb_nvt_get_all (cache_kb, oid);
+
+  /* Another process may have updated the cache KB to a new feed. */
+  feed_version = kb_item_get_str (cache_kb, NVTICACHE_STR);
+  nvti_cache_check_version (feed_version);
+  nvti = nvti_cache_lookup (oid);
+  if (nvti == NULL)
+    {
+      nvti = kb_nvt_get_all (cache_kb, oid);
+      if (nvti && feed_version)
+        nvti_cache_insert (nvti, feed_version);
+    }
+  g_free (feed_version);
+  return nvti;
+}
+
+/**
+ * @brief Get fields of many plugins at once.
+ *
+ * This is to be preferred over the single field getters when iterating over
+ * many OIDs, as all the requests are pipelined.
+ *
+ * @param[in]   oids    OIDs to match.
+ * @param[in]   count   Number of OIDs.
+ * @param[in]   mask    NVT_FIELD() bits of the fields to get.
+ *
+ * @return Array of count fields, in the order of oids, to be freed with
+ *         kb_nvt_fields_free(). NULL on error.
+ */
+kb_nvt_fields_t *
+nvticache_get_fields (const char **oids, size_t count, unsigned int mask)
 {
   assert (cache_kb);
-  return kb_nvt_get_all (cache_kb, oid);
+  return kb_nvt_get_fields (cache_kb, oids, count, mask);
+}
+
+/**
+ * @brief Parse a NVT preference as stored in the cache KB.
+ *
+ * @param[in]   str     Preference, as "id|||name|||type|||default".
+ *
+ * @return Preference, NULL if str is malformed.
+ */
+static nvtpref_t *
+nvtpref_from_str (const char *str)
+{
+  nvtpref_t *np;
+  char **array = g_strsplit (str, "|||", -1);
+
+  if (g_strv_length (array) != 4)
+    {
+      g_strfreev (array);
+      return NULL;
+    }
+  np = nvtpref_new (atoi (array[0]), array[1], array[2], array[3]);
+  g_strfreev (array);
+  return np;
+}
+
+/**
+ * @brief Get a length-prefixed string of packed NVT preferences.
+ *
+ * @param[in,out] packed  Packed preferences, moved past the string.
+ *
+ * @return The string, NULL if packed is malformed.
+ */
+static char *
+nvtprefs_unpack_str (const char **packed)
+{
+  char *end;
+  unsigned long len;
+
+  if (!g_ascii_isdigit (**packed))
+    return NULL;
+  len = strtoul (*packed, &end, 10);
+  if (*end != ':' || strnlen (end + 1, len) < len)
+    return NULL;
+  *packed = end + 1 + len;
+  return g_strndup (end + 1, len);
+}
+
+/**
+ * @brief Parse NVT preferences packed for KB_NVT_LAYOUT_HASH.
+ *
+ * @param[in]   packed  Packed preferences.
+ *
+ * @return List of preferences, NULL if there are none. Parsing stops at the
+ *         first malformed preference.
+ */
+static GSList *
+nvtprefs_unpack (const char *packed)
+{
+  GSList *list = NULL;
+
+  while (packed && *packed)
+    {
+      char *str[4];
+      int i, malformed;
+
+      for (i = 0; i < 4; i++)
+        if ((str[i] = nvtprefs_unpack_str (&packed)) == NULL)
+          break;
+      malformed = i < 4;
+      if (!malformed)
+        list = g_slist_prepend (
+          list, nvtpref_new (atoi (str[0]), str[1], str[2], str[3]));
+      while (i--)
+        g_free (str[i]);
+      if (malformed)
+        {
+          g_warning ("%s: Malformed NVT preferences", __func__);
+          break;
+        }
+    }
+  return g_slist_reverse (list);
 }
 
 /**
@@ -534,21 +1347,22 @@ nvticache_get_prefs (const char *oid)
 
   assert (cache_kb);
 
+  if (cache_layout == KB_NVT_LAYOUT_HASH)
+    {
+      char *packed = kb_nvt_get (cache_kb, oid, NVT_PREFS_POS);
+
+      list = nvtprefs_unpack (packed);
+      g_free (packed);
+      return list;
+    }
+
   g_snprintf (pattern, sizeof (pattern), "oid:%s:prefs", oid);
   prefs = element = kb_item_get_all (cache_kb, pattern);
   while (element)
     {
-      nvtpref_t *np;
-      char **array = g_strsplit (element->v_str, "|||", -1);
-
-      assert (array[3]);
-      assert (!array[4]);
-      np = g_malloc0 (sizeof (nvtpref_t));
-      np->id = atoi (array[0]);
-      np->name = array[1];
-      np->type = array[2];
-      np->dflt = array[3];
-      g_free (array);
+      nvtpref_t *np = nvtpref_from_str (element->v_str);
+
+      assert (np);
       list = g_slist_append (list, np);
       element = element->next;
     }
@@ -596,9 +1410,13 @@ nvticache_delete (const char *oid)
   assert (cache_kb);
   assert (oid);
 
+  nvti_cache_remove (oid);
   filename = nvticache_get_filename (oid);
-  g_snprintf (pattern, sizeof (pattern), "oid:%s:prefs", oid);
-  kb_del_items (cache_kb, pattern);
+  if (cache_layout == KB_NVT_LAYOUT_LIST)
+    {
+      g_snprintf (pattern, sizeof (pattern), "oid:%s:prefs", oid);
+      kb_del_items (cache_kb, pattern);
+    }
   g_snprintf (pattern, sizeof (pattern), "nvt:%s", oid);
   kb_del_items (cache_kb, pattern);
 
@@ -618,7 +1436,11 @@ nvticache_delete (const char *oid)
 char *
 nvticache_feed_version (void)
 {
-  return kb_item_get_str (cache_kb, NVTICACHE_STR);
+  char *feed_version;
+
+  feed_version = kb_item_get_str (cache_kb, NVTICACHE_STR);
+  nvti_cache_check_version (feed_version);
+  return feed_version;
 }
 
 /**
@@ -634,9 +1456,497 @@ nvticache_check_feed (void)
 
   if (!(current = nvt_feed_version ()))
     return 0;
-  cached = kb_item_get_str (cache_kb, NVTICACHE_STR);
+  cached = nvticache_feed_version ();
   ret = strcmp (cached, current);
   g_free (cached);
   g_free (current);
   return ret;
 }
+
+/**
+ * @brief Get the full path of a NVT cache snapshot.
+ *
+ * @param path  Path of the snapshot, NULL for the default one.
+ *
+ * @return Path to be freed.
+ */
+static char *
+snapshot_path (const char *path)
+{
+  if (path)
+    return g_strdup (path);
+  return g_build_filename (snapshot_dir ?: GVM_PID_DIR, SNAPSHOT_FILENAME,
+                           NULL);
+}
+
+/**
+ * @brief Set the directory of the default NVT cache snapshot.
+ *
+ * The NVT directory is often read-only, so the snapshot is kept in the run
+ * directory by default.
+ *
+ * @param dir  Writable directory, NULL for the default one.
+ */
+void
+nvticache_set_snapshot_dir (const char *dir)
+{
+  g_free (snapshot_dir);
+  snapshot_dir = g_strdup (dir);
+}
+
+/**
+ * @brief Add a string to a snapshot string table, reusing an existing copy.
+ *
+ * @param strtab   String table.
+ * @param offsets  Offsets of the strings already in the table.
+ * @param str      String to add.
+ *
+ * @return Offset of the string in the table.
+ */
+static guint32
+snapshot_add_str (GString *strtab, GHashTable *offsets, const char *str)
+{
+  gpointer offset;
+
+  if (str == NULL || *str == '\0')
+    return 0;
+  if (g_hash_table_lookup_extended (offsets, str, NULL, &offset))
+    return GPOINTER_TO_UINT (offset);
+
+  offset = GUINT_TO_POINTER (strtab->len);
+  g_string_append_len (strtab, str, strlen (str) + 1);
+  g_hash_table_insert (offsets, g_strdup (str), offset);
+  return GPOINTER_TO_UINT (offset);
+}
+
+/**
+ * @brief Collect the preferences of all NVTs in the cache.
+ *
+ * @return Table of OID to GSList of preferences, in KB order.
+ */
+static GHashTable *
+snapshot_collect_prefs (void)
+{
+  GHashTable *prefs;
+  unsigned long long cursor = 0;
+
+  prefs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  do
+    {
+      struct kb_item *items, *item;
+
+      items = kb_item_iter_pattern (cache_kb, "oid:*:prefs", &cursor);
+      /* Items of a key come in reverse order, so prepending restores it. */
+      for (item = items; item; item = item->next)
+        {
+          char *oid;
+          GSList *list;
+
+          if (item->type != KB_TYPE_STR || item->namelen < 11)
+            continue;
+          oid = g_strndup (item->name + 4, item->namelen - 11);
+          list = g_hash_table_lookup (prefs, oid);
+          list = g_slist_prepend (list, g_strdup (item->v_str));
+          g_hash_table_replace (prefs, oid, list);
+        }
+      kb_item_free (items);
+    }
+  while (cursor != 0);
+
+  return prefs;
+}
+
+/**
+ * @brief Collect the preferences of NVTs stored in KB_NVT_LAYOUT_HASH.
+ *
+ * @param oids    OIDs of the NVTs.
+ * @param fields  Fields of the NVTs, with the packed preferences.
+ * @param count   Number of NVTs.
+ *
+ * @return Table of OID to GSList of preferences, like
+ *         snapshot_collect_prefs().
+ */
+static GHashTable *
+snapshot_unpack_prefs (const char **oids, const kb_nvt_fields_t *fields,
+                       size_t count)
+{
+  GHashTable *prefs;
+  size_t i;
+
+  prefs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (i = 0; i < count; i++)
+    {
+      GSList *unpacked, *element, *list = NULL;
+
+      unpacked = nvtprefs_unpack (fields[i].prefs);
+      for (element = unpacked; element; element = element->next)
+        {
+          nvtpref_t *np = element->data;
+
+          list = g_slist_prepend (
+            list, g_strdup_printf ("%d|||%s|||%s|||%s", nvtpref_id (np),
+                                   nvtpref_name (np), nvtpref_type (np),
+                                   nvtpref_default (np)));
+        }
+      g_slist_free_full (unpacked, (GDestroyNotify) nvtpref_free);
+      if (list)
+        g_hash_table_replace (prefs, g_strdup (oids[i]),
+                              g_slist_reverse (list));
+    }
+  return prefs;
+}
+
+/**
+ * @brief Free the preferences list of a snapshot_collect_prefs() table.
+ *
+ * @param oid   OID.
+ * @param list  List of preferences.
+ */
+static void
+snapshot_free_prefs (gpointer oid, gpointer list)
+{
+  (void) oid;
+  g_slist_free_full (list, g_free);
+}
+
+/**
+ * @brief Write a snapshot of the NVT cache to disk.
+ *
+ * The snapshot can be restored by nvticache_snapshot_load() into an empty
+ * cache KB, as long as the feed version didn't change.
+ *
+ * @param path  Path of the snapshot. NULL for the default one, see
+ *              nvticache_set_snapshot_dir().
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int
+nvticache_snapshot_write (const char *path)
+{
+  snapshot_header_t header;
+  GSList *oids, *element;
+  GHashTable *prefs, *offsets;
+  GArray *records, *pref_offsets;
+  GString *strtab;
+  kb_nvt_fields_t *fields;
+  const char **oid_array;
+  char *feed_version, *file, *tmp_file;
+  size_t count, i;
+  FILE *fp;
+  int rc = 0;
+
+  assert (cache_kb);
+
+  feed_version = nvticache_feed_version ();
+  if (!feed_version)
+    return -1;
+  oids = nvticache_get_oids ();
+  count = g_slist_length (oids);
+  oid_array = g_malloc0_n (count + 1, sizeof (char *));
+  for (i = 0, element = oids; element; element = element->next)
+    oid_array[i++] = element->data;
+  fields = kb_nvt_get_fields (cache_kb, oid_array, count,
+                              (NVT_FIELD (NVT_TIMESTAMP_POS) - 1)
+                                | NVT_FIELD (NVT_PREFS_POS));
+  if (!fields)
+    {
+      g_free (oid_array);
+      g_slist_free_full (oids, g_free);
+      g_free (feed_version);
+      return -1;
+    }
+  if (cache_layout == KB_NVT_LAYOUT_HASH)
+    prefs = snapshot_unpack_prefs (oid_array, fields, count);
+  else
+    prefs = snapshot_collect_prefs ();
+
+  strtab = g_string_new_len ("", 1);
+  offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  records = g_array_sized_new (FALSE, TRUE, sizeof (snapshot_record_t), count);
+  pref_offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+  for (i = 0; i < count; i++)
+    {
+      snapshot_record_t record;
+      int pos;
+
+      /* Deleted since the OIDs were listed. */
+      if (!fields[i].field[NVT_FILENAME_POS])
+        continue;
+
+      memset (&record, 0, sizeof (record));
+      for (pos = 0; pos < NVT_TIMESTAMP_POS; pos++)
+        record.field[pos] =
+          snapshot_add_str (strtab, offsets, fields[i].field[pos]);
+      record.oid = snapshot_add_str (strtab, offsets, oid_array[i]);
+      record.first_pref = pref_offsets->len;
+      for (element = g_hash_table_lookup (prefs, oid_array[i]); element;
+           element = element->next)
+        {
+          guint32 offset = snapshot_add_str (strtab, offsets, element->data);
+
+          g_array_append_val (pref_offsets, offset);
+          record.pref_count++;
+        }
+      g_array_append_val (records, record);
+    }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, SNAPSHOT_MAGIC, sizeof (header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.byte_order = SNAPSHOT_BYTE_ORDER;
+  header.count = records->len;
+  header.pref_count = pref_offsets->len;
+  header.feed_version = snapshot_add_str (strtab, offsets, feed_version);
+  header.strtab_offset = sizeof (header)
+                         + (guint64) records->len * sizeof (snapshot_record_t)
+                         + (guint64) pref_offsets->len * sizeof (guint32);
+  header.strtab_size = strtab->len;
+
+  /* Offsets are 32 bits wide. */
+  if (strtab->len > G_MAXUINT32)
+    {
+      g_warning ("%s: NVT cache too big for a snapshot", __func__);
+      rc = -1;
+    }
+
+  file = snapshot_path (path);
+  tmp_file = g_strdup_printf ("%s.tmp", file);
+  if (rc == 0)
+    {
+      fp = fopen (tmp_file, "w");
+      if (fp == NULL)
+        {
+          g_warning ("%s: Failed to open %s: %s", __func__, tmp_file,
+                     strerror (errno));
+          rc = -1;
+        }
+      else
+        {
+          if (fwrite (&header, sizeof (header), 1, fp) != 1
+              || fwrite (records->data, sizeof (snapshot_record_t),
+                         records->len, fp)
+                   != records->len
+              || fwrite (pref_offsets->data, sizeof (guint32),
+                         pref_offsets->len, fp)
+                   != pref_offsets->len
+              || fwrite (strtab->str, 1, strtab->len, fp) != strtab->len)
+            rc = -1;
+          if (fclose (fp))
+            rc = -1;
+          if (rc == 0 && rename (tmp_file, file))
+            rc = -1;
+          if (rc)
+            {
+              g_warning ("%s: Failed to write %s: %s", __func__, file,
+                         strerror (errno));
+              unlink (tmp_file);
+            }
+          else
+            g_debug ("%s: Wrote %u NVTs to %s", __func__, header.count, file);
+        }
+    }
+
+  g_free (tmp_file);
+  g_free (file);
+  g_array_free (pref_offsets, TRUE);
+  g_array_free (records, TRUE);
+  g_hash_table_destroy (offsets);
+  g_string_free (strtab, TRUE);
+  g_hash_table_foreach (prefs, (GHFunc) snapshot_free_prefs, NULL);
+  g_hash_table_destroy (prefs);
+  kb_nvt_fields_free (fields, count);
+  g_free (oid_array);
+  g_slist_free_full (oids, g_free);
+  g_free (feed_version);
+  return rc;
+}
+
+/**
+ * @brief Get a string from a snapshot string table.
+ *
+ * @param strtab  String table. Its last byte is a NULL byte.
+ * @param size    Size of the string table.
+ * @param offset  Offset of the string.
+ *
+ * @return The string, NULL if offset is out of the table.
+ */
+static const char *
+snapshot_str (const char *strtab, guint64 size, guint32 offset)
+{
+  if (offset >= size)
+    return NULL;
+  return strtab + offset;
+}
+
+/**
+ * @brief Build a NVT Info from a snapshot record.
+ *
+ * @param record      NVT record.
+ * @param prefs       Preference records.
+ * @param pref_count  Number of preference records.
+ * @param strtab      String table.
+ * @param size        Size of the string table.
+ *
+ * @return NVT Info, NULL if the record is malformed.
+ */
+static nvti_t *
+snapshot_record_nvti (const snapshot_record_t *record, const guint32 *prefs,
+                      guint32 pref_count, const char *strtab, guint64 size)
+{
+  const char *field[NVT_TIMESTAMP_POS], *oid;
+  nvti_t *nvti;
+  guint32 i;
+  int pos;
+
+  for (pos = 0; pos < NVT_TIMESTAMP_POS; pos++)
+    if ((field[pos] = snapshot_str (strtab, size, record->field[pos])) == NULL)
+      return NULL;
+  if ((oid = snapshot_str (strtab, size, record->oid)) == NULL
+      || record->first_pref > pref_count
+      || record->pref_count > pref_count - record->first_pref)
+    return NULL;
+
+  nvti = nvti_new ();
+  nvti_set_oid (nvti, oid);
+  nvti_set_required_keys (nvti, field[NVT_REQUIRED_KEYS_POS]);
+  nvti_set_mandatory_keys (nvti, field[NVT_MANDATORY_KEYS_POS]);
+  nvti_set_excluded_keys (nvti, field[NVT_EXCLUDED_KEYS_POS]);
+  nvti_set_required_udp_ports (nvti, field[NVT_REQUIRED_UDP_PORTS_POS]);
+  nvti_set_required_ports (nvti, field[NVT_REQUIRED_PORTS_POS]);
+  nvti_set_dependencies (nvti, field[NVT_DEPENDENCIES_POS]);
+  nvti_set_tag (nvti, field[NVT_TAGS_POS]);
+  nvti_add_refs (nvti, "cve", field[NVT_CVES_POS], "");
+  nvti_add_refs (nvti, "bid", field[NVT_BIDS_POS], "");
+  nvti_add_refs (nvti, NULL, field[NVT_XREFS_POS], "");
+  nvti_set_category (nvti, atoi (field[NVT_CATEGORY_POS]));
+  nvti_set_timeout (nvti, atoi (field[NVT_TIMEOUT_POS]));
+  nvti_set_family (nvti, field[NVT_FAMILY_POS]);
+  nvti_set_name (nvti, field[NVT_NAME_POS]);
+
+  for (i = record->first_pref; i < record->first_pref + record->pref_count;
+       i++)
+    {
+      const char *str = snapshot_str (strtab, size, prefs[i]);
+      nvtpref_t *np = str ? nvtpref_from_str (str) : NULL;
+
+      if (np == NULL)
+        {
+          nvti_free (nvti);
+          return NULL;
+        }
+      nvti_add_pref (nvti, np);
+    }
+
+  return nvti;
+}
+
+/**
+ * @brief Restore the NVT cache from a snapshot written by
+ *        nvticache_snapshot_write().
+ *
+ * The snapshot is only restored if it was written for the current feed
+ * version. To be called on an empty cache.
+ *
+ * @param path  Path of the snapshot. NULL for the default one, see
+ *              nvticache_set_snapshot_dir().
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int
+nvticache_snapshot_load (const char *path)
+{
+  const snapshot_header_t *header;
+  const snapshot_record_t *records;
+  const guint32 *prefs;
+  const char *data, *strtab, *feed_version;
+  char *file, *current = NULL;
+  GMappedFile *map;
+  GError *error = NULL;
+  gsize size;
+  guint32 i;
+  int rc = -1;
+
+  assert (cache_kb);
+
+  file = snapshot_path (path);
+  map = g_mapped_file_new (file, FALSE, &error);
+  if (map == NULL)
+    {
+      g_debug ("%s: %s", __func__, error->message);
+      g_error_free (error);
+      g_free (file);
+      return -1;
+    }
+
+  data = g_mapped_file_get_contents (map);
+  size = g_mapped_file_get_length (map);
+  header = (const snapshot_header_t *) data;
+  if (size < sizeof (*header)
+      || memcmp (header->magic, SNAPSHOT_MAGIC, sizeof (header->magic))
+      || header->version != SNAPSHOT_VERSION
+      || header->byte_order != SNAPSHOT_BYTE_ORDER
+      || header->strtab_offset
+           != sizeof (*header)
+                + (guint64) header->count * sizeof (snapshot_record_t)
+                + (guint64) header->pref_count * sizeof (guint32)
+      || header->strtab_size == 0
+      || header->strtab_offset + header->strtab_size != size)
+    {
+      g_warning ("%s: %s is not a valid NVT cache snapshot", __func__, file);
+      goto out;
+    }
+  records = (const snapshot_record_t *) (data + sizeof (*header));
+  prefs = (const guint32 *) (records + header->count);
+  strtab = data + header->strtab_offset;
+  if (strtab[header->strtab_size - 1] != '\0'
+      || !(feed_version = snapshot_str (strtab, header->strtab_size,
+                                        header->feed_version)))
+    {
+      g_warning ("%s: %s is not a valid NVT cache snapshot", __func__, file);
+      goto out;
+    }
+
+  current = nvt_feed_version ();
+  if (g_strcmp0 (current, feed_version))
+    {
+      g_debug ("%s: %s is for feed version %s, not %s", __func__, file,
+               feed_version, current);
+      goto out;
+    }
+
+  rc = 0;
+  kb_batch_begin (cache_kb);
+  for (i = 0; i < header->count; i++)
+    {
+      nvti_t *nvti;
+
+      nvti = snapshot_record_nvti (&records[i], prefs, header->pref_count,
+                                   strtab, header->strtab_size);
+      if (nvti == NULL)
+        {
+          g_warning ("%s: Malformed NVT record %u in %s", __func__, i, file);
+          rc = -1;
+          break;
+        }
+      if (kb_nvt_add (cache_kb, nvti,
+                      strtab + records[i].field[NVT_FILENAME_POS]))
+        rc = -1;
+      nvti_free (nvti);
+    }
+  if (kb_batch_commit (cache_kb))
+    rc = -1;
+
+  if (rc == 0)
+    {
+      kb_item_set_str (cache_kb, NVTICACHE_STR, feed_version, 0);
+      cache_saved = 0;
+      g_message ("Restored %u NVTs of feed version %s from %s", header->count,
+                 feed_version, file);
+    }
+
+out:
+  g_free (current);
+  g_mapped_file_unref (map);
+  g_free (file);
+  return rc;
+}
@@ -36,9 +36,25 @@
 #define NVTICACHE_STR "nvticache10"
 #endif
 
+/**
+ * @brief Usage counters of the in-process NVT Info cache.
+ */
+typedef struct
+{
+  unsigned long hits;      /**< Lookups served from memory. */
+  unsigned long misses;    /**< Lookups that went to the cache KB. */
+  unsigned long evictions; /**< Entries dropped to stay under max_size. */
+  size_t entries;          /**< Number of cached NVT Infos. */
+  size_t size;             /**< Estimated memory used, in bytes. */
+  size_t max_size;         /**< Memory limit, in bytes. */
+} nvticache_stats_t;
+
 int
 nvticache_init (const char *, const char *);
 
+int
+nvticache_init_layout (const char *, const char *, enum kb_nvt_layout);
+
 void
 nvticache_reset ();
 
@@ -54,9 +70,26 @@ nvticache_initialized (void);
 int
 nvticache_check (const gchar *);
 
+GSList *
+nvticache_get_stale (GSList *);
+
 int
 nvticache_add (const nvti_t *, const char *);
 
+/**
+ * @brief Parallel ingestion of NVT Infos into the cache.
+ */
+typedef struct nvticache_ingest nvticache_ingest_t;
+
+nvticache_ingest_t *
+nvticache_ingest_new (const char *, int);
+
+int
+nvticache_ingest_add (nvticache_ingest_t *, nvti_t *, const char *);
+
+int
+nvticache_ingest_finish (nvticache_ingest_t *);
+
 char *
 nvticache_get_src (const char *);
 
@@ -114,6 +147,9 @@ nvticache_get_dependencies (const char *);
 nvti_t *
 nvticache_get_nvt (const char *);
 
+kb_nvt_fields_t *
+nvticache_get_fields (const char **, size_t, unsigned int);
+
 GSList *
 nvticache_get_oids (void);
 
@@ -129,4 +165,19 @@ nvticache_feed_version (void);
 int
 nvticache_check_feed (void);
 
+int
+nvticache_snapshot_write (const char *);
+
+int
+nvticache_snapshot_load (const char *);
+
+void
+nvticache_set_snapshot_dir (const char *);
+
+void
+nvticache_set_cache_size (size_t);
+
+void
+nvticache_get_cache_stats (nvticache_stats_t *);
+
 #endif /* not _GVM_NVTICACHE_H */
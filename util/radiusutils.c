@@ -24,7 +24,7 @@
 
 #ifdef ENABLE_RADIUS_AUTH
 
-#include <arpa/inet.h> /* for inet_pton */
+#include <arpa/inet.h> /* for inet_pton, inet_ntop */
 
 #if defined(RADIUS_AUTH_FREERADIUS)
 #include <freeradius-client.h>
@@ -53,7 +53,9 @@
 /**
  * Initialize the Radius client configuration.
  *
- * @param[in]   hostname    Server hostname.
+ * Reads the dictionary, so the handle is best kept for many requests.
+ *
+ * @param[in]   hostname    Server hostname or address.
  * @param[in]   secret      Radius secret key.
  *
  * @return Radius Client handle if success, NULL otherwise.
@@ -192,9 +194,306 @@ radius_init_fail:
   return NULL;
 }
 
+/**
+ * @brief Resolve the address of a Radius server.
+ *
+ * @param[in]   hostname    Server hostname.
+ *
+ * @return Numeric address to configure the server with, NULL if the
+ *         hostname does not resolve.  Free with g_free.
+ */
+static gchar *
+radius_server_address (const char *hostname)
+{
+  struct in6_addr ip6;
+  char addr[INET6_ADDRSTRLEN];
+
+  if (gvm_resolve (hostname, &ip6, AF_UNSPEC))
+    {
+      g_warning ("radius_authenticate: Couldn't resolve %s", hostname);
+      return NULL;
+    }
+  if (IN6_IS_ADDR_V4MAPPED (&ip6))
+    inet_ntop (AF_INET, &ip6.s6_addr32[3], addr, sizeof (addr));
+  else
+    inet_ntop (AF_INET6, &ip6, addr, sizeof (addr));
+  return g_strdup (addr);
+}
+
+/**
+ * @brief An idle pooled Radius client handle.
+ */
+typedef struct
+{
+  rc_handle *rh;    ///< The handle.
+  gint64 last_used; ///< Monotonic time the handle was last released.
+} radius_pool_handle_t;
+
+/**
+ * @brief Pooled client of one Radius server and secret.
+ */
+typedef struct
+{
+  GQueue idle; ///< Idle handles, most recently released last.
+  guint open;  ///< Handles open, idle or in use.
+  gchar *addr; ///< Resolved server address, NULL while no handle is open.
+} radius_client_t;
+
+/**
+ * @brief Maximum handles per client, 0 to disable pooling.
+ */
+static guint radius_pool_max = 0;
+
+/**
+ * @brief Seconds after which an idle handle is destroyed.
+ */
+static guint radius_pool_idle_timeout = 0;
+
+/**
+ * @brief Clients, keyed by server and secret.
+ */
+static GHashTable *radius_clients = NULL;
+
+/**
+ * @brief Lock for the clients.
+ */
+static GMutex radius_pool_lock;
+
+/**
+ * @brief Signalled when a pooled handle is released or destroyed.
+ */
+static GCond radius_pool_cond;
+
+/**
+ * @brief Free a client.
+ *
+ * @param[in] client  The client.
+ */
+static void
+radius_client_free (radius_client_t *client)
+{
+  g_free (client->addr);
+  g_free (client);
+}
+
+/**
+ * @brief Destroy idle handles of a list.
+ *
+ * @param[in] handles  List of radius_pool_handle_t.
+ */
+static void
+radius_pool_close (GList *handles)
+{
+  GList *iter;
+
+  for (iter = handles; iter; iter = iter->next)
+    {
+      radius_pool_handle_t *handle = iter->data;
+
+      rc_destroy (handle->rh);
+      g_free (handle);
+    }
+  g_list_free (handles);
+}
+
+/**
+ * @brief Take the expired idle handles out of a client.
+ *
+ * Must be called with the clients locked.  The server address is resolved
+ * again once the client has no handles left.
+ *
+ * @param[in] client  The client.
+ * @param[in] all     Whether to take all idle handles.
+ *
+ * @return Taken handles, to be destroyed with radius_pool_close.
+ */
+static GList *
+radius_pool_expire (radius_client_t *client, gboolean all)
+{
+  radius_pool_handle_t *handle;
+  GList *expired = NULL;
+  gint64 limit;
+
+  limit = g_get_monotonic_time ()
+          - (gint64) radius_pool_idle_timeout * G_USEC_PER_SEC;
+  while ((handle = g_queue_peek_head (&client->idle))
+         && (all || (radius_pool_idle_timeout && handle->last_used <= limit)))
+    {
+      g_queue_pop_head (&client->idle);
+      client->open--;
+      expired = g_list_prepend (expired, handle);
+    }
+  if (client->open == 0)
+    {
+      g_free (client->addr);
+      client->addr = NULL;
+    }
+  return expired;
+}
+
+/**
+ * @brief Configure pooling of Radius client handles.
+ *
+ * With pooling, radius_authenticate keeps a client per server and secret.
+ * The client keeps its handles, with the dictionary and configuration
+ * read, and the resolved server address, so that an authentication costs
+ * only the Access-Request.  At most max_handles requests per client are
+ * in flight at once, further authentications wait for a handle.  Handles
+ * idle for idle_timeout seconds are destroyed, and the address of a
+ * client without handles is resolved again.  Pooling is disabled by
+ * default.
+ *
+ * @param[in] max_handles   Handles per client, 0 to disable pooling and
+ *                          destroy the idle handles.
+ * @param[in] idle_timeout  Seconds an idle handle is kept, 0 for no limit.
+ */
+void
+radius_auth_set_pool (unsigned int max_handles, unsigned int idle_timeout)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GList *closed = NULL;
+
+  g_mutex_lock (&radius_pool_lock);
+  radius_pool_max = max_handles;
+  radius_pool_idle_timeout = idle_timeout;
+  if (radius_clients == NULL)
+    radius_clients =
+      g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                             (GDestroyNotify) radius_client_free);
+  g_hash_table_iter_init (&iter, radius_clients);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    closed =
+      g_list_concat (radius_pool_expire (value, max_handles == 0), closed);
+  g_cond_broadcast (&radius_pool_cond);
+  g_mutex_unlock (&radius_pool_lock);
+  radius_pool_close (closed);
+}
+
+/**
+ * @brief Get a handle slot from a client.
+ *
+ * Waits while the client is at its limit.
+ *
+ * @param[in]  key       Key of the client.
+ * @param[in]  hostname  Server hostname.
+ * @param[in]  secret    Radius secret key.
+ *
+ * @return A handle, NULL on error.  The slot is given up on error.
+ */
+static rc_handle *
+radius_pool_acquire (const gchar *key, const char *hostname,
+                     const char *secret)
+{
+  radius_client_t *client;
+  radius_pool_handle_t *handle;
+  GList *expired;
+  rc_handle *rh = NULL;
+  gboolean slot = FALSE;
+  gchar *addr;
+
+  g_mutex_lock (&radius_pool_lock);
+  client = g_hash_table_lookup (radius_clients, key);
+  if (client == NULL)
+    {
+      client = g_malloc0 (sizeof (*client));
+      g_queue_init (&client->idle);
+      g_hash_table_insert (radius_clients, g_strdup (key), client);
+    }
+  for (;;)
+    {
+      expired = radius_pool_expire (client, FALSE);
+      if ((handle = g_queue_pop_tail (&client->idle)))
+        {
+          rh = handle->rh;
+          g_free (handle);
+          break;
+        }
+      if (client->open < radius_pool_max || radius_pool_max == 0)
+        {
+          client->open++;
+          slot = TRUE;
+          break;
+        }
+      if (expired)
+        break;
+      g_cond_wait (&radius_pool_cond, &radius_pool_lock);
+    }
+  addr = g_strdup (client->addr);
+  g_mutex_unlock (&radius_pool_lock);
+  radius_pool_close (expired);
+
+  if (rh)
+    {
+      g_free (addr);
+      return rh;
+    }
+  if (slot == FALSE)
+    /* Closing made room, try again. */
+    return radius_pool_acquire (key, hostname, secret);
+
+  /* Set up a new handle in the slot, outside the lock. */
+  if (addr == NULL)
+    {
+      addr = radius_server_address (hostname);
+      if (addr)
+        {
+          g_mutex_lock (&radius_pool_lock);
+          if (client->addr == NULL)
+            client->addr = g_strdup (addr);
+          g_mutex_unlock (&radius_pool_lock);
+        }
+    }
+  if (addr)
+    rh = radius_init (addr, secret);
+  g_free (addr);
+  if (rh == NULL)
+    {
+      g_mutex_lock (&radius_pool_lock);
+      client->open--;
+      g_cond_broadcast (&radius_pool_cond);
+      g_mutex_unlock (&radius_pool_lock);
+    }
+  return rh;
+}
+
+/**
+ * @brief Return a handle to its client.
+ *
+ * @param[in] key  Key of the client.
+ * @param[in] rh   Handle to keep for reuse.  Destroyed instead if pooling
+ *                 was disabled meanwhile.
+ */
+static void
+radius_pool_release (const gchar *key, rc_handle *rh)
+{
+  radius_client_t *client;
+
+  g_mutex_lock (&radius_pool_lock);
+  client = g_hash_table_lookup (radius_clients, key);
+  if (radius_pool_max && client->open <= radius_pool_max)
+    {
+      radius_pool_handle_t *handle;
+
+      handle = g_malloc (sizeof (*handle));
+      handle->rh = rh;
+      handle->last_used = g_get_monotonic_time ();
+      g_queue_push_tail (&client->idle, handle);
+      rh = NULL;
+    }
+  else
+    client->open--;
+  g_cond_broadcast (&radius_pool_cond);
+  g_mutex_unlock (&radius_pool_lock);
+  if (rh)
+    rc_destroy (rh);
+}
+
 /**
  * @brief Authenticate against a Radius server.
  *
+ * Uses a pooled client handle if radius_auth_set_pool enabled pooling.
+ *
  * @param[in]   hostname    Server hostname.
  * @param[in]   secret      Radius secret key.
  * @param[in]   username    Username to authenticate.
@@ -211,12 +510,36 @@ radius_authenticate (const char *hostname, const char *secret,
   VALUE_PAIR *send = NULL, *received = NULL;
   rc_handle *rh;
   int rc = -1;
-  struct sockaddr_in ip4;
-  struct sockaddr_in6 ip6;
+  gchar *key = NULL;
+  gboolean pooled;
+
+  g_mutex_lock (&radius_pool_lock);
+  pooled = radius_pool_max > 0;
+  g_mutex_unlock (&radius_pool_lock);
+
+  if (pooled)
+    {
+      gchar *secret_sum;
+
+      secret_sum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, secret, -1);
+      key = g_strdup_printf ("%s %s", hostname, secret_sum);
+      g_free (secret_sum);
+      rh = radius_pool_acquire (key, hostname, secret);
+    }
+  else
+    {
+      gchar *addr;
 
-  rh = radius_init (hostname, secret);
+      addr = radius_server_address (hostname);
+      rh = addr ? radius_init (addr, secret) : NULL;
+      g_free (addr);
+    }
   if (!rh)
-    return -1;
+    {
+      g_free (key);
+      return -1;
+    }
+
   if (rc_avpair_add (rh, &send, PW_USER_NAME, (char *) username, -1, 0) == NULL)
     {
       g_warning ("radius_authenticate: Couldn't set the username");
@@ -233,19 +556,17 @@ radius_authenticate (const char *hostname, const char *secret,
       g_warning ("radius_authenticate: Couldn't set the service type");
       goto authenticate_leave;
     }
-  if (gvm_resolve (hostname, &ip4, AF_INET)
-      && gvm_resolve (hostname, &ip6, AF_INET6))
-    {
-      g_warning ("radius_authenticate: Couldn't resolve %s", hostname);
-      goto authenticate_leave;
-    }
 
   rc = 1;
   if (rc_auth (rh, 0, send, &received, msg) == OK_RC)
     rc = 0;
 
 authenticate_leave:
-  rc_destroy (rh);
+  if (key)
+    radius_pool_release (key, rh);
+  else
+    rc_destroy (rh);
+  g_free (key);
   if (send)
     rc_avpair_free (send);
   if (received)
@@ -277,4 +598,17 @@ radius_authenticate (const char *hostname, const char *secret,
   return -1;
 }
 
+/**
+ * @brief Dummy function for manager.
+ *
+ * @param[in] max_handles   Handles per client.
+ * @param[in] idle_timeout  Seconds an idle handle is kept.
+ */
+void
+radius_auth_set_pool (unsigned int max_handles, unsigned int idle_timeout)
+{
+  (void) max_handles;
+  (void) idle_timeout;
+}
+
 #endif /* ENABLE_RADIUS_AUTH */
@@ -28,4 +28,7 @@
 int
 radius_authenticate (const char *, const char *, const char *, const char *);
 
+void
+radius_auth_set_pool (unsigned int, unsigned int);
+
 #endif /* not _GVM_RADIUSUTILS_H */
@@ -29,7 +29,8 @@
 
 #include "serverutils.h"
 
-#include "../base/hosts.h" /* for is_hostname, is_ipv4_address, is_ipv6_add.. */
+#include "../base/hosts.h"   /* for is_hostname, is_ipv4_address, is_ipv6_add.. */
+#include "../base/logging.h" /* for gvm_log_enabled */
 
 #include <arpa/inet.h>
 #include <errno.h>  /* for errno, ENOTCONN, EAGAIN */
@@ -39,11 +40,14 @@
 #include <gnutls/x509.h> /* for gnutls_x509_crt_..., gnutls_x509_privkey_... */
 #include <netdb.h>      /* for addrinfo, freeaddrinfo, gai_strerror, getad... */
 #include <signal.h>     /* for sigaction, SIGPIPE, sigemptyset, SIG_IGN */
+#include <limits.h>     /* for IOV_MAX */
 #include <stdio.h>      /* for fclose, FILE, SEEK_END, SEEK_SET */
 #include <string.h>     /* for strerror, strlen, memset */
 #include <sys/socket.h> /* for shutdown, connect, socket, SHUT_RDWR, SOCK_... */
+#include <sys/stat.h>   /* for stat */
 #include <sys/types.h>
-#include <unistd.h> /* for close, ssize_t, usleep */
+#include <sys/uio.h> /* for iovec, writev */
+#include <unistd.h>  /* for close, ssize_t, usleep */
 
 #undef G_LOG_DOMAIN
 /**
@@ -51,17 +55,109 @@
  */
 #define G_LOG_DOMAIN "lib  serv"
 
+/**
+ * @brief Size of the stack buffer that formatted messages are sent from.
+ *
+ * Longer messages are formatted into the heap.
+ */
+#define SEND_BUFFER_SIZE 4096
+
+/**
+ * @brief Max size of the data sent in one call that is gathered into a single
+ * @brief TLS record.
+ */
+#define SEND_CORK_MAX 16384
+
+/**
+ * @brief Size of the chunks that files are sent in.
+ */
+#define SEND_FILE_CHUNK_SIZE 65536
+
+/**
+ * @brief Max number of servers to keep TLS session data for.
+ */
+#define TLS_SESSION_CACHE_MAX 256
+
 /**
  * @brief Server address.
  */
 struct sockaddr_in address;
 
+/**
+ * @brief TLS session data of a server, for resuming sessions.
+ */
+typedef struct
+{
+  gchar *key;          ///< "host:port:digest" of server and credentials.
+  gnutls_datum_t data; ///< Session data, empty if none yet.
+} tls_session_entry_t;
+
+/**
+ * @brief TLS session data, by server and client credentials.
+ *
+ * Entries are never removed, so sessions can point at their entry.
+ */
+static GHashTable *tls_session_cache = NULL;
+
+/**
+ * @brief Lock of the TLS session cache.
+ */
+static GMutex tls_session_cache_lock;
+
+/**
+ * @brief Parsed TLS credentials, shared by the sessions that use them.
+ */
+typedef struct
+{
+  gchar *key;                                   ///< Key in the cache.
+  gchar *files;                                 ///< Files loaded, or NULL.
+  gnutls_certificate_credentials_t credentials; ///< Credentials.
+  int refs; ///< References, including the one of the cache.
+} tls_credentials_entry_t;
+
+/**
+ * @brief Credentials by key, and by credentials for releasing them.
+ */
+static struct
+{
+  GHashTable *keys;        ///< Current entries, by key.
+  GHashTable *credentials; ///< All entries in use, by credentials.
+} tls_credentials_cache = {NULL, NULL};
+
+/**
+ * @brief Lock of the TLS credentials cache.
+ */
+static GMutex tls_credentials_cache_lock;
+
+/**
+ * @brief Diffie-Hellman parameters, by file, size and mtime.
+ *
+ * Entries are never freed, as credentials keep pointing at the parameters.
+ */
+static GHashTable *dh_params_cache = NULL;
+
+/**
+ * @brief Lock of the Diffie-Hellman parameters cache.
+ */
+static GMutex dh_params_cache_lock;
+
 static int
 server_attach_internal (int, gnutls_session_t *, const char *, int);
 static int
 server_new_internal (unsigned int, const char *, const gchar *, const gchar *,
                      const gchar *, gnutls_session_t *,
                      gnutls_certificate_credentials_t *);
+static int
+server_new_gnutls_init (gnutls_certificate_credentials_t *);
+static int
+server_new_gnutls_set (unsigned int, const char *, gnutls_session_t *,
+                       gnutls_certificate_credentials_t *);
+static int
+server_credentials_set_file (gnutls_certificate_credentials_t, const gchar *,
+                             const gchar *, const gchar *);
+static int
+server_credentials_set_mem (gnutls_certificate_credentials_t, const char *,
+                            const char *, const char *);
 
 /* Connections. */
 
@@ -310,9 +406,145 @@ client_cert_callback (gnutls_session_t session,
   return 0;
 }
 
+/**
+ * @brief Get a digest of certificates and key in memory.
+ *
+ * @param[in]   ca_cert      Certificate authority public key, or NULL.
+ * @param[in]   pub_key      Public key, or NULL.
+ * @param[in]   priv_key     Private key, or NULL.
+ *
+ * @return SHA-256 digest in hex, to be freed with g_free.
+ */
+static gchar *
+tls_credentials_digest (const char *ca_cert, const char *pub_key,
+                        const char *priv_key)
+{
+  const char *fields[] = {ca_cert, pub_key, priv_key};
+  GChecksum *checksum;
+  gchar *digest;
+  guint i;
+
+  /* A presence byte before and a NULL byte after each field, so that
+   * different fields never hash the same. */
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  for (i = 0; i < G_N_ELEMENTS (fields); i++)
+    {
+      g_checksum_update (checksum, (const guchar *) (fields[i] ? "1" : "0"),
+                         1);
+      g_checksum_update (checksum,
+                         (const guchar *) (fields[i] ? fields[i] : ""), -1);
+      g_checksum_update (checksum, (const guchar *) "", 1);
+    }
+  digest = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+  return digest;
+}
+
+/**
+ * @brief Store the data of a TLS session in the cache, for resuming it later.
+ *
+ * @param[in]  session  Session, set up by tls_session_resume.
+ */
+static void
+tls_session_save (gnutls_session_t session)
+{
+  tls_session_entry_t *entry = gnutls_session_get_ptr (session);
+  gnutls_datum_t data;
+
+  if (entry == NULL || gnutls_session_get_data2 (session, &data))
+    return;
+
+  g_mutex_lock (&tls_session_cache_lock);
+  gnutls_free (entry->data.data);
+  entry->data = data;
+  g_mutex_unlock (&tls_session_cache_lock);
+}
+
+/**
+ * @brief Store a TLS 1.3 session ticket in the cache, as a handshake hook.
+ *
+ * TLS 1.3 servers send tickets after the handshake, so the session data
+ * is only resumable once one arrived.
+ *
+ * @param[in]  session   Session.
+ * @param[in]  htype     Handshake message type.
+ * @param[in]  when      Whether the hook runs before or after the message.
+ * @param[in]  incoming  Whether the message was received.
+ * @param[in]  msg       Message.
+ *
+ * @return 0.
+ */
+static int
+tls_session_ticket_hook (gnutls_session_t session, unsigned int htype,
+                         unsigned int when, unsigned int incoming,
+                         const gnutls_datum_t *msg)
+{
+  (void) htype;
+  (void) when;
+  (void) msg;
+  if (incoming)
+    tls_session_save (session);
+  return 0;
+}
+
+/**
+ * @brief Prepare a client TLS session to resume an earlier one to a server.
+ *
+ * Only sessions set up with the same certificates and key are resumed, as
+ * a resumed session keeps the client authentication of the earlier one.
+ *
+ * @param[in]  session   Session, before the handshake.
+ * @param[in]  host      Host of the server.
+ * @param[in]  port      Port of the server.
+ * @param[in]  ca_mem    CA cert, or NULL.
+ * @param[in]  pub_mem   Public key, or NULL.
+ * @param[in]  priv_mem  Private key, or NULL.
+ */
+static void
+tls_session_resume (gnutls_session_t session, const char *host, int port,
+                    const char *ca_mem, const char *pub_mem,
+                    const char *priv_mem)
+{
+  tls_session_entry_t *entry;
+  gchar *key, *digest;
+
+  digest = tls_credentials_digest (ca_mem, pub_mem, priv_mem);
+  key = g_strdup_printf ("%s:%d:%s", host, port, digest);
+  g_free (digest);
+  g_mutex_lock (&tls_session_cache_lock);
+  if (tls_session_cache == NULL)
+    tls_session_cache = g_hash_table_new (g_str_hash, g_str_equal);
+  entry = g_hash_table_lookup (tls_session_cache, key);
+  if (entry == NULL
+      && g_hash_table_size (tls_session_cache) < TLS_SESSION_CACHE_MAX)
+    {
+      entry = g_malloc0 (sizeof (*entry));
+      entry->key = key;
+      key = NULL;
+      g_hash_table_insert (tls_session_cache, entry->key, entry);
+    }
+  if (entry && entry->data.size
+      && gnutls_session_set_data (session, entry->data.data, entry->data.size))
+    g_debug ("%s: Failed to set session data for %s", __FUNCTION__,
+             entry->key);
+  g_mutex_unlock (&tls_session_cache_lock);
+  g_free (key);
+
+  if (entry == NULL)
+    return;
+  gnutls_session_set_ptr (session, entry);
+  gnutls_handshake_set_hook_function (session,
+                                      GNUTLS_HANDSHAKE_NEW_SESSION_TICKET,
+                                      GNUTLS_HOOK_POST, tls_session_ticket_hook);
+}
+
 /**
  * @brief Connect to the server using a given host, port and cert.
  *
+ * An earlier TLS session to the same host and port, with the same
+ * certificates and key, is resumed if the server allows it, which saves
+ * the full handshake.
+ *
  * @param[in]  session   Pointer to GNUTLS session.
  * @param[in]  host      Host to connect to.
  * @param[in]  port      Port to connect to.
@@ -353,17 +585,20 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
       return -1;
     }
 
-  /** @warning On success we are leaking the credentials. We can't free
-      them because the session only makes a shallow copy. */
+  /* The session only makes a shallow copy of the credentials.  They are
+     shared by all sessions with the same certificates, and the cache keeps
+     them for as long as the process runs. */
 
-  if (gvm_server_new_mem (GNUTLS_CLIENT, ca_mem, pub_mem, priv_mem, session,
-                          &credentials))
+  gcry_control (GCRYCTL_ENABLE_QUICK_RANDOM, 0);
+  if (gnutls_global_init ()
+      || gvm_server_credentials_get_mem (ca_mem, pub_mem, priv_mem,
+                                         &credentials))
     {
       g_warning ("Failed to create client TLS session.");
       return -1;
     }
-
-  if (ca_mem && pub_mem && priv_mem)
+  ret = server_new_gnutls_set (GNUTLS_CLIENT, NULL, session, &credentials);
+  if (ret == 0 && ca_mem && pub_mem && priv_mem)
     {
       set_cert_pub_mem (pub_mem);
       set_cert_priv_mem (priv_mem);
@@ -371,6 +606,12 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
       gnutls_certificate_set_retrieve_function (credentials,
                                                 client_cert_callback);
     }
+  gvm_server_credentials_unref (credentials);
+  if (ret)
+    {
+      g_warning ("Failed to create client TLS session.");
+      return -1;
+    }
 
   /* Create the port string. */
 
@@ -389,7 +630,6 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
       g_warning ("Failed to get server addresses for %s: %s", host,
                  gai_strerror (errno));
       gnutls_deinit (*session);
-      gnutls_certificate_free_credentials (credentials);
       return -1;
     }
   g_free (port_string);
@@ -409,7 +649,6 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
           g_warning ("Failed to create server socket");
           freeaddrinfo (addresses);
           gnutls_deinit (*session);
-          gnutls_certificate_free_credentials (credentials);
           return -1;
         }
 
@@ -429,12 +668,13 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
     {
       g_warning ("Failed to connect to server");
       gnutls_deinit (*session);
-      gnutls_certificate_free_credentials (credentials);
       return -1;
     }
 
   g_debug ("   Connected to server '%s' port %d.", host, port);
 
+  tls_session_resume (*session, host, port, ca_mem, pub_mem, priv_mem);
+
   /* Complete setup of server session. */
   ret = server_attach_internal (server_socket, session, host, port);
   if (ret)
@@ -443,7 +683,6 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
         {
           close (server_socket);
           gnutls_deinit (*session);
-          gnutls_certificate_free_credentials (credentials);
         }
       close (server_socket);
       return -1;
@@ -454,6 +693,11 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
       return -1;
     }
 
+  if (gnutls_session_is_resumed (*session))
+    g_debug ("   Resumed TLS session with server '%s' port %d.", host, port);
+  else if (gnutls_protocol_get_version (*session) != GNUTLS_TLS1_3)
+    tls_session_save (*session);
+
   return server_socket;
 }
 
@@ -591,73 +835,216 @@ gvm_server_attach (int socket, gnutls_session_t *session)
 }
 
 /**
- * @brief Send a string to the server.
+ * @brief Send data to the server.
  *
- * @param[in]  session  Pointer to GNUTLS session.
- * @param[in]  fmt      Format of string to send.
- * @param[in]  ap       Args for fmt.
+ * @param[in]  session  Pointer to GNUTLS session, or NULL to write to socket.
+ * @param[in]  socket   Socket, if session is NULL.
+ * @param[in]  iov      Buffers to send, in order.  Modified.
+ * @param[in]  iovcnt   Number of buffers.
  * @param[in]  quiet    Whether to log debug and info messages.  Useful for
  *                      hiding passwords.
  *
  * @return 0 on success, 1 if server closed connection, -1 on error.
  */
 static int
-gvm_server_vsendf_internal (gnutls_session_t *session, const char *fmt,
-                            va_list ap, int quiet)
+server_sendv_internal (gnutls_session_t *session, int socket,
+                       struct iovec *iov, int iovcnt, int quiet)
 {
-  char *sref, *string;
-  int rc = 0, left;
-
-  left = vasprintf (&string, fmt, ap);
-  if (left == -1)
-    string = NULL;
+  int rc = 0, index;
+  size_t total = 0;
+  gboolean corked = FALSE;
+
+  /* Formatting the data for the log is costly, so only do it if the debug
+   * messages would be logged. */
+  if (quiet == 0 && gvm_log_enabled (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG) == FALSE)
+    quiet = 1;
+
+  /* Gather small buffers into one TLS record instead of a record each.
+   * Larger data fills whole records anyway, and corking would copy it. */
+  for (index = 0; index < iovcnt; index++)
+    total += iov[index].iov_len;
+  if (session && iovcnt > 1 && total <= SEND_CORK_MAX)
+    {
+      gnutls_record_cork (*session);
+      corked = TRUE;
+    }
 
-  sref = string;
-  while (left > 0)
+  while (iovcnt > 0)
     {
       ssize_t count;
 
+      if (iov->iov_len == 0)
+        {
+          iov++;
+          iovcnt--;
+          continue;
+        }
+
       if (quiet == 0)
-        g_debug ("   send %d from %.*s[...]", left, left < 30 ? left : 30,
-                 string);
-      count = gnutls_record_send (*session, string, left);
-      if (count < 0)
+        g_debug ("   send %zu from %.*s[...]", iov->iov_len,
+                 iov->iov_len < 30 ? (int) iov->iov_len : 30,
+                 (char *) iov->iov_base);
+      if (session)
         {
-          if (count == GNUTLS_E_INTERRUPTED)
-            /* Interrupted, try write again. */
-            continue;
-          if (count == GNUTLS_E_REHANDSHAKE)
+          count = gnutls_record_send (*session, iov->iov_base, iov->iov_len);
+          if (count < 0)
             {
-              /* \todo Rehandshake. */
+              if (count == GNUTLS_E_INTERRUPTED)
+                /* Interrupted, try write again. */
+                continue;
+              if (count == GNUTLS_E_REHANDSHAKE)
+                {
+                  /* \todo Rehandshake. */
+                  if (quiet == 0)
+                    g_message ("   %s rehandshake", __FUNCTION__);
+                  continue;
+                }
+              g_warning ("Failed to write to server: %s",
+                         gnutls_strerror (count));
+              rc = -1;
+              goto out;
+            }
+          if (count == 0)
+            {
+              /* Server closed connection. */
               if (quiet == 0)
-                g_message ("   %s rehandshake", __FUNCTION__);
-              continue;
+                g_debug ("=  server closed");
+              rc = 1;
+              goto out;
             }
-          g_warning ("Failed to write to server: %s", gnutls_strerror (count));
-          rc = -1;
-          goto out;
         }
-      if (count == 0)
+      else
+        {
+          count = writev (socket, iov, MIN (iovcnt, IOV_MAX));
+          if (count < 0)
+            {
+              if (errno == EINTR || errno == EAGAIN)
+                continue;
+              g_warning ("Failed to write to server: %s", strerror (errno));
+              rc = -1;
+              goto out;
+            }
+        }
+
+      /* Drop what was written, which may span several buffers. */
+      while (count > 0)
         {
-          /* Server closed connection. */
+          size_t done = MIN ((size_t) count, iov->iov_len);
+
           if (quiet == 0)
-            g_debug ("=  server closed");
-          rc = 1;
-          goto out;
+            g_debug ("=> %.*s", (int) done, (char *) iov->iov_base);
+          iov->iov_base = (char *) iov->iov_base + done;
+          iov->iov_len -= done;
+          count -= done;
+          if (iov->iov_len == 0)
+            {
+              iov++;
+              iovcnt--;
+            }
         }
-      if (quiet == 0)
-        g_debug ("=> %.*s", (int) count, string);
-      string += count;
-      left -= count;
     }
-  if (quiet == 0)
-    g_debug ("=> done");
 
 out:
-  g_free (sref);
+  if (corked)
+    {
+      ssize_t count;
+
+      /* Flush what is still corked. */
+      do
+        count = gnutls_record_uncork (*session, GNUTLS_RECORD_WAIT);
+      while (count == GNUTLS_E_INTERRUPTED || count == GNUTLS_E_AGAIN);
+      if (rc == 0 && count < 0)
+        {
+          g_warning ("Failed to write to server: %s", gnutls_strerror (count));
+          rc = -1;
+        }
+    }
+  if (rc == 0 && quiet == 0)
+    g_debug ("=> done");
+  return rc;
+}
+
+/**
+ * @brief Send a string to the server.
+ *
+ * @param[in]  session  Pointer to GNUTLS session, or NULL to write to socket.
+ * @param[in]  socket   Socket, if session is NULL.
+ * @param[in]  string   String to send.
+ * @param[in]  length   Length of string.
+ * @param[in]  quiet    Whether to log debug and info messages.  Useful for
+ *                      hiding passwords.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+server_send_internal (gnutls_session_t *session, int socket, const char *string,
+                      size_t length, int quiet)
+{
+  struct iovec iov;
+
+  iov.iov_base = (void *) string;
+  iov.iov_len = length;
+  return server_sendv_internal (session, socket, &iov, 1, quiet);
+}
+
+/**
+ * @brief Format and send a string to the server.
+ *
+ * Short messages are formatted on the stack, so that sending them does not
+ * allocate.
+ *
+ * @param[in]  session  Pointer to GNUTLS session, or NULL to write to socket.
+ * @param[in]  socket   Socket, if session is NULL.
+ * @param[in]  fmt      Format of string to send.
+ * @param[in]  ap       Args for fmt.
+ * @param[in]  quiet    Whether to log debug and info messages.  Useful for
+ *                      hiding passwords.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+server_vsendf_internal (gnutls_session_t *session, int socket, const char *fmt,
+                        va_list ap, int quiet)
+{
+  char buffer[SEND_BUFFER_SIZE];
+  char *string;
+  va_list aq;
+  int rc, length;
+
+  va_copy (aq, ap);
+  length = vsnprintf (buffer, sizeof (buffer), fmt, aq);
+  va_end (aq);
+  if (length < 0)
+    return 0;
+  if (length < (int) sizeof (buffer))
+    return server_send_internal (session, socket, buffer, length, quiet);
+
+  length = vasprintf (&string, fmt, ap);
+  if (length == -1)
+    return 0;
+  rc = server_send_internal (session, socket, string, length, quiet);
+  g_free (string);
   return rc;
 }
 
+/**
+ * @brief Send a string to the server.
+ *
+ * @param[in]  session  Pointer to GNUTLS session.
+ * @param[in]  fmt      Format of string to send.
+ * @param[in]  ap       Args for fmt.
+ * @param[in]  quiet    Whether to log debug and info messages.  Useful for
+ *                      hiding passwords.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+gvm_server_vsendf_internal (gnutls_session_t *session, const char *fmt,
+                            va_list ap, int quiet)
+{
+  return server_vsendf_internal (session, 0, fmt, ap, quiet);
+}
+
 /**
  * @brief Send a string to the server.
  *
@@ -672,41 +1059,128 @@ out:
 static int
 unix_vsendf_internal (int socket, const char *fmt, va_list ap, int quiet)
 {
-  char *string_start, *string;
-  int rc = 0, left;
+  return server_vsendf_internal (NULL, socket, fmt, ap, quiet);
+}
 
-  left = vasprintf (&string, fmt, ap);
-  if (left == -1)
-    string = NULL;
+/**
+ * @brief Send buffers to the server, without copying them into one string.
+ *
+ * @param[in]  session  Pointer to GNUTLS session, or NULL to write to socket.
+ * @param[in]  socket   Socket, if session is NULL.
+ * @param[in]  iov      Buffers to send, in order.
+ * @param[in]  iovcnt   Number of buffers.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+server_sendv (gnutls_session_t *session, int socket, const struct iovec *iov,
+              int iovcnt)
+{
+  struct iovec stack[16], *copy;
+  int rc;
+
+  if (iovcnt <= 0)
+    return 0;
+
+  /* The send loop consumes the buffers as it goes. */
+  copy = iovcnt <= (int) G_N_ELEMENTS (stack) ? stack
+                                              : g_new (struct iovec, iovcnt);
+  memcpy (copy, iov, iovcnt * sizeof (*iov));
+  rc = server_sendv_internal (session, socket, copy, iovcnt, 0);
+  if (copy != stack)
+    g_free (copy);
+  return rc;
+}
+
+/**
+ * @brief Send buffers to the server.
+ *
+ * @param[in]  session  Pointer to GNUTLS session.
+ * @param[in]  iov      Buffers to send, in order.
+ * @param[in]  iovcnt   Number of buffers.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+int
+gvm_server_sendv (gnutls_session_t *session, const struct iovec *iov,
+                  int iovcnt)
+{
+  return server_sendv (session, 0, iov, iovcnt);
+}
+
+/**
+ * @brief Send buffers through a socket.
+ *
+ * @param[in]  socket   Socket.
+ * @param[in]  iov      Buffers to send, in order.
+ * @param[in]  iovcnt   Number of buffers.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+int
+gvm_socket_sendv (int socket, const struct iovec *iov, int iovcnt)
+{
+  return server_sendv (NULL, socket, iov, iovcnt);
+}
+
+/**
+ * @brief Send buffers to the connection.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  iov         Buffers to send, in order.
+ * @param[in]  iovcnt      Number of buffers.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+int
+gvm_connection_sendv (gvm_connection_t *connection, const struct iovec *iov,
+                      int iovcnt)
+{
+  if (connection->tls)
+    return server_sendv (&connection->session, 0, iov, iovcnt);
+  return server_sendv (NULL, connection->socket, iov, iovcnt);
+}
+
+/**
+ * @brief Send the contents of a file to the connection.
+ *
+ * The file is sent in chunks from its current offset up to its end, so that
+ * large payloads are never held in memory whole.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  fd          File descriptor of the file.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+int
+gvm_connection_send_file (gvm_connection_t *connection, int fd)
+{
+  gnutls_session_t *session;
+  char *buffer;
+  int rc = 0;
 
-  string_start = string;
-  while (left > 0)
+  session = connection->tls ? &connection->session : NULL;
+  buffer = g_malloc (SEND_FILE_CHUNK_SIZE);
+  while (rc == 0)
     {
       ssize_t count;
 
-      if (quiet == 0)
-        g_debug ("   send %d from %.*s[...]", left, left < 30 ? left : 30,
-                 string);
-      count = write (socket, string, left);
+      count = read (fd, buffer, SEND_FILE_CHUNK_SIZE);
       if (count < 0)
         {
-          if (errno == EINTR || errno == EAGAIN)
+          if (errno == EINTR)
             continue;
-          g_warning ("Failed to write to server: %s", strerror (errno));
+          g_warning ("%s: Failed to read file: %s", __FUNCTION__,
+                     strerror (errno));
           rc = -1;
-          goto out;
+          break;
         }
-      if (quiet == 0)
-        g_debug ("=> %.*s", (int) count, string);
-
-      string += count;
-      left -= count;
+      if (count == 0)
+        break;
+      rc = server_send_internal (session, connection->socket, buffer, count,
+                                 1);
     }
-  if (quiet == 0)
-    g_debug ("=> done");
-
-out:
-  g_free (string_start);
+  g_free (buffer);
   return rc;
 }
 
@@ -907,7 +1381,7 @@ gvm_server_sendf_xml (gnutls_session_t *session, const char *format, ...)
 
   va_start (ap, format);
   msg = g_markup_vprintf_escaped (format, ap);
-  rc = gvm_server_sendf (session, "%s", msg);
+  rc = server_send_internal (session, 0, msg, strlen (msg), 0);
   g_free (msg);
   va_end (ap);
   return rc;
@@ -932,7 +1406,8 @@ gvm_connection_sendf_xml (gvm_connection_t *connection, const char *format, ...)
 
   va_start (ap, format);
   msg = g_markup_vprintf_escaped (format, ap);
-  rc = gvm_connection_sendf (connection, "%s", msg);
+  rc = server_send_internal (connection->tls ? &connection->session : NULL,
+                             connection->socket, msg, strlen (msg), 0);
   g_free (msg);
   va_end (ap);
   return rc;
@@ -959,7 +1434,7 @@ gvm_server_sendf_xml_quiet (gnutls_session_t *session, const char *format, ...)
 
   va_start (ap, format);
   msg = g_markup_vprintf_escaped (format, ap);
-  rc = gvm_server_sendf_quiet (session, "%s", msg);
+  rc = server_send_internal (session, 0, msg, strlen (msg), 1);
   g_free (msg);
   va_end (ap);
   return rc;
@@ -987,7 +1462,8 @@ gvm_connection_sendf_xml_quiet (gvm_connection_t *connection,
 
   va_start (ap, format);
   msg = g_markup_vprintf_escaped (format, ap);
-  rc = gvm_connection_sendf_quiet (connection, "%s", msg);
+  rc = server_send_internal (connection->tls ? &connection->session : NULL,
+                             connection->socket, msg, strlen (msg), 1);
   g_free (msg);
   va_end (ap);
   return rc;
@@ -1073,41 +1549,32 @@ server_new_gnutls_set (unsigned int end_type, const char *priority,
 }
 
 /**
- * @brief Make a session for connecting to a server.
+ * @brief Load certificate and key files into credentials.
  *
- * @param[in]   end_type            Connection end type (GNUTLS_SERVER or
- *                                  GNUTLS_CLIENT).
- * @param[in]   priority            Custom priority string or NULL.
- * @param[in]   ca_cert_file        Certificate authority file.
- * @param[in]   cert_file           Certificate file.
- * @param[in]   key_file            Key file.
- * @param[out]  server_session      The session with the server.
- * @param[out]  server_credentials  Server credentials.
+ * @param[in]  credentials   Credentials.
+ * @param[in]  ca_cert_file  Certificate authority file, or NULL.
+ * @param[in]  cert_file     Certificate file, or NULL.
+ * @param[in]  key_file      Key file, or NULL.
  *
  * @return 0 on success, -1 on error.
  */
 static int
-server_new_internal (unsigned int end_type, const char *priority,
-                     const gchar *ca_cert_file, const gchar *cert_file,
-                     const gchar *key_file, gnutls_session_t *server_session,
-                     gnutls_certificate_credentials_t *server_credentials)
+server_credentials_set_file (gnutls_certificate_credentials_t credentials,
+                             const gchar *ca_cert_file, const gchar *cert_file,
+                             const gchar *key_file)
 {
-  if (server_new_gnutls_init (server_credentials))
-    return -1;
-
   if (cert_file && key_file)
     {
       int ret;
 
-      ret = gnutls_certificate_set_x509_key_file (
-        *server_credentials, cert_file, key_file, GNUTLS_X509_FMT_PEM);
+      ret = gnutls_certificate_set_x509_key_file (credentials, cert_file,
+                                                  key_file, GNUTLS_X509_FMT_PEM);
       if (ret < 0)
         {
           g_warning ("%s: failed to set credentials key file: %s\n",
                      __FUNCTION__, gnutls_strerror (ret));
           g_warning ("%s:   cert file: %s\n", __FUNCTION__, cert_file);
           g_warning ("%s:   key file : %s\n", __FUNCTION__, key_file);
-          gnutls_certificate_free_credentials (*server_credentials);
           return -1;
         }
     }
@@ -1116,17 +1583,321 @@ server_new_internal (unsigned int end_type, const char *priority,
     {
       int ret;
 
-      ret = gnutls_certificate_set_x509_trust_file (
-        *server_credentials, ca_cert_file, GNUTLS_X509_FMT_PEM);
+      ret = gnutls_certificate_set_x509_trust_file (credentials, ca_cert_file,
+                                                    GNUTLS_X509_FMT_PEM);
       if (ret < 0)
         {
           g_warning ("%s: failed to set credentials trust file: %s\n",
                      __FUNCTION__, gnutls_strerror (ret));
           g_warning ("%s: trust file: %s\n", __FUNCTION__, ca_cert_file);
-          gnutls_certificate_free_credentials (*server_credentials);
           return -1;
         }
     }
+  return 0;
+}
+
+/**
+ * @brief Load certificates and key stored in memory into credentials.
+ *
+ * @param[in]  credentials  Credentials.
+ * @param[in]  ca_cert      Certificate authority public key, or NULL.
+ * @param[in]  pub_key      Public key, or NULL.
+ * @param[in]  priv_key     Private key, or NULL.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+server_credentials_set_mem (gnutls_certificate_credentials_t credentials,
+                            const char *ca_cert, const char *pub_key,
+                            const char *priv_key)
+{
+  if (pub_key && priv_key)
+    {
+      int ret;
+      gnutls_datum_t pub, priv;
+
+      pub.data = (void *) pub_key;
+      pub.size = strlen (pub_key);
+      priv.data = (void *) priv_key;
+      priv.size = strlen (priv_key);
+
+      ret = gnutls_certificate_set_x509_key_mem (credentials, &pub, &priv,
+                                                 GNUTLS_X509_FMT_PEM);
+      if (ret < 0)
+        {
+          g_warning ("%s: %s\n", __FUNCTION__, gnutls_strerror (ret));
+          return -1;
+        }
+    }
+
+  if (ca_cert)
+    {
+      int ret;
+      gnutls_datum_t data;
+
+      data.data = (void *) ca_cert;
+      data.size = strlen (ca_cert);
+      ret = gnutls_certificate_set_x509_trust_mem (credentials, &data,
+                                                   GNUTLS_X509_FMT_PEM);
+      if (ret < 0)
+        {
+          g_warning ("%s: %s\n", __FUNCTION__, gnutls_strerror (ret));
+          return -1;
+        }
+    }
+  return 0;
+}
+
+/**
+ * @brief Get a key for a file in a cache, which changes with the file.
+ *
+ * @param[in]  string  String to append the key to.
+ * @param[in]  file    File, or NULL.
+ *
+ * @return 0 on success, -1 if the file cannot be accessed.
+ */
+static int
+server_cache_file_key (GString *string, const gchar *file)
+{
+  struct stat st;
+
+  if (file == NULL)
+    {
+      g_string_append (string, "|");
+      return 0;
+    }
+  if (stat (file, &st))
+    return -1;
+  g_string_append_printf (string, "|%s:%lld:%lld.%09ld", file,
+                          (long long) st.st_size, (long long) st.st_mtime,
+                          (long) st.st_mtim.tv_nsec);
+  return 0;
+}
+
+/**
+ * @brief Get credentials from the cache, loading them on a miss.
+ *
+ * Must be called locked.
+ *
+ * @param[in]  key           Key of the credentials.
+ * @param[in]  files         Names of the files, if from files.
+ * @param[in]  ca_cert_file  Certificate authority file, if from files.
+ * @param[in]  cert_file     Certificate file, if from files.
+ * @param[in]  key_file      Key file, if from files.
+ * @param[in]  mem           Whether to load from memory.
+ * @param[in]  ca_cert       Certificate authority public key, if from memory.
+ * @param[in]  pub_key       Public key, if from memory.
+ * @param[in]  priv_key      Private key, if from memory.
+ *
+ * @return Credentials with a new reference, NULL on error.
+ */
+static gnutls_certificate_credentials_t
+tls_credentials_cache_get (const gchar *key, const gchar *files,
+                           const gchar *ca_cert_file,
+                           const gchar *cert_file, const gchar *key_file,
+                           gboolean mem, const char *ca_cert,
+                           const char *pub_key, const char *priv_key)
+{
+  tls_credentials_entry_t *entry;
+  gnutls_certificate_credentials_t credentials;
+
+  if (tls_credentials_cache.keys == NULL)
+    {
+      tls_credentials_cache.keys = g_hash_table_new (g_str_hash, g_str_equal);
+      tls_credentials_cache.credentials = g_hash_table_new (NULL, NULL);
+    }
+
+  entry = g_hash_table_lookup (tls_credentials_cache.keys, key);
+  if (entry)
+    {
+      entry->refs++;
+      return entry->credentials;
+    }
+
+  if (server_new_gnutls_init (&credentials))
+    return NULL;
+  if (mem ? server_credentials_set_mem (credentials, ca_cert, pub_key, priv_key)
+          : server_credentials_set_file (credentials, ca_cert_file, cert_file,
+                                         key_file))
+    {
+      gnutls_certificate_free_credentials (credentials);
+      return NULL;
+    }
+
+  entry = g_malloc (sizeof (*entry));
+  entry->key = g_strdup (key);
+  entry->files = g_strdup (files);
+  entry->credentials = credentials;
+  /* One for the cache and one for the caller. */
+  entry->refs = 2;
+  g_hash_table_insert (tls_credentials_cache.keys, entry->key, entry);
+  g_hash_table_insert (tls_credentials_cache.credentials, credentials, entry);
+  return credentials;
+}
+
+/**
+ * @brief Drop a reference to cached credentials.  Must be called locked.
+ *
+ * @param[in]  entry  Cache entry.
+ */
+static void
+tls_credentials_entry_unref (tls_credentials_entry_t *entry)
+{
+  if (--entry->refs)
+    return;
+  g_hash_table_remove (tls_credentials_cache.credentials, entry->credentials);
+  gnutls_certificate_free_credentials (entry->credentials);
+  g_free (entry->key);
+  g_free (entry->files);
+  g_free (entry);
+}
+
+/**
+ * @brief Get shared credentials loaded from certificate and key files.
+ *
+ * The files are parsed once per process, until they change.  Release the
+ * credentials with gvm_server_credentials_unref, never free them directly.
+ *
+ * @param[in]   ca_cert_file  Certificate authority file, or NULL.
+ * @param[in]   cert_file     Certificate file, or NULL.
+ * @param[in]   key_file      Key file, or NULL.
+ * @param[out]  credentials   Credentials.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_server_credentials_get_file (const gchar *ca_cert_file,
+                                 const gchar *cert_file, const gchar *key_file,
+                                 gnutls_certificate_credentials_t *credentials)
+{
+  GString *key;
+  gchar *files;
+
+  key = g_string_new ("file");
+  if (server_cache_file_key (key, ca_cert_file)
+      || server_cache_file_key (key, cert_file)
+      || server_cache_file_key (key, key_file))
+    {
+      g_warning ("%s: failed to access credentials files", __FUNCTION__);
+      g_string_free (key, TRUE);
+      return -1;
+    }
+
+  files = g_strdup_printf ("%s|%s|%s", ca_cert_file ? ca_cert_file : "",
+                           cert_file ? cert_file : "",
+                           key_file ? key_file : "");
+
+  g_mutex_lock (&tls_credentials_cache_lock);
+  if (tls_credentials_cache.keys)
+    {
+      GHashTableIter iter;
+      tls_credentials_entry_t *entry;
+
+      /* Let go of the credentials of earlier versions of the files. */
+      g_hash_table_iter_init (&iter, tls_credentials_cache.keys);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+        if (entry->files && strcmp (entry->files, files) == 0
+            && strcmp (entry->key, key->str))
+          {
+            g_hash_table_iter_remove (&iter);
+            tls_credentials_entry_unref (entry);
+          }
+    }
+  *credentials =
+    tls_credentials_cache_get (key->str, files, ca_cert_file, cert_file,
+                               key_file, FALSE, NULL, NULL, NULL);
+  g_mutex_unlock (&tls_credentials_cache_lock);
+  g_string_free (key, TRUE);
+  g_free (files);
+  return *credentials ? 0 : -1;
+}
+
+/**
+ * @brief Get shared credentials loaded from certificates and key in memory.
+ *
+ * Identical certificates and key are parsed once per process.  The cache
+ * only keeps a digest of them.  Release the credentials with
+ * gvm_server_credentials_unref, never free them directly.
+ *
+ * @param[in]   ca_cert      Certificate authority public key, or NULL.
+ * @param[in]   pub_key      Public key, or NULL.
+ * @param[in]   priv_key     Private key, or NULL.
+ * @param[out]  credentials  Credentials.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_server_credentials_get_mem (const char *ca_cert, const char *pub_key,
+                                const char *priv_key,
+                                gnutls_certificate_credentials_t *credentials)
+{
+  gchar *digest, *key;
+
+  digest = tls_credentials_digest (ca_cert, pub_key, priv_key);
+  key = g_strdup_printf ("mem|%s", digest);
+  g_free (digest);
+
+  g_mutex_lock (&tls_credentials_cache_lock);
+  *credentials = tls_credentials_cache_get (key, NULL, NULL, NULL, NULL, TRUE,
+                                            ca_cert, pub_key, priv_key);
+  g_mutex_unlock (&tls_credentials_cache_lock);
+  g_free (key);
+  return *credentials ? 0 : -1;
+}
+
+/**
+ * @brief Release credentials from gvm_server_credentials_get_*.
+ *
+ * @param[in]  credentials  Credentials.  Credentials that are not from the
+ *                          cache are freed.
+ */
+void
+gvm_server_credentials_unref (gnutls_certificate_credentials_t credentials)
+{
+  tls_credentials_entry_t *entry = NULL;
+
+  if (credentials == NULL)
+    return;
+  g_mutex_lock (&tls_credentials_cache_lock);
+  if (tls_credentials_cache.credentials)
+    entry = g_hash_table_lookup (tls_credentials_cache.credentials,
+                                 credentials);
+  if (entry)
+    tls_credentials_entry_unref (entry);
+  g_mutex_unlock (&tls_credentials_cache_lock);
+  if (entry == NULL)
+    gnutls_certificate_free_credentials (credentials);
+}
+
+/**
+ * @brief Make a session for connecting to a server.
+ *
+ * @param[in]   end_type            Connection end type (GNUTLS_SERVER or
+ *                                  GNUTLS_CLIENT).
+ * @param[in]   priority            Custom priority string or NULL.
+ * @param[in]   ca_cert_file        Certificate authority file.
+ * @param[in]   cert_file           Certificate file.
+ * @param[in]   key_file            Key file.
+ * @param[out]  server_session      The session with the server.
+ * @param[out]  server_credentials  Server credentials.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+server_new_internal (unsigned int end_type, const char *priority,
+                     const gchar *ca_cert_file, const gchar *cert_file,
+                     const gchar *key_file, gnutls_session_t *server_session,
+                     gnutls_certificate_credentials_t *server_credentials)
+{
+  if (server_new_gnutls_init (server_credentials))
+    return -1;
+
+  if (server_credentials_set_file (*server_credentials, ca_cert_file,
+                                   cert_file, key_file))
+    {
+      gnutls_certificate_free_credentials (*server_credentials);
+      return -1;
+    }
 
   if (server_new_gnutls_set (end_type, priority, server_session,
                              server_credentials))
@@ -1182,40 +1953,10 @@ gvm_server_new_mem (unsigned int end_type, const char *ca_cert,
   if (server_new_gnutls_init (credentials))
     return -1;
 
-  if (pub_key && priv_key)
+  if (server_credentials_set_mem (*credentials, ca_cert, pub_key, priv_key))
     {
-      int ret;
-      gnutls_datum_t pub, priv;
-
-      pub.data = (void *) pub_key;
-      pub.size = strlen (pub_key);
-      priv.data = (void *) priv_key;
-      priv.size = strlen (priv_key);
-
-      ret = gnutls_certificate_set_x509_key_mem (*credentials, &pub, &priv,
-                                                 GNUTLS_X509_FMT_PEM);
-      if (ret < 0)
-        {
-          g_warning ("%s: %s\n", __FUNCTION__, gnutls_strerror (ret));
-          return -1;
-        }
-    }
-
-  if (ca_cert)
-    {
-      int ret;
-      gnutls_datum_t data;
-
-      data.data = (void *) ca_cert;
-      data.size = strlen (ca_cert);
-      ret = gnutls_certificate_set_x509_trust_mem (*credentials, &data,
-                                                   GNUTLS_X509_FMT_PEM);
-      if (ret < 0)
-        {
-          g_warning ("%s: %s\n", __FUNCTION__, gnutls_strerror (ret));
-          gnutls_certificate_free_credentials (*credentials);
-          return -1;
-        }
+      gnutls_certificate_free_credentials (*credentials);
+      return -1;
     }
 
   if (server_new_gnutls_set (end_type, NULL, session, credentials))
@@ -1241,19 +1982,56 @@ set_gnutls_dhparams (gnutls_certificate_credentials_t creds,
 {
   int ret;
   gnutls_datum_t data;
+  gnutls_dh_params_t params;
+  GString *key;
 
   if (!creds || !dhparams_file)
     return -1;
 
-  if (load_gnutls_file (dhparams_file, &data))
-    return -1;
-  gnutls_dh_params_t params = g_malloc0 (sizeof (gnutls_dh_params_t));
-  ret = gnutls_dh_params_import_pkcs3 (params, &data, GNUTLS_X509_FMT_PEM);
-  unload_gnutls_file (&data);
-  if (ret)
-    return -1;
-  else
-    gnutls_certificate_set_dh_params (creds, params);
+  /* The parameters are imported once per version of the file. */
+  key = g_string_new ("");
+  if (server_cache_file_key (key, dhparams_file))
+    {
+      g_string_free (key, TRUE);
+      return -1;
+    }
+
+  g_mutex_lock (&dh_params_cache_lock);
+  if (dh_params_cache == NULL)
+    dh_params_cache = g_hash_table_new (g_str_hash, g_str_equal);
+  params = g_hash_table_lookup (dh_params_cache, key->str);
+  if (params == NULL)
+    {
+      if (load_gnutls_file (dhparams_file, &data))
+        {
+          g_mutex_unlock (&dh_params_cache_lock);
+          g_string_free (key, TRUE);
+          return -1;
+        }
+      ret = gnutls_dh_params_init (&params);
+      if (ret == 0)
+        {
+          ret =
+            gnutls_dh_params_import_pkcs3 (params, &data, GNUTLS_X509_FMT_PEM);
+          if (ret)
+            gnutls_dh_params_deinit (params);
+        }
+      unload_gnutls_file (&data);
+      if (ret)
+        {
+          g_mutex_unlock (&dh_params_cache_lock);
+          g_string_free (key, TRUE);
+          return -1;
+        }
+      g_hash_table_insert (dh_params_cache, g_string_free (key, FALSE),
+                           params);
+      key = NULL;
+    }
+  g_mutex_unlock (&dh_params_cache_lock);
+  if (key)
+    g_string_free (key, TRUE);
+
+  gnutls_certificate_set_dh_params (creds, params);
   return 0;
 }
 
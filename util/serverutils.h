@@ -32,6 +32,7 @@
 #include <gnutls/gnutls.h> /* for gnutls_session_t, gnutls_certificate_cred... */
 #include <stdarg.h>        /* for va_list */
 #include <sys/param.h>
+#include <sys/uio.h> /* for iovec */
 #ifdef __FreeBSD__
 #include <netinet/in.h>
 #endif
@@ -104,6 +105,18 @@ gvm_connection_sendf_xml_quiet (gvm_connection_t *, const char *, ...);
 int
 gvm_connection_sendf (gvm_connection_t *, const char *, ...);
 
+int
+gvm_server_sendv (gnutls_session_t *, const struct iovec *, int);
+
+int
+gvm_socket_sendv (int, const struct iovec *, int);
+
+int
+gvm_connection_sendv (gvm_connection_t *, const struct iovec *, int);
+
+int
+gvm_connection_send_file (gvm_connection_t *, int);
+
 int
 gvm_server_new (unsigned int, gchar *, gchar *, gchar *, gnutls_session_t *,
                 gnutls_certificate_credentials_t *);
@@ -112,6 +125,17 @@ int
 gvm_server_new_mem (unsigned int, const char *, const char *, const char *,
                     gnutls_session_t *, gnutls_certificate_credentials_t *);
 
+int
+gvm_server_credentials_get_file (const gchar *, const gchar *, const gchar *,
+                                 gnutls_certificate_credentials_t *);
+
+int
+gvm_server_credentials_get_mem (const char *, const char *, const char *,
+                                gnutls_certificate_credentials_t *);
+
+void
+gvm_server_credentials_unref (gnutls_certificate_credentials_t);
+
 int
 gvm_server_free (int, gnutls_session_t, gnutls_certificate_credentials_t);
 
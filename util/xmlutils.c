@@ -28,14 +28,19 @@
 
 #include "xmlutils.h"
 
+#include "../base/logging.h" /* for gvm_log_enabled */
+
 #include <assert.h>      /* for assert */
 #include <errno.h>       /* for errno, EAGAIN, EINTR */
-#include <fcntl.h>       /* for fcntl, F_SETFL, O_NONBLOCK */
+#include <fcntl.h>       /* for fcntl, open, F_SETFL, O_NONBLOCK */
 #include <glib.h>        /* for g_free, GSList, g_markup_parse_context_free */
 #include <glib/gtypes.h> /* for GPOINTER_TO_INT, GINT_TO_POINTER, gsize */
+#include <poll.h>        /* for poll, POLLIN */
 #include <string.h>      /* for strcmp, strerror, strlen */
+#include <sys/mman.h>    /* for mmap, munmap, madvise */
+#include <sys/stat.h>    /* for fstat, S_ISREG */
 #include <time.h>        /* for time, time_t */
-#include <unistd.h>      /* for ssize_t */
+#include <unistd.h>      /* for ssize_t, read, close */
 
 #undef G_LOG_DOMAIN
 /**
@@ -44,10 +49,273 @@
 #define G_LOG_DOMAIN "lib   xml"
 
 /**
- * @brief Size of the buffer for reading from the manager.
+ * @brief Max size of the buffer for reading from the manager.
  */
 #define BUFFER_SIZE 1048576
 
+/**
+ * @brief Size of the buffer for reading from the manager, at the start of a
+ * @brief read.
+ *
+ * The buffer doubles up to BUFFER_SIZE whenever a read fills it.
+ */
+#define BUFFER_INITIAL_SIZE 16384
+
+/**
+ * @brief Size of the first block of an entity arena.
+ */
+#define ENTITY_ARENA_BLOCK_SIZE 4096
+
+/**
+ * @brief Max size of the blocks an entity arena grows by.
+ */
+#define ENTITY_ARENA_MAX_BLOCK_SIZE 1048576
+
+/**
+ * @brief Number of children past which the children of an entity are indexed
+ * @brief by name.
+ */
+#define ENTITY_CHILD_INDEX_THRESHOLD 16
+
+/**
+ * @brief Link of the children list of an entity, as seen by its index.
+ */
+typedef struct
+{
+  entities_t node; ///< Link.
+  entity_t child;  ///< Child the link held.
+} entity_child_link_t;
+
+/**
+ * @brief Index of the children of an entity, by name.
+ *
+ * The index is checked against the children list on every lookup, so that
+ * the list can be changed in any way: children appended since are added to
+ * it, any other change rebuilds it.
+ */
+struct entity_child_index_s
+{
+  GArray *links;     ///< Links of the list indexed, as entity_child_link_t.
+  GHashTable *names; ///< Children, as GPtrArrays, by name.
+};
+
+/**
+ * @brief Free an index of the children of an entity.
+ *
+ * @param[in]  index  Index.
+ */
+static void
+entity_child_index_free (entity_child_index_t index)
+{
+  g_array_free (index->links, TRUE);
+  g_hash_table_destroy (index->names);
+  g_free (index);
+}
+
+/**
+ * @brief Block of memory of an entity arena.
+ */
+typedef struct entity_arena_block
+{
+  struct entity_arena_block *next; ///< Previous block.
+  gsize size;                      ///< Size of data.
+  gsize used;                      ///< Bytes of data allocated.
+  gsize padding;                   ///< Keeps data 16-byte aligned.
+} entity_arena_block_t;
+
+/**
+ * @brief Region that all the nodes and strings of an entity tree come from.
+ */
+struct entity_arena_s
+{
+  entity_arena_block_t *blocks; ///< Blocks, the current one first.
+  gsize next_size;              ///< Size of the next block.
+  gchar *last;                  ///< Last allocation, for growing it in place.
+  entity_t root;                ///< Root of the tree, which owns the arena.
+  GSList *indexes;              ///< Child indexes of the entities.
+};
+
+/**
+ * @brief Get the data of an arena block.
+ *
+ * @param[in]  block  Block.
+ *
+ * @return Start of the data.
+ */
+static gchar *
+entity_arena_block_data (entity_arena_block_t *block)
+{
+  return (gchar *) (block + 1);
+}
+
+/**
+ * @brief Create an entity arena.
+ *
+ * @return A new arena, to free with entity_arena_free.
+ */
+static entity_arena_t
+entity_arena_new (void)
+{
+  entity_arena_t arena = g_malloc0 (sizeof (*arena));
+
+  arena->next_size = ENTITY_ARENA_BLOCK_SIZE;
+  return arena;
+}
+
+/**
+ * @brief Free an entity arena, with everything allocated from it.
+ *
+ * @param[in]  arena  Arena.
+ */
+static void
+entity_arena_free (entity_arena_t arena)
+{
+  while (arena->blocks)
+    {
+      entity_arena_block_t *next = arena->blocks->next;
+
+      g_free (arena->blocks);
+      arena->blocks = next;
+    }
+  g_slist_free_full (arena->indexes, (GDestroyNotify) entity_child_index_free);
+  g_free (arena);
+}
+
+/**
+ * @brief Allocate memory from an entity arena.
+ *
+ * @param[in]  arena  Arena.
+ * @param[in]  size   Number of bytes.
+ *
+ * @return Memory, aligned for any type, freed with the arena.
+ */
+static gpointer
+entity_arena_alloc (entity_arena_t arena, gsize size)
+{
+  entity_arena_block_t *block = arena->blocks;
+
+  size = (size + 15) & ~(gsize) 15;
+  if (block == NULL || block->size - block->used < size)
+    {
+      gsize block_size = MAX (size, arena->next_size);
+
+      block = g_malloc (sizeof (*block) + block_size);
+      block->size = block_size;
+      block->used = 0;
+      block->next = arena->blocks;
+      arena->blocks = block;
+      if (arena->next_size < ENTITY_ARENA_MAX_BLOCK_SIZE)
+        arena->next_size *= 2;
+    }
+  arena->last = entity_arena_block_data (block) + block->used;
+  block->used += size;
+  return arena->last;
+}
+
+/**
+ * @brief Copy a string into an entity arena.
+ *
+ * @param[in]  arena  Arena.
+ * @param[in]  str    String.
+ * @param[in]  len    Length of str.
+ *
+ * @return Copy of the string.
+ */
+static gchar *
+entity_arena_strndup (entity_arena_t arena, const gchar *str, gsize len)
+{
+  gchar *copy = entity_arena_alloc (arena, len + 1);
+
+  memcpy (copy, str, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+/**
+ * @brief Append to a string allocated from an entity arena.
+ *
+ * The string grows in place when it is the last allocation and its block has
+ * room, as is the case for the text of the element being parsed.
+ *
+ * @param[in]  arena  Arena.
+ * @param[in]  str    String, from the arena.
+ * @param[in]  more   String to append.
+ * @param[in]  len    Length of more.
+ *
+ * @return The appended string, str or a new copy.
+ */
+static gchar *
+entity_arena_strappend (entity_arena_t arena, gchar *str, const gchar *more,
+                        gsize len)
+{
+  entity_arena_block_t *block = arena->blocks;
+  gsize old_len = strlen (str);
+  gchar *result;
+
+  if (str == arena->last)
+    {
+      gsize offset = str - entity_arena_block_data (block);
+      gsize size = (old_len + len + 1 + 15) & ~(gsize) 15;
+
+      if (offset + size <= block->size)
+        {
+          block->used = offset + size;
+          memcpy (str + old_len, more, len);
+          str[old_len + len] = '\0';
+          return str;
+        }
+    }
+
+  result = entity_arena_alloc (arena, old_len + len + 1);
+  memcpy (result, str, old_len);
+  memcpy (result + old_len, more, len);
+  result[old_len + len] = '\0';
+  return result;
+}
+
+/**
+ * @brief Create an entity in an arena.
+ *
+ * @param[in]  arena  Arena.
+ * @param[in]  name   Name of the entity.
+ * @param[in]  names   List of attribute names.
+ * @param[in]  values  List of attribute values.
+ *
+ * @return The new entity, freed with the arena.
+ */
+static entity_t
+make_entity_arena (entity_arena_t arena, const char *name, const gchar **names,
+                   const gchar **values)
+{
+  entity_t entity;
+  int count = 0, i;
+
+  entity = entity_arena_alloc (arena, sizeof (*entity));
+  memset (entity, 0, sizeof (*entity));
+  entity->arena = arena;
+  entity->name = entity_arena_strndup (arena, name, strlen (name));
+
+  while (names[count] && values[count])
+    count++;
+  if (count)
+    {
+      entity->attribute_pairs =
+        entity_arena_alloc (arena, (2 * count + 1) * sizeof (gchar *));
+      for (i = 0; i < count; i++)
+        {
+          entity->attribute_pairs[2 * i] =
+            entity_arena_strndup (arena, names[i], strlen (names[i]));
+          entity->attribute_pairs[2 * i + 1] =
+            entity_arena_strndup (arena, values[i], strlen (values[i]));
+        }
+      entity->attribute_pairs[2 * count] = NULL;
+    }
+
+  /* Last, so that the text can grow in place. */
+  entity->text = entity_arena_strndup (arena, "", 0);
+  return entity;
+}
+
 /**
  * @brief Create an entity.
  *
@@ -65,6 +333,9 @@ make_entity (const char *name, const char *text)
   entity->text = g_strdup (text ? text : "");
   entity->entities = NULL;
   entity->attributes = NULL;
+  entity->arena = NULL;
+  entity->attribute_pairs = NULL;
+  entity->child_index = NULL;
   return entity;
 }
 
@@ -121,17 +392,27 @@ add_entity (entities_t *entities, const char *name, const char *text)
 /**
  * @brief Free an entity, recursively.
  *
+ * An entity in an arena is freed with the arena, when the root of the tree
+ * is freed.  Freeing any other entity of an arena tree does nothing.
+ *
  * @param[in]  entity  The entity, can be NULL.
  */
 void
 free_entity (entity_t entity)
 {
-  if (entity)
+  if (entity && entity->arena)
+    {
+      if (entity->arena->root == entity)
+        entity_arena_free (entity->arena);
+    }
+  else if (entity)
     {
       g_free (entity->name);
       g_free (entity->text);
       if (entity->attributes)
         g_hash_table_destroy (entity->attributes);
+      if (entity->child_index)
+        entity_child_index_free (entity->child_index);
       if (entity->entities)
         {
           GSList *list = entity->entities;
@@ -193,9 +474,104 @@ compare_entity_with_name (gconstpointer entity, gconstpointer name)
   return strcmp (entity_name ((entity_t) entity), (char *) name);
 }
 
+/**
+ * @brief Get the index of the children of an entity, bringing it up to date.
+ *
+ * The children list is walked to check that the links indexed are still
+ * its first links and still hold the same children.  This only compares
+ * pointers, and never follows a link of the index, which may be freed.
+ *
+ * @param[in]  entity  Entity.
+ *
+ * @return Index, freed with the entity.
+ */
+static entity_child_index_t
+entity_child_index (entity_t entity)
+{
+  entity_child_index_t index = entity->child_index;
+  entities_t node;
+  guint position;
+
+  if (index == NULL)
+    {
+      index = g_malloc0 (sizeof (*index));
+      index->links = g_array_new (FALSE, FALSE, sizeof (entity_child_link_t));
+      index->names = g_hash_table_new_full (
+        g_str_hash, g_str_equal, NULL, (GDestroyNotify) g_ptr_array_unref);
+      entity->child_index = index;
+      if (entity->arena)
+        entity->arena->indexes =
+          g_slist_prepend (entity->arena->indexes, index);
+    }
+
+  node = entity->entities;
+  for (position = 0; position < index->links->len; position++)
+    {
+      entity_child_link_t *link;
+
+      link = &g_array_index (index->links, entity_child_link_t, position);
+      if (node != link->node || node->data != link->child)
+        break;
+      node = node->next;
+    }
+  if (position < index->links->len)
+    {
+      /* Children were removed, replaced or reordered. */
+      g_hash_table_remove_all (index->names);
+      g_array_set_size (index->links, 0);
+      node = entity->entities;
+    }
+
+  for (; node; node = node->next)
+    {
+      entity_child_link_t link;
+      GPtrArray *children;
+
+      link.node = node;
+      link.child = (entity_t) node->data;
+      g_array_append_val (index->links, link);
+      children = g_hash_table_lookup (index->names, link.child->name);
+      if (children == NULL)
+        {
+          children = g_ptr_array_new ();
+          g_hash_table_insert (index->names, link.child->name, children);
+        }
+      g_ptr_array_add (children, link.child);
+    }
+  return index;
+}
+
+/**
+ * @brief Check whether the children of an entity are to be looked up with an
+ * @brief index.
+ *
+ * @param[in]  entity  Entity.
+ *
+ * @return TRUE if there is an index or there are many children, else FALSE.
+ */
+static gboolean
+entity_child_indexed (entity_t entity)
+{
+  entities_t node = entity->entities;
+  int count = 0;
+
+  if (entity->child_index)
+    return TRUE;
+  while (node && count < ENTITY_CHILD_INDEX_THRESHOLD)
+    {
+      node = node->next;
+      count++;
+    }
+  return node != NULL;
+}
+
 /**
  * @brief Get a child of an entity.
  *
+ * Elements with many children have their children indexed by name on the
+ * first lookup.  Further lookups only walk the children to check that the
+ * index is up to date, without comparing names.
+ *
  * @param[in]  entity  Entity.
  * @param[in]  name    Name of the child.
  *
@@ -204,15 +580,71 @@ compare_entity_with_name (gconstpointer entity, gconstpointer name)
 entity_t
 entity_child (entity_t entity, const char *name)
 {
+  GPtrArray *children;
+
   if (!entity)
     return NULL;
 
-  if (entity->entities)
+  if (entity_child_indexed (entity) == FALSE)
     {
       entities_t match =
         g_slist_find_custom (entity->entities, name, compare_entity_with_name);
       return match ? (entity_t) match->data : NULL;
     }
+
+  children = g_hash_table_lookup (entity_child_index (entity)->names, name);
+  return children ? (entity_t) g_ptr_array_index (children, 0) : NULL;
+}
+
+/**
+ * @brief Start iterating over the children of an entity that have a name.
+ *
+ * The children must not change during the iteration.
+ *
+ * @param[out]  iter    Iterator.
+ * @param[in]   entity  Entity, can be NULL.
+ * @param[in]   name    Name of the children.  Must outlive the iterator.
+ */
+void
+entity_child_iter_init (entity_child_iter_t *iter, entity_t entity,
+                        const char *name)
+{
+  iter->name = name;
+  iter->next = NULL;
+  iter->children = NULL;
+  iter->position = 0;
+  if (entity == NULL)
+    return;
+  if (entity_child_indexed (entity))
+    iter->children =
+      g_hash_table_lookup (entity_child_index (entity)->names, name);
+  else
+    iter->next = entity->entities;
+}
+
+/**
+ * @brief Get the next child of an iteration over children with a name.
+ *
+ * @param[in]  iter  Iterator.
+ *
+ * @return The next child with the name, or NULL when there are no more.
+ */
+entity_t
+entity_child_iter_next (entity_child_iter_t *iter)
+{
+  if (iter->children)
+    return iter->position < iter->children->len
+             ? (entity_t) g_ptr_array_index (iter->children, iter->position++)
+             : NULL;
+
+  while (iter->next)
+    {
+      entity_t child = (entity_t) iter->next->data;
+
+      iter->next = iter->next->next;
+      if (strcmp (child->name, iter->name) == 0)
+        return child;
+    }
   return NULL;
 }
 
@@ -230,11 +662,54 @@ entity_attribute (entity_t entity, const char *name)
   if (!entity)
     return NULL;
 
+  if (entity->attribute_pairs)
+    {
+      gchar **pair;
+
+      for (pair = entity->attribute_pairs; *pair; pair += 2)
+        if (strcmp (pair[0], name) == 0)
+          return pair[1];
+      return NULL;
+    }
   if (entity->attributes)
     return (const char *) g_hash_table_lookup (entity->attributes, name);
   return NULL;
 }
 
+/**
+ * @brief Call a function for each attribute of an entity.
+ *
+ * @param[in]  entity  Entity.
+ * @param[in]  func    Function, called with name, value and data.
+ * @param[in]  data    Data for func.
+ */
+static void
+entity_foreach_attribute (entity_t entity, GHFunc func, gpointer data)
+{
+  if (entity->attribute_pairs)
+    {
+      gchar **pair;
+
+      for (pair = entity->attribute_pairs; *pair; pair += 2)
+        func (pair[0], pair[1], data);
+    }
+  else if (entity->attributes)
+    g_hash_table_foreach (entity->attributes, func, data);
+}
+
+/**
+ * @brief Check whether an entity has attributes.
+ *
+ * @param[in]  entity  Entity.
+ *
+ * @return TRUE if the entity has attributes, FALSE otherwise.
+ */
+static gboolean
+entity_has_attributes (entity_t entity)
+{
+  return entity->attribute_pairs != NULL || entity->attributes != NULL;
+}
+
 /**
  * @brief Add attributes from an XML callback to an entity.
  *
@@ -261,9 +736,54 @@ add_attributes (entity_t entity, const gchar **names, const gchar **values)
     }
 }
 
+/**
+ * @brief Start an XML element in a context.
+ *
+ * @param[in]  data              Context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  attribute_names   XML attribute name.
+ * @param[in]  attribute_values  XML attribute values.
+ * @param[in]  prepend           Whether to prepend the element to the children
+ *                               of its parent, which are then in reverse order
+ *                               until context_end_element puts them in order.
+ *                               Otherwise it is appended.
+ */
+static void
+context_start_element (context_data_t *data, const gchar *element_name,
+                       const gchar **attribute_names,
+                       const gchar **attribute_values, gboolean prepend)
+{
+  entity_t entity;
+
+  if (data->current)
+    {
+      entity_t current = (entity_t) data->current->data;
+
+      entity = make_entity (element_name, NULL);
+      if (prepend)
+        current->entities = g_slist_prepend (current->entities, entity);
+      else
+        current->entities = g_slist_append (current->entities, entity);
+    }
+  else
+    entity = make_entity (element_name, NULL);
+
+  add_attributes (entity, attribute_names, attribute_values);
+
+  /* "Push" the element. */
+  if (data->first == NULL)
+    data->current = data->first = g_slist_prepend (NULL, entity);
+  else
+    data->current = g_slist_prepend (data->current, entity);
+}
+
 /**
  * @brief Handle the start of an OMP XML element.
  *
+ * Children are prepended, and put in order when their parent ends, because
+ * appending to a long list is slow.  Only the parsers of this module do
+ * this, as they hand out trees once they are complete.
+ *
  * @param[in]  context           Parser context.
  * @param[in]  element_name      XML element name.
  * @param[in]  attribute_names   XML attribute name.
@@ -276,6 +796,32 @@ handle_start_element (GMarkupParseContext *context, const gchar *element_name,
                       const gchar **attribute_names,
                       const gchar **attribute_values, gpointer user_data,
                       GError **error)
+{
+  (void) context;
+  (void) error;
+  context_start_element ((context_data_t *) user_data, element_name,
+                         attribute_names, attribute_values, TRUE);
+}
+
+/**
+ * @brief Handle the start of an XML element, allocating from an arena.
+ *
+ * The first element creates the arena, and its descendants are allocated
+ * from it.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  attribute_names   XML attribute name.
+ * @param[in]  attribute_values  XML attribute values.
+ * @param[in]  user_data         Dummy parameter.
+ * @param[in]  error             Error parameter.
+ */
+static void
+handle_start_element_arena (GMarkupParseContext *context,
+                            const gchar *element_name,
+                            const gchar **attribute_names,
+                            const gchar **attribute_values, gpointer user_data,
+                            GError **error)
 {
   entity_t entity;
   context_data_t *data = (context_data_t *) user_data;
@@ -285,12 +831,23 @@ handle_start_element (GMarkupParseContext *context, const gchar *element_name,
   if (data->current)
     {
       entity_t current = (entity_t) data->current->data;
-      entity = add_entity (&current->entities, element_name, NULL);
+      GSList *node;
+
+      node = entity_arena_alloc (current->arena, sizeof (*node));
+      entity = make_entity_arena (current->arena, element_name,
+                                  attribute_names, attribute_values);
+      node->data = entity;
+      node->next = current->entities;
+      current->entities = node;
     }
   else
-    entity = add_entity (NULL, element_name, NULL);
+    {
+      entity_arena_t arena = entity_arena_new ();
 
-  add_attributes (entity, attribute_names, attribute_values);
+      entity = make_entity_arena (arena, element_name, attribute_names,
+                                  attribute_values);
+      arena->root = entity;
+    }
 
   /* "Push" the element. */
   if (data->first == NULL)
@@ -302,6 +859,9 @@ handle_start_element (GMarkupParseContext *context, const gchar *element_name,
 /**
  * @brief Handle the start of an OMP XML element.
  *
+ * The element is appended to the children of its parent, so that the tree
+ * is in document order while it is being parsed.
+ *
  * @param[in]  context           Parser context.
  * @param[in]  element_name      XML element name.
  * @param[in]  attribute_names   XML attribute name.
@@ -312,28 +872,29 @@ xml_handle_start_element (context_data_t *context, const gchar *element_name,
                           const gchar **attribute_names,
                           const gchar **attribute_values)
 {
-  return handle_start_element (NULL, element_name, attribute_names,
-                               attribute_values, context, NULL);
+  context_start_element (context, element_name, attribute_names,
+                         attribute_values, FALSE);
 }
 
 /**
- * @brief Handle the end of an XML element.
+ * @brief End an XML element in a context.
  *
- * @param[in]  context           Parser context.
+ * @param[in]  data              Context.
  * @param[in]  element_name      XML element name.
- * @param[in]  user_data         Dummy parameter.
- * @param[in]  error             Error parameter.
+ * @param[in]  prepended         Whether the children of the element were
+ *                               prepended, and need to be put in order.
  */
 static void
-handle_end_element (GMarkupParseContext *context, const gchar *element_name,
-                    gpointer user_data, GError **error)
+context_end_element (context_data_t *data, const gchar *element_name,
+                     gboolean prepended)
 {
-  context_data_t *data = (context_data_t *) user_data;
+  entity_t entity;
 
-  (void) context;
-  (void) error;
   (void) element_name;
   assert (data->current && data->first);
+  entity = (entity_t) data->current->data;
+  if (prepended)
+    entity->entities = g_slist_reverse (entity->entities);
   if (data->current == data->first)
     {
       assert (strcmp (element_name,
@@ -354,6 +915,25 @@ handle_end_element (GMarkupParseContext *context, const gchar *element_name,
     }
 }
 
+/**
+ * @brief Handle the end of an XML element.
+ *
+ * Puts the children of the element in order, as they were prepended.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  user_data         Dummy parameter.
+ * @param[in]  error             Error parameter.
+ */
+static void
+handle_end_element (GMarkupParseContext *context, const gchar *element_name,
+                    gpointer user_data, GError **error)
+{
+  (void) context;
+  (void) error;
+  context_end_element ((context_data_t *) user_data, element_name, TRUE);
+}
+
 /**
  * @brief Handle the end of an XML element.
  *
@@ -363,7 +943,7 @@ handle_end_element (GMarkupParseContext *context, const gchar *element_name,
 void
 xml_handle_end_element (context_data_t *context, const gchar *element_name)
 {
-  handle_end_element (NULL, element_name, context, NULL);
+  context_end_element (context, element_name, FALSE);
 }
 
 /**
@@ -382,10 +962,12 @@ handle_text (GMarkupParseContext *context, const gchar *text, gsize text_len,
   context_data_t *data = (context_data_t *) user_data;
 
   (void) context;
-  (void) text_len;
   (void) error;
   entity_t current = (entity_t) data->current->data;
-  if (current->text)
+  if (current->arena)
+    current->text =
+      entity_arena_strappend (current->arena, current->text, text, text_len);
+  else if (current->text)
     {
       gchar *old = current->text;
       current->text = g_strconcat (current->text, text, NULL);
@@ -424,30 +1006,78 @@ handle_error (GMarkupParseContext *context, GError *error, gpointer user_data)
 }
 
 /**
- * @brief Try read an XML entity tree from the manager.
+ * @brief Turn blocking back on for a socket, after a read with a timeout.
  *
- * @param[in]   session        Pointer to GNUTLS session.
- * @param[in]   timeout        Server idle time before giving up, in seconds.  0
- * to wait forever.
- * @param[out]  entity         Pointer to an entity tree.
- * @param[out]  string_return  An optional return location for the text read
- *                             from the session.  If NULL then it simply
- *                             remains NULL.  If a pointer to NULL then it
- * points to a freshly allocated GString on successful return. Otherwise it
- * points to an existing GString onto which the text is appended.
+ * @param[in]  socket   Socket.
+ * @param[in]  timeout  Timeout of the read.
+ */
+static void
+xml_read_restore_socket (int socket, int timeout)
+{
+  if (timeout > 0 && fcntl (socket, F_SETFL, 0L) < 0)
+    g_warning ("%s :failed to set socket flag: %s", __FUNCTION__,
+               strerror (errno));
+}
+
+/**
+ * @brief Wait until a socket can be read, after a read would have blocked.
+ *
+ * @param[in]  socket     Socket.
+ * @param[in]  timeout    Server idle time before giving up, in seconds.
+ * @param[in]  last_time  Time of the last data from the server.
+ *
+ * @return 0 readable, -1 error, -4 timeout.
+ */
+static int
+xml_read_wait (int socket, int timeout, time_t last_time)
+{
+  struct pollfd pfd;
+
+  pfd.fd = socket;
+  pfd.events = POLLIN;
+  while (1)
+    {
+      time_t left = timeout - (time (NULL) - last_time);
+      int ret;
+
+      if (left <= 0)
+        return -4;
+      ret = poll (&pfd, 1, left * 1000);
+      if (ret > 0)
+        return 0;
+      if (ret < 0 && errno != EINTR)
+        {
+          g_warning ("%s: poll failed: %s", __FUNCTION__, strerror (errno));
+          return -1;
+        }
+    }
+}
+
+/**
+ * @brief Read XML from the manager or a socket into a parse context, until the
+ * first element closes.
+ *
+ * @param[in]   session      Pointer to GNUTLS session to read from, or NULL to
+ *                           read from socket.
+ * @param[in]   socket       Socket to read from, if session is NULL.
+ * @param[in]   timeout      Server idle time before giving up, in seconds.  0
+ *                           to wait forever.
+ * @param[in]   xml_context  Parse context to feed.
+ * @param[in]   done         Flag that the parser handlers set when the first
+ *                           element closes.
+ * @param[in]   string       String to append the text read to, or NULL.
  *
  * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
  */
-int
-try_read_entity_and_string (gnutls_session_t *session, int timeout,
-                            entity_t *entity, GString **string_return)
+static int
+xml_read_and_parse (gnutls_session_t *session, int socket, int timeout,
+                    GMarkupParseContext *xml_context, const gboolean *done,
+                    GString *string)
 {
-  GMarkupParser xml_parser;
   GError *error = NULL;
-  GMarkupParseContext *xml_context;
-  GString *string;
-  int socket;
   time_t last_time;
+  gboolean debug;
+  gsize size;
 
   // Buffer for reading from the manager.
   char *buffer;
@@ -460,46 +1090,21 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
       return -1;
     }
 
+  if (session)
+    socket = GPOINTER_TO_INT (gnutls_transport_get_ptr (*session));
   if (timeout > 0)
     {
       /* Turn off blocking. */
 
-      socket = GPOINTER_TO_INT (gnutls_transport_get_ptr (*session));
       if (fcntl (socket, F_SETFL, O_NONBLOCK) == -1)
         return -1;
     }
-  else
-    /* Quiet compiler. */
-    socket = 0;
-
-  buffer = g_malloc0 (BUFFER_SIZE);
-
-  /* Setup return arg. */
-
-  if (string_return == NULL)
-    string = NULL;
-  else if (*string_return == NULL)
-    string = g_string_new ("");
-  else
-    string = *string_return;
 
-  /* Create the XML parser. */
-
-  xml_parser.start_element = handle_start_element;
-  xml_parser.end_element = handle_end_element;
-  xml_parser.text = handle_text;
-  xml_parser.passthrough = NULL;
-  xml_parser.error = handle_error;
-
-  context_data_t context_data;
-  context_data.done = FALSE;
-  context_data.first = NULL;
-  context_data.current = NULL;
-
-  /* Setup the XML context. */
+  /* Dumping the data is costly, so only do it if it would be logged. */
+  debug = gvm_log_enabled (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG);
 
-  xml_context =
-    g_markup_parse_context_new (&xml_parser, 0, &context_data, NULL);
+  size = BUFFER_INITIAL_SIZE;
+  buffer = g_malloc (size);
 
   /* Read and parse, until encountering end of file or error. */
 
@@ -508,45 +1113,41 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
       ssize_t count;
       while (1)
         {
-          g_debug ("   asking for %i\n", BUFFER_SIZE);
-          count = gnutls_record_recv (*session, buffer, BUFFER_SIZE);
-          if (count < 0)
+          if (session)
             {
+              count = gnutls_record_recv (*session, buffer, size);
               if (count == GNUTLS_E_INTERRUPTED)
                 /* Interrupted, try read again. */
                 continue;
-              if ((timeout > 0) && (count == GNUTLS_E_AGAIN))
-                {
-                  /* Server still busy, either timeout or try read again. */
-                  if ((timeout - (time (NULL) - last_time)) <= 0)
-                    {
-                      g_warning ("   timeout\n");
-                      if (fcntl (socket, F_SETFL, 0L) < 0)
-                        g_warning ("%s :failed to set socket flag: %s",
-                                   __FUNCTION__, strerror (errno));
-                      g_markup_parse_context_free (xml_context);
-                      g_free (buffer);
-                      return -4;
-                    }
-                  continue;
-                }
               if (count == GNUTLS_E_REHANDSHAKE)
                 /* Try again. TODO Rehandshake. */
                 continue;
-              if (context_data.first && context_data.first->data)
-                {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
-                }
-              if (string && *string_return == NULL)
-                g_string_free (string, TRUE);
-              if (timeout > 0)
+            }
+          else
+            {
+              count = read (socket, buffer, size);
+              if (count < 0 && errno == EINTR)
+                /* Interrupted, try read again. */
+                continue;
+            }
+          if (count < 0)
+            {
+              if ((timeout > 0)
+                  && (session ? count == GNUTLS_E_AGAIN : errno == EAGAIN))
                 {
-                  if (fcntl (socket, F_SETFL, 0L) < 0)
-                    g_warning ("%s :failed to set socket flag: %s",
-                               __FUNCTION__, strerror (errno));
+                  int ret;
+
+                  /* Server still busy, wait until there is more to read. */
+                  ret = xml_read_wait (socket, timeout, last_time);
+                  if (ret == 0)
+                    continue;
+                  if (ret == -4)
+                    g_warning ("   timeout\n");
+                  xml_read_restore_socket (socket, timeout);
+                  g_free (buffer);
+                  return ret;
                 }
-              g_markup_parse_context_free (xml_context);
+              xml_read_restore_socket (socket, timeout);
               g_free (buffer);
               return -1;
             }
@@ -559,27 +1160,15 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
                   g_warning ("   End error: %s\n", error->message);
                   g_error_free (error);
                 }
-              if (context_data.first && context_data.first->data)
-                {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
-                }
-              if (string && *string_return == NULL)
-                g_string_free (string, TRUE);
-              if (timeout > 0)
-                {
-                  if (fcntl (socket, F_SETFL, 0L) < 0)
-                    g_warning ("%s :failed to set socket flag: %s",
-                               __FUNCTION__, strerror (errno));
-                }
-              g_markup_parse_context_free (xml_context);
+              xml_read_restore_socket (socket, timeout);
               g_free (buffer);
               return -3;
             }
           break;
         }
 
-      g_debug ("<= %.*s\n", (int) count, buffer);
+      if (debug)
+        g_debug ("<= %.*s\n", (int) count, buffer);
 
       if (string)
         g_string_append_len (string, buffer, count);
@@ -588,59 +1177,38 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
       if (error)
         {
           g_error_free (error);
-          if (context_data.first && context_data.first->data)
-            {
-              free_entity (context_data.first->data);
-              g_slist_free_1 (context_data.first);
-            }
-          if (string && *string_return == NULL)
-            g_string_free (string, TRUE);
-          if (timeout > 0)
-            {
-              if (fcntl (socket, F_SETFL, 0L) < 0)
-                g_warning ("%s :failed to set socket flag: %s", __FUNCTION__,
-                           strerror (errno));
-            }
-          g_markup_parse_context_free (xml_context);
+          xml_read_restore_socket (socket, timeout);
           g_free (buffer);
           return -2;
         }
-      if (context_data.done)
+      if (*done)
         {
           g_markup_parse_context_end_parse (xml_context, &error);
+          xml_read_restore_socket (socket, timeout);
+          g_free (buffer);
           if (error)
             {
               g_warning ("   End error: %s\n", error->message);
               g_error_free (error);
-              if (context_data.first && context_data.first->data)
-                {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
-                }
-              if (timeout > 0)
-                fcntl (socket, F_SETFL, 0L);
-              g_markup_parse_context_free (xml_context);
-              g_free (buffer);
               return -2;
             }
-          *entity = (entity_t) context_data.first->data;
-          if (string)
-            *string_return = string;
-          if (timeout > 0)
-            fcntl (socket, F_SETFL, 0L);
-          g_markup_parse_context_free (xml_context);
-          g_free (buffer);
           return 0;
         }
 
+      /* The server sends faster than the buffer holds, so read more at once
+       * next time. */
+      if ((gsize) count == size && size < BUFFER_SIZE)
+        {
+          size *= 2;
+          g_free (buffer);
+          buffer = g_malloc (size);
+        }
+
       if ((timeout > 0) && (time (&last_time) == -1))
         {
           g_warning ("   failed to get current time (1): %s\n",
                      strerror (errno));
-          if (fcntl (socket, F_SETFL, 0L) < 0)
-            g_warning ("%s :failed to set socket flag: %s", __FUNCTION__,
-                       strerror (errno));
-          g_markup_parse_context_free (xml_context);
+          xml_read_restore_socket (socket, timeout);
           g_free (buffer);
           return -1;
         }
@@ -648,9 +1216,11 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
 }
 
 /**
- * @brief Try read an XML entity tree from the socket.
+ * @brief Try read an XML entity tree from the manager or a socket.
  *
- * @param[in]   socket         Socket to read from.
+ * @param[in]   session        Pointer to GNUTLS session, or NULL to read from
+ *                             socket.
+ * @param[in]   socket         Socket to read from, if session is NULL.
  * @param[in]   timeout        Server idle time before giving up, in seconds.  0
  * to wait forever.
  * @param[out]  entity         Pointer to an entity tree.
@@ -659,38 +1229,20 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
  *                             remains NULL.  If a pointer to NULL then it
  * points to a freshly allocated GString on successful return. Otherwise it
  * points to an existing GString onto which the text is appended.
+ * @param[in]   arena          Whether to allocate the tree from an arena.
  *
  * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
  */
-int
-try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
-                              GString **string_return)
+static int
+try_read_entity_and_string_full (gnutls_session_t *session, int socket,
+                                 int timeout, entity_t *entity,
+                                 GString **string_return, gboolean arena)
 {
   GMarkupParser xml_parser;
-  GError *error = NULL;
   GMarkupParseContext *xml_context;
   GString *string;
-  time_t last_time;
-  /* Buffer for reading from the socket. */
-  char *buffer;
-
-  /* Record the start time. */
-
-  if (time (&last_time) == -1)
-    {
-      g_warning ("   failed to get current time: %s\n", strerror (errno));
-      return -1;
-    }
-
-  if (timeout > 0)
-    {
-      /* Turn off blocking. */
-
-      if (fcntl (socket, F_SETFL, O_NONBLOCK) == -1)
-        return -1;
-    }
-
-  buffer = g_malloc0 (BUFFER_SIZE);
+  context_data_t context_data;
+  int ret;
 
   /* Setup return arg. */
 
@@ -703,13 +1255,13 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
 
   /* Create the XML parser. */
 
-  xml_parser.start_element = handle_start_element;
+  xml_parser.start_element =
+    arena ? handle_start_element_arena : handle_start_element;
   xml_parser.end_element = handle_end_element;
   xml_parser.text = handle_text;
   xml_parser.passthrough = NULL;
   xml_parser.error = handle_error;
 
-  context_data_t context_data;
   context_data.done = FALSE;
   context_data.first = NULL;
   context_data.current = NULL;
@@ -719,148 +1271,288 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
   xml_context =
     g_markup_parse_context_new (&xml_parser, 0, &context_data, NULL);
 
-  /* Read and parse, until encountering end of file or error. */
+  ret = xml_read_and_parse (session, socket, timeout, xml_context,
+                            &context_data.done, string);
+  g_markup_parse_context_free (xml_context);
 
-  while (1)
+  if (ret)
     {
-      int count;
-      while (1)
+      // FIX there may be multiple entries in list
+      if (context_data.first && context_data.first->data)
         {
-          g_debug ("   asking for %i\n", BUFFER_SIZE);
-          count = read (socket, buffer, BUFFER_SIZE);
-          if (count < 0)
-            {
-              if (errno == EINTR)
-                /* Interrupted, try read again. */
-                continue;
-              if (timeout > 0)
-                {
-                  if (errno == EAGAIN)
-                    {
-                      /* Server still busy, either timeout or try read again. */
-                      if ((timeout - (time (NULL) - last_time)) <= 0)
-                        {
-                          g_warning ("   timeout\n");
-                          if (fcntl (socket, F_SETFL, 0L) < 0)
-                            g_warning ("%s :failed to set socket flag: %s",
-                                       __FUNCTION__, strerror (errno));
-                          g_markup_parse_context_free (xml_context);
-                          g_free (buffer);
-                          return -4;
-                        }
-                    }
-                  continue;
-                }
-              if (context_data.first && context_data.first->data)
-                {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
-                }
-              if (string && *string_return == NULL)
-                g_string_free (string, TRUE);
-              if (timeout > 0)
-                fcntl (socket, F_SETFL, 0L);
-              g_markup_parse_context_free (xml_context);
-              g_free (buffer);
-              return -1;
-            }
-          if (count == 0)
-            {
-              /* End of file. */
-              g_markup_parse_context_end_parse (xml_context, &error);
-              if (error)
-                {
-                  g_warning ("   End error: %s\n", error->message);
-                  g_error_free (error);
-                }
-              if (context_data.first && context_data.first->data)
-                {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
-                }
-              if (string && *string_return == NULL)
-                g_string_free (string, TRUE);
-              if (timeout > 0)
-                {
-                  if (fcntl (socket, F_SETFL, 0L) < 0)
-                    g_warning ("%s :failed to set socket flag: %s",
-                               __FUNCTION__, strerror (errno));
-                }
-              g_markup_parse_context_free (xml_context);
-              g_free (buffer);
-              return -3;
-            }
-          break;
+          free_entity (context_data.first->data);
+          g_slist_free_1 (context_data.first);
         }
+      if (string && *string_return == NULL)
+        g_string_free (string, TRUE);
+      return ret;
+    }
 
-      g_debug ("<= %.*s\n", (int) count, buffer);
+  *entity = (entity_t) context_data.first->data;
+  g_slist_free_1 (context_data.first);
+  if (string)
+    *string_return = string;
+  return 0;
+}
 
-      if (string)
-        g_string_append_len (string, buffer, count);
+/**
+ * @brief Try read an XML entity tree from the manager.
+ *
+ * @param[in]   session        Pointer to GNUTLS session.
+ * @param[in]   timeout        Server idle time before giving up, in seconds.  0
+ * to wait forever.
+ * @param[out]  entity         Pointer to an entity tree.
+ * @param[out]  string_return  An optional return location for the text read
+ *                             from the session.  If NULL then it simply
+ *                             remains NULL.  If a pointer to NULL then it
+ * points to a freshly allocated GString on successful return. Otherwise it
+ * points to an existing GString onto which the text is appended.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
+ */
+int
+try_read_entity_and_string (gnutls_session_t *session, int timeout,
+                            entity_t *entity, GString **string_return)
+{
+  return try_read_entity_and_string_full (session, 0, timeout, entity,
+                                          string_return, FALSE);
+}
 
-      g_markup_parse_context_parse (xml_context, buffer, count, &error);
-      if (error)
-        {
-          g_error_free (error);
-          // FIX there may be multiple entries in list
-          if (context_data.first && context_data.first->data)
-            {
-              free_entity (context_data.first->data);
-              g_slist_free_1 (context_data.first);
-            }
-          if (string && *string_return == NULL)
-            g_string_free (string, TRUE);
-          if (timeout > 0)
-            {
-              if (fcntl (socket, F_SETFL, 0L) < 0)
-                g_warning ("%s :failed to set socket flag: %s", __FUNCTION__,
-                           strerror (errno));
-            }
-          g_markup_parse_context_free (xml_context);
-          g_free (buffer);
-          return -2;
-        }
-      if (context_data.done)
-        {
-          g_markup_parse_context_end_parse (xml_context, &error);
-          if (error)
-            {
-              g_warning ("   End error: %s\n", error->message);
-              g_error_free (error);
-              if (context_data.first && context_data.first->data)
-                {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
-                }
-              if (timeout > 0)
-                fcntl (socket, F_SETFL, 0L);
-              g_markup_parse_context_free (xml_context);
-              g_free (buffer);
-              return -2;
-            }
-          *entity = (entity_t) context_data.first->data;
-          if (string)
-            *string_return = string;
-          if (timeout > 0)
-            fcntl (socket, F_SETFL, 0L);
-          g_slist_free (context_data.first);
-          g_markup_parse_context_free (xml_context);
-          g_free (buffer);
-          return 0;
-        }
+/**
+ * @brief Try read an XML entity tree from the socket.
+ *
+ * @param[in]   socket         Socket to read from.
+ * @param[in]   timeout        Server idle time before giving up, in seconds.  0
+ * to wait forever.
+ * @param[out]  entity         Pointer to an entity tree.
+ * @param[out]  string_return  An optional return location for the text read
+ *                             from the session.  If NULL then it simply
+ *                             remains NULL.  If a pointer to NULL then it
+ * points to a freshly allocated GString on successful return. Otherwise it
+ * points to an existing GString onto which the text is appended.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
+ */
+int
+try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
+                              GString **string_return)
+{
+  return try_read_entity_and_string_full (NULL, socket, timeout, entity,
+                                          string_return, FALSE);
+}
 
-      if ((timeout > 0) && (time (&last_time) == -1))
+/**
+ * @brief State of a streaming XML read.
+ */
+typedef struct
+{
+  const xml_stream_handlers_t *handlers; ///< Handlers.
+  gpointer data;                         ///< Data for the handlers.
+  int depth;                             ///< Number of open elements.
+  context_data_t capture;                ///< Element being captured.
+  gboolean done;                         ///< Whether the first element closed.
+} xml_stream_t;
+
+/**
+ * @brief Check whether an element of a streaming XML read is to be captured.
+ *
+ * @param[in]  stream        Stream state.
+ * @param[in]  element_name  XML element name.
+ *
+ * @return TRUE if the element is to be captured, FALSE otherwise.
+ */
+static gboolean
+xml_stream_captures (xml_stream_t *stream, const gchar *element_name)
+{
+  const gchar **name = stream->handlers->capture;
+
+  while (name && *name)
+    if (strcmp (*name++, element_name) == 0)
+      return TRUE;
+  return FALSE;
+}
+
+/**
+ * @brief Handle the start of an XML element in a streaming read.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  attribute_names   XML attribute name.
+ * @param[in]  attribute_values  XML attribute values.
+ * @param[in]  user_data         Stream state.
+ * @param[in]  error             Error parameter.
+ */
+static void
+xml_stream_handle_start_element (GMarkupParseContext *context,
+                                 const gchar *element_name,
+                                 const gchar **attribute_names,
+                                 const gchar **attribute_values,
+                                 gpointer user_data, GError **error)
+{
+  xml_stream_t *stream = (xml_stream_t *) user_data;
+
+  if (stream->capture.first || xml_stream_captures (stream, element_name))
+    handle_start_element_arena (context, element_name, attribute_names,
+                                attribute_values, &stream->capture, error);
+  else if (stream->handlers->start_element)
+    stream->handlers->start_element (element_name, attribute_names,
+                                     attribute_values, stream->depth,
+                                     stream->data);
+  stream->depth++;
+}
+
+/**
+ * @brief Handle the end of an XML element in a streaming read.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  user_data         Stream state.
+ * @param[in]  error             Error parameter.
+ */
+static void
+xml_stream_handle_end_element (GMarkupParseContext *context,
+                               const gchar *element_name, gpointer user_data,
+                               GError **error)
+{
+  xml_stream_t *stream = (xml_stream_t *) user_data;
+
+  stream->depth--;
+  if (stream->capture.first)
+    {
+      handle_end_element (context, element_name, &stream->capture, error);
+      if (stream->capture.done)
         {
-          g_warning ("   failed to get current time (1): %s\n",
-                     strerror (errno));
-          if (fcntl (socket, F_SETFL, 0L) < 0)
-            g_warning ("%s :failed to set server socket flag: %s", __FUNCTION__,
-                       strerror (errno));
-          g_markup_parse_context_free (xml_context);
-          g_free (buffer);
-          return -1;
+          entity_t entity = (entity_t) stream->capture.first->data;
+
+          g_slist_free_1 (stream->capture.first);
+          stream->capture.first = NULL;
+          stream->capture.done = FALSE;
+          if (stream->handlers->entity)
+            stream->handlers->entity (entity, stream->depth, stream->data);
+          else
+            free_entity (entity);
         }
     }
+  else if (stream->handlers->end_element)
+    stream->handlers->end_element (element_name, stream->depth, stream->data);
+
+  if (stream->depth == 0)
+    stream->done = TRUE;
+}
+
+/**
+ * @brief Handle text of an XML element in a streaming read.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  text              The text.
+ * @param[in]  text_len          Length of the text.
+ * @param[in]  user_data         Stream state.
+ * @param[in]  error             Error parameter.
+ */
+static void
+xml_stream_handle_text (GMarkupParseContext *context, const gchar *text,
+                        gsize text_len, gpointer user_data, GError **error)
+{
+  xml_stream_t *stream = (xml_stream_t *) user_data;
+
+  if (stream->capture.first)
+    handle_text (context, text, text_len, &stream->capture, error);
+  else if (stream->handlers->text && stream->depth > 0 && text_len > 0)
+    stream->handlers->text (text, text_len, stream->depth - 1, stream->data);
+}
+
+/**
+ * @brief Try read an XML element from the manager or a socket as a stream of
+ * events.
+ *
+ * @param[in]   session    Pointer to GNUTLS session, or NULL to read from
+ *                         socket.
+ * @param[in]   socket     Socket to read from, if session is NULL.
+ * @param[in]   timeout    Server idle time before giving up, in seconds.  0
+ *                         to wait forever.
+ * @param[in]   handlers   Handlers to call.
+ * @param[in]   data       Data for the handlers.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
+ */
+static int
+try_read_xml_stream_full (gnutls_session_t *session, int socket, int timeout,
+                          const xml_stream_handlers_t *handlers, gpointer data)
+{
+  GMarkupParser xml_parser;
+  GMarkupParseContext *xml_context;
+  xml_stream_t stream;
+  int ret;
+
+  xml_parser.start_element = xml_stream_handle_start_element;
+  xml_parser.end_element = xml_stream_handle_end_element;
+  xml_parser.text = xml_stream_handle_text;
+  xml_parser.passthrough = NULL;
+  xml_parser.error = handle_error;
+
+  memset (&stream, 0, sizeof (stream));
+  stream.handlers = handlers;
+  stream.data = data;
+
+  xml_context = g_markup_parse_context_new (&xml_parser, 0, &stream, NULL);
+  ret = xml_read_and_parse (session, socket, timeout, xml_context,
+                            &stream.done, NULL);
+  g_markup_parse_context_free (xml_context);
+
+  /* Free any element left half captured.  The stack of open elements ends
+   * with the captured one. */
+  if (stream.capture.first)
+    {
+      free_entity (stream.capture.first->data);
+      g_slist_free (stream.capture.current);
+    }
+  return ret;
+}
+
+/**
+ * @brief Try read an XML element from the manager as a stream of events.
+ *
+ * The handlers get the elements as they are parsed, so the whole response is
+ * never held in memory.  Elements named in handlers->capture are instead
+ * passed whole, as entity trees, to handlers->entity.
+ *
+ * @param[in]   session    Pointer to GNUTLS session.
+ * @param[in]   timeout    Server idle time before giving up, in seconds.  0
+ *                         to wait forever.
+ * @param[in]   handlers   Handlers to call.
+ * @param[in]   data       Data for the handlers.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
+ */
+int
+try_read_xml_stream (gnutls_session_t *session, int timeout,
+                     const xml_stream_handlers_t *handlers, gpointer data)
+{
+  return try_read_xml_stream_full (session, 0, timeout, handlers, data);
+}
+
+/**
+ * @brief Try read an XML element from a connection as a stream of events.
+ *
+ * See @ref try_read_xml_stream.
+ *
+ * @param[in]   connection  Connection.
+ * @param[in]   timeout     Server idle time before giving up, in seconds.  0
+ *                          to wait forever.
+ * @param[in]   handlers    Handlers to call.
+ * @param[in]   data        Data for the handlers.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
+ */
+int
+try_read_xml_stream_c (gvm_connection_t *connection, int timeout,
+                       const xml_stream_handlers_t *handlers, gpointer data)
+{
+  if (connection->tls)
+    return try_read_xml_stream_full (&connection->session, 0, timeout,
+                                     handlers, data);
+  return try_read_xml_stream_full (NULL, connection->socket, timeout, handlers,
+                                   data);
 }
 
 /**
@@ -1045,6 +1737,30 @@ try_read_entity_c (gvm_connection_t *connection, int timeout, entity_t *entity)
                                        NULL);
 }
 
+/**
+ * @brief Try read an XML entity tree from the manager into an arena.
+ *
+ * The whole tree is allocated from a single region, which free_entity on the
+ * root releases at once.  The tree must not be modified with add_entity.
+ *
+ * @param[in]   connection  Connection.
+ * @param[in]   timeout     Server idle time before giving up, in seconds.  0 to
+ *                          wait forever.
+ * @param[out]  entity      Pointer to an entity tree.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
+ */
+int
+try_read_entity_arena_c (gvm_connection_t *connection, int timeout,
+                         entity_t *entity)
+{
+  if (connection->tls)
+    return try_read_entity_and_string_full (&connection->session, 0, timeout,
+                                            entity, NULL, TRUE);
+  return try_read_entity_and_string_full (NULL, connection->socket, timeout,
+                                          entity, NULL, TRUE);
+}
+
 /**
  * @brief Read an XML entity tree from the manager.
  *
@@ -1082,9 +1798,150 @@ read_entity_s (int socket, entity_t *entity)
  * @return 0 success, -1 read error, -2 parse error, -3 end of file.
  */
 int
-read_entity_c (gvm_connection_t *connection, entity_t *entity)
+read_entity_c (gvm_connection_t *connection, entity_t *entity)
+{
+  return try_read_entity_c (connection, 0, entity);
+}
+
+/**
+ * @brief Data for reading a sequence of XML entity trees.
+ */
+typedef struct
+{
+  context_data_t context; ///< Context of the tree being read.
+  GPtrArray *entities;    ///< Array to add the trees to.
+  guint left;             ///< Number of trees still to read.
+  gboolean done;          ///< Flag which is true when all trees are read.
+} entities_data_t;
+
+/**
+ * @brief Handle the end of an XML element in a sequence of trees.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  user_data         Sequence data.
+ * @param[in]  error             Error parameter.
+ */
+static void
+handle_end_element_entities (GMarkupParseContext *context,
+                             const gchar *element_name, gpointer user_data,
+                             GError **error)
+{
+  entities_data_t *data = (entities_data_t *) user_data;
+
+  handle_end_element (context, element_name, &data->context, error);
+  if (data->context.done)
+    {
+      /* Hand over the tree and start on the next one. */
+      g_ptr_array_add (data->entities, data->context.first->data);
+      g_slist_free_1 (data->context.first);
+      data->context.first = NULL;
+      data->context.done = FALSE;
+      if (--data->left == 0)
+        data->done = TRUE;
+    }
+}
+
+/**
+ * @brief Handle the start of an XML element in a sequence of trees.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  attribute_names   XML attribute name.
+ * @param[in]  attribute_values  XML attribute values.
+ * @param[in]  user_data         Sequence data.
+ * @param[in]  error             Error parameter.
+ */
+static void
+handle_start_element_entities (GMarkupParseContext *context,
+                               const gchar *element_name,
+                               const gchar **attribute_names,
+                               const gchar **attribute_values,
+                               gpointer user_data, GError **error)
+{
+  entities_data_t *data = (entities_data_t *) user_data;
+
+  handle_start_element (context, element_name, attribute_names,
+                        attribute_values, &data->context, error);
+}
+
+/**
+ * @brief Handle text in a sequence of trees.
+ *
+ * Text between the trees is dropped.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  text              The text.
+ * @param[in]  text_len          Length of the text.
+ * @param[in]  user_data         Sequence data.
+ * @param[in]  error             Error parameter.
+ */
+static void
+handle_text_entities (GMarkupParseContext *context, const gchar *text,
+                      gsize text_len, gpointer user_data, GError **error)
+{
+  entities_data_t *data = (entities_data_t *) user_data;
+
+  if (data->context.current)
+    handle_text (context, text, text_len, &data->context, error);
+}
+
+/**
+ * @brief Read a sequence of XML entity trees from the manager.
+ *
+ * For pipelined requests, where the responses follow each other on
+ * the connection.  All the trees are read through one parser, so that no
+ * data of a later tree is lost when it arrives with an earlier one.
+ *
+ * @param[in]   connection  Connection.
+ * @param[in]   count       Number of trees to read.
+ * @param[out]  entities    Array to add the trees to, in order.  The trees
+ *                          read before any error are added too.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file.
+ */
+int
+read_entities_c (gvm_connection_t *connection, guint count,
+                 GPtrArray *entities)
 {
-  return try_read_entity_c (connection, 0, entity);
+  GMarkupParser xml_parser;
+  GMarkupParseContext *xml_context;
+  entities_data_t data;
+  int ret;
+
+  if (count == 0)
+    return 0;
+
+  xml_parser.start_element = handle_start_element_entities;
+  xml_parser.end_element = handle_end_element_entities;
+  xml_parser.text = handle_text_entities;
+  xml_parser.passthrough = NULL;
+  xml_parser.error = handle_error;
+
+  data.context.done = FALSE;
+  data.context.first = NULL;
+  data.context.current = NULL;
+  data.entities = entities;
+  data.left = count;
+  data.done = FALSE;
+
+  xml_context = g_markup_parse_context_new (&xml_parser, 0, &data, NULL);
+  if (connection->tls)
+    ret = xml_read_and_parse (&connection->session, 0, 0, xml_context,
+                              &data.done, NULL);
+  else
+    ret = xml_read_and_parse (NULL, connection->socket, 0, xml_context,
+                              &data.done, NULL);
+  g_markup_parse_context_free (xml_context);
+
+  if (data.context.first)
+    {
+      /* Free the partial tree, and the stack of open elements, which ends
+       * with the root. */
+      free_entity (data.context.first->data);
+      g_slist_free (data.context.current);
+    }
+  return ret;
 }
 
 /**
@@ -1092,11 +1949,12 @@ read_entity_c (gvm_connection_t *connection, entity_t *entity)
  *
  * @param[in]   string  Input string.
  * @param[out]  entity  Pointer to an entity tree.
+ * @param[in]   arena   Whether to allocate the tree from an arena.
  *
  * @return 0 success, -1 read error, -2 parse error, -3 XML ended prematurely.
  */
-int
-parse_entity (const char *string, entity_t *entity)
+static int
+parse_entity_full (const char *string, entity_t *entity, gboolean arena)
 {
   GMarkupParser xml_parser;
   GError *error = NULL;
@@ -1105,7 +1963,8 @@ parse_entity (const char *string, entity_t *entity)
 
   /* Create the XML parser. */
 
-  xml_parser.start_element = handle_start_element;
+  xml_parser.start_element =
+    arena ? handle_start_element_arena : handle_start_element;
   xml_parser.end_element = handle_end_element;
   xml_parser.text = handle_text;
   xml_parser.passthrough = NULL;
@@ -1126,6 +1985,7 @@ parse_entity (const char *string, entity_t *entity)
   if (error)
     {
       g_error_free (error);
+      g_markup_parse_context_free (xml_context);
       if (context_data.first && context_data.first->data)
         {
           free_entity (context_data.first->data);
@@ -1136,6 +1996,7 @@ parse_entity (const char *string, entity_t *entity)
   if (context_data.done)
     {
       g_markup_parse_context_end_parse (xml_context, &error);
+      g_markup_parse_context_free (xml_context);
       if (error)
         {
           g_warning ("   End error: %s\n", error->message);
@@ -1151,6 +2012,7 @@ parse_entity (const char *string, entity_t *entity)
       g_slist_free_1 (context_data.first);
       return 0;
     }
+  g_markup_parse_context_free (xml_context);
   if (context_data.first && context_data.first->data)
     {
       free_entity (context_data.first->data);
@@ -1160,78 +2022,288 @@ parse_entity (const char *string, entity_t *entity)
 }
 
 /**
- * @brief Print an XML entity for g_slist_foreach to a GString.
+ * @brief Read an XML entity tree from a string.
+ *
+ * @param[in]   string  Input string.
+ * @param[out]  entity  Pointer to an entity tree.
  *
- * @param[in]  entity  The entity, as a gpointer.
- * @param[in]  string  The stream to which to print, as a gpointer.
+ * @return 0 success, -1 read error, -2 parse error, -3 XML ended prematurely.
  */
-static void
-foreach_print_entity_to_string (gpointer entity, gpointer string)
+int
+parse_entity (const char *string, entity_t *entity)
 {
-  print_entity_to_string ((entity_t) entity, (GString *) string);
+  return parse_entity_full (string, entity, FALSE);
 }
 
 /**
- * @brief Print an XML attribute for g_hash_table_foreach to a GString.
+ * @brief Read an XML entity tree from a string into an arena.
  *
- * @param[in]  name    The attribute name.
- * @param[in]  value   The attribute value.
- * @param[in]  string  The string to which to print.
+ * The whole tree is allocated from a single region, which free_entity on the
+ * root releases at once.  The tree must not be modified with add_entity.
+ *
+ * @param[in]   string  Input string.
+ * @param[out]  entity  Pointer to an entity tree.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 XML ended prematurely.
+ */
+int
+parse_entity_arena (const char *string, entity_t *entity)
+{
+  return parse_entity_full (string, entity, TRUE);
+}
+
+/**
+ * @brief Size at which streamed XML output is written out.
+ */
+#define XML_PRINT_CHUNK_SIZE 65536
+
+/**
+ * @brief Output of XML serialization.
+ */
+typedef struct
+{
+  GString *buffer; ///< Output, or pending output if write is set.
+  /** Writes out pending output, returns 0 on success.  NULL to keep all. */
+  int (*write) (const gchar *, gsize, gpointer);
+  gpointer data; ///< Data for write.
+  int error;     ///< Result of the first failed write, else 0.
+} xml_print_t;
+
+/**
+ * @brief Escape text for XML, like g_markup_escape_text.
+ *
+ * Escapes into the output directly, without a temporary string.
+ *
+ * @param[in]  out   String to append to, or NULL to only measure.
+ * @param[in]  text  Text to escape, may be NULL.
+ *
+ * @return Length of the escaped text.
+ */
+static gsize
+xml_escape (GString *out, const gchar *text)
+{
+  const gchar *run, *pos;
+  gsize size = 0;
+
+  if (text == NULL)
+    return 0;
+
+  for (run = pos = text; *pos; pos++)
+    {
+      const guchar c = *pos;
+      const gchar *escaped;
+      gchar number[8];
+      int skip = 0;
+
+      switch (c)
+        {
+        case '&':
+          escaped = "&amp;";
+          break;
+        case '<':
+          escaped = "&lt;";
+          break;
+        case '>':
+          escaped = "&gt;";
+          break;
+        case '\'':
+          escaped = "&#39;";
+          break;
+        case '"':
+          escaped = "&quot;";
+          break;
+        default:
+          if ((c >= 0x1 && c <= 0x8) || c == 0xb || c == 0xc
+              || (c >= 0xe && c <= 0x1f) || c == 0x7f)
+            g_snprintf (number, sizeof (number), "&#x%x;", c);
+          else if (c == 0xc2 && (guchar) pos[1] >= 0x80
+                   && (guchar) pos[1] <= 0x9f && (guchar) pos[1] != 0x85)
+            {
+              /* C1 control character, except NEL like glib. */
+              g_snprintf (number, sizeof (number), "&#x%x;", (guchar) pos[1]);
+              skip = 1;
+            }
+          else
+            continue;
+          escaped = number;
+        }
+
+      if (out)
+        {
+          g_string_append_len (out, run, pos - run);
+          g_string_append (out, escaped);
+        }
+      size += (pos - run) + strlen (escaped);
+      pos += skip;
+      run = pos + 1;
+    }
+  if (out)
+    g_string_append_len (out, run, pos - run);
+  return size + (pos - run);
+}
+
+/**
+ * @brief Add the size of an attribute for entity_foreach_attribute.
+ *
+ * @param[in]  name   The attribute name.
+ * @param[in]  value  The attribute value.
+ * @param[in]  size   The size to add to.
  */
 static void
-foreach_print_attribute_to_string (gpointer name, gpointer value,
-                                   gpointer string)
+foreach_attribute_size (gpointer name, gpointer value, gpointer size)
 {
-  g_string_append_printf ((GString *) string, " %s=\"%s\"", (char *) name,
-                          (char *) value);
+  *(gsize *) size += strlen (name) + 4 + xml_escape (NULL, value);
 }
 
 /**
- * @brief Print an XML entity tree to a GString, appending it if string is not
- * @brief empty.
+ * @brief Get the size of the XML of an entity tree.
  *
- * @param[in]      entity  Entity tree to print to string.
- * @param[in,out]  string  String to write to (will be created if NULL).
+ * @param[in]  entity  Entity tree.
+ *
+ * @return Length of the XML that print_entity_to_string appends.
  */
-void
-print_entity_to_string (entity_t entity, GString *string)
+static gsize
+entity_xml_size (entity_t entity)
 {
-  gchar *text_escaped = NULL;
-  g_string_append_printf (string, "<%s", entity->name);
-  if (entity->attributes && g_hash_table_size (entity->attributes))
-    g_hash_table_foreach (entity->attributes, foreach_print_attribute_to_string,
-                          string);
-  g_string_append_printf (string, ">");
-  text_escaped = g_markup_escape_text (entity->text, -1);
-  g_string_append_printf (string, "%s", text_escaped);
-  g_free (text_escaped);
-  g_slist_foreach (entity->entities, foreach_print_entity_to_string, string);
-  g_string_append_printf (string, "</%s>", entity->name);
+  gsize size;
+  GSList *child;
+
+  size = 2 * strlen (entity->name) + 5;
+  entity_foreach_attribute (entity, foreach_attribute_size, &size);
+  size += xml_escape (NULL, entity->text);
+  for (child = entity->entities; child; child = child->next)
+    size += entity_xml_size (child->data);
+  return size;
 }
 
 /**
- * @brief Print an XML entity for g_slist_foreach.
+ * @brief Write out the pending output of XML serialization.
  *
- * @param[in]  entity  The entity, as a gpointer.
- * @param[in]  stream  The stream to which to print, as a gpointer.
+ * @param[in]  print  Output.
+ * @param[in]  force  Whether to write even if less than a chunk is pending.
  */
 static void
-foreach_print_entity (gpointer entity, gpointer stream)
+xml_print_flush (xml_print_t *print, gboolean force)
 {
-  print_entity ((FILE *) stream, (entity_t) entity);
+  if (print->write == NULL || print->buffer->len == 0
+      || (force == FALSE && print->buffer->len < XML_PRINT_CHUNK_SIZE))
+    return;
+  if (print->error == 0)
+    print->error =
+      print->write (print->buffer->str, print->buffer->len, print->data);
+  g_string_truncate (print->buffer, 0);
 }
 
 /**
- * @brief Print an XML attribute for g_hash_table_foreach.
+ * @brief Print an XML attribute for entity_foreach_attribute.
  *
- * @param[in]  name    The attribute name.
- * @param[in]  value   The attribute value.
- * @param[in]  stream  The stream to which to print.
+ * @param[in]  name   The attribute name.
+ * @param[in]  value  The attribute value.
+ * @param[in]  print  Output.
+ */
+static void
+foreach_print_attribute_xml (gpointer name, gpointer value, gpointer print)
+{
+  GString *buffer = ((xml_print_t *) print)->buffer;
+
+  g_string_append_c (buffer, ' ');
+  g_string_append (buffer, name);
+  g_string_append (buffer, "=\"");
+  xml_escape (buffer, value);
+  g_string_append_c (buffer, '"');
+}
+
+/**
+ * @brief Serialize an XML entity tree.
+ *
+ * @param[in]  print   Output.
+ * @param[in]  entity  Entity tree.
  */
 static void
-foreach_print_attribute (gpointer name, gpointer value, gpointer stream)
+xml_print_entity (xml_print_t *print, entity_t entity)
+{
+  GSList *child;
+
+  g_string_append_c (print->buffer, '<');
+  g_string_append (print->buffer, entity->name);
+  entity_foreach_attribute (entity, foreach_print_attribute_xml, print);
+  g_string_append_c (print->buffer, '>');
+  xml_escape (print->buffer, entity->text);
+  xml_print_flush (print, FALSE);
+  for (child = entity->entities; child; child = child->next)
+    xml_print_entity (print, child->data);
+  g_string_append (print->buffer, "</");
+  g_string_append (print->buffer, entity->name);
+  g_string_append_c (print->buffer, '>');
+  xml_print_flush (print, FALSE);
+}
+
+/**
+ * @brief Serialize an XML entity tree in chunks.
+ *
+ * @param[in]  entity  Entity tree.
+ * @param[in]  write   Function that writes out a chunk, returns 0 on success.
+ * @param[in]  data    Data for write.
+ *
+ * @return 0 on success, else the result of the failed write.
+ */
+static int
+xml_print_entity_chunked (entity_t entity,
+                          int (*write) (const gchar *, gsize, gpointer),
+                          gpointer data)
+{
+  xml_print_t print;
+
+  print.buffer = g_string_sized_new (XML_PRINT_CHUNK_SIZE + 1024);
+  print.write = write;
+  print.data = data;
+  print.error = 0;
+  xml_print_entity (&print, entity);
+  xml_print_flush (&print, TRUE);
+  g_string_free (print.buffer, TRUE);
+  return print.error;
+}
+
+/**
+ * @brief Print an XML entity tree to a GString, appending it if string is not
+ * @brief empty.
+ *
+ * The string is grown once to the size of the XML, and text is escaped into
+ * it directly.
+ *
+ * @param[in]      entity  Entity tree to print to string.
+ * @param[in,out]  string  String to write to (will be created if NULL).
+ */
+void
+print_entity_to_string (entity_t entity, GString *string)
 {
-  fprintf ((FILE *) stream, " %s=\"%s\"", (char *) name, (char *) value);
+  xml_print_t print;
+  gsize len;
+
+  len = string->len;
+  g_string_set_size (string, len + entity_xml_size (entity));
+  g_string_truncate (string, len);
+
+  print.buffer = string;
+  print.write = NULL;
+  print.data = NULL;
+  print.error = 0;
+  xml_print_entity (&print, entity);
+}
+
+/**
+ * @brief Write a chunk of XML to a stream.
+ *
+ * @param[in]  chunk   The chunk.
+ * @param[in]  len     Length of chunk.
+ * @param[in]  stream  The stream, as a gpointer.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+xml_print_write_stream (const gchar *chunk, gsize len, gpointer stream)
+{
+  return fwrite (chunk, 1, len, (FILE *) stream) == len ? 0 : -1;
 }
 
 /**
@@ -1243,19 +2315,99 @@ foreach_print_attribute (gpointer name, gpointer value, gpointer stream)
 void
 print_entity (FILE *stream, entity_t entity)
 {
-  gchar *text_escaped = NULL;
-  fprintf (stream, "<%s", entity->name);
-  if (entity->attributes && g_hash_table_size (entity->attributes))
-    g_hash_table_foreach (entity->attributes, foreach_print_attribute, stream);
-  fprintf (stream, ">");
-  text_escaped = g_markup_escape_text (entity->text, -1);
-  fprintf (stream, "%s", text_escaped);
-  g_free (text_escaped);
-  g_slist_foreach (entity->entities, foreach_print_entity, stream);
-  fprintf (stream, "</%s>", entity->name);
+  xml_print_entity_chunked (entity, xml_print_write_stream, stream);
   fflush (stream);
 }
 
+/**
+ * @brief Write a chunk of XML to a file descriptor.
+ *
+ * @param[in]  chunk  The chunk.
+ * @param[in]  len    Length of chunk.
+ * @param[in]  fd     The file descriptor, as a gpointer.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+xml_print_write_fd (const gchar *chunk, gsize len, gpointer fd)
+{
+  while (len > 0)
+    {
+      ssize_t count;
+
+      count = write (GPOINTER_TO_INT (fd), chunk, len);
+      if (count < 0)
+        {
+          if (errno == EINTR || errno == EAGAIN)
+            continue;
+          g_warning ("%s: Failed to write XML: %s", __FUNCTION__,
+                     strerror (errno));
+          return -1;
+        }
+      chunk += count;
+      len -= count;
+    }
+  return 0;
+}
+
+/**
+ * @brief Print an XML entity tree to a file descriptor.
+ *
+ * The XML is written in chunks as it is serialized, so the tree is never
+ * held in memory as text whole.
+ *
+ * @param[in]  fd      The file descriptor.
+ * @param[in]  entity  Entity tree.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+print_entity_to_fd (int fd, entity_t entity)
+{
+  return xml_print_entity_chunked (entity, xml_print_write_fd,
+                                   GINT_TO_POINTER (fd));
+}
+
+/**
+ * @brief Write a chunk of XML to a connection.
+ *
+ * @param[in]  chunk       The chunk.
+ * @param[in]  len         Length of chunk.
+ * @param[in]  connection  The connection, as a gpointer.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+xml_print_write_connection (const gchar *chunk, gsize len,
+                            gpointer connection)
+{
+  struct iovec iov;
+
+  iov.iov_base = (gchar *) chunk;
+  iov.iov_len = len;
+  return gvm_connection_sendv ((gvm_connection_t *) connection, &iov, 1);
+}
+
+/**
+ * @brief Send an XML entity tree to a connection.
+ *
+ * The XML is sent in chunks as it is serialized, so that forwarding a large
+ * tree does not need a copy of it as text.
+ *
+ * @param[in]  connection  The connection.
+ * @param[in]  entity      Entity tree.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+int
+print_entity_c (gvm_connection_t *connection, entity_t entity)
+{
+  return xml_print_entity_chunked (entity, xml_print_write_connection,
+                                   connection);
+}
+
+#undef XML_PRINT_CHUNK_SIZE
+
 /* "Formatted" (indented) output of entity_t */
 
 /**
@@ -1294,9 +2446,7 @@ print_entity_format (entity_t entity, gpointer indent)
     printf ("  ");
 
   printf ("<%s", entity->name);
-  if (entity->attributes && g_hash_table_size (entity->attributes))
-    g_hash_table_foreach (entity->attributes, foreach_print_attribute_format,
-                          indent);
+  entity_foreach_attribute (entity, foreach_print_attribute_format, indent);
   printf (">");
 
   text_escaped = g_markup_escape_text (entity->text, -1);
@@ -1334,6 +2484,38 @@ compare_find_attribute (gpointer key, gpointer value, gpointer attributes2)
   return TRUE;
 }
 
+/**
+ * @brief Data for comparing the attributes of two entities.
+ */
+typedef struct
+{
+  entity_t entity2; ///< Entity to look the attributes up in.
+  gboolean failed;  ///< Whether an attribute differed.
+} compare_attributes_t;
+
+/**
+ * @brief Look for an attribute of one entity in another, for
+ * @brief entity_foreach_attribute.
+ *
+ * @param[in]  name     Attribute name.
+ * @param[in]  value    Attribute value.
+ * @param[in]  compare  Compare data.
+ */
+static void
+foreach_compare_attribute (gpointer name, gpointer value, gpointer compare)
+{
+  compare_attributes_t *data = (compare_attributes_t *) compare;
+  const char *value2;
+
+  if (data->failed)
+    return;
+  value2 = entity_attribute (data->entity2, name);
+  if (value2 && strcmp (value, value2) == 0)
+    return;
+  g_debug ("  compare failed attribute: %s\n", (char *) value);
+  data->failed = TRUE;
+}
+
 /**
  * @brief Compare two XML entity.
  *
@@ -1363,17 +2545,30 @@ compare_entities (entity_t entity1, entity_t entity2)
       return 1;
     }
 
-  if (entity1->attributes == NULL)
+  if (entity_has_attributes (entity1) == FALSE)
     {
-      if (entity2->attributes)
+      if (entity_has_attributes (entity2))
         return 1;
     }
   else
     {
-      if (entity2->attributes == NULL)
+      gboolean failed = FALSE;
+
+      if (entity_has_attributes (entity2) == FALSE)
         return 1;
-      if (g_hash_table_find (entity1->attributes, compare_find_attribute,
-                             (gpointer) entity2->attributes))
+      if (entity1->attributes && entity2->attributes)
+        failed = g_hash_table_find (entity1->attributes, compare_find_attribute,
+                                    (gpointer) entity2->attributes)
+                 != NULL;
+      else
+        {
+          compare_attributes_t compare = {entity2, FALSE};
+
+          entity_foreach_attribute (entity1, foreach_compare_attribute,
+                                    &compare);
+          failed = compare.failed;
+        }
+      if (failed)
         {
           g_debug ("  compare failed attributes\n");
           return 1;
@@ -1443,9 +2638,22 @@ xml_string_append (GString *xml, const char *format, ...)
 
 /* XML file utilities */
 
+/**
+ * @brief Size of the pieces an XML file is parsed in.
+ */
+#define XML_FILE_BUFFER_SIZE 1048576
+
+/**
+ * @brief Error domain that stops an XML search once it is done.
+ */
+#define XML_SEARCH_DONE g_quark_from_static_string ("xml-search-done")
+
 /**
  * @brief Handle the opening tag of an element in an XML search.
  *
+ * Stops the parse once the element is found, by setting an error in the
+ * XML_SEARCH_DONE domain.
+ *
  * @param[in]   ctx               The parse context.
  * @param[in]   element_name      The name of the element.
  * @param[in]   attribute_names   NULL-terminated array of attribute names.
@@ -1508,34 +2716,72 @@ xml_search_handle_start_element (GMarkupParseContext *ctx,
         {
           search_data->found = 1;
         }
+
+      if (search_data->found)
+        {
+          search_data->done = 1;
+          g_set_error (error, XML_SEARCH_DONE, 0, "Element found");
+        }
     }
 }
 
-#define XML_FILE_BUFFER_SIZE 1048576
-int
+/**
+ * @brief Feed a piece of an XML file to a search.
+ *
+ * @param[in]  context  The parse context.
+ * @param[in]  text     The piece.
+ * @param[in]  len      Length of the piece.
+ *
+ * @return 0 to go on, 1 if the search is over.
+ */
+static int
+xml_search_parse (GMarkupParseContext *context, const gchar *text, gsize len)
+{
+  GError *error = NULL;
+
+  if (g_markup_parse_context_parse (context, text, len, &error))
+    return 0;
+  if (error->domain != XML_SEARCH_DONE)
+    g_debug ("%s: %s", __FUNCTION__, error->message);
+  g_error_free (error);
+  return 1;
+}
+
 /**
  * @brief Tests if an XML file contains an element with given attributes.
  *
+ * The file is mapped into memory and parsed in large pieces, and the parse
+ * stops at the first matching element.
+ *
  * @param[in]   file_path         Path of the XML file.
  * @param[in]   find_element      Name of the element to find.
  * @param[in]   find_attributes   GHashTable of attributes to find.
  *
  * @return  1 if element was found, 0 if not.
  */
+int
 find_element_in_xml_file (gchar *file_path, gchar *find_element,
                           GHashTable *find_attributes)
 {
-  gchar buffer[XML_FILE_BUFFER_SIZE];
-  FILE *file;
-  int read_len;
   GMarkupParser xml_parser;
   GMarkupParseContext *xml_context;
   xml_search_data_t search_data;
-  GError *error = NULL;
+  struct stat state;
+  gchar *map;
+  int fd;
 
   search_data.find_element = find_element;
   search_data.find_attributes = find_attributes;
   search_data.found = 0;
+  search_data.done = 0;
+
+  fd = open (file_path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    {
+      g_warning ("%s: Failed to open '%s': %s", __FUNCTION__, file_path,
+                 strerror (errno));
+      return 0;
+    }
 
   /* Create the XML parser. */
   xml_parser.start_element = xml_search_handle_start_element;
@@ -1545,24 +2791,114 @@ find_element_in_xml_file (gchar *file_path, gchar *find_element,
   xml_parser.error = NULL;
   xml_context = g_markup_parse_context_new (&xml_parser, 0, &search_data, NULL);
 
-  file = fopen (file_path, "r");
-  if (file == NULL)
+  map = MAP_FAILED;
+  if (fstat (fd, &state) == 0 && S_ISREG (state.st_mode) && state.st_size > 0)
+    map = mmap (NULL, state.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (map != MAP_FAILED)
     {
-      g_markup_parse_context_free (xml_context);
-      g_warning ("%s: Failed to open '%s':", __FUNCTION__, strerror (errno));
-      return 0;
-    }
+      gsize offset, len;
 
-  while ((read_len = fread (&buffer, sizeof (char), XML_FILE_BUFFER_SIZE, file))
-         && g_markup_parse_context_parse (xml_context, buffer, read_len, &error)
-         && error == NULL)
+      madvise (map, state.st_size, MADV_SEQUENTIAL);
+      for (offset = 0; offset < (gsize) state.st_size; offset += len)
+        {
+          len = MIN (XML_FILE_BUFFER_SIZE, (gsize) state.st_size - offset);
+          if (xml_search_parse (xml_context, map + offset, len))
+            break;
+        }
+      munmap (map, state.st_size);
+    }
+  else
     {
+      gchar *buffer;
+      ssize_t len;
+
+      /* Not a regular file, empty or not mappable. */
+      buffer = g_malloc (XML_FILE_BUFFER_SIZE);
+      while ((len = read (fd, buffer, XML_FILE_BUFFER_SIZE)) > 0
+             || (len == -1 && errno == EINTR))
+        if (len > 0 && xml_search_parse (xml_context, buffer, len))
+          break;
+      g_free (buffer);
     }
-  g_markup_parse_context_end_parse (xml_context, &error);
-
-  fclose (file);
 
+  close (fd);
   g_markup_parse_context_free (xml_context);
   return search_data.found;
 }
+
+/**
+ * @brief Shared state of a parallel XML file search.
+ */
+typedef struct
+{
+  gchar **file_paths;          /**< Paths of the XML files. */
+  gchar *find_element;         /**< Name of the element to find. */
+  GHashTable *find_attributes; /**< Attributes to find. */
+  int *found;                  /**< Result of each file. */
+} xml_files_search_t;
+
+/**
+ * @brief Search one file of a parallel XML file search, in a worker.
+ *
+ * @param[in]  data       Index of the file, plus one.
+ * @param[in]  user_data  The search.
+ */
+static void
+xml_files_search_worker (gpointer data, gpointer user_data)
+{
+  xml_files_search_t *search = user_data;
+  int index = GPOINTER_TO_INT (data) - 1;
+
+  search->found[index] =
+    find_element_in_xml_file (search->file_paths[index], search->find_element,
+                              search->find_attributes);
+}
+
+/**
+ * @brief Tests which XML files contain an element with given attributes.
+ *
+ * Like find_element_in_xml_file for each file, except that the files are
+ * searched in parallel.
+ *
+ * @param[in]   file_paths        NULL-terminated paths of the XML files.
+ * @param[in]   find_element      Name of the element to find.
+ * @param[in]   find_attributes   GHashTable of attributes to find.
+ * @param[out]  found             Where to write 1 or 0 for each file, as
+ *                                find_element_in_xml_file returns.
+ * @param[in]   workers           Number of worker threads.  1 or less to
+ *                                search in the calling thread.
+ *
+ * @return  Number of files the element was found in.
+ */
+int
+find_element_in_xml_files (gchar **file_paths, gchar *find_element,
+                           GHashTable *find_attributes, int *found,
+                           int workers)
+{
+  xml_files_search_t search;
+  GThreadPool *pool = NULL;
+  int index, count;
+
+  search.file_paths = file_paths;
+  search.find_element = find_element;
+  search.find_attributes = find_attributes;
+  search.found = found;
+
+  if (workers > 1)
+    pool = g_thread_pool_new (xml_files_search_worker, &search, workers, TRUE,
+                              NULL);
+  for (index = 0; file_paths[index]; index++)
+    if (pool)
+      g_thread_pool_push (pool, GINT_TO_POINTER (index + 1), NULL);
+    else
+      xml_files_search_worker (GINT_TO_POINTER (index + 1), &search);
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  count = 0;
+  for (index = 0; file_paths[index]; index++)
+    count += found[index];
+  return count;
+}
 #undef XML_FILE_BUFFER_SIZE
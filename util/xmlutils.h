@@ -59,18 +59,64 @@ xml_handle_text (context_data_t *, const gchar *, gsize);
  */
 typedef GSList *entities_t;
 
+/**
+ * @brief Region that the nodes of an entity tree can be allocated from.
+ */
+typedef struct entity_arena_s *entity_arena_t;
+
+/**
+ * @brief Index of the children of an entity, by name.
+ */
+typedef struct entity_child_index_s *entity_child_index_t;
+
 /**
  * @brief XML element.
  */
 struct entity_s
 {
-  char *name;             ///< Name.
-  char *text;             ///< Text.
-  GHashTable *attributes; ///< Attributes.
-  entities_t entities;    ///< Children.
+  char *name;                       ///< Name.
+  char *text;                       ///< Text.
+  GHashTable *attributes;           ///< Attributes.
+  entities_t entities;              ///< Children.
+  entity_arena_t arena;             ///< Arena of the tree, or NULL.
+  gchar **attribute_pairs;          ///< Attributes, in an arena tree.
+  entity_child_index_t child_index; ///< Children by name, or NULL.
 };
 typedef struct entity_s *entity_t;
 
+/**
+ * @brief Iterator over the children of an entity that have a given name.
+ */
+typedef struct
+{
+  const char *name;    ///< Name of the children.
+  entities_t next;     ///< Next child to check, when not indexed.
+  GPtrArray *children; ///< Children with the name, when indexed.
+  guint position;      ///< Position of the next child in children.
+} entity_child_iter_t;
+
+/**
+ * @brief Handlers for reading XML as a stream of events.
+ *
+ * Depths start at 0 for the first element.  Any handler can be NULL.  The
+ * elements within a captured element only reach the entity handler, as part
+ * of the captured tree.
+ */
+typedef struct
+{
+  /** Start of an element, with its attributes. */
+  void (*start_element) (const gchar *, const gchar **, const gchar **, int,
+                         gpointer);
+  /** End of an element. */
+  void (*end_element) (const gchar *, int, gpointer);
+  /** Text of an element, in one or more pieces. */
+  void (*text) (const gchar *, gsize, int, gpointer);
+  /** A captured element.  The handler must free it with free_entity. */
+  void (*entity) (entity_t, int, gpointer);
+  /** NULL-terminated names of elements to capture whole, or NULL. */
+  const gchar **capture;
+} xml_stream_handlers_t;
+
 /**
  * @brief Data for xml search functions.
  */
@@ -94,6 +140,12 @@ int compare_entities (entity_t, entity_t);
 entity_t
 entity_child (entity_t, const char *);
 
+void
+entity_child_iter_init (entity_child_iter_t *, entity_t, const char *);
+
+entity_t
+entity_child_iter_next (entity_child_iter_t *);
+
 const char *
 entity_attribute (entity_t, const char *);
 
@@ -132,6 +184,17 @@ try_read_entity (gnutls_session_t *, int, entity_t *);
 int
 try_read_entity_c (gvm_connection_t *, int, entity_t *);
 
+int
+try_read_entity_arena_c (gvm_connection_t *, int, entity_t *);
+
+int
+try_read_xml_stream (gnutls_session_t *, int, const xml_stream_handlers_t *,
+                     gpointer);
+
+int
+try_read_xml_stream_c (gvm_connection_t *, int, const xml_stream_handlers_t *,
+                       gpointer);
+
 int
 read_entity (gnutls_session_t *, entity_t *);
 
@@ -141,6 +204,9 @@ read_entity_s (int, entity_t *);
 int
 read_entity_c (gvm_connection_t *, entity_t *);
 
+int
+read_entities_c (gvm_connection_t *, guint, GPtrArray *);
+
 int
 read_string (gnutls_session_t *, GString **);
 
@@ -150,9 +216,18 @@ read_string_c (gvm_connection_t *, GString **);
 int
 parse_entity (const char *, entity_t *);
 
+int
+parse_entity_arena (const char *, entity_t *);
+
 void
 print_entity_to_string (entity_t entity, GString *string);
 
+int
+print_entity_to_fd (int, entity_t);
+
+int
+print_entity_c (gvm_connection_t *, entity_t);
+
 int xml_count_entities (entities_t);
 
 void
@@ -163,4 +238,7 @@ xml_string_append (GString *, const char *, ...);
 int
 find_element_in_xml_file (gchar *, gchar *, GHashTable *);
 
+int
+find_element_in_xml_files (gchar **, gchar *, GHashTable *, int *, int);
+
 #endif /* not _GVM_XMLUTILS_H */